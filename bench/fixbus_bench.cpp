@@ -0,0 +1,144 @@
+// Throughput of the shared-memory fix bus: one writer thread publishes
+// batches of fixes as fast as it can while reader threads follow it, and
+// each side reports fixes per second plus the records readers lost to
+// overruns. Writer and readers share one process, but only the mapping
+// connects them, as it would between processes.
+//
+// Usage: gps_fixbus_bench [fixes] [readers] [capacity] [batch]
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QString>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+
+#include "fixbus.h"
+#include "gpsparser.h"
+
+namespace {
+
+struct ReaderResult
+{
+    quint64 fixes = 0;
+    quint64 overruns = 0;
+    quint64 outOfOrder = 0;
+    qint64 elapsedNs = 0;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    quint64 total = 10000000;
+    int readerCount = 2;
+    int capacity = FixBusWriter::DEFAULT_CAPACITY;
+    int batch = 64;
+    if (argc > 1) {
+        total = qMax<quint64>(1, QByteArray(argv[1]).toULongLong());
+    }
+    if (argc > 2) {
+        readerCount = qBound(0, QByteArray(argv[2]).toInt(), 64);
+    }
+    if (argc > 3) {
+        capacity = qMax(2, QByteArray(argv[3]).toInt());
+    }
+    if (argc > 4) {
+        batch = qBound(1, QByteArray(argv[4]).toInt(), 4096);
+    }
+
+    QTextStream out(stdout);
+    const QString name = QString("gps-fixbus-bench-%1").arg(QCoreApplication::applicationPid());
+    FixBusWriter writer;
+    if (!writer.create(name, capacity)) {
+        out << "Cannot create fix bus: " << writer.errorString() << '\n';
+        return 1;
+    }
+
+    std::atomic<bool> writing(true);
+    QVector<ReaderResult> results(readerCount);
+    QVector<QThread *> readers;
+    for (int r = 0; r < readerCount; ++r) {
+        ReaderResult *result = &results[r];
+        readers.append(QThread::create([&name, &writing, result]() {
+            FixBusReader reader;
+            if (!reader.attach(name, FixBusReader::Oldest)) {
+                return;
+            }
+
+            GpsFix fixes[GpsParser::MAX_FIXES_PER_DATAGRAM];
+            quint64 lastSequence = 0;
+            QElapsedTimer timer;
+            timer.start();
+            while (true) {
+                // Checked before reading: once the writer is done, an
+                // empty read means everything has been seen
+                const bool finished = !writing.load(std::memory_order_acquire);
+                const int count = reader.read(fixes, GpsParser::MAX_FIXES_PER_DATAGRAM);
+                for (int i = 0; i < count; ++i) {
+                    // The writer counts fixes in timestampMs
+                    const quint64 sequence = quint64(fixes[i].timestampMs);
+                    if (sequence <= lastSequence) {
+                        ++result->outOfOrder;
+                    }
+                    lastSequence = sequence;
+                }
+                result->fixes += quint64(count);
+                if (count == 0 && finished) {
+                    break;
+                }
+            }
+            result->elapsedNs = timer.nsecsElapsed();
+            result->overruns = reader.overruns();
+        }));
+        readers.last()->start();
+    }
+
+    QVector<GpsFix> fixes(batch);
+    for (int i = 0; i < batch; ++i) {
+        fixes[i].latitude = 52.52;
+        fixes[i].longitude = 13.405;
+        fixes[i].deviceId = quint32(i + 1);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    quint64 published = 0;
+    while (published < total) {
+        const int count = int(qMin<quint64>(quint64(batch), total - published));
+        for (int i = 0; i < count; ++i) {
+            fixes[i].timestampMs = qint64(published + quint64(i) + 1);
+        }
+        writer.publish(fixes.constData(), count);
+        published += quint64(count);
+    }
+    const qint64 writeNs = timer.nsecsElapsed();
+    writing.store(false, std::memory_order_release);
+
+    for (QThread *thread : qAsConst(readers)) {
+        thread->wait();
+        delete thread;
+    }
+
+    out << "Fixes: " << total << ", batch " << batch << ", ring " << capacity << " records\n";
+    out << QString("Writer:   %1 Mfixes/s, %2 ns/fix\n")
+               .arg(total / (writeNs / 1e9) / 1e6, 0, 'f', 2)
+               .arg(double(writeNs) / total, 0, 'f', 1);
+    for (int r = 0; r < readerCount; ++r) {
+        const ReaderResult &result = results[r];
+        out << QString("Reader %1: %2 Mfixes/s, %3 read, %4 overruns, %5 out of order\n")
+                   .arg(r)
+                   .arg(result.fixes / (qMax<qint64>(1, result.elapsedNs) / 1e9) / 1e6, 0, 'f', 2)
+                   .arg(result.fixes)
+                   .arg(result.overruns)
+                   .arg(result.outOfOrder);
+    }
+
+    writer.close();
+    return 0;
+}
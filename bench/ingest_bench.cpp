@@ -0,0 +1,328 @@
+// Headless throughput of the receive path: synthetic JSON, CSV, NMEA and
+// binary streams are sent over loopback UDP to a real UdpReceiver (worker
+// thread, batched receive, parse, projection, archive and GUI-thread
+// hand-off), and the fixes it delivers are counted. Reports datagrams/s
+// sent and received, fixes/s delivered, single-thread parse ns/datagram,
+// heap allocations per datagram on the receiving side, and where datagrams
+// were lost (socket buffer, hand-off queue, parse errors).
+//
+// Usage: gps_ingest_bench [--format json|csv|nmea|binary|all] [--rate N]
+//                         [--targets N] [--pack N] [--duration s] [--port N]
+//                         [--threads N] [--buffer KiB]
+//
+// --rate is datagrams per second (0: as fast as the sender can go).
+// --threads and --buffer set the receiver's SO_REUSEPORT fan-out and
+// SO_RCVBUF. The archive is written to a temporary directory that is
+// removed afterwards.
+
+#include <QByteArray>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QString>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QVector>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "gpsparser.h"
+#include "nmeastream.h"
+#include "synthetictraffic.h"
+#include "udpreceiver.h"
+
+// Counts heap allocations made by every thread except the sender, so the
+// figure covers the receiver thread and the GUI-thread hand-off only
+namespace {
+
+std::atomic<quint64> g_allocations(0);
+thread_local bool t_isSender = false;
+
+void *countedAllocate(std::size_t size)
+{
+    if (!t_isSender) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void *p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+const int FRAMES_PER_TARGET = 16; // Distinct datagrams per target in the send pool
+const int MAX_SENDER_SOCKETS = 256;
+const int DRAIN_WAIT_MS = 500;
+
+struct Datagram
+{
+    QByteArray payload;
+    int socket; // Index into the sender's sockets; CSV/NMEA targets are told apart by it
+};
+
+// Round-robin over targets so consecutive datagrams come from different senders
+QVector<Datagram> makePool(SyntheticTraffic::Format format, int targets, int pack)
+{
+    // Binary packs consecutive targets into one datagram
+    const bool binary = format == SyntheticTraffic::Binary;
+    const int senders = binary ? (targets + pack - 1) / pack : targets;
+    QVector<Datagram> pool;
+    pool.reserve(senders * FRAMES_PER_TARGET);
+    for (int frame = 0; frame < FRAMES_PER_TARGET; ++frame) {
+        for (int target = 0; target < senders; ++target) {
+            const QByteArray payload = SyntheticTraffic::payload(format, binary ? target * pack : target, frame, pack);
+            pool.append({ payload, target % MAX_SENDER_SOCKETS });
+        }
+    }
+    return pool;
+}
+
+double parseNsPerDatagram(SyntheticTraffic::Format format, const QVector<Datagram> &pool)
+{
+    // The calls the receiver thread makes, without the socket
+    std::vector<std::unique_ptr<NmeaStream>> streams(MAX_SENDER_SOCKETS);
+    for (auto &stream : streams) {
+        stream.reset(new NmeaStream);
+    }
+    static GpsFix fixes[GpsParser::MAX_FIXES_PER_DATAGRAM];
+    const bool nmea = format == SyntheticTraffic::Nmea;
+    const int rounds = qMax(1, 200000 / pool.size());
+
+    volatile double sink = 0.0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int round = 0; round < rounds; ++round) {
+        for (const Datagram &datagram : pool) {
+            const int count = nmea
+                ? streams[datagram.socket]->feed(datagram.payload.constData(), datagram.payload.size(),
+                                                 fixes, GpsParser::MAX_FIXES_PER_DATAGRAM)
+                : GpsParser::parse(datagram.payload.constData(), datagram.payload.size(),
+                                   fixes, GpsParser::MAX_FIXES_PER_DATAGRAM);
+            sink = sink + count;
+        }
+    }
+    return double(timer.nsecsElapsed()) / (double(rounds) * pool.size());
+}
+
+struct RunResult
+{
+    quint64 sent = 0;
+    quint64 received = 0;
+    quint64 fixes = 0;
+    quint64 parseErrors = 0;
+    quint64 queueDrops = 0;
+    quint64 allocations = 0;
+    double seconds = 0.0;
+};
+
+RunResult runIngest(const QVector<Datagram> &pool, const ReceiverConfig &config, int rate, double duration)
+{
+    RunResult result;
+    UdpReceiver receiver(UdpReceiver::WorkerThread);
+    if (!receiver.startListening(config)) {
+        return result;
+    }
+    const quint16 port = config.endpoints.first().port;
+
+    quint64 fixes = 0;
+    QObject::connect(&receiver, &UdpReceiver::gpsFixesReceived, [&fixes](const QVector<GpsFix> &batch) {
+        fixes += batch.size();
+    });
+
+    const quint64 receivedBefore = receiver.datagramsReceived();
+    const quint64 errorsBefore = receiver.parseErrors();
+    const quint64 dropsBefore = receiver.droppedFixes();
+    const quint64 allocationsBefore = g_allocations.load();
+
+    std::atomic<quint64> sent(0);
+    QThread *sender = QThread::create([&pool, &sent, port, rate, duration]() {
+        t_isSender = true;
+        std::vector<std::unique_ptr<QUdpSocket>> sockets;
+        int socketCount = 0;
+        for (const Datagram &datagram : pool) {
+            socketCount = qMax(socketCount, datagram.socket + 1);
+        }
+        for (int i = 0; i < socketCount; ++i) {
+            sockets.emplace_back(new QUdpSocket);
+            sockets.back()->bind(QHostAddress::LocalHost, 0);
+        }
+
+        const QHostAddress target(QHostAddress::LocalHost);
+        QElapsedTimer clock;
+        clock.start();
+        quint64 count = 0;
+        int next = 0;
+        while (clock.nsecsElapsed() < qint64(duration * 1e9)) {
+            // Paced in small bursts; unpaced when rate is 0
+            const quint64 due = rate > 0 ? quint64(clock.nsecsElapsed() * 1e-9 * rate) + 1 : count + 64;
+            if (count >= due) {
+                QThread::usleep(100);
+                continue;
+            }
+            while (count < due) {
+                const Datagram &datagram = pool[next];
+                sockets[datagram.socket]->writeDatagram(datagram.payload.constData(), datagram.payload.size(),
+                                                        target, port);
+                next = next + 1 == pool.size() ? 0 : next + 1;
+                ++count;
+            }
+        }
+        sent.store(count);
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    QEventLoop loop;
+    QObject::connect(sender, &QThread::finished, &loop, &QEventLoop::quit);
+    sender->start();
+    loop.exec();
+
+    // Let the receiver work off what is still queued
+    QTimer::singleShot(DRAIN_WAIT_MS, &loop, &QEventLoop::quit);
+    loop.exec();
+    result.seconds = double(timer.nsecsElapsed()) * 1e-9 - DRAIN_WAIT_MS / 1000.0;
+
+    result.sent = sent.load();
+    result.received = receiver.datagramsReceived() - receivedBefore;
+    result.parseErrors = receiver.parseErrors() - errorsBefore;
+    result.queueDrops = receiver.droppedFixes() - dropsBefore;
+    result.allocations = g_allocations.load() - allocationsBefore;
+    result.fixes = fixes;
+
+    sender->wait();
+    delete sender;
+    receiver.stopListening();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "format", "json, csv, nmea, binary or all.", "format", "all" });
+    parser.addOption({ "rate", "Datagrams per second, 0 for unpaced.", "rate", "100000" });
+    parser.addOption({ "targets", "Number of simulated devices.", "targets", "100" });
+    parser.addOption({ "pack", "Fixes per binary datagram.", "pack", "32" });
+    parser.addOption({ "duration", "Seconds per format.", "seconds", "5" });
+    parser.addOption({ "port", "UDP port to receive on.", "port", "45454" });
+    parser.addOption({ "threads", "Receiver threads (SO_REUSEPORT).", "threads", "1" });
+    parser.addOption({ "buffer", "Socket receive buffer in KiB, 0 for the default.", "KiB", "0" });
+    parser.process(app);
+
+    const int rate = qMax(0, parser.value("rate").toInt());
+    const int targets = qMax(1, parser.value("targets").toInt());
+    const int pack = qBound(1, parser.value("pack").toInt(), int(GpsParser::MAX_FIXES_PER_DATAGRAM));
+    const double duration = qMax(0.1, parser.value("duration").toDouble());
+    const quint16 port = quint16(parser.value("port").toUInt());
+    ReceiverConfig config;
+    config.endpoints.append(ReceiverEndpoint());
+    config.endpoints.first().port = port;
+    config.threads = qMax(1, parser.value("threads").toInt());
+    config.receiveBufferBytes = qMax(0, parser.value("buffer").toInt()) * 1024;
+    QVector<SyntheticTraffic::Format> formats = { SyntheticTraffic::Json, SyntheticTraffic::Csv,
+                                                  SyntheticTraffic::Nmea, SyntheticTraffic::Binary };
+    if (parser.value("format") != "all") {
+        SyntheticTraffic::Format format;
+        if (!SyntheticTraffic::formatFromName(parser.value("format"), format)) {
+            parser.showHelp(1);
+        }
+        formats = { format };
+    }
+
+    // Keep the benchmark's fixes out of the user's track archive
+    QTemporaryDir archiveDir;
+    qputenv("GPS_ARCHIVE_DIR", archiveDir.path().toLocal8Bit());
+
+    QTextStream out(stdout);
+    out << QString("targets %1, rate %2/s, %3 s per format, %4 receiver thread(s)\n\n")
+               .arg(targets).arg(rate > 0 ? QString::number(rate) : QString("unpaced")).arg(duration)
+               .arg(config.threads);
+    out << "format     sent/s     recv/s    fixes/s  parse ns/dgram  allocs/dgram  "
+           "socket drop%  queue drop%  errors\n";
+    out.flush();
+
+    for (SyntheticTraffic::Format format : qAsConst(formats)) {
+        const QString name = SyntheticTraffic::formatName(format);
+        const QVector<Datagram> pool = makePool(format, targets, pack);
+        const double parseNs = parseNsPerDatagram(format, pool);
+        const RunResult result = runIngest(pool, config, rate, duration);
+        if (result.seconds <= 0.0 || result.sent == 0) {
+            out << QString("%1 could not receive on port %2\n").arg(name, -6).arg(port);
+            continue;
+        }
+
+        const double received = double(qMax<quint64>(1, result.received));
+        const quint64 lost = result.sent > result.received ? result.sent - result.received : 0;
+        const int fixesPerDatagram = format == SyntheticTraffic::Binary ? pack : 1;
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+                   .arg(name, -6)
+                   .arg(result.sent / result.seconds, 10, 'f', 0)
+                   .arg(result.received / result.seconds, 10, 'f', 0)
+                   .arg(result.fixes / result.seconds, 10, 'f', 0)
+                   .arg(parseNs, 15, 'f', 1)
+                   .arg(result.allocations / received, 13, 'f', 2)
+                   .arg(100.0 * lost / result.sent, 13, 'f', 2)
+                   .arg(100.0 * result.queueDrops / qMax(1.0, received * fixesPerDatagram), 12, 'f', 2)
+                   .arg(result.parseErrors, 7);
+        out.flush();
+    }
+
+    return 0;
+}
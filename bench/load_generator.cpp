@@ -0,0 +1,414 @@
+// UDP load generator for finding where UdpReceiver starts dropping: sends
+// JSON, CSV, NMEA and binary fixes from many simulated devices at a fixed
+// or ramping rate, in bursts, with a share of malformed datagrams, and on
+// Linux hands whole batches to the kernel with sendmmsg(). One line is
+// printed per second so the receiver's counters can be lined up with the
+// offered load.
+//
+// Usage: gps_load_generator [--host H] [--port N] [--format F|mixed]
+//                           [--devices N] [--rate N] [--ramp N] [--burst N]
+//                           [--batch N] [--pack N] [--malformed R]
+//                           [--duration s]
+//
+// --rate is datagrams per second (0: as fast as possible) and --ramp adds
+// that many every second. With --burst B the datagrams of each interval go
+// out B at a time, back to back. --malformed is the fraction (0-1) of
+// datagrams replaced by damaged ones the parser must reject.
+
+#include <QByteArray>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QString>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+#include "gpsparser.h"
+#include "synthetictraffic.h"
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#else
+#include <QUdpSocket>
+#endif
+
+namespace {
+
+const int MAX_SOCKETS = 1024;        // Source ports; CSV/NMEA devices beyond this share one
+const int POOL_DATAGRAMS = 1 << 20;  // Upper bound on pre-built datagrams
+const int MAX_FRAMES = 16;           // Distinct positions per device
+const int MAX_BATCH = 1024;          // UIO_MAXIOV
+const int SEND_BUFFER_BYTES = 4 * 1024 * 1024;
+const int SPIN_THRESHOLD_US = 100;   // Shorter waits spin instead of sleeping
+
+struct Entry
+{
+    QByteArray payload;
+    SyntheticTraffic::Format format;
+    int fixes;
+};
+
+// One source port and the datagrams it sends, in order
+class SourceSocket
+{
+public:
+    SourceSocket()
+        : m_next(0)
+#ifdef Q_OS_LINUX
+        , m_fd(-1)
+#endif
+    {
+    }
+
+    ~SourceSocket()
+    {
+#ifdef Q_OS_LINUX
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+#endif
+    }
+
+    bool open(const QHostAddress &host, quint16 port, QString &error)
+    {
+#ifdef Q_OS_LINUX
+        const bool ipv6 = host.protocol() == QAbstractSocket::IPv6Protocol;
+        m_fd = ::socket(ipv6 ? AF_INET6 : AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (m_fd < 0) {
+            error = QString::fromLocal8Bit(std::strerror(errno));
+            return false;
+        }
+        int bufferSize = SEND_BUFFER_BYTES;
+        ::setsockopt(m_fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+        // Connected, so every message can go out without an address
+        sockaddr_storage address;
+        std::memset(&address, 0, sizeof(address));
+        socklen_t length = 0;
+        if (ipv6) {
+            sockaddr_in6 *in6 = reinterpret_cast<sockaddr_in6 *>(&address);
+            in6->sin6_family = AF_INET6;
+            in6->sin6_port = htons(port);
+            const Q_IPV6ADDR bytes = host.toIPv6Address();
+            std::memcpy(&in6->sin6_addr, &bytes, sizeof(bytes));
+            length = sizeof(sockaddr_in6);
+        } else {
+            sockaddr_in *in4 = reinterpret_cast<sockaddr_in *>(&address);
+            in4->sin_family = AF_INET;
+            in4->sin_port = htons(port);
+            in4->sin_addr.s_addr = htonl(host.toIPv4Address());
+            length = sizeof(sockaddr_in);
+        }
+        if (::connect(m_fd, reinterpret_cast<sockaddr *>(&address), length) != 0) {
+            error = QString::fromLocal8Bit(std::strerror(errno));
+            return false;
+        }
+        return true;
+#else
+        m_socket.reset(new QUdpSocket);
+        m_socket->connectToHost(host, port);
+        if (!m_socket->waitForConnected()) {
+            error = m_socket->errorString();
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    void append(const Entry &entry)
+    {
+        m_entries.append(entry);
+    }
+
+    // Sends up to count datagrams, substituting malformed ones where
+    // isMalformed() says so; returns how many the kernel took, -1 on error
+    template<typename Picker>
+    int send(int count, Picker isMalformed, const QVector<QByteArray> *malformedPool,
+             quint64 &fixes, quint64 &malformed)
+    {
+        count = qMin(count, MAX_BATCH);
+        const QByteArray *payloads[MAX_BATCH];
+        int fixCounts[MAX_BATCH];
+        for (int i = 0; i < count; ++i) {
+            const Entry &entry = m_entries[(m_next + i) % m_entries.size()];
+            if (isMalformed()) {
+                const QVector<QByteArray> &damaged = malformedPool[entry.format];
+                payloads[i] = &damaged[(m_next + i) % damaged.size()];
+                fixCounts[i] = -1;
+            } else {
+                payloads[i] = &entry.payload;
+                fixCounts[i] = entry.fixes;
+            }
+        }
+
+#ifdef Q_OS_LINUX
+        mmsghdr headers[MAX_BATCH];
+        iovec iovecs[MAX_BATCH];
+        std::memset(headers, 0, sizeof(mmsghdr) * count);
+        for (int i = 0; i < count; ++i) {
+            iovecs[i].iov_base = const_cast<char *>(payloads[i]->constData());
+            iovecs[i].iov_len = size_t(payloads[i]->size());
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+        const int sent = ::sendmmsg(m_fd, headers, unsigned(count), 0);
+#else
+        int sent = 0;
+        while (sent < count && m_socket->write(*payloads[sent]) >= 0) {
+            ++sent;
+        }
+        if (sent == 0) {
+            sent = -1;
+        }
+#endif
+        for (int i = 0; i < sent; ++i) {
+            if (fixCounts[i] < 0) {
+                ++malformed;
+            } else {
+                fixes += quint64(fixCounts[i]);
+            }
+        }
+        if (sent > 0) {
+            m_next = (m_next + sent) % m_entries.size();
+        }
+        return sent;
+    }
+
+private:
+    QVector<Entry> m_entries;
+    int m_next;
+#ifdef Q_OS_LINUX
+    int m_fd;
+#else
+    std::unique_ptr<QUdpSocket> m_socket;
+#endif
+};
+
+// xorshift32; cheap enough to call per datagram
+class Random
+{
+public:
+    explicit Random(quint32 seed)
+        : m_state(seed ? seed : 1)
+    {
+    }
+
+    quint32 next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+private:
+    quint32 m_state;
+};
+
+bool resolve(const QString &host, QHostAddress &address)
+{
+    if (address.setAddress(host)) {
+        return true;
+    }
+    const QHostInfo info = QHostInfo::fromName(host);
+    for (const QHostAddress &candidate : info.addresses()) {
+        if (candidate.protocol() == QAbstractSocket::IPv4Protocol) {
+            address = candidate;
+            return true;
+        }
+    }
+    if (!info.addresses().isEmpty()) {
+        address = info.addresses().first();
+        return true;
+    }
+    return false;
+}
+
+void waitUntil(const QElapsedTimer &clock, qint64 deadlineNs)
+{
+    const qint64 remainingUs = (deadlineNs - clock.nsecsElapsed()) / 1000;
+    if (remainingUs > SPIN_THRESHOLD_US) {
+        QThread::usleep(quint64(remainingUs - SPIN_THRESHOLD_US / 2));
+    }
+    while (clock.nsecsElapsed() < deadlineNs) {
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "host", "Target host.", "host", "127.0.0.1" });
+    parser.addOption({ "port", "Target port.", "port", "12345" });
+    parser.addOption({ "format", "json, csv, nmea, binary, or mixed for all four.", "format", "binary" });
+    parser.addOption({ "devices", "Simulated devices.", "count", "1000" });
+    parser.addOption({ "rate", "Datagrams per second, 0 for unpaced.", "rate", "10000" });
+    parser.addOption({ "ramp", "Datagrams per second added every second.", "rate", "0" });
+    parser.addOption({ "burst", "Datagrams released back to back at each pacing step.", "count", "1" });
+    parser.addOption({ "batch", "Datagrams per sendmmsg() call.", "count", "64" });
+    parser.addOption({ "pack", "Fixes per binary datagram.", "count", "32" });
+    parser.addOption({ "malformed", "Fraction of malformed datagrams, 0-1.", "ratio", "0" });
+    parser.addOption({ "duration", "Seconds to run.", "seconds", "10" });
+    parser.process(app);
+
+    QTextStream out(stdout);
+
+    QHostAddress host;
+    if (!resolve(parser.value("host"), host)) {
+        out << "Unknown host " << parser.value("host") << '\n';
+        return 1;
+    }
+    const quint16 port = quint16(parser.value("port").toUInt());
+    const int devices = qMax(1, parser.value("devices").toInt());
+    const int pack = qBound(1, parser.value("pack").toInt(), int(GpsParser::MAX_FIXES_PER_DATAGRAM));
+    const qint64 ramp = qMax(0, parser.value("ramp").toInt());
+    const int burst = qMax(1, parser.value("burst").toInt());
+    const int batch = qBound(1, parser.value("batch").toInt(), MAX_BATCH);
+    const double malformedRatio = qBound(0.0, parser.value("malformed").toDouble(), 1.0);
+    const double duration = qMax(0.1, parser.value("duration").toDouble());
+    qint64 rate = qMax(0, parser.value("rate").toInt());
+
+    QVector<SyntheticTraffic::Format> formats;
+    if (parser.value("format") == "mixed") {
+        formats = { SyntheticTraffic::Json, SyntheticTraffic::Csv, SyntheticTraffic::Nmea, SyntheticTraffic::Binary };
+    } else {
+        SyntheticTraffic::Format format;
+        if (!SyntheticTraffic::formatFromName(parser.value("format"), format)) {
+            parser.showHelp(1);
+        }
+        formats = { format };
+    }
+
+    // A sending unit is one device, or one datagram's worth of devices for
+    // binary; units take turns on the source sockets. Mixed traffic sends
+    // one record per binary datagram so every unit is one device.
+    const bool binaryOnly = formats.size() == 1 && formats.first() == SyntheticTraffic::Binary;
+    const int binaryPack = binaryOnly ? pack : 1;
+    const int units = (devices + binaryPack - 1) / binaryPack;
+    const int socketCount = qMin(units, MAX_SOCKETS);
+    const int frames = qBound(1, POOL_DATAGRAMS / units, MAX_FRAMES);
+
+    std::vector<std::unique_ptr<SourceSocket>> sockets;
+    for (int i = 0; i < socketCount; ++i) {
+        sockets.emplace_back(new SourceSocket);
+        QString error;
+        if (!sockets.back()->open(host, port, error)) {
+            out << "Cannot open socket " << i << ": " << error << '\n';
+            return 1;
+        }
+    }
+
+    QVector<QByteArray> malformedPool[SyntheticTraffic::Binary + 1];
+    for (SyntheticTraffic::Format format : qAsConst(formats)) {
+        const QByteArray valid = SyntheticTraffic::payload(format, 0, 0, binaryPack);
+        for (int variant = 0; variant < 2; ++variant) {
+            malformedPool[format].append(SyntheticTraffic::malformed(format, valid, variant));
+        }
+    }
+
+    for (int frame = 0; frame < frames; ++frame) {
+        for (int unit = 0; unit < units; ++unit) {
+            const SyntheticTraffic::Format format = formats[unit % formats.size()];
+            const int device = unit * binaryPack;
+            const int fixes = format == SyntheticTraffic::Binary ? qMin(binaryPack, devices - device) : 1;
+            sockets[unit % socketCount]->append(
+                { SyntheticTraffic::payload(format, device, frame, fixes), format, fixes });
+        }
+    }
+
+    out << QString("%1 devices from %2 sockets to %3:%4, %5, batch %6, burst %7, %8% malformed\n")
+               .arg(devices).arg(socketCount).arg(host.toString()).arg(port)
+               .arg(parser.value("format")).arg(batch).arg(burst).arg(malformedRatio * 100.0, 0, 'f', 1);
+    out << "   second   target/s  datagrams/s     fixes/s  malformed/s  send errors\n";
+    out.flush();
+
+    Random random(0x9e3779b9u);
+    const quint32 malformedThreshold = quint32(malformedRatio * 4294967295.0);
+    auto isMalformed = [&random, malformedThreshold, malformedRatio]() {
+        return malformedRatio > 0.0 && random.next() <= malformedThreshold;
+    };
+
+    quint64 totalSent = 0;
+    quint64 totalFixes = 0;
+    quint64 totalMalformed = 0;
+    quint64 totalErrors = 0;
+    int nextSocket = 0;
+
+    QElapsedTimer clock;
+    clock.start();
+    const qint64 endNs = qint64(duration * 1e9);
+    for (int second = 0; qint64(second) * 1000000000 < endNs; ++second) {
+        // Each second starts a fresh pacing window at the current rate
+        const qint64 windowStartNs = qint64(second) * 1000000000;
+        const qint64 windowEndNs = qMin(windowStartNs + 1000000000, endNs);
+        quint64 sent = 0;
+        quint64 fixes = 0;
+        quint64 malformed = 0;
+        quint64 errors = 0;
+
+        while (clock.nsecsElapsed() < windowEndNs) {
+            int count = batch;
+            if (rate > 0) {
+                // Datagrams released so far in this window, a burst at a time
+                const qint64 elapsedNs = clock.nsecsElapsed() - windowStartNs;
+                const quint64 bursts = quint64(elapsedNs * rate / burst / 1000000000) + 1;
+                const quint64 released = qMin<quint64>(bursts * burst, quint64(rate));
+                if (sent >= released) {
+                    if (released >= quint64(rate)) {
+                        break;
+                    }
+                    waitUntil(clock, windowStartNs + qint64(bursts * burst * 1000000000 / rate));
+                    continue;
+                }
+                count = int(qMin<quint64>(released - sent, quint64(batch)));
+            }
+
+            SourceSocket &socket = *sockets[nextSocket];
+            nextSocket = (nextSocket + 1) % socketCount;
+            const int result = socket.send(count, isMalformed, malformedPool, fixes, malformed);
+            if (result < 0) {
+                ++errors;
+            } else {
+                sent += quint64(result);
+            }
+        }
+        waitUntil(clock, windowEndNs);
+
+        const double seconds = (windowEndNs - windowStartNs) / 1e9;
+        out << QString("%1 %2 %3 %4 %5 %6\n")
+                   .arg(second + 1, 9)
+                   .arg(rate > 0 ? QString::number(rate) : QString("max"), 10)
+                   .arg(sent / seconds, 12, 'f', 0)
+                   .arg(fixes / seconds, 11, 'f', 0)
+                   .arg(malformed / seconds, 12, 'f', 0)
+                   .arg(errors, 12);
+        out.flush();
+
+        totalSent += sent;
+        totalFixes += fixes;
+        totalMalformed += malformed;
+        totalErrors += errors;
+        if (rate > 0) {
+            rate += ramp;
+        }
+    }
+
+    out << QString("\n%1 datagrams, %2 fixes, %3 malformed, %4 send errors in %5 s\n")
+               .arg(totalSent).arg(totalFixes).arg(totalMalformed).arg(totalErrors)
+               .arg(clock.nsecsElapsed() / 1e9, 0, 'f', 1);
+    return 0;
+}
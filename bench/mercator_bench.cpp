@@ -0,0 +1,93 @@
+// Cost of projecting live fixes to EPSG:3857: QgsCoordinateTransform/PROJ,
+// the scalar WebMercator path and its SIMD batch kernel, plus the largest
+// deviation of each fast path from PROJ.
+//
+// Usage: gps_mercator_bench [points]
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+
+#include <qgsapplication.h>
+#include <qgscoordinatereferencesystem.h>
+#include <qgscoordinatetransform.h>
+#include <qgsproject.h>
+
+#include <cmath>
+
+#include "webmercator.h"
+
+namespace {
+
+double maxDeviation(const QVector<double> &x, const QVector<double> &y,
+                    const QVector<double> &referenceX, const QVector<double> &referenceY)
+{
+    double deviation = 0.0;
+    for (int i = 0; i < x.size(); ++i) {
+        deviation = qMax(deviation, std::hypot(x[i] - referenceX[i], y[i] - referenceY[i]));
+    }
+    return deviation;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QgsApplication app(argc, argv, false);
+    QgsApplication::initQgis();
+
+    int count = 1000000;
+    if (argc > 1) {
+        count = qMax(2, QByteArray(argv[1]).toInt());
+    }
+
+    // Positions within the latitude range Web Mercator can show
+    QVector<double> longitude(count);
+    QVector<double> latitude(count);
+    QRandomGenerator random(42);
+    for (int i = 0; i < count; ++i) {
+        longitude[i] = random.bounded(360.0) - 180.0;
+        latitude[i] = random.bounded(2 * WebMercator::MAX_LATITUDE) - WebMercator::MAX_LATITUDE;
+    }
+
+    QElapsedTimer timer;
+
+    QVector<double> projX = longitude;
+    QVector<double> projY = latitude;
+    QVector<double> projZ(count, 0.0);
+    QgsCoordinateTransform transform(QgsCoordinateReferenceSystem("EPSG:4326"),
+                                     QgsCoordinateReferenceSystem("EPSG:3857"),
+                                     QgsProject::instance());
+    timer.start();
+    transform.transformCoords(count, projX.data(), projY.data(), projZ.data());
+    const double projNs = double(timer.nsecsElapsed()) / count;
+
+    QVector<double> scalarX(count);
+    QVector<double> scalarY(count);
+    timer.restart();
+    for (int i = 0; i < count; ++i) {
+        WebMercator::project(longitude[i], latitude[i], scalarX[i], scalarY[i]);
+    }
+    const double scalarNs = double(timer.nsecsElapsed()) / count;
+
+    QVector<double> batchX(count);
+    QVector<double> batchY(count);
+    timer.restart();
+    WebMercator::project(longitude.constData(), latitude.constData(), batchX.data(), batchY.data(), count);
+    const double batchNs = double(timer.nsecsElapsed()) / count;
+
+    QTextStream out(stdout);
+    out << QString("%1 points, SIMD kernel: %2\n").arg(count).arg(WebMercator::hasSimdKernel() ? "yes" : "no");
+    out << "path                 ns/point   max deviation from PROJ (m)\n";
+    out << QString("%1 %2 %3\n").arg("PROJ", -20).arg(projNs, 8, 'f', 1).arg(0.0, 29, 'g', 3);
+    out << QString("%1 %2 %3\n").arg("WebMercator scalar", -20).arg(scalarNs, 8, 'f', 1)
+               .arg(maxDeviation(scalarX, scalarY, projX, projY), 29, 'g', 3);
+    out << QString("%1 %2 %3\n").arg("WebMercator batch", -20).arg(batchNs, 8, 'f', 1)
+               .arg(maxDeviation(batchX, batchY, projX, projY), 29, 'g', 3);
+
+    QgsApplication::exitQgis();
+    return 0;
+}
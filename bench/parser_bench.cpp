@@ -0,0 +1,260 @@
+// Per-format parse cost of the single-pass GpsParser compared with the
+// previous JSON -> CSV -> NMEA try-chain in UdpReceiver, followed by the
+// per-fix wire size and decode cost of each format including packed binary.
+//
+// Usage: gps_parser_bench [iterations]
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QtEndian>
+
+#include "gpsparser.h"
+
+namespace legacy {
+
+// Verbatim copies of the parsers UdpReceiver used before GpsParser
+
+bool parseJsonFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude)
+{
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+
+    if (error.error != QJsonParseError::NoError) {
+        return false;
+    }
+
+    QJsonObject obj = doc.object();
+
+    if (!obj.contains("latitude") || !obj.contains("longitude")) {
+        return false;
+    }
+
+    latitude = obj["latitude"].toDouble();
+    longitude = obj["longitude"].toDouble();
+    altitude = obj.value("altitude").toDouble(0.0);
+
+    if (latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0) {
+        return false;
+    }
+
+    return true;
+}
+
+bool parseCSVFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude)
+{
+    QString str = QString::fromUtf8(data).trimmed();
+    QStringList parts = str.split(',');
+
+    if (parts.size() < 2) {
+        return false;
+    }
+
+    bool latOk, lonOk, altOk = true;
+    latitude = parts[0].toDouble(&latOk);
+    longitude = parts[1].toDouble(&lonOk);
+
+    if (parts.size() >= 3) {
+        altitude = parts[2].toDouble(&altOk);
+    } else {
+        altitude = 0.0;
+    }
+
+    if (!latOk || !lonOk || !altOk) {
+        return false;
+    }
+
+    if (latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0) {
+        return false;
+    }
+
+    return true;
+}
+
+bool parseNMEAFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude)
+{
+    QString str = QString::fromUtf8(data).trimmed();
+
+    if (!str.startsWith("$GPGGA")) {
+        return false;
+    }
+
+    QStringList parts = str.split(',');
+    if (parts.size() < 15) {
+        return false;
+    }
+
+    if (parts[2].isEmpty() || parts[3].isEmpty()) {
+        return false;
+    }
+
+    double lat = parts[2].left(2).toDouble() + parts[2].mid(2).toDouble() / 60.0;
+    if (parts[3] == "S") lat = -lat;
+
+    if (parts[4].isEmpty() || parts[5].isEmpty()) {
+        return false;
+    }
+
+    double lon = parts[4].left(3).toDouble() + parts[4].mid(3).toDouble() / 60.0;
+    if (parts[5] == "W") lon = -lon;
+
+    double alt = 0.0;
+    if (!parts[9].isEmpty()) {
+        alt = parts[9].toDouble();
+    }
+
+    latitude = lat;
+    longitude = lon;
+    altitude = alt;
+
+    if (latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0) {
+        return false;
+    }
+
+    return true;
+}
+
+bool parseGpsData(const QByteArray &data, double &latitude, double &longitude, double &altitude)
+{
+    return parseJsonFormat(data, latitude, longitude, altitude)
+           || parseCSVFormat(data, latitude, longitude, altitude)
+           || parseNMEAFormat(data, latitude, longitude, altitude);
+}
+
+} // namespace legacy
+
+namespace {
+
+struct Sample
+{
+    const char *name;
+    QByteArray payload;
+};
+
+// Keeps the optimizer from discarding parse results
+volatile double g_sink = 0.0;
+
+double legacyNsPerParse(const QByteArray &payload, int iterations)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        double latitude, longitude, altitude;
+        if (legacy::parseGpsData(payload, latitude, longitude, altitude)) {
+            g_sink = g_sink + latitude;
+        }
+    }
+    return double(timer.nsecsElapsed()) / iterations;
+}
+
+double parserNsPerParse(const QByteArray &payload, int iterations)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        GpsFix fix;
+        if (GpsParser::parse(payload, fix)) {
+            g_sink = g_sink + fix.latitude;
+        }
+    }
+    return double(timer.nsecsElapsed()) / iterations;
+}
+
+// Same fix as the text samples, packed count times into one binary datagram
+QByteArray binaryDatagram(int count)
+{
+    QByteArray datagram(GpsParser::BINARY_HEADER_SIZE + count * GpsParser::BINARY_RECORD_SIZE, '\0');
+    uchar *p = reinterpret_cast<uchar *>(datagram.data());
+    p[0] = GpsParser::BINARY_MAGIC;
+    p[1] = GpsParser::BINARY_MAGIC_TAG;
+    p[2] = GpsParser::BINARY_VERSION;
+    p[3] = uchar(count);
+    for (int i = 0; i < count; ++i) {
+        uchar *record = p + GpsParser::BINARY_HEADER_SIZE + i * GpsParser::BINARY_RECORD_SIZE;
+        qToLittleEndian<quint32>(quint32(i + 1), record);
+        qToLittleEndian<qint64>(Q_INT64_C(1704110400000), record + 4);
+        qToLittleEndian<qint32>(407128000, record + 12);
+        qToLittleEndian<qint32>(-740060000, record + 16);
+        qToLittleEndian<qint32>(10500, record + 20);
+        qToLittleEndian<quint16>(350, record + 28);
+        record[30] = GpsFix::HasSpeed | GpsFix::HasHeading | GpsFix::HasAccuracy;
+    }
+    return datagram;
+}
+
+double nsPerFix(const QByteArray &payload, int iterations, int &fixesPerDatagram)
+{
+    GpsFix fixes[GpsParser::MAX_FIXES_PER_DATAGRAM];
+    int decoded = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        decoded = GpsParser::parse(payload.constData(), payload.size(), fixes, GpsParser::MAX_FIXES_PER_DATAGRAM);
+        g_sink = g_sink + fixes[0].latitude;
+    }
+    fixesPerDatagram = decoded;
+    return decoded > 0 ? double(timer.nsecsElapsed()) / (double(iterations) * decoded) : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int iterations = 200000;
+    if (argc > 1) {
+        iterations = qMax(1, QByteArray(argv[1]).toInt());
+    }
+
+    // Same payload shapes as test_sender.py
+    const Sample samples[] = {
+        { "json", QByteArray("{\"latitude\": 40.712800, \"longitude\": -74.006000, \"altitude\": 10.5, "
+                             "\"timestamp\": \"2024-01-01T12:00:00\", \"accuracy\": 3.5, "
+                             "\"speed\": 0.0, \"heading\": 0.0}") },
+        { "csv", QByteArray("40.712800,-74.006000,10.50") },
+        { "nmea", QByteArray("$GPGGA,120000,4042.7680,N,07400.3600,W,1,08,1.0,10.5,M,46.9,M,,*68") },
+    };
+
+    QTextStream out(stdout);
+    out << "format   legacy ns/parse   single-pass ns/parse   speedup\n";
+    for (const Sample &sample : samples) {
+        // Warm up both paths before timing
+        legacyNsPerParse(sample.payload, iterations / 10 + 1);
+        parserNsPerParse(sample.payload, iterations / 10 + 1);
+
+        const double before = legacyNsPerParse(sample.payload, iterations);
+        const double after = parserNsPerParse(sample.payload, iterations);
+        out << QString("%1 %2 %3 %4x\n")
+                   .arg(sample.name, -6)
+                   .arg(before, 17, 'f', 1)
+                   .arg(after, 22, 'f', 1)
+                   .arg(after > 0.0 ? before / after : 0.0, 8, 'f', 1);
+    }
+
+    const Sample wireSamples[] = {
+        samples[0],
+        samples[1],
+        samples[2],
+        { "binary", binaryDatagram(1) },
+        { "binary32", binaryDatagram(32) },
+    };
+
+    out << "\nformat     bytes/fix   ns/fix\n";
+    for (const Sample &sample : wireSamples) {
+        int fixesPerDatagram = 0;
+        nsPerFix(sample.payload, iterations / 10 + 1, fixesPerDatagram);
+        const double ns = nsPerFix(sample.payload, iterations, fixesPerDatagram);
+        out << QString("%1 %2 %3\n")
+                   .arg(sample.name, -8)
+                   .arg(double(sample.payload.size()) / qMax(1, fixesPerDatagram), 11, 'f', 1)
+                   .arg(ns, 8, 'f', 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,361 @@
+// Render cost of MapWidget as the selected trail grows: for each trail
+// size a fresh widget is built on the offscreen platform, fed the trail and
+// N live markers through updatePositions(), and timed for
+//
+//   append        updatePositions() per trail fix, first and last tenth
+//   markers       one batch placing every live marker
+//   full.layers   a render job over the canvas layers
+//   full.overlay  the scene (map image, trail, markers) at the same extent
+//   pan, zoom     setExtent() + canvas refresh cycle + scene paint
+//   move          a new fix for every marker and the selected track + paint
+//   refresh       canvas refresh at an unchanged view, served from the
+//                 cached basemap tier + paint
+//
+// Results go to stdout as a table and, with --json, to a file as an array
+// of { phase, trailPoints, markers, unit, samples, median, p95, max }.
+//
+// The canvas renders with MapWidget's RenderProfile: --render-threads,
+// --sequential and --no-progressive change it to compare configurations,
+// e.g. the single-thread sequential setup of a low-core laptop.
+//
+// Usage: gps_render_bench [--points 10000,100000,1000000] [--markers N]
+//                         [--repeat N] [--size WxH] [--basemap none|osm]
+//                         [--render-threads N] [--sequential]
+//                         [--no-progressive] [--json file]
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+#include <qgsapplication.h>
+#include <qgsmapcanvas.h>
+#include <qgsmaprendererparalleljob.h>
+#include <qgsmaprenderersequentialjob.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "gpsfix.h"
+#include "mapwidget.h"
+#include "webmercator.h"
+
+namespace {
+
+const int APPEND_BATCH = 1000; // Fixes per updatePositions() while loading the trail
+const int CANVAS_TIMEOUT_MS = 30000;
+const quint32 TRAIL_DEVICE = 1;
+const double CENTER_LONGITUDE = -74.0;
+const double CENTER_LATITUDE = 40.7;
+const double TRAIL_RADIUS_DEGREES = 0.1;
+
+struct Result
+{
+    QString phase;
+    int trailPoints = 0;
+    int markers = 0;
+    QString unit;
+    int samples = 0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double max = 0.0;
+};
+
+Result summarize(const QString &phase, int trailPoints, int markers, const QString &unit, QVector<double> values)
+{
+    Result result;
+    result.phase = phase;
+    result.trailPoints = trailPoints;
+    result.markers = markers;
+    result.unit = unit;
+    result.samples = values.size();
+    if (!values.isEmpty()) {
+        std::sort(values.begin(), values.end());
+        result.median = values[values.size() / 2];
+        result.p95 = values[qMin(values.size() - 1, int(std::ceil(values.size() * 0.95)) - 1)];
+        result.max = values.last();
+    }
+    return result;
+}
+
+// A Lissajous figure around the centre: it keeps crossing itself, so the
+// trail stays dense on screen whatever its length
+GpsFix trailFix(int index)
+{
+    const double t = index * 1e-4;
+    GpsFix fix;
+    fix.deviceId = TRAIL_DEVICE;
+    fix.longitude = CENTER_LONGITUDE + TRAIL_RADIUS_DEGREES * std::sin(3.0 * t);
+    fix.latitude = CENTER_LATITUDE + TRAIL_RADIUS_DEGREES * std::sin(4.0 * t + 0.5);
+    fix.altitude = 10.0;
+    fix.timestampMs = Q_INT64_C(1773576000000) + index * Q_INT64_C(1000);
+    WebMercator::project(fix.longitude, fix.latitude, fix.mapX, fix.mapY);
+    return fix;
+}
+
+// Marker m on a grid over the trail's area, nudged by step
+GpsFix markerFix(int marker, int markers, int step)
+{
+    const int columns = qMax(1, int(std::sqrt(double(markers))));
+    GpsFix fix;
+    fix.deviceId = TRAIL_DEVICE + 1 + quint32(marker);
+    fix.longitude = CENTER_LONGITUDE - TRAIL_RADIUS_DEGREES
+                    + 2.0 * TRAIL_RADIUS_DEGREES * (marker % columns) / columns + step * 1e-5;
+    fix.latitude = CENTER_LATITUDE - TRAIL_RADIUS_DEGREES
+                   + 2.0 * TRAIL_RADIUS_DEGREES * (marker / columns) / columns + step * 1e-5;
+    fix.altitude = 10.0;
+    fix.timestampMs = Q_INT64_C(1773576000000) + step * Q_INT64_C(1000);
+    WebMercator::project(fix.longitude, fix.latitude, fix.mapX, fix.mapY);
+    return fix;
+}
+
+// One canvas refresh cycle, from refresh() to the render job finishing
+double refreshCanvas(QgsMapCanvas *canvas)
+{
+    QEventLoop loop;
+    QObject::connect(canvas, &QgsMapCanvas::mapCanvasRefreshed, &loop, &QEventLoop::quit);
+    QTimer::singleShot(CANVAS_TIMEOUT_MS, &loop, &QEventLoop::quit);
+
+    QElapsedTimer timer;
+    timer.start();
+    canvas->refresh();
+    loop.exec();
+    return timer.nsecsElapsed() / 1e6;
+}
+
+// Paints the visible part of the scene the way the viewport does
+double paintScene(QgsMapCanvas *canvas, QImage &image)
+{
+    QElapsedTimer timer;
+    timer.start();
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    canvas->scene()->render(&painter, QRectF(image.rect()),
+                            canvas->mapToScene(canvas->viewport()->rect()).boundingRect());
+    painter.end();
+    return timer.nsecsElapsed() / 1e6;
+}
+
+QVector<Result> runTrailSize(int trailPoints, int markers, int repeat, const QSize &size, bool basemap,
+                             const RenderProfile &profile)
+{
+    QVector<Result> results;
+
+    MapWidget widget;
+    widget.setRenderProfile(profile);
+    widget.resize(size);
+    widget.show();
+    QgsMapCanvas *canvas = widget.mapCanvas();
+    if (basemap) {
+        widget.addBaseMap();
+    }
+    refreshCanvas(canvas);
+
+    // Trail: the first fix selects the trail device
+    QVector<double> appendNs;
+    QVector<GpsFix> batch;
+    batch.reserve(APPEND_BATCH);
+    QElapsedTimer timer;
+    for (int first = 0; first < trailPoints; first += APPEND_BATCH) {
+        batch.clear();
+        for (int i = first; i < qMin(trailPoints, first + APPEND_BATCH); ++i) {
+            batch.append(trailFix(i));
+        }
+        timer.start();
+        widget.updatePositions(batch);
+        appendNs.append(double(timer.nsecsElapsed()) / batch.size());
+    }
+    const int tenth = qMax(1, appendNs.size() / 10);
+    results.append(summarize("append.first", trailPoints, markers, "ns/fix", appendNs.mid(0, tenth)));
+    results.append(summarize("append.last", trailPoints, markers, "ns/fix", appendNs.mid(appendNs.size() - tenth)));
+
+    batch.clear();
+    for (int marker = 0; marker < markers; ++marker) {
+        batch.append(markerFix(marker, markers, 0));
+    }
+    timer.start();
+    widget.updatePositions(batch);
+    results.append(summarize("markers", trailPoints, markers, "ms", QVector<double>{ timer.nsecsElapsed() / 1e6 }));
+
+    // Whole trail on screen
+    double minX = 0.0;
+    double minY = 0.0;
+    double maxX = 0.0;
+    double maxY = 0.0;
+    WebMercator::project(CENTER_LONGITUDE - TRAIL_RADIUS_DEGREES, CENTER_LATITUDE - TRAIL_RADIUS_DEGREES, minX, minY);
+    WebMercator::project(CENTER_LONGITUDE + TRAIL_RADIUS_DEGREES, CENTER_LATITUDE + TRAIL_RADIUS_DEGREES, maxX, maxY);
+    const QgsRectangle extent(minX, minY, maxX, maxY);
+    canvas->setExtent(extent);
+    refreshCanvas(canvas);
+
+    QImage image(canvas->viewport()->size(), QImage::Format_ARGB32_Premultiplied);
+
+    QVector<double> layersMs;
+    QVector<double> overlayMs;
+    for (int i = 0; i < repeat; ++i) {
+        timer.start();
+        if (profile.parallel) {
+            QgsMapRendererParallelJob job(canvas->mapSettings());
+            job.start();
+            job.waitForFinished();
+        } else {
+            QgsMapRendererSequentialJob job(canvas->mapSettings());
+            job.start();
+            job.waitForFinished();
+        }
+        layersMs.append(timer.nsecsElapsed() / 1e6);
+        overlayMs.append(paintScene(canvas, image));
+    }
+    results.append(summarize("full.layers", trailPoints, markers, "ms", layersMs));
+    results.append(summarize("full.overlay", trailPoints, markers, "ms", overlayMs));
+
+    // Quarter-screen steps back and forth
+    QVector<double> panMs;
+    for (int i = 0; i < repeat; ++i) {
+        const double offset = (i % 2 ? -0.25 : 0.25) * extent.width();
+        const QgsRectangle current = canvas->extent();
+        canvas->setExtent(QgsRectangle(current.xMinimum() + offset, current.yMinimum(),
+                                       current.xMaximum() + offset, current.yMaximum()));
+        panMs.append(refreshCanvas(canvas) + paintScene(canvas, image));
+    }
+    results.append(summarize("pan", trailPoints, markers, "ms", panMs));
+
+    // Alternating 2x in and out around the centre
+    canvas->setExtent(extent);
+    QVector<double> zoomMs;
+    for (int i = 0; i < repeat; ++i) {
+        QgsRectangle current = canvas->extent();
+        current.scale(i % 2 ? 2.0 : 0.5);
+        canvas->setExtent(current);
+        zoomMs.append(refreshCanvas(canvas) + paintScene(canvas, image));
+    }
+    results.append(summarize("zoom", trailPoints, markers, "ms", zoomMs));
+
+    // Live update: every marker and the trail move, layers are not re-rendered
+    canvas->setExtent(extent);
+    refreshCanvas(canvas);
+    QVector<double> moveMs;
+    for (int i = 0; i < repeat; ++i) {
+        batch.clear();
+        batch.append(trailFix(trailPoints + i));
+        for (int marker = 0; marker < markers; ++marker) {
+            batch.append(markerFix(marker, markers, i + 1));
+        }
+        timer.start();
+        widget.updatePositions(batch);
+        moveMs.append(timer.nsecsElapsed() / 1e6 + paintScene(canvas, image));
+    }
+    results.append(summarize("move", trailPoints, markers, "ms", moveMs));
+
+    // Nothing moved: the basemap tier image is reused
+    QVector<double> refreshMs;
+    for (int i = 0; i < repeat; ++i) {
+        refreshMs.append(refreshCanvas(canvas) + paintScene(canvas, image));
+    }
+    results.append(summarize("refresh", trailPoints, markers, "ms", refreshMs));
+
+    return results;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // No display needed; an explicit QT_QPA_PLATFORM still wins
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // Keep the widget away from the user's track archive
+    QTemporaryDir archiveDir;
+    qputenv("GPS_ARCHIVE_DIR", archiveDir.path().toLocal8Bit());
+
+    QgsApplication app(argc, argv, true);
+    QgsApplication::initQgis();
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "points", "Comma-separated trail sizes.", "list", "10000,100000,1000000" });
+    parser.addOption({ "markers", "Live markers besides the selected track.", "count", "1000" });
+    parser.addOption({ "repeat", "Samples per timed phase.", "count", "20" });
+    parser.addOption({ "size", "Widget size.", "WxH", "1280x800" });
+    parser.addOption({ "basemap", "none, or osm through the tile cache.", "basemap", "none" });
+    parser.addOption({ "render-threads", "Render threads, 0 for every core.", "count", "0" });
+    parser.addOption({ "sequential", "Render the layers in turn on one thread." });
+    parser.addOption({ "no-progressive", "No partial images or preview renders around the view." });
+    parser.addOption({ "json", "Also write the results to this file as JSON.", "file" });
+    parser.process(app);
+
+    QVector<int> trailSizes;
+    for (const QString &value : parser.value("points").split(',', Qt::SkipEmptyParts)) {
+        trailSizes.append(qMax(1, value.toInt()));
+    }
+    const int markers = qMax(0, parser.value("markers").toInt());
+    const int repeat = qMax(1, parser.value("repeat").toInt());
+    const QStringList dimensions = parser.value("size").split('x');
+    const QSize size(dimensions.value(0).toInt(), dimensions.value(1).toInt());
+    const bool basemap = parser.value("basemap") == "osm";
+    RenderProfile profile;
+    profile.threads = qMax(0, parser.value("render-threads").toInt());
+    profile.parallel = !parser.isSet("sequential");
+    profile.progressive = !parser.isSet("no-progressive");
+
+    QTextStream out(stdout);
+    out << QString("%1x%2, %3 markers, %4 samples per phase, basemap %5, %6 render threads, %7%8\n\n")
+               .arg(size.width()).arg(size.height()).arg(markers).arg(repeat)
+               .arg(basemap ? "osm" : "none")
+               .arg(profile.threads > 0 ? QString::number(profile.threads) : QString("all"))
+               .arg(profile.parallel ? "parallel" : "sequential")
+               .arg(profile.progressive ? ", progressive" : "");
+    out << "trail points  phase          unit        median         p95         max\n";
+    out.flush();
+
+    QJsonArray json;
+    for (int trailPoints : qAsConst(trailSizes)) {
+        for (const Result &result : runTrailSize(trailPoints, markers, repeat, size.expandedTo(QSize(64, 64)), basemap,
+                                                   profile)) {
+            out << QString("%1  %2 %3 %4 %5 %6\n")
+                       .arg(result.trailPoints, 12)
+                       .arg(result.phase, -14)
+                       .arg(result.unit, -6)
+                       .arg(result.median, 11, 'f', 3)
+                       .arg(result.p95, 11, 'f', 3)
+                       .arg(result.max, 11, 'f', 3);
+            out.flush();
+
+            QJsonObject entry;
+            entry["phase"] = result.phase;
+            entry["trailPoints"] = result.trailPoints;
+            entry["markers"] = result.markers;
+            entry["unit"] = result.unit;
+            entry["samples"] = result.samples;
+            entry["median"] = result.median;
+            entry["p95"] = result.p95;
+            entry["max"] = result.max;
+            json.append(entry);
+        }
+    }
+
+    if (parser.isSet("json")) {
+        QFile file(parser.value("json"));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            out << "Could not write " << file.fileName() << '\n';
+            return 1;
+        }
+        file.write(QJsonDocument(json).toJson());
+    }
+
+    QgsApplication::exitQgis();
+    return 0;
+}
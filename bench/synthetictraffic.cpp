@@ -0,0 +1,154 @@
+#include "synthetictraffic.h"
+#include "gpsparser.h"
+
+#include <QtEndian>
+
+#include <cmath>
+
+namespace {
+
+const double ORIGIN_LATITUDE = 40.7;
+const double ORIGIN_LONGITUDE = -74.0;
+const double GRID_STEP_DEGREES = 0.001;
+const double FRAME_STEP_DEGREES = 0.0001;
+const int GRID_COLUMNS = 100;
+const qint64 EPOCH_MS = Q_INT64_C(1773576000000);
+
+void position(int device, int frame, double &latitude, double &longitude, double &altitude)
+{
+    latitude = ORIGIN_LATITUDE + (device % GRID_COLUMNS) * GRID_STEP_DEGREES + frame * FRAME_STEP_DEGREES;
+    longitude = ORIGIN_LONGITUDE + (device / GRID_COLUMNS % GRID_COLUMNS) * GRID_STEP_DEGREES
+                + frame * FRAME_STEP_DEGREES;
+    altitude = 10.0 + frame % 100;
+}
+
+QByteArray nmeaCoordinate(double degrees, int degreeDigits)
+{
+    const double absolute = std::fabs(degrees);
+    const int whole = int(absolute);
+    return QByteArray::number(whole).rightJustified(degreeDigits, '0')
+           + QByteArray::number((absolute - whole) * 60.0, 'f', 4).rightJustified(7, '0');
+}
+
+} // namespace
+
+bool SyntheticTraffic::formatFromName(const QString &name, Format &format)
+{
+    for (Format candidate : { Json, Csv, Nmea, Binary }) {
+        if (name == formatName(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString SyntheticTraffic::formatName(Format format)
+{
+    switch (format) {
+    case Json:
+        return "json";
+    case Csv:
+        return "csv";
+    case Nmea:
+        return "nmea";
+    case Binary:
+        return "binary";
+    }
+    return QString();
+}
+
+QByteArray SyntheticTraffic::payload(Format format, int device, int frame, int pack)
+{
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double altitude = 0.0;
+    position(device, frame, latitude, longitude, altitude);
+
+    switch (format) {
+    case Json:
+        return "{\"latitude\": " + QByteArray::number(latitude, 'f', 6)
+               + ", \"longitude\": " + QByteArray::number(longitude, 'f', 6)
+               + ", \"altitude\": " + QByteArray::number(altitude, 'f', 2)
+               + ", \"device_id\": \"sim-" + QByteArray::number(device) + "\"}";
+    case Csv:
+        return QByteArray::number(latitude, 'f', 6) + ',' + QByteArray::number(longitude, 'f', 6) + ','
+               + QByteArray::number(altitude, 'f', 2);
+    case Nmea: {
+        // RMC + GGA for one epoch
+        const int second = frame % 86400;
+        const QByteArray time = QByteArray::number(second / 3600).rightJustified(2, '0')
+                                + QByteArray::number(second / 60 % 60).rightJustified(2, '0')
+                                + QByteArray::number(second % 60).rightJustified(2, '0') + ".00";
+        const QByteArray lat = nmeaCoordinate(latitude, 2) + (latitude < 0 ? ",S" : ",N");
+        const QByteArray lon = nmeaCoordinate(longitude, 3) + (longitude < 0 ? ",W" : ",E");
+        return nmeaSentence("GPRMC," + time + ",A," + lat + "," + lon + ",0.0,0.0,150326,,,A")
+               + nmeaSentence("GPGGA," + time + "," + lat + "," + lon + ",1,08,1.0,"
+                              + QByteArray::number(altitude, 'f', 1) + ",M,46.9,M,,");
+    }
+    case Binary:
+        break;
+    }
+
+    pack = qBound(1, pack, int(GpsParser::MAX_FIXES_PER_DATAGRAM));
+    QByteArray datagram(GpsParser::BINARY_HEADER_SIZE + pack * GpsParser::BINARY_RECORD_SIZE, '\0');
+    uchar *p = reinterpret_cast<uchar *>(datagram.data());
+    p[0] = GpsParser::BINARY_MAGIC;
+    p[1] = GpsParser::BINARY_MAGIC_TAG;
+    p[2] = GpsParser::BINARY_VERSION;
+    p[3] = uchar(pack);
+    for (int i = 0; i < pack; ++i) {
+        position(device + i, frame, latitude, longitude, altitude);
+        uchar *record = p + GpsParser::BINARY_HEADER_SIZE + i * GpsParser::BINARY_RECORD_SIZE;
+        qToLittleEndian<quint32>(quint32(device + i + 1), record);
+        qToLittleEndian<qint64>(EPOCH_MS + frame * Q_INT64_C(1000), record + 4);
+        qToLittleEndian<qint32>(qint32(std::lround(latitude * 1e7)), record + 12);
+        qToLittleEndian<qint32>(qint32(std::lround(longitude * 1e7)), record + 16);
+        qToLittleEndian<qint32>(qint32(std::lround(altitude * 1000.0)), record + 20);
+    }
+    return datagram;
+}
+
+QByteArray SyntheticTraffic::malformed(Format format, const QByteArray &valid, int variant)
+{
+    switch (format) {
+    case Json:
+        // Cut short, or a coordinate out of range
+        if (variant % 2) {
+            return valid.left(valid.size() / 2);
+        }
+        return "{\"latitude\": 123.0, \"longitude\": 0.0}";
+    case Csv:
+        return variant % 2 ? QByteArray("40.7,not-a-number,10") : QByteArray("40.7");
+    case Nmea: {
+        // Wrong checksum on every sentence, or a truncated sentence
+        if (variant % 2) {
+            return valid.left(valid.indexOf('*'));
+        }
+        QByteArray damaged = valid;
+        for (int i = damaged.indexOf('*'); i >= 0; i = damaged.indexOf('*', i + 1)) {
+            damaged[i + 1] = damaged[i + 1] == '0' ? '1' : '0';
+        }
+        return damaged;
+    }
+    case Binary: {
+        // Record count beyond the datagram, or an unknown version
+        if (variant % 2) {
+            return valid.left(valid.size() - GpsParser::BINARY_RECORD_SIZE / 2);
+        }
+        QByteArray damaged = valid;
+        damaged[2] = char(GpsParser::BINARY_VERSION + 1);
+        return damaged;
+    }
+    }
+    return QByteArray();
+}
+
+QByteArray SyntheticTraffic::nmeaSentence(const QByteArray &body)
+{
+    quint8 checksum = 0;
+    for (char c : body) {
+        checksum ^= quint8(c);
+    }
+    return "$" + body + "*" + QByteArray::number(checksum, 16).toUpper().rightJustified(2, '0') + "\r\n";
+}
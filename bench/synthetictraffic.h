@@ -0,0 +1,39 @@
+#ifndef SYNTHETICTRAFFIC_H
+#define SYNTHETICTRAFFIC_H
+
+#include <QByteArray>
+#include <QString>
+
+// Datagrams in every wire format for benchmarks and load generation.
+//
+// Device d's position depends only on d and the frame number, so pools of
+// datagrams can be built once and replayed. Devices sit on a grid a few
+// kilometres across and each frame moves them a little; NMEA frames are a
+// second apart.
+class SyntheticTraffic
+{
+public:
+    enum Format {
+        Json,
+        Csv,
+        Nmea,
+        Binary
+    };
+
+    static bool formatFromName(const QString &name, Format &format);
+    static QString formatName(Format format);
+
+    // One datagram of device's frame; a binary datagram holds pack records
+    // for devices device .. device + pack - 1. JSON carries "sim-<device>"
+    // and binary records device + 1 as the device ID; CSV and NMEA have
+    // none and rely on the sender's address.
+    static QByteArray payload(Format format, int device, int frame, int pack = 1);
+
+    // A damaged copy of a valid datagram that the parser must reject;
+    // variant picks one of several kinds of damage
+    static QByteArray malformed(Format format, const QByteArray &valid, int variant);
+
+    static QByteArray nmeaSentence(const QByteArray &body);
+};
+
+#endif // SYNTHETICTRAFFIC_H
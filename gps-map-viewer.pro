@@ -11,16 +11,67 @@ DEFINES += APP_VERSION=\\\"$$VERSION\\\"
 
 # Source files
 SOURCES += \
+    src/batchdatagramreader.cpp \
+    src/capturefile.cpp \
+    src/fixbus.cpp \
     src/main.cpp \
     src/mainwindow.cpp \
+    src/gpsparser.cpp \
+    src/latencymonitor.cpp \
+    src/logger.cpp \
+    src/logmodel.cpp \
     src/mapwidget.cpp \
-    src/udpreceiver.cpp
+    src/nmeastream.cpp \
+    src/positionmarkeritem.cpp \
+    src/receiverconfig.cpp \
+    src/rendertierstats.cpp \
+    src/spatialgrid.cpp \
+    src/startupprofiler.cpp \
+    src/tilecache.cpp \
+    src/tilecacheservice.cpp \
+    src/tileproxyserver.cpp \
+    src/trackarchive.cpp \
+    src/trackoverlayitem.cpp \
+    src/tracktable.cpp \
+    src/trailcanvasitem.cpp \
+    src/trailstore.cpp \
+    src/udpreceiver.cpp \
+    src/udpreceiverworker.cpp \
+    src/uiupdatescheduler.cpp \
+    src/webmercator.cpp
 
 # Header files
 HEADERS += \
+    src/batchdatagramreader.h \
+    src/capturefile.h \
+    src/fixbus.h \
+    src/gpsfix.h \
+    src/gpsparser.h \
+    src/latencymonitor.h \
+    src/logger.h \
+    src/logmodel.h \
     src/mainwindow.h \
     src/mapwidget.h \
-    src/udpreceiver.h
+    src/nmeastream.h \
+    src/positionmarkeritem.h \
+    src/receiverconfig.h \
+    src/renderprofile.h \
+    src/rendertierstats.h \
+    src/spatialgrid.h \
+    src/spscqueue.h \
+    src/startupprofiler.h \
+    src/tilecache.h \
+    src/tilecacheservice.h \
+    src/tileproxyserver.h \
+    src/trackarchive.h \
+    src/trackoverlayitem.h \
+    src/tracktable.h \
+    src/trailcanvasitem.h \
+    src/trailstore.h \
+    src/udpreceiver.h \
+    src/udpreceiverworker.h \
+    src/uiupdatescheduler.h \
+    src/webmercator.h
 
 # UI files
 FORMS += \
@@ -47,6 +98,9 @@ unix {
     LIBS += -lqgis_core \
             -lqgis_gui \
             -lqgis_app
+
+    # shm_open() for the fix bus
+    linux: LIBS += -lrt
 }
 
 win32 {
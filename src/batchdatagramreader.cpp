@@ -0,0 +1,420 @@
+#include "batchdatagramreader.h"
+#include "gpsfix.h"
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+
+namespace {
+
+// Room for the SO_RXQ_OVFL counter the kernel attaches to each datagram
+const int CONTROL_SIZE = CMSG_SPACE(sizeof(quint32));
+
+QString lastError()
+{
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+} // namespace
+
+struct BatchDatagramReader::ReceiveRing
+{
+    char buffers[BATCH_SIZE][MAX_DATAGRAM_SIZE];
+    mmsghdr headers[BATCH_SIZE];
+    iovec iovecs[BATCH_SIZE];
+    sockaddr_storage addresses[BATCH_SIZE];
+    alignas(cmsghdr) char controls[BATCH_SIZE][CONTROL_SIZE];
+
+    ReceiveRing()
+    {
+        std::memset(headers, 0, sizeof(headers));
+        for (int i = 0; i < BATCH_SIZE; ++i) {
+            iovecs[i].iov_base = buffers[i];
+            iovecs[i].iov_len = MAX_DATAGRAM_SIZE;
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_name = &addresses[i];
+            headers[i].msg_hdr.msg_control = controls[i];
+        }
+    }
+};
+
+BatchDatagramReader::BatchDatagramReader()
+    : m_fd(-1)
+    , m_receiveBufferBytes(0)
+    , m_reusePort(false)
+    , m_overflowCount(0)
+    , m_kernelDrops(0)
+    , m_ring(new ReceiveRing)
+{
+}
+
+BatchDatagramReader::~BatchDatagramReader()
+{
+    close();
+}
+
+bool BatchDatagramReader::isSupported()
+{
+    return true;
+}
+
+bool BatchDatagramReader::isReusePortSupported()
+{
+#ifdef SO_REUSEPORT
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool BatchDatagramReader::bind(quint16 port, const QHostAddress &group)
+{
+    close();
+    m_overflowCount = 0;
+    m_kernelDrops = 0;
+
+    const bool multicast = !group.isNull();
+    const bool ipv4Group = multicast && group.protocol() == QAbstractSocket::IPv4Protocol;
+
+    // Dual-stack socket, matching QHostAddress::Any; IPv4 groups need an
+    // IPv4 socket to join
+    int fd = ipv4Group ? -1 : ::socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+        int v6Only = 0;
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only));
+        configureSocket(fd);
+
+        sockaddr_in6 address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin6_family = AF_INET6;
+        address.sin6_port = htons(port);
+        if (multicast) {
+            // Only datagrams sent to this group, not to others on the port
+            const Q_IPV6ADDR groupAddress = group.toIPv6Address();
+            std::memcpy(&address.sin6_addr, groupAddress.c, sizeof(groupAddress.c));
+        } else {
+            address.sin6_addr = in6addr_any;
+        }
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+            if (!multicast) {
+                m_fd = fd;
+                return true;
+            }
+
+            ipv6_mreq membership;
+            std::memset(&membership, 0, sizeof(membership));
+            const Q_IPV6ADDR groupAddress = group.toIPv6Address();
+            std::memcpy(&membership.ipv6mr_multiaddr, groupAddress.c, sizeof(groupAddress.c));
+            if (::setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &membership, sizeof(membership)) == 0) {
+                m_fd = fd;
+                return true;
+            }
+        }
+        m_errorString = lastError();
+        ::close(fd);
+    } else if (!ipv4Group) {
+        m_errorString = lastError();
+    }
+    if (multicast && !ipv4Group) {
+        return false;
+    }
+
+    // IPv4-only hosts and IPv4 groups
+    fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        m_errorString = lastError();
+        return false;
+    }
+    configureSocket(fd);
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(multicast ? group.toIPv4Address() : INADDR_ANY);
+    address.sin_port = htons(port);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        m_errorString = lastError();
+        ::close(fd);
+        return false;
+    }
+
+    if (multicast) {
+        ip_mreqn membership;
+        std::memset(&membership, 0, sizeof(membership));
+        membership.imr_multiaddr.s_addr = htonl(group.toIPv4Address());
+        membership.imr_address.s_addr = htonl(INADDR_ANY);
+        if (::setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+            m_errorString = lastError();
+            ::close(fd);
+            return false;
+        }
+    }
+
+    m_fd = fd;
+    return true;
+}
+
+void BatchDatagramReader::configureSocket(int fd)
+{
+    int on = 1;
+    int off = 0;
+
+    // By default a socket bound to the port gets every group any socket on
+    // the host joined; each socket here wants only its own memberships, or
+    // endpoints sharing a port would see each other's traffic twice
+#ifdef IP_MULTICAST_ALL
+    ::setsockopt(fd, IPPROTO_IP, IP_MULTICAST_ALL, &off, sizeof(off));
+#endif
+#ifdef IPV6_MULTICAST_ALL
+    ::setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &off, sizeof(off));
+#endif
+
+    // A group bind and the wildcard bind of a unicast endpoint on the same
+    // port only coexist when both sockets allow it; other programs may
+    // also listen to the same group
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+    if (m_reusePort) {
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    }
+#endif
+
+    // SO_RCVBUFFORCE ignores rmem_max but needs CAP_NET_ADMIN
+    if (m_receiveBufferBytes > 0
+        && ::setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &m_receiveBufferBytes, sizeof(m_receiveBufferBytes)) != 0) {
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &m_receiveBufferBytes, sizeof(m_receiveBufferBytes));
+    }
+
+#ifdef SO_RXQ_OVFL
+    ::setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+#endif
+}
+
+int BatchDatagramReader::receiveBufferSize() const
+{
+    if (m_fd < 0) {
+        return 0;
+    }
+    int bytes = 0;
+    socklen_t length = sizeof(bytes);
+    if (::getsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &bytes, &length) != 0) {
+        return 0;
+    }
+    return bytes;
+}
+
+void BatchDatagramReader::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+int BatchDatagramReader::receiveBatch()
+{
+    if (m_fd < 0) {
+        return -1;
+    }
+
+    // The kernel overwrites the name and control lengths and the flags on
+    // every call
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        m_ring->headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        m_ring->headers[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+        m_ring->headers[i].msg_hdr.msg_flags = 0;
+    }
+
+    int count;
+    do {
+        count = ::recvmmsg(m_fd, m_ring->headers, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        m_errorString = lastError();
+        return -1;
+    }
+    updateKernelDrops(count);
+    return count;
+}
+
+void BatchDatagramReader::updateKernelDrops(int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    // The counter is cumulative, so the newest datagram carrying one is
+    // enough; it is only attached once the socket has dropped something
+    msghdr &header = m_ring->headers[count - 1].msg_hdr;
+    for (cmsghdr *control = CMSG_FIRSTHDR(&header); control; control = CMSG_NXTHDR(&header, control)) {
+#ifdef SO_RXQ_OVFL
+        if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SO_RXQ_OVFL) {
+            quint32 overflowCount;
+            std::memcpy(&overflowCount, CMSG_DATA(control), sizeof(overflowCount));
+            m_kernelDrops += quint32(overflowCount - m_overflowCount);
+            m_overflowCount = overflowCount;
+        }
+#endif
+    }
+}
+
+const char *BatchDatagramReader::data(int index) const
+{
+    return m_ring->buffers[index];
+}
+
+int BatchDatagramReader::size(int index) const
+{
+    return int(qMin<unsigned>(m_ring->headers[index].msg_len, MAX_DATAGRAM_SIZE));
+}
+
+bool BatchDatagramReader::isTruncated(int index) const
+{
+    return (m_ring->headers[index].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+}
+
+const sockaddr *BatchDatagramReader::sender(int index) const
+{
+    return reinterpret_cast<const sockaddr *>(&m_ring->addresses[index]);
+}
+
+quint32 BatchDatagramReader::senderId(int index) const
+{
+    const sockaddr_storage &address = m_ring->addresses[index];
+    if (address.ss_family == AF_INET6) {
+        const sockaddr_in6 &in6 = reinterpret_cast<const sockaddr_in6 &>(address);
+        return GpsFix::deviceIdFromAddress(in6.sin6_addr.s6_addr, ntohs(in6.sin6_port));
+    }
+    if (address.ss_family == AF_INET) {
+        const sockaddr_in &in4 = reinterpret_cast<const sockaddr_in &>(address);
+        quint8 mapped[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+        std::memcpy(mapped + 12, &in4.sin_addr.s_addr, 4);
+        return GpsFix::deviceIdFromAddress(mapped, ntohs(in4.sin_port));
+    }
+    return 0;
+}
+
+#else // !Q_OS_LINUX
+
+struct BatchDatagramReader::ReceiveRing
+{
+};
+
+BatchDatagramReader::BatchDatagramReader()
+    : m_fd(-1)
+    , m_receiveBufferBytes(0)
+    , m_reusePort(false)
+    , m_overflowCount(0)
+    , m_kernelDrops(0)
+{
+}
+
+BatchDatagramReader::~BatchDatagramReader()
+{
+}
+
+bool BatchDatagramReader::isSupported()
+{
+    return false;
+}
+
+bool BatchDatagramReader::isReusePortSupported()
+{
+    return false;
+}
+
+bool BatchDatagramReader::bind(quint16, const QHostAddress &)
+{
+    m_errorString = QStringLiteral("recvmmsg() is not available on this platform");
+    return false;
+}
+
+void BatchDatagramReader::configureSocket(int)
+{
+}
+
+int BatchDatagramReader::receiveBufferSize() const
+{
+    return 0;
+}
+
+void BatchDatagramReader::close()
+{
+}
+
+int BatchDatagramReader::receiveBatch()
+{
+    return -1;
+}
+
+void BatchDatagramReader::updateKernelDrops(int)
+{
+}
+
+const char *BatchDatagramReader::data(int) const
+{
+    return nullptr;
+}
+
+int BatchDatagramReader::size(int) const
+{
+    return 0;
+}
+
+bool BatchDatagramReader::isTruncated(int) const
+{
+    return false;
+}
+
+const sockaddr *BatchDatagramReader::sender(int) const
+{
+    return nullptr;
+}
+
+quint32 BatchDatagramReader::senderId(int) const
+{
+    return 0;
+}
+
+#endif // Q_OS_LINUX
+
+bool BatchDatagramReader::isOpen() const
+{
+    return m_fd >= 0;
+}
+
+int BatchDatagramReader::socketDescriptor() const
+{
+    return m_fd;
+}
+
+QString BatchDatagramReader::errorString() const
+{
+    return m_errorString;
+}
+
+void BatchDatagramReader::setReceiveBufferSize(int bytes)
+{
+    m_receiveBufferBytes = qMax(0, bytes);
+}
+
+void BatchDatagramReader::setReusePort(bool reusePort)
+{
+    m_reusePort = reusePort;
+}
+
+quint64 BatchDatagramReader::kernelDrops() const
+{
+    return m_kernelDrops;
+}
@@ -0,0 +1,88 @@
+#ifndef BATCHDATAGRAMREADER_H
+#define BATCHDATAGRAMREADER_H
+
+#include <QHostAddress>
+#include <QString>
+#include <QtGlobal>
+
+#include <memory>
+
+struct sockaddr;
+
+// Non-blocking UDP socket drained with recvmmsg().
+//
+// All receive buffers and message headers are allocated once, so a burst
+// of up to BATCH_SIZE datagrams costs a single syscall and no heap
+// traffic. Only available on Linux; bind() fails elsewhere so callers can
+// fall back to QUdpSocket.
+class BatchDatagramReader
+{
+public:
+    static const int BATCH_SIZE = 64;
+    static const int MAX_DATAGRAM_SIZE = 8192;
+
+    BatchDatagramReader();
+    ~BatchDatagramReader();
+
+    BatchDatagramReader(const BatchDatagramReader &) = delete;
+    BatchDatagramReader &operator=(const BatchDatagramReader &) = delete;
+
+    static bool isSupported();
+    static bool isReusePortSupported();
+
+    // Options applied by the next bind(). A receive buffer of 0 keeps the
+    // system default; larger requests are capped at net.core.rmem_max
+    // unless the process has CAP_NET_ADMIN. With reusePort several readers
+    // can bind the same port and the kernel spreads senders across them.
+    void setReceiveBufferSize(int bytes);
+    void setReusePort(bool reusePort);
+
+    // Binds to port on every interface; a multicast group is joined on the
+    // default interface after binding
+    bool bind(quint16 port, const QHostAddress &group = QHostAddress());
+    void close();
+    bool isOpen() const;
+    int socketDescriptor() const;
+    QString errorString() const;
+
+    // SO_RCVBUF as reported by the kernel, which doubles the requested size
+    // to account for its own bookkeeping
+    int receiveBufferSize() const;
+
+    // Datagrams the kernel dropped on this socket because its buffer was
+    // full, as of the last receiveBatch() (SO_RXQ_OVFL)
+    quint64 kernelDrops() const;
+
+    // Reads the next batch; returns the number of datagrams, 0 when the
+    // socket is drained, or -1 on error. Results stay valid until the next call.
+    int receiveBatch();
+
+    const char *data(int index) const;
+    int size(int index) const;
+    bool isTruncated(int index) const;
+    const sockaddr *sender(int index) const;
+
+    // GpsFix::deviceIdFromAddress() of the sender; IPv4 senders hash as
+    // their IPv4-mapped IPv6 address so both socket types agree
+    quint32 senderId(int index) const;
+
+private:
+    struct ReceiveRing;
+
+    void configureSocket(int fd);
+    void updateKernelDrops(int count);
+
+    int m_fd;
+    int m_receiveBufferBytes;
+    bool m_reusePort;
+    QString m_errorString;
+
+    // The kernel reports a running 32-bit drop count with each datagram
+    quint32 m_overflowCount;
+    quint64 m_kernelDrops;
+
+    // Preallocated buffers and headers, reused by every recvmmsg() call
+    std::unique_ptr<ReceiveRing> m_ring;
+};
+
+#endif // BATCHDATAGRAMREADER_H
@@ -0,0 +1,303 @@
+#include "capturefile.h"
+
+#include <QMutexLocker>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+const char CaptureReader::MAGIC[6] = { 'G', 'P', 'S', 'C', 'A', 'P' };
+
+namespace {
+
+QString indexPathFor(const QString &path)
+{
+    return path + ".idx";
+}
+
+} // namespace
+
+CaptureWriter::CaptureWriter()
+    : m_offset(0)
+    , m_lastIndexedTimeUs(0)
+    , m_lastTimeUs(0)
+    , m_datagramsWritten(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    closeFiles();
+
+    m_file.setFileName(path);
+    m_indexFile.setFileName(indexPathFor(path));
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || !m_indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        closeFiles();
+        return false;
+    }
+
+    uchar header[CaptureReader::HEADER_SIZE];
+    std::memcpy(header, CaptureReader::MAGIC, sizeof(CaptureReader::MAGIC));
+    qToLittleEndian<quint16>(CaptureReader::VERSION, header + 6);
+    if (m_file.write(reinterpret_cast<const char *>(header), sizeof(header)) != qint64(sizeof(header))) {
+        closeFiles();
+        return false;
+    }
+
+    m_offset = CaptureReader::HEADER_SIZE;
+    m_lastIndexedTimeUs = 0;
+    m_lastTimeUs = 0;
+    m_datagramsWritten = 0;
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    QMutexLocker locker(&m_mutex);
+    closeFiles();
+}
+
+void CaptureWriter::closeFiles()
+{
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    if (m_indexFile.isOpen()) {
+        m_indexFile.close();
+    }
+}
+
+bool CaptureWriter::isOpen() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_file.isOpen();
+}
+
+bool CaptureWriter::append(qint64 receiveTimeUs, quint32 senderId, const char *data, int size)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen()) {
+        return false;
+    }
+
+    // Another receiver thread may have written a later-stamped batch first
+    if (m_datagramsWritten > 0 && receiveTimeUs < m_lastTimeUs) {
+        receiveTimeUs = m_lastTimeUs;
+    }
+    m_lastTimeUs = receiveTimeUs;
+
+    if (m_datagramsWritten == 0 || receiveTimeUs - m_lastIndexedTimeUs >= CaptureReader::INDEX_INTERVAL_US) {
+        uchar entry[16];
+        qToLittleEndian<qint64>(receiveTimeUs, entry);
+        qToLittleEndian<qint64>(m_offset, entry + 8);
+        m_indexFile.write(reinterpret_cast<const char *>(entry), sizeof(entry));
+        m_lastIndexedTimeUs = receiveTimeUs;
+    }
+
+    // Both writes land in QFile's buffer; the disk sees one write per buffer
+    uchar header[CaptureReader::RECORD_HEADER_SIZE];
+    qToLittleEndian<qint64>(receiveTimeUs, header);
+    qToLittleEndian<quint32>(senderId, header + 8);
+    qToLittleEndian<quint32>(quint32(size), header + 12);
+    if (m_file.write(reinterpret_cast<const char *>(header), sizeof(header)) != qint64(sizeof(header))
+        || m_file.write(data, size) != size) {
+        return false;
+    }
+
+    m_offset += CaptureReader::RECORD_HEADER_SIZE + size;
+    ++m_datagramsWritten;
+    return true;
+}
+
+void CaptureWriter::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_file.isOpen()) {
+        m_file.flush();
+        m_indexFile.flush();
+    }
+}
+
+quint64 CaptureWriter::datagramsWritten() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_datagramsWritten;
+}
+
+QString CaptureWriter::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_file.error() != QFileDevice::NoError ? m_file.errorString() : m_indexFile.errorString();
+}
+
+CaptureReader::CaptureReader()
+    : m_map(nullptr)
+    , m_size(0)
+    , m_offset(0)
+    , m_endTimeUs(0)
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+bool CaptureReader::open(const QString &path)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_map = m_size > 0 ? m_file.map(0, m_size) : nullptr;
+    if (!m_map || m_size < HEADER_SIZE || std::memcmp(m_map, MAGIC, sizeof(MAGIC)) != 0
+        || qFromLittleEndian<quint16>(m_map + 6) != VERSION) {
+        m_error = m_map ? QString("%1 is not a GPS capture").arg(path) : m_file.errorString();
+        close();
+        return false;
+    }
+
+    loadIndex(indexPathFor(path));
+    extendIndex();
+    rewind();
+    return true;
+}
+
+void CaptureReader::close()
+{
+    if (m_map) {
+        m_file.unmap(const_cast<uchar *>(m_map));
+        m_map = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_size = 0;
+    m_offset = 0;
+    m_index.clear();
+    m_endTimeUs = 0;
+}
+
+bool CaptureReader::isOpen() const
+{
+    return m_map != nullptr;
+}
+
+bool CaptureReader::recordAt(qint64 offset, CapturedDatagram &datagram) const
+{
+    if (!m_map || offset + RECORD_HEADER_SIZE > m_size) {
+        return false;
+    }
+
+    const uchar *header = m_map + offset;
+    const quint32 size = qFromLittleEndian<quint32>(header + 12);
+    if (qint64(size) > m_size - offset - RECORD_HEADER_SIZE) {
+        return false; // Incomplete tail of an interrupted capture
+    }
+
+    datagram.receiveTimeUs = qFromLittleEndian<qint64>(header);
+    datagram.senderId = qFromLittleEndian<quint32>(header + 8);
+    datagram.data = reinterpret_cast<const char *>(header + RECORD_HEADER_SIZE);
+    datagram.size = int(size);
+    return true;
+}
+
+bool CaptureReader::peek(CapturedDatagram &datagram) const
+{
+    return recordAt(m_offset, datagram);
+}
+
+void CaptureReader::next()
+{
+    CapturedDatagram datagram;
+    if (recordAt(m_offset, datagram)) {
+        m_offset += RECORD_HEADER_SIZE + datagram.size;
+    }
+}
+
+void CaptureReader::seek(qint64 timeUs)
+{
+    // Last index entry at or before timeUs, then a short linear scan
+    auto entry = std::upper_bound(m_index.constBegin(), m_index.constEnd(), timeUs,
+                                  [](qint64 time, const IndexEntry &e) { return time < e.timeUs; });
+    m_offset = entry == m_index.constBegin() ? qint64(HEADER_SIZE) : (entry - 1)->offset;
+
+    CapturedDatagram datagram;
+    while (recordAt(m_offset, datagram) && datagram.receiveTimeUs < timeUs) {
+        m_offset += RECORD_HEADER_SIZE + datagram.size;
+    }
+}
+
+void CaptureReader::rewind()
+{
+    m_offset = HEADER_SIZE;
+}
+
+qint64 CaptureReader::startTimeUs() const
+{
+    return m_index.isEmpty() ? 0 : m_index.first().timeUs;
+}
+
+qint64 CaptureReader::endTimeUs() const
+{
+    return m_endTimeUs;
+}
+
+QString CaptureReader::errorString() const
+{
+    return m_error;
+}
+
+void CaptureReader::loadIndex(const QString &indexPath)
+{
+    QFile indexFile(indexPath);
+    if (!indexFile.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const QByteArray bytes = indexFile.readAll();
+    const uchar *p = reinterpret_cast<const uchar *>(bytes.constData());
+    const int entries = bytes.size() / 16;
+    m_index.reserve(entries);
+    for (int i = 0; i < entries; ++i, p += 16) {
+        IndexEntry entry;
+        entry.timeUs = qFromLittleEndian<qint64>(p);
+        entry.offset = qFromLittleEndian<qint64>(p + 8);
+
+        // Entries must point at records, in order; drop the rest and rescan
+        CapturedDatagram datagram;
+        if ((!m_index.isEmpty() && entry.offset <= m_index.last().offset)
+            || !recordAt(entry.offset, datagram) || datagram.receiveTimeUs != entry.timeUs) {
+            break;
+        }
+        m_index.append(entry);
+    }
+}
+
+void CaptureReader::extendIndex()
+{
+    qint64 offset = m_index.isEmpty() ? qint64(HEADER_SIZE) : m_index.last().offset;
+    qint64 lastIndexedTimeUs = m_index.isEmpty() ? 0 : m_index.last().timeUs;
+
+    CapturedDatagram datagram;
+    while (recordAt(offset, datagram)) {
+        if (m_index.isEmpty() || datagram.receiveTimeUs - lastIndexedTimeUs >= INDEX_INTERVAL_US) {
+            m_index.append({ datagram.receiveTimeUs, offset });
+            lastIndexedTimeUs = datagram.receiveTimeUs;
+        }
+        m_endTimeUs = datagram.receiveTimeUs;
+        offset += RECORD_HEADER_SIZE + datagram.size;
+    }
+}
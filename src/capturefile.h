@@ -0,0 +1,111 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+// Raw datagram capture: an append-only record file plus a sparse time index.
+//
+// <path> starts with the 8-byte header "GPSCAP" + u16 version, followed by
+// one record per datagram: i64 receive time (us since the epoch), u32
+// sender ID, u32 payload length, payload. <path>.idx holds (i64 time,
+// i64 file offset) pairs, one at least every INDEX_INTERVAL_US of capture
+// time, so seeking reads a handful of records instead of the whole file.
+// All integers are little-endian. A crash loses at most the unflushed tail;
+// readers stop at the first incomplete record and extend a missing or
+// short index by scanning past its last entry.
+
+struct CapturedDatagram
+{
+    qint64 receiveTimeUs = 0;
+    quint32 senderId = 0;
+    const char *data = nullptr; // Points into the reader's mapping
+    int size = 0;
+};
+
+// Every member may be called from several receiver threads at once; records from different threads interleave in arrival
+// order at the lock. Each thread stamps its own batches, so a record may
+// reach the lock stamped earlier than one already written; it is written
+// with that record's time instead. Receive times in a capture therefore
+// never decrease, which seeking, the index and replay pacing rely on, at
+// the cost of shifting such records by the skew between the threads.
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    // Creates or truncates the capture and its index
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+
+    bool append(qint64 receiveTimeUs, quint32 senderId, const char *data, int size);
+    void flush();
+
+    quint64 datagramsWritten() const;
+    QString errorString() const;
+
+private:
+    void closeFiles();
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    QFile m_indexFile;
+    qint64 m_offset;
+    qint64 m_lastIndexedTimeUs;
+    qint64 m_lastTimeUs;
+    quint64 m_datagramsWritten;
+};
+
+class CaptureReader
+{
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+
+    // Current record without consuming it; false at the end of the capture
+    bool peek(CapturedDatagram &datagram) const;
+    void next();
+
+    // Positions at the first record received at or after timeUs
+    void seek(qint64 timeUs);
+    void rewind();
+
+    qint64 startTimeUs() const;
+    qint64 endTimeUs() const;
+    QString errorString() const;
+
+    static const char MAGIC[6];
+    static const quint16 VERSION = 1;
+    static const int HEADER_SIZE = 8;
+    static const int RECORD_HEADER_SIZE = 16;
+    static const qint64 INDEX_INTERVAL_US = 1000000;
+
+private:
+    struct IndexEntry
+    {
+        qint64 timeUs;
+        qint64 offset;
+    };
+
+    bool recordAt(qint64 offset, CapturedDatagram &datagram) const;
+    void loadIndex(const QString &indexPath);
+    void extendIndex();
+
+    QFile m_file;
+    const uchar *m_map;
+    qint64 m_size;
+    qint64 m_offset;
+    QVector<IndexEntry> m_index;
+    qint64 m_endTimeUs;
+    QString m_error;
+};
+
+#endif // CAPTUREFILE_H
@@ -0,0 +1,560 @@
+#include "fixbus.h"
+
+#include <QMutexLocker>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int RECORD_WORDS = int(sizeof(FixBusRecord) / sizeof(quint64));
+
+enum RingState : quint32 {
+    Initializing = 0,
+    Open = 1,
+    Closed = 2
+};
+
+struct RingHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 recordSize;
+    quint32 capacity;
+    qint64 writerPid;
+    std::atomic<quint32> state;
+    quint32 writerPidNamespace; // Inode of the writer's /proc/self/ns/pid, 0 if unknown
+    quint32 reserved[8];
+
+    // Records published; on its own cache line, away from the fields
+    // readers check once at attach
+    alignas(64) std::atomic<quint64> head;
+};
+
+struct RingSlot
+{
+    std::atomic<quint64> sequence; // n + 1 once record n is complete, 0 while written
+    std::atomic<quint64> words[RECORD_WORDS];
+};
+
+static_assert(sizeof(FixBusRecord) % sizeof(quint64) == 0, "records are copied as 64-bit words");
+static_assert(offsetof(RingHeader, head) == 64 && sizeof(RingHeader) == 128, "header layout is shared");
+static_assert(sizeof(RingSlot) == 96, "slot layout is shared");
+static_assert(std::atomic<quint64>::is_always_lock_free, "the ring needs address-free 64-bit atomics");
+
+// The mapped segment, as both ends see it
+struct SharedRing
+{
+    void *address = nullptr;
+    size_t size = 0;
+    RingHeader *header = nullptr;
+    RingSlot *slots = nullptr;
+    quint64 mask = 0;
+
+    static size_t segmentSize(quint32 capacity)
+    {
+        return sizeof(RingHeader) + size_t(capacity) * sizeof(RingSlot);
+    }
+};
+
+} // namespace
+
+FixBusRecord FixBusRecord::fromFix(const GpsFix &fix)
+{
+    FixBusRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.latitude = fix.latitude;
+    record.longitude = fix.longitude;
+    record.altitude = fix.altitude;
+    record.mapX = fix.mapX;
+    record.mapY = fix.mapY;
+    record.timestampMs = fix.timestampMs;
+    record.sourceTimestampMs = fix.sourceTimestampMs;
+    record.receiveNs = fix.receiveNs;
+    record.deviceId = fix.deviceId;
+    record.speed = fix.speed;
+    record.heading = fix.heading;
+    record.accuracy = fix.accuracy;
+    record.hdop = fix.hdop;
+    record.optionalFields = fix.optionalFields;
+    record.satellitesUsed = fix.satellitesUsed;
+    record.satellitesInView = fix.satellitesInView;
+    return record;
+}
+
+GpsFix FixBusRecord::toFix() const
+{
+    GpsFix fix;
+    fix.latitude = latitude;
+    fix.longitude = longitude;
+    fix.altitude = altitude;
+    fix.mapX = mapX;
+    fix.mapY = mapY;
+    fix.timestampMs = timestampMs;
+    fix.sourceTimestampMs = sourceTimestampMs;
+    fix.receiveNs = receiveNs;
+    fix.deviceId = deviceId;
+    fix.speed = speed;
+    fix.heading = heading;
+    fix.accuracy = accuracy;
+    fix.hdop = hdop;
+    fix.optionalFields = optionalFields;
+    fix.satellitesUsed = satellitesUsed;
+    fix.satellitesInView = satellitesInView;
+    return fix;
+}
+
+struct FixBusWriter::Segment : SharedRing
+{
+};
+
+struct FixBusReader::Segment : SharedRing
+{
+};
+
+#ifdef Q_OS_LINUX
+
+namespace {
+
+QString lastError()
+{
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+// "/name" for shm_open(); empty when name is not a single path component
+QByteArray shmPath(const QString &name)
+{
+    QString trimmed = name.trimmed();
+    while (trimmed.startsWith('/')) {
+        trimmed.remove(0, 1);
+    }
+    if (trimmed.isEmpty() || trimmed.contains('/')) {
+        return QByteArray();
+    }
+    return '/' + trimmed.toLocal8Bit();
+}
+
+bool isProcessAlive(qint64 pid)
+{
+    return pid > 0 && (::kill(pid_t(pid), 0) == 0 || errno == EPERM);
+}
+
+// Identifies this process's PID namespace; 0 when /proc does not tell
+quint32 pidNamespace()
+{
+    struct stat info;
+    return ::stat("/proc/self/ns/pid", &info) == 0 ? quint32(info.st_ino) : 0;
+}
+
+// Whether the ring's writer still runs. Its pid only means something in
+// its own PID namespace: from another container kill() would probe an
+// unrelated process or none at all, so there the state word decides and a
+// writer that crashed is only noticed when a new one replaces the ring.
+bool isWriterAlive(const RingHeader *header)
+{
+    if (header->state.load(std::memory_order_acquire) == Closed) {
+        return false;
+    }
+    const quint32 ns = header->writerPidNamespace;
+    if (ns == 0 || ns != pidNamespace()) {
+        return true;
+    }
+    return isProcessAlive(header->writerPid);
+}
+
+// Maps an existing segment read-only and checks its header; the reader
+// side of attach and the writer's check for a live predecessor
+bool mapExisting(const QByteArray &path, SharedRing &ring, QString &error)
+{
+    const int fd = ::shm_open(path.constData(), O_RDONLY, 0);
+    if (fd < 0) {
+        error = errno == ENOENT ? QString("No fix bus named %1").arg(QString::fromLocal8Bit(path.mid(1)))
+                                : lastError();
+        return false;
+    }
+
+    struct stat status;
+    if (::fstat(fd, &status) != 0 || size_t(status.st_size) < sizeof(RingHeader)) {
+        error = QStringLiteral("Fix bus is still being created");
+        ::close(fd);
+        return false;
+    }
+
+    void *address = ::mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        error = lastError();
+        return false;
+    }
+
+    RingHeader *header = static_cast<RingHeader *>(address);
+    const quint32 capacity = header->capacity;
+    if (header->state.load(std::memory_order_acquire) == Initializing) {
+        error = QStringLiteral("Fix bus is still being created");
+    } else if (header->magic != FixBusWriter::MAGIC || header->version != FixBusWriter::VERSION
+               || header->recordSize != sizeof(FixBusRecord)) {
+        error = QStringLiteral("Not a fix bus of this version");
+    } else if (capacity < 2 || (capacity & (capacity - 1)) != 0
+               || size_t(status.st_size) < SharedRing::segmentSize(capacity)) {
+        error = QStringLiteral("Fix bus header is corrupt");
+    } else {
+        ring.address = address;
+        ring.size = size_t(status.st_size);
+        ring.header = header;
+        ring.slots = reinterpret_cast<RingSlot *>(static_cast<char *>(address) + sizeof(RingHeader));
+        ring.mask = capacity - 1;
+        return true;
+    }
+
+    ::munmap(address, size_t(status.st_size));
+    return false;
+}
+
+} // namespace
+
+FixBusWriter::FixBusWriter()
+    : m_segment(nullptr)
+    , m_head(0)
+{
+}
+
+FixBusWriter::~FixBusWriter()
+{
+    close();
+}
+
+bool FixBusWriter::create(const QString &name, int capacity)
+{
+    close();
+
+    const QByteArray path = shmPath(name);
+    if (path.isEmpty()) {
+        m_errorString = QString("Invalid fix bus name \"%1\"").arg(name);
+        return false;
+    }
+
+    quint32 slotCount = 2;
+    while (slotCount < quint32(qMax(capacity, 2))) {
+        slotCount <<= 1;
+    }
+
+    // A ring whose writer is still running is not ours to replace; one
+    // left behind by a crash is
+    SharedRing existing;
+    QString ignored;
+    if (mapExisting(path, existing, ignored)) {
+        const qint64 pid = existing.header->writerPid;
+        const bool own = pid == qint64(::getpid()) && existing.header->writerPidNamespace == pidNamespace();
+        const bool live = existing.header->state.load(std::memory_order_acquire) == Open && !own
+                          && isWriterAlive(existing.header);
+        ::munmap(existing.address, existing.size);
+        if (live) {
+            m_errorString = QString("Fix bus %1 is in use by process %2").arg(name).arg(pid);
+            return false;
+        }
+    }
+    ::shm_unlink(path.constData());
+
+    const int fd = ::shm_open(path.constData(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        m_errorString = lastError();
+        return false;
+    }
+
+    // ftruncate() zero-fills: every slot starts with sequence 0
+    const size_t size = SharedRing::segmentSize(slotCount);
+    void *address = MAP_FAILED;
+    if (::ftruncate(fd, off_t(size)) == 0) {
+        address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (address == MAP_FAILED) {
+        m_errorString = lastError();
+        ::close(fd);
+        ::shm_unlink(path.constData());
+        return false;
+    }
+    ::close(fd);
+
+    m_segment = new Segment;
+    m_segment->address = address;
+    m_segment->size = size;
+    m_segment->header = static_cast<RingHeader *>(address);
+    m_segment->slots = reinterpret_cast<RingSlot *>(static_cast<char *>(address) + sizeof(RingHeader));
+    m_segment->mask = slotCount - 1;
+
+    RingHeader *header = m_segment->header;
+    header->magic = MAGIC;
+    header->version = VERSION;
+    header->recordSize = sizeof(FixBusRecord);
+    header->capacity = slotCount;
+    header->writerPid = qint64(::getpid());
+    header->writerPidNamespace = pidNamespace();
+    header->head.store(0, std::memory_order_relaxed);
+    header->state.store(Open, std::memory_order_release);
+
+    m_name = QString::fromLocal8Bit(path.mid(1));
+    m_head = 0;
+    m_errorString.clear();
+    return true;
+}
+
+void FixBusWriter::close()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_segment) {
+        return;
+    }
+
+    m_segment->header->state.store(Closed, std::memory_order_release);
+    ::munmap(m_segment->address, m_segment->size);
+    ::shm_unlink(shmPath(m_name).constData());
+    delete m_segment;
+    m_segment = nullptr;
+}
+
+void FixBusWriter::publish(const GpsFix *fixes, int count)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_segment || count <= 0) {
+        return;
+    }
+
+    RingSlot *slots = m_segment->slots;
+    const quint64 mask = m_segment->mask;
+    quint64 head = m_head;
+    for (int i = 0; i < count; ++i) {
+        const FixBusRecord record = FixBusRecord::fromFix(fixes[i]);
+        quint64 words[RECORD_WORDS];
+        std::memcpy(words, &record, sizeof(record));
+
+        // Seqlock write: readers that see any new word also see sequence 0
+        RingSlot &slot = slots[head & mask];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int word = 0; word < RECORD_WORDS; ++word) {
+            slot.words[word].store(words[word], std::memory_order_relaxed);
+        }
+        slot.sequence.store(head + 1, std::memory_order_release);
+        ++head;
+    }
+
+    m_head = head;
+    m_segment->header->head.store(head, std::memory_order_release);
+}
+
+FixBusReader::FixBusReader()
+    : m_segment(nullptr)
+    , m_next(0)
+    , m_overruns(0)
+{
+}
+
+FixBusReader::~FixBusReader()
+{
+    detach();
+}
+
+bool FixBusReader::attach(const QString &name, StartPosition start)
+{
+    detach();
+
+    const QByteArray path = shmPath(name);
+    if (path.isEmpty()) {
+        m_errorString = QString("Invalid fix bus name \"%1\"").arg(name);
+        return false;
+    }
+
+    Segment *segment = new Segment;
+    if (!mapExisting(path, *segment, m_errorString)) {
+        delete segment;
+        return false;
+    }
+    m_segment = segment;
+
+    const quint64 head = m_segment->header->head.load(std::memory_order_acquire);
+    const quint64 capacity = m_segment->mask + 1;
+    m_next = start == Latest ? head : head - qMin(head, capacity);
+    m_overruns = 0;
+    m_errorString.clear();
+    return true;
+}
+
+void FixBusReader::detach()
+{
+    if (!m_segment) {
+        return;
+    }
+    ::munmap(m_segment->address, m_segment->size);
+    delete m_segment;
+    m_segment = nullptr;
+}
+
+int FixBusReader::read(GpsFix *fixes, int max)
+{
+    if (!m_segment) {
+        return 0;
+    }
+
+    const RingHeader *header = m_segment->header;
+    const quint64 capacity = m_segment->mask + 1;
+    quint64 head = header->head.load(std::memory_order_acquire);
+    if (head - m_next > capacity) {
+        skipTo(head - capacity);
+    }
+
+    int count = 0;
+    while (count < max && m_next < head) {
+        const RingSlot &slot = m_segment->slots[m_next & m_segment->mask];
+        const quint64 before = slot.sequence.load(std::memory_order_acquire);
+        if (before == m_next + 1) {
+            quint64 words[RECORD_WORDS];
+            for (int word = 0; word < RECORD_WORDS; ++word) {
+                words[word] = slot.words[word].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == before) {
+                FixBusRecord record;
+                std::memcpy(&record, words, sizeof(record));
+                fixes[count++] = record.toFix();
+                ++m_next;
+                continue;
+            }
+        }
+
+        // The writer lapped this reader: resume half a ring behind it so
+        // the next reads are not overwritten straight away
+        head = header->head.load(std::memory_order_acquire);
+        const quint64 resume = head - qMin(head, capacity / 2);
+        if (resume <= m_next) {
+            break; // The slot is being rewritten; try again on the next call
+        }
+        skipTo(resume);
+    }
+    return count;
+}
+
+bool FixBusReader::isWriterGone() const
+{
+    if (!m_segment) {
+        return true;
+    }
+    return !isWriterAlive(m_segment->header);
+}
+
+#else // !Q_OS_LINUX
+
+FixBusWriter::FixBusWriter()
+    : m_segment(nullptr)
+    , m_head(0)
+{
+}
+
+FixBusWriter::~FixBusWriter()
+{
+}
+
+bool FixBusWriter::create(const QString &, int)
+{
+    m_errorString = QStringLiteral("The shared-memory fix bus is only available on Linux");
+    return false;
+}
+
+void FixBusWriter::close()
+{
+}
+
+void FixBusWriter::publish(const GpsFix *, int)
+{
+}
+
+FixBusReader::FixBusReader()
+    : m_segment(nullptr)
+    , m_next(0)
+    , m_overruns(0)
+{
+}
+
+FixBusReader::~FixBusReader()
+{
+}
+
+bool FixBusReader::attach(const QString &, StartPosition)
+{
+    m_errorString = QStringLiteral("The shared-memory fix bus is only available on Linux");
+    return false;
+}
+
+void FixBusReader::detach()
+{
+}
+
+int FixBusReader::read(GpsFix *, int)
+{
+    return 0;
+}
+
+bool FixBusReader::isWriterGone() const
+{
+    return true;
+}
+
+#endif // Q_OS_LINUX
+
+bool FixBusWriter::isOpen() const
+{
+    return m_segment != nullptr;
+}
+
+QString FixBusWriter::name() const
+{
+    return m_name;
+}
+
+QString FixBusWriter::errorString() const
+{
+    return m_errorString;
+}
+
+quint64 FixBusWriter::published() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_head;
+}
+
+bool FixBusReader::isAttached() const
+{
+    return m_segment != nullptr;
+}
+
+QString FixBusReader::errorString() const
+{
+    return m_errorString;
+}
+
+quint64 FixBusReader::overruns() const
+{
+    return m_overruns;
+}
+
+quint64 FixBusReader::position() const
+{
+    return m_next;
+}
+
+void FixBusReader::skipTo(quint64 sequence)
+{
+    if (sequence > m_next) {
+        m_overruns += sequence - m_next;
+        m_next = sequence;
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef FIXBUS_H
+#define FIXBUS_H
+
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+#include "gpsfix.h"
+
+// One fix as stored in the shared ring: fixed size, native byte order,
+// no pointers, so any local process can produce or consume it without a
+// parser. Layout version FixBusWriter::VERSION.
+struct FixBusRecord
+{
+    double latitude;
+    double longitude;
+    double altitude;
+    double mapX; // Web Mercator; readers reproject, so producers may leave 0
+    double mapY;
+    qint64 timestampMs;       // Receive time, ms since the epoch; 0 for "now"
+    qint64 sourceTimestampMs; // Device clock, 0 when unknown
+    qint64 receiveNs;         // CLOCK_MONOTONIC receive stamp, 0 when unknown
+    quint32 deviceId;         // 0 lets the reader assign one per bus
+    float speed;
+    float heading;
+    float accuracy;
+    float hdop;
+    quint8 optionalFields; // GpsFix::OptionalField bits
+    quint8 satellitesUsed;
+    quint8 satellitesInView;
+    quint8 reserved;
+
+    static FixBusRecord fromFix(const GpsFix &fix);
+    GpsFix toFix() const;
+};
+
+static_assert(sizeof(FixBusRecord) == 88, "FixBusRecord layout is part of the shared-memory format");
+
+// Single-writer, multi-reader ring of FixBusRecords in POSIX shared memory
+// (/dev/shm/<name>).
+//
+// The segment is a 128-byte header (magic "GFXB", version, record size,
+// capacity, writer pid, state, writer PID namespace, and at offset 64 the 64-bit count of
+// records published) followed by capacity slots of a 64-bit sequence
+// word and the record. Record n goes to slot n % capacity. Its sequence
+// word is 0 while the writer fills the slot and n + 1 once the record is
+// complete. The head count is advanced after each batch. Readers map the
+// segment read-only and follow the head with a seqlock check of each slot,
+// so publishing and reading are plain memory operations; a reader that
+// falls more than capacity records behind sees the writer overwrite its
+// next slot and skips ahead, counting the records it lost as overruns.
+//
+// Only Linux is supported; create() and attach() fail elsewhere.
+class FixBusWriter
+{
+public:
+    static const quint32 MAGIC = 0x42584647; // "GFXB"
+    static const quint32 VERSION = 1;
+    static const int DEFAULT_CAPACITY = 1 << 18;
+
+    FixBusWriter();
+    ~FixBusWriter();
+
+    FixBusWriter(const FixBusWriter &) = delete;
+    FixBusWriter &operator=(const FixBusWriter &) = delete;
+
+    // Creates the segment, replacing one whose writer is gone; fails while
+    // another live process writes to name. capacity is rounded up to a
+    // power of two.
+    bool create(const QString &name, int capacity = DEFAULT_CAPACITY);
+
+    // Marks the ring closed for readers and removes the name
+    void close();
+    bool isOpen() const;
+    QString name() const;
+    QString errorString() const;
+
+    // Appends fixes; safe to call from several threads, which take turns
+    void publish(const GpsFix *fixes, int count);
+
+    // Records published since create()
+    quint64 published() const;
+
+private:
+    struct Segment;
+
+    Segment *m_segment;
+    QString m_name;
+    QString m_errorString;
+    quint64 m_head;
+    mutable QMutex m_mutex;
+};
+
+// One reader of a FixBusWriter ring. Readers never write to the segment,
+// so any number of them may follow one writer.
+class FixBusReader
+{
+public:
+    enum StartPosition {
+        Latest, // Only records published after attach()
+        Oldest  // Everything still in the ring
+    };
+
+    FixBusReader();
+    ~FixBusReader();
+
+    FixBusReader(const FixBusReader &) = delete;
+    FixBusReader &operator=(const FixBusReader &) = delete;
+
+    bool attach(const QString &name, StartPosition start = Latest);
+    void detach();
+    bool isAttached() const;
+    QString errorString() const;
+
+    // Copies up to max of the next records into fixes; returns how many
+    int read(GpsFix *fixes, int max);
+
+    // True once the writer closed the ring or its process is gone; the
+    // name may by then belong to a new ring, so detach and attach again.
+    // A writer in another PID namespace (container) cannot be probed, so
+    // its crash only shows once the ring is replaced.
+    bool isWriterGone() const;
+
+    // Records overwritten before this reader got to them
+    quint64 overruns() const;
+
+    // Sequence number of the next record to read
+    quint64 position() const;
+
+private:
+    struct Segment;
+
+    void skipTo(quint64 sequence);
+
+    Segment *m_segment;
+    QString m_errorString;
+    quint64 m_next;
+    quint64 m_overruns;
+};
+
+#endif // FIXBUS_H
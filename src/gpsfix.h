@@ -0,0 +1,71 @@
+#ifndef GPSFIX_H
+#define GPSFIX_H
+
+#include <QMetaType>
+#include <QVector>
+
+// A single decoded position report
+struct GpsFix
+{
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double altitude = 0.0;
+    qint64 timestampMs = 0; // Receive time, ms since the epoch
+
+    // Monotonic receive time (LatencyMonitor::now()) for latency tracing;
+    // 0 for fixes that did not come through the receiver
+    qint64 receiveNs = 0;
+
+    // Web Mercator (EPSG:3857) position, filled in at ingest
+    double mapX = 0.0;
+    double mapY = 0.0;
+
+    // Device clock from the payload, ms since the epoch; 0 when not sent
+    qint64 sourceTimestampMs = 0;
+
+    // Optional motion and quality values, valid where optionalFields says so
+    enum OptionalField : quint8 {
+        HasSpeed = 0x01,
+        HasHeading = 0x02,
+        HasAccuracy = 0x04
+    };
+    float speed = 0.0f;    // m/s
+    float heading = 0.0f;  // Degrees clockwise from true north
+    float accuracy = 0.0f; // Horizontal, metres
+    quint8 optionalFields = 0;
+
+    // Solution quality reported by NMEA receivers; 0 when unknown
+    float hdop = 0.0f;
+    quint8 satellitesUsed = 0;
+    quint8 satellitesInView = 0;
+
+    // Track the fix belongs to; 0 until the payload or the sender sets it
+    quint32 deviceId = 0;
+
+    // FNV-1a of a device name from the payload; never 0
+    static quint32 deviceIdFromName(const char *name, int size)
+    {
+        quint32 hash = 2166136261u;
+        for (int i = 0; i < size; ++i) {
+            hash = (hash ^ quint8(name[i])) * 16777619u;
+        }
+        return hash ? hash : 1;
+    }
+
+    // Hash of a sender's IPv6 (or IPv4-mapped) address and port; never 0
+    static quint32 deviceIdFromAddress(const quint8 *ipv6Address, quint16 port)
+    {
+        quint32 hash = 2166136261u;
+        for (int i = 0; i < 16; ++i) {
+            hash = (hash ^ ipv6Address[i]) * 16777619u;
+        }
+        hash = (hash ^ quint8(port >> 8)) * 16777619u;
+        hash = (hash ^ quint8(port)) * 16777619u;
+        return hash ? hash : 1;
+    }
+};
+
+Q_DECLARE_METATYPE(GpsFix)
+Q_DECLARE_METATYPE(QVector<GpsFix>)
+
+#endif // GPSFIX_H
@@ -0,0 +1,530 @@
+#include "gpsparser.h"
+#include "nmeastream.h"
+
+#include <QtEndian>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Powers of ten that are exactly representable as doubles
+const double kExactPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+inline void skipSpace(const char *&p, const char *end)
+{
+    while (p < end && isSpace(*p)) {
+        ++p;
+    }
+}
+
+// Locale-independent decimal parser working on raw bytes.
+// Accepts [+-]digits[.digits][(e|E)[+-]digits] and advances p past the number.
+// Mantissas up to 2^53 with small exponents are converted exactly.
+bool parseDouble(const char *&p, const char *end, double &out)
+{
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = (*s == '-');
+        ++s;
+    }
+
+    quint64 mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+
+    while (s < end && isDigit(*s)) {
+        if (significantDigits < 19) {
+            mantissa = mantissa * 10 + quint64(*s - '0');
+            if (mantissa != 0) {
+                ++significantDigits;
+            }
+        } else {
+            ++exponent;
+        }
+        anyDigits = true;
+        ++s;
+    }
+
+    if (s < end && *s == '.') {
+        ++s;
+        while (s < end && isDigit(*s)) {
+            if (significantDigits < 19) {
+                mantissa = mantissa * 10 + quint64(*s - '0');
+                if (mantissa != 0) {
+                    ++significantDigits;
+                }
+                --exponent;
+            }
+            anyDigits = true;
+            ++s;
+        }
+    }
+
+    if (!anyDigits) {
+        return false;
+    }
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        ++s;
+        bool negativeExponent = false;
+        if (s < end && (*s == '-' || *s == '+')) {
+            negativeExponent = (*s == '-');
+            ++s;
+        }
+        if (s == end || !isDigit(*s)) {
+            return false;
+        }
+        int explicitExponent = 0;
+        while (s < end && isDigit(*s)) {
+            if (explicitExponent < 10000) {
+                explicitExponent = explicitExponent * 10 + (*s - '0');
+            }
+            ++s;
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    double value = double(mantissa);
+    if (mantissa < (quint64(1) << 53) && exponent >= -22 && exponent <= 22) {
+        value = exponent < 0 ? value / kExactPowersOfTen[-exponent]
+                             : value * kExactPowersOfTen[exponent];
+    } else if (mantissa != 0) {
+        value *= std::pow(10.0, exponent);
+    }
+
+    out = negative ? -value : value;
+    p = s;
+    return true;
+}
+
+// Parses a whole field (surrounding blanks allowed) as a number
+bool parseField(const char *begin, const char *end, double &out)
+{
+    skipSpace(begin, end);
+    while (end > begin && isSpace(end[-1])) {
+        --end;
+    }
+    return parseDouble(begin, end, out) && begin == end;
+}
+
+bool isValidPosition(double latitude, double longitude)
+{
+    return latitude >= -90.0 && latitude <= 90.0 && longitude >= -180.0 && longitude <= 180.0;
+}
+
+// Skips a JSON string; p points at the opening quote
+bool skipJsonString(const char *&p, const char *end)
+{
+    ++p;
+    while (p < end) {
+        const char c = *p++;
+        if (c == '\\') {
+            if (p == end) {
+                return false;
+            }
+            ++p;
+        } else if (c == '"') {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool skipJsonLiteral(const char *&p, const char *end, const char *literal)
+{
+    const int length = int(std::strlen(literal));
+    if (end - p < length || std::memcmp(p, literal, length) != 0) {
+        return false;
+    }
+    p += length;
+    return true;
+}
+
+bool skipJsonValue(const char *&p, const char *end, int depth)
+{
+    if (p == end || depth > 32) {
+        return false;
+    }
+
+    switch (*p) {
+    case '"':
+        return skipJsonString(p, end);
+    case 't':
+        return skipJsonLiteral(p, end, "true");
+    case 'f':
+        return skipJsonLiteral(p, end, "false");
+    case 'n':
+        return skipJsonLiteral(p, end, "null");
+    case '{':
+    case '[': {
+        const bool isObject = (*p == '{');
+        const char close = isObject ? '}' : ']';
+        ++p;
+        skipSpace(p, end);
+        if (p < end && *p == close) {
+            ++p;
+            return true;
+        }
+        while (true) {
+            if (isObject) {
+                if (p == end || *p != '"' || !skipJsonString(p, end)) {
+                    return false;
+                }
+                skipSpace(p, end);
+                if (p == end || *p != ':') {
+                    return false;
+                }
+                ++p;
+                skipSpace(p, end);
+            }
+            if (!skipJsonValue(p, end, depth + 1)) {
+                return false;
+            }
+            skipSpace(p, end);
+            if (p == end) {
+                return false;
+            }
+            if (*p == close) {
+                ++p;
+                return true;
+            }
+            if (*p != ',') {
+                return false;
+            }
+            ++p;
+            skipSpace(p, end);
+        }
+    }
+    default: {
+        double ignored;
+        return parseDouble(p, end, ignored);
+    }
+    }
+}
+
+inline bool keyEquals(const char *key, int length, const char *name)
+{
+    return length == int(std::strlen(name)) && std::memcmp(key, name, length) == 0;
+}
+
+} // namespace
+
+GpsParser::Format GpsParser::detectFormat(const char *data, int size)
+{
+    // Binary payloads are never trimmed: 0x20 is a valid trailing byte
+    if (size >= 2 && quint8(data[0]) == BINARY_MAGIC && quint8(data[1]) == BINARY_MAGIC_TAG) {
+        return BinaryFormat;
+    }
+
+    const char *p = data;
+    const char *end = data + size;
+    skipSpace(p, end);
+    if (p == end) {
+        return UnknownFormat;
+    }
+
+    const char c = *p;
+    if (c == '{') {
+        return JsonFormat;
+    }
+    if (c == '$') {
+        return NmeaFormat;
+    }
+    if (isDigit(c) || c == '-' || c == '+' || c == '.') {
+        return CsvFormat;
+    }
+    return UnknownFormat;
+}
+
+bool GpsParser::parse(const QByteArray &data, GpsFix &fix)
+{
+    return parse(data.constData(), data.size(), fix);
+}
+
+bool GpsParser::parse(const char *data, int size, GpsFix &fix)
+{
+    return parse(data, size, &fix, 1) == 1;
+}
+
+int GpsParser::parse(const char *data, int size, GpsFix *fixes, int maxFixes)
+{
+    if (maxFixes < 1) {
+        return 0;
+    }
+    if (detectFormat(data, size) == BinaryFormat) {
+        return parseBinary(data, data + size, fixes, maxFixes);
+    }
+
+    const char *begin = data;
+    const char *end = data + size;
+    skipSpace(begin, end);
+    while (end > begin && isSpace(end[-1])) {
+        --end;
+    }
+
+    const Format format = detectFormat(begin, int(end - begin));
+    if (format == NmeaFormat) {
+        return parseNmea(begin, end, fixes, maxFixes);
+    }
+
+    // JSON and CSV carry one fix; reset whatever the caller's slot held
+    GpsFix &fix = fixes[0];
+    fix = GpsFix();
+
+    bool ok = false;
+    switch (format) {
+    case JsonFormat:
+        ok = parseJson(begin, end, fix);
+        break;
+    case CsvFormat:
+        ok = parseCsv(begin, end, fix);
+        break;
+    case NmeaFormat:
+    case BinaryFormat:
+    case UnknownFormat:
+        break;
+    }
+    return ok ? 1 : 0;
+}
+
+bool GpsParser::parseNumber(const char *begin, const char *end, double &value)
+{
+    return parseField(begin, end, value);
+}
+
+int GpsParser::parseBinary(const char *begin, const char *end, GpsFix *fixes, int maxFixes)
+{
+    const qint64 size = end - begin;
+    if (size < BINARY_HEADER_SIZE) {
+        return 0;
+    }
+
+    const uchar *header = reinterpret_cast<const uchar *>(begin);
+    const int count = header[3];
+    if (header[2] != BINARY_VERSION || count == 0 || count > maxFixes
+        || size != BINARY_HEADER_SIZE + qint64(count) * BINARY_RECORD_SIZE) {
+        return 0;
+    }
+
+    // A bad record rejects the whole datagram, like a malformed text payload
+    const uchar *record = header + BINARY_HEADER_SIZE;
+    for (int i = 0; i < count; ++i, record += BINARY_RECORD_SIZE) {
+        const double latitude = qFromLittleEndian<qint32>(record + 12) * 1e-7;
+        const double longitude = qFromLittleEndian<qint32>(record + 16) * 1e-7;
+        if (!isValidPosition(latitude, longitude)) {
+            return 0;
+        }
+
+        GpsFix &fix = fixes[i];
+        fix = GpsFix();
+        fix.deviceId = qFromLittleEndian<quint32>(record);
+        fix.sourceTimestampMs = qFromLittleEndian<qint64>(record + 4);
+        fix.latitude = latitude;
+        fix.longitude = longitude;
+        fix.altitude = qFromLittleEndian<qint32>(record + 20) * 1e-3;
+        fix.optionalFields = record[30] & (GpsFix::HasSpeed | GpsFix::HasHeading | GpsFix::HasAccuracy);
+        if (fix.optionalFields & GpsFix::HasSpeed) {
+            fix.speed = qFromLittleEndian<quint16>(record + 24) * 0.01f;
+        }
+        if (fix.optionalFields & GpsFix::HasHeading) {
+            fix.heading = qFromLittleEndian<quint16>(record + 26) * 0.01f;
+        }
+        if (fix.optionalFields & GpsFix::HasAccuracy) {
+            fix.accuracy = qFromLittleEndian<quint16>(record + 28) * 0.01f;
+        }
+    }
+    return count;
+}
+
+bool GpsParser::parseJson(const char *begin, const char *end, GpsFix &fix)
+{
+    const char *p = begin;
+    if (p == end || *p != '{') {
+        return false;
+    }
+    ++p;
+    skipSpace(p, end);
+
+    bool hasLatitude = false;
+    bool hasLongitude = false;
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double altitude = 0.0;
+    double optional[3] = { 0.0, 0.0, 0.0 };
+    quint8 optionalFields = 0;
+    quint32 deviceId = 0;
+
+    if (p < end && *p == '}') {
+        ++p;
+    } else {
+        while (true) {
+            if (p == end || *p != '"') {
+                return false;
+            }
+            const char *key = p + 1;
+            if (!skipJsonString(p, end)) {
+                return false;
+            }
+            const int keyLength = int(p - 1 - key);
+
+            skipSpace(p, end);
+            if (p == end || *p != ':') {
+                return false;
+            }
+            ++p;
+            skipSpace(p, end);
+            if (p == end) {
+                return false;
+            }
+
+            const bool isNumber = isDigit(*p) || *p == '-';
+            if (keyEquals(key, keyLength, "latitude")) {
+                if (!isNumber || !parseDouble(p, end, latitude)) {
+                    return false;
+                }
+                hasLatitude = true;
+            } else if (keyEquals(key, keyLength, "longitude")) {
+                if (!isNumber || !parseDouble(p, end, longitude)) {
+                    return false;
+                }
+                hasLongitude = true;
+            } else if (keyEquals(key, keyLength, "altitude") && isNumber) {
+                if (!parseDouble(p, end, altitude)) {
+                    return false;
+                }
+            } else if (isNumber && (keyEquals(key, keyLength, "speed")
+                                    || keyEquals(key, keyLength, "heading")
+                                    || keyEquals(key, keyLength, "accuracy"))) {
+                const int slot = key[0] == 's' ? 0 : key[0] == 'h' ? 1 : 2;
+                if (!parseDouble(p, end, optional[slot])) {
+                    return false;
+                }
+                optionalFields |= quint8(1 << slot);
+            } else if (keyEquals(key, keyLength, "device_id")) {
+                // String IDs are hashed as raw bytes; numeric IDs are used as-is
+                const char *value = p;
+                if (!skipJsonValue(p, end, 1)) {
+                    return false;
+                }
+                if (*value == '"') {
+                    deviceId = GpsFix::deviceIdFromName(value + 1, int(p - value) - 2);
+                } else if (isNumber) {
+                    double number = 0.0;
+                    if (parseDouble(value, p, number) && number >= 1.0 && number <= 4294967295.0) {
+                        deviceId = quint32(number);
+                    }
+                }
+            } else if (!skipJsonValue(p, end, 1)) {
+                return false;
+            }
+
+            skipSpace(p, end);
+            if (p == end) {
+                return false;
+            }
+            if (*p == '}') {
+                ++p;
+                break;
+            }
+            if (*p != ',') {
+                return false;
+            }
+            ++p;
+            skipSpace(p, end);
+        }
+    }
+
+    // Nothing but whitespace may follow the object
+    skipSpace(p, end);
+    if (p != end || !hasLatitude || !hasLongitude) {
+        return false;
+    }
+
+    if (!isValidPosition(latitude, longitude)) {
+        return false;
+    }
+
+    fix.latitude = latitude;
+    fix.longitude = longitude;
+    fix.altitude = altitude;
+    fix.speed = float(optional[0]);
+    fix.heading = float(optional[1]);
+    fix.accuracy = float(optional[2]);
+    fix.optionalFields = optionalFields;
+    fix.deviceId = deviceId;
+    return true;
+}
+
+bool GpsParser::parseCsv(const char *begin, const char *end, GpsFix &fix)
+{
+    // latitude,longitude[,altitude[,...]]
+    const char *fields[4];
+    const char *fieldEnds[4];
+    int fieldCount = 0;
+
+    const char *fieldStart = begin;
+    for (const char *p = begin; fieldCount < 4; ++p) {
+        if (p == end || *p == ',') {
+            fields[fieldCount] = fieldStart;
+            fieldEnds[fieldCount] = p;
+            ++fieldCount;
+            if (p == end) {
+                break;
+            }
+            fieldStart = p + 1;
+        }
+    }
+
+    if (fieldCount < 2) {
+        return false;
+    }
+
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double altitude = 0.0;
+    if (!parseField(fields[0], fieldEnds[0], latitude)
+        || !parseField(fields[1], fieldEnds[1], longitude)) {
+        return false;
+    }
+    if (fieldCount >= 3 && !parseField(fields[2], fieldEnds[2], altitude)) {
+        return false;
+    }
+
+    if (!isValidPosition(latitude, longitude)) {
+        return false;
+    }
+
+    fix.latitude = latitude;
+    fix.longitude = longitude;
+    fix.altitude = altitude;
+    fix.deviceId = 0;
+    return true;
+}
+
+int GpsParser::parseNmea(const char *begin, const char *end, GpsFix *fixes, int maxFixes)
+{
+    // Without a stream to carry state, the datagram is taken as whole
+    // sentences and whatever epoch it ends in is complete
+    NmeaStream stream;
+    const int count = stream.feed(begin, int(end - begin), fixes, maxFixes);
+    if (stream.acceptedSentences() == 0) {
+        return 0;
+    }
+    return count + stream.flush(fixes + count, maxFixes - count);
+}
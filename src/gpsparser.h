@@ -0,0 +1,70 @@
+#ifndef GPSPARSER_H
+#define GPSPARSER_H
+
+#include <QByteArray>
+
+#include "gpsfix.h"
+
+// Single-pass GPS payload parser.
+//
+// The wire format is picked from the first significant byte ('{' JSON,
+// '$' NMEA, digit/sign CSV, 0xA5 binary) and decoded straight from the raw
+// bytes, so a datagram is scanned exactly once and no temporary strings
+// are allocated. NMEA datagrams go through a one-shot NmeaStream and may
+// hold several sentences and epochs; use a long-lived NmeaStream per
+// source when sentences can span datagrams.
+//
+// Binary datagrams are little-endian: a 4-byte header (0xA5, 'G', version,
+// record count) followed by count 32-byte records:
+//
+//   offset  type  field
+//        0  u32   device ID (0: identify by sender address)
+//        4  i64   device timestamp, ms since the epoch (0: unknown)
+//       12  i32   latitude, 1e-7 degrees
+//       16  i32   longitude, 1e-7 degrees
+//       20  i32   altitude, mm
+//       24  u16   speed, cm/s
+//       26  u16   heading, 0.01 degrees
+//       28  u16   horizontal accuracy, cm
+//       30  u8    flags: GpsFix::HasSpeed | HasHeading | HasAccuracy
+//       31  u8    reserved, 0
+class GpsParser
+{
+public:
+    enum Format {
+        UnknownFormat,
+        JsonFormat,
+        CsvFormat,
+        NmeaFormat,
+        BinaryFormat
+    };
+
+    static Format detectFormat(const char *data, int size);
+
+    // Single-fix payloads; a binary datagram must hold exactly one record
+    static bool parse(const QByteArray &data, GpsFix &fix);
+    static bool parse(const char *data, int size, GpsFix &fix);
+
+    // Decodes every fix in the datagram into fixes and returns how many;
+    // 0 if the payload is invalid or a binary one holds more than maxFixes
+    // (surplus NMEA epochs are dropped instead)
+    static int parse(const char *data, int size, GpsFix *fixes, int maxFixes);
+
+    // Locale-independent decimal number filling the whole of [begin, end)
+    static bool parseNumber(const char *begin, const char *end, double &value);
+
+    static const quint8 BINARY_MAGIC = 0xA5;
+    static const quint8 BINARY_MAGIC_TAG = 'G';
+    static const quint8 BINARY_VERSION = 1;
+    static const int BINARY_HEADER_SIZE = 4;
+    static const int BINARY_RECORD_SIZE = 32;
+    static const int MAX_FIXES_PER_DATAGRAM = 255;
+
+private:
+    static int parseBinary(const char *begin, const char *end, GpsFix *fixes, int maxFixes);
+    static bool parseJson(const char *begin, const char *end, GpsFix &fix);
+    static bool parseCsv(const char *begin, const char *end, GpsFix &fix);
+    static int parseNmea(const char *begin, const char *end, GpsFix *fixes, int maxFixes);
+};
+
+#endif // GPSPARSER_H
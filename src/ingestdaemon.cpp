@@ -0,0 +1,129 @@
+#include "ingestdaemon.h"
+#include "latencymonitor.h"
+#include "logger.h"
+#include "udpreceiver.h"
+
+IngestDaemon::IngestDaemon(QObject *parent)
+    : QObject(parent)
+    , m_receiver(nullptr)
+    , m_fixesReceived(0)
+    , m_lastDatagrams(0)
+    , m_lastFixes(0)
+    , m_lastStatsNs(0)
+    , m_segmentsSealed(0)
+{
+    m_receiver = new UdpReceiver(UdpReceiver::WorkerThread, this);
+    connect(m_receiver, &UdpReceiver::gpsFixesReceived, this, &IngestDaemon::onGpsFixesReceived);
+    connect(m_receiver, &UdpReceiver::connectionStatusChanged, this, &IngestDaemon::onConnectionStatusChanged);
+    connect(m_receiver, &UdpReceiver::errorOccurred, this, &IngestDaemon::onErrorOccurred);
+    connect(m_receiver, &UdpReceiver::archiveSegmentSealed, this, &IngestDaemon::onArchiveSegmentSealed);
+
+    m_statsTimer.setInterval(STATS_INTERVAL_S_DEFAULT * 1000);
+    connect(&m_statsTimer, &QTimer::timeout, this, &IngestDaemon::logStats);
+}
+
+IngestDaemon::~IngestDaemon()
+{
+    stop();
+}
+
+bool IngestDaemon::start(const ReceiverConfig &config)
+{
+    if (!m_receiver->startListening(config)) {
+        GPS_LOG_ERROR(Logger::App, "Failed to listen on UDP {}", config.endpointsString());
+        return false;
+    }
+
+    const ReceiverConfig active = m_receiver->config();
+    GPS_LOG_INFO(Logger::App, "Listening on UDP {} ({} thread(s))", active.endpointsString(), active.threads);
+
+    m_lastStatsNs = LatencyMonitor::now();
+    if (m_statsTimer.interval() > 0) {
+        m_statsTimer.start();
+    }
+    return true;
+}
+
+void IngestDaemon::stop()
+{
+    m_statsTimer.stop();
+    if (m_receiver->isRecording()) {
+        m_receiver->stopRecording();
+    }
+    if (m_receiver->isListening()) {
+        m_receiver->stopListening();
+        logStats();
+        GPS_LOG_INFO(Logger::App, "Stopped; {} fixes from {} devices", m_fixesReceived, m_trackTable.count());
+    }
+}
+
+bool IngestDaemon::startRecording(const QString &path)
+{
+    if (!m_receiver->startRecording(path)) {
+        GPS_LOG_ERROR(Logger::App, "Failed to record to {}", path);
+        return false;
+    }
+    GPS_LOG_INFO(Logger::App, "Recording datagrams to {}", path);
+    return true;
+}
+
+void IngestDaemon::setStatsInterval(int seconds)
+{
+    m_statsTimer.setInterval(qMax(0, seconds) * 1000);
+    if (seconds <= 0) {
+        m_statsTimer.stop();
+    } else if (m_receiver->isListening()) {
+        m_statsTimer.start();
+    }
+}
+
+const TrackTable &IngestDaemon::tracks() const
+{
+    return m_trackTable;
+}
+
+void IngestDaemon::onGpsFixesReceived(const QVector<GpsFix> &fixes)
+{
+    // Latest position per device only; trails would grow without bound
+    m_trackTable.update(fixes, false);
+    m_fixesReceived += quint64(fixes.size());
+}
+
+void IngestDaemon::onConnectionStatusChanged(bool connected)
+{
+    GPS_LOG_INFO(Logger::App, connected ? "Receiving GPS data" : "No GPS data");
+}
+
+void IngestDaemon::onErrorOccurred(const QString &error)
+{
+    GPS_LOG_ERROR(Logger::App, "{}", error);
+}
+
+void IngestDaemon::onArchiveSegmentSealed(const QString &path)
+{
+    ++m_segmentsSealed;
+    GPS_LOG_DEBUG(Logger::App, "Archive segment {}", path);
+}
+
+void IngestDaemon::logStats()
+{
+    const qint64 nowNs = LatencyMonitor::now();
+    const double seconds = qMax<qint64>(1, nowNs - m_lastStatsNs) / 1e9;
+    const quint64 datagrams = m_receiver->datagramsReceived();
+
+    GPS_LOG_INFO(Logger::App,
+                 "{} datagrams/s, {} fixes/s | Datagrams: {} | Parse errors: {} | Dropped: {} | "
+                 "Kernel drops: {} | Tracks: {} | Segments: {}",
+                 qint64((datagrams - m_lastDatagrams) / seconds), qint64((m_fixesReceived - m_lastFixes) / seconds),
+                 datagrams, m_receiver->parseErrors(), m_receiver->droppedFixes(), m_receiver->kernelDrops(),
+                 m_trackTable.count(), m_segmentsSealed);
+
+    const ReceiverConfig active = m_receiver->config();
+    if (!active.busInput.isEmpty()) {
+        GPS_LOG_INFO(Logger::App, "Fix bus {} | Overruns: {}", active.busInput, m_receiver->busOverruns());
+    }
+
+    m_lastDatagrams = datagrams;
+    m_lastFixes = m_fixesReceived;
+    m_lastStatsNs = nowNs;
+}
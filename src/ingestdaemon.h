@@ -0,0 +1,59 @@
+#ifndef INGESTDAEMON_H
+#define INGESTDAEMON_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include "gpsfix.h"
+#include "receiverconfig.h"
+#include "tracktable.h"
+
+class UdpReceiver;
+
+// The ingest side of the viewer without a GUI: UdpReceiver on its worker
+// threads parses, projects and archives fixes, and the latest fix of every
+// device is kept in a TrackTable. Trails are not recorded; the archive is
+// the history. Throughput and track counts are logged every stats interval.
+class IngestDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IngestDaemon(QObject *parent = nullptr);
+    ~IngestDaemon();
+
+    bool start(const ReceiverConfig &config);
+
+    // Stops listening and seals the open archive segments
+    void stop();
+
+    // Raw datagram capture, as in the GUI; call after start()
+    bool startRecording(const QString &path);
+
+    // Seconds between stats lines; 0 turns them off
+    void setStatsInterval(int seconds);
+
+    const TrackTable &tracks() const;
+
+private slots:
+    void onGpsFixesReceived(const QVector<GpsFix> &fixes);
+    void onConnectionStatusChanged(bool connected);
+    void onErrorOccurred(const QString &error);
+    void onArchiveSegmentSealed(const QString &path);
+    void logStats();
+
+private:
+    UdpReceiver *m_receiver;
+    TrackTable m_trackTable;
+    QTimer m_statsTimer;
+    quint64 m_fixesReceived;
+    quint64 m_lastDatagrams;
+    quint64 m_lastFixes;
+    qint64 m_lastStatsNs;
+    int m_segmentsSealed;
+
+    static const int STATS_INTERVAL_S_DEFAULT = 10;
+};
+
+#endif // INGESTDAEMON_H
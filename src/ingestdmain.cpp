@@ -0,0 +1,133 @@
+// Headless ingest daemon: receives, parses and archives GPS fixes with no
+// GUI. Links Qt Core and Network only; neither Qt Widgets nor QGIS is
+// loaded, so it fits edge boxes that only collect data. The GUI reads the
+// archive it writes from the same directory.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QTextStream>
+
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "ingestdaemon.h"
+#include "logger.h"
+#include "receiverconfig.h"
+
+#ifdef Q_OS_UNIX
+namespace {
+
+// SIGINT/SIGTERM write a byte here; the event loop reads it and quits so
+// the archive segments are sealed on the way out
+int g_signalSockets[2] = { -1, -1 };
+
+void onTerminationSignal(int)
+{
+    const char byte = 1;
+    const ssize_t written = ::write(g_signalSockets[0], &byte, 1);
+    Q_UNUSED(written);
+}
+
+bool installSignalHandlers(QCoreApplication &app)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, g_signalSockets) != 0) {
+        return false;
+    }
+
+    QSocketNotifier *notifier = new QSocketNotifier(g_signalSockets[1], QSocketNotifier::Read, &app);
+    // activated() is overloaded in Qt 5.15, hence the string-based connection;
+    // the byte is left unread, a second signal only asks to quit again
+    QObject::connect(notifier, SIGNAL(activated(int)), &app, SLOT(quit()));
+
+    struct sigaction action = {};
+    action.sa_handler = onTerminationSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return ::sigaction(SIGINT, &action, nullptr) == 0 && ::sigaction(SIGTERM, &action, nullptr) == 0;
+}
+
+} // namespace
+#endif
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Same names as the GUI, so both use the same archive directory
+    app.setApplicationName("GPS Map Viewer");
+    app.setApplicationVersion("1.0.0");
+    app.setOrganizationName("GPS Map Viewer");
+    app.setOrganizationDomain("gps-map-viewer.local");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Receives GPS fixes over UDP and writes them to the track archive.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption({ { "p", "port" }, "UDP port to listen on.", "port", "12345" });
+    parser.addOption({ "listen", "More sockets, comma-separated: port[@multicast group][/json|csv|nmea|binary].",
+                       "list" });
+    parser.addOption({ "buffer", "Socket receive buffer in KiB (default: system default).", "KiB", "0" });
+    parser.addOption({ "threads", "Receiver threads sharing each unicast port.", "count", "1" });
+    parser.addOption({ "archive", "Track archive directory (default: GPS_ARCHIVE_DIR or the application "
+                                  "data directory).", "directory" });
+    parser.addOption({ "archive-max", "Delete the oldest archived fixes beyond this size; 0 for no limit "
+                                      "(default: GPS_ARCHIVE_MAX_MB or 2048).", "MiB" });
+    parser.addOption({ "record", "Also record every datagram to this capture file.", "file" });
+    parser.addOption({ "bus-in", "Also read fixes from this shared-memory fix bus.", "name" });
+    parser.addOption({ "bus-out", "Publish every parsed fix to this shared-memory fix bus.", "name" });
+    parser.addOption({ "bus-capacity", "Records the output fix bus holds (default: 262144).", "records", "0" });
+    parser.addOption({ "stats", "Seconds between stats lines in the log; 0 for none.", "seconds", "10" });
+    parser.process(app);
+
+    // Logs go to stderr unless GPS_LOG_FILE names a file
+    Logger::configure(qEnvironmentVariable("GPS_LOG_RULES"));
+    if (!Logger::instance().start(qEnvironmentVariable("GPS_LOG_FILE"))) {
+        QTextStream(stderr) << "Could not open log file " << qEnvironmentVariable("GPS_LOG_FILE") << '\n';
+    }
+
+    ReceiverEndpoint primary;
+    primary.port = quint16(parser.value("port").toUInt());
+
+    ReceiverConfig config;
+    config.endpoints.append(primary);
+    QString error;
+    if (!ReceiverConfig::parseEndpoints(parser.value("listen"), config.endpoints, error)) {
+        QTextStream(stderr) << error << '\n';
+        Logger::instance().stop();
+        return 2;
+    }
+    config.receiveBufferBytes = qMax(0, parser.value("buffer").toInt()) * 1024;
+    config.threads = qMax(1, parser.value("threads").toInt());
+    config.busInput = parser.value("bus-in");
+    config.busOutput = parser.value("bus-out");
+    config.busCapacity = qMax(0, parser.value("bus-capacity").toInt());
+    config.archiveDirectory = parser.value("archive");
+    if (parser.isSet("archive-max")) {
+        config.archiveMaxBytes = qMax(0LL, parser.value("archive-max").toLongLong()) * 1024 * 1024;
+    }
+
+#ifdef Q_OS_UNIX
+    if (!installSignalHandlers(app)) {
+        GPS_LOG_WARNING(Logger::App, "Could not install signal handlers; SIGINT and SIGTERM will not seal "
+                                     "the open archive segment");
+    }
+#endif
+
+    int result = 1;
+    {
+        IngestDaemon daemon;
+        daemon.setStatsInterval(parser.value("stats").toInt());
+        if (daemon.start(config)
+            && (!parser.isSet("record") || daemon.startRecording(parser.value("record")))) {
+            result = app.exec();
+        }
+        daemon.stop();
+    }
+
+    Logger::instance().stop();
+    return result;
+}
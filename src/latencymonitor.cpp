@@ -0,0 +1,163 @@
+#include "latencymonitor.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QTextStream>
+#include <QtAlgorithms>
+
+#include <chrono>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::record(qint64 value)
+{
+    const quint64 clamped = quint64(qBound<qint64>(0, value, (Q_INT64_C(1) << MAX_VALUE_BITS) - 1));
+    m_counts[bucketIndex(clamped)].fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(1, std::memory_order_relaxed);
+
+    qint64 previous = m_max.load(std::memory_order_relaxed);
+    while (value > previous && !m_max.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (std::atomic<quint64> &count : m_counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    m_total.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::count() const
+{
+    return m_total.load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::max() const
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::valueAtPercentile(double percentile) const
+{
+    const quint64 total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    const quint64 target = qMax<quint64>(1, quint64(std::ceil(qBound(0.0, percentile, 100.0) / 100.0 * total)));
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return qMin(bucketUpperBound(i), max());
+        }
+    }
+    return max(); // Raced with a concurrent record
+}
+
+int LatencyHistogram::bucketIndex(quint64 value)
+{
+    if (value < quint64(SUB_BUCKET_COUNT)) {
+        return int(value);
+    }
+
+    // Keep the top SUB_BUCKET_BITS bits of the value
+    const int highestBit = 63 - qCountLeadingZeroBits(value);
+    const int shift = highestBit - (SUB_BUCKET_BITS - 1);
+    const int halfCount = SUB_BUCKET_COUNT / 2;
+    return SUB_BUCKET_COUNT + (shift - 1) * halfCount + int(value >> shift) - halfCount;
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    const int halfCount = SUB_BUCKET_COUNT / 2;
+    const int shift = (index - SUB_BUCKET_COUNT) / halfCount + 1;
+    const qint64 subBucket = (index - SUB_BUCKET_COUNT) % halfCount + halfCount;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+LatencyMonitor::LatencyMonitor()
+{
+}
+
+LatencyMonitor &LatencyMonitor::instance()
+{
+    static LatencyMonitor monitor;
+    return monitor;
+}
+
+qint64 LatencyMonitor::now()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyMonitor::record(Stage stage, qint64 receiveNs, qint64 nowNs)
+{
+    if (receiveNs != 0) {
+        m_stages[stage].histogram.record((nowNs - receiveNs) / 1000);
+    }
+}
+
+const LatencyHistogram &LatencyMonitor::histogram(Stage stage) const
+{
+    return m_stages[stage].histogram;
+}
+
+void LatencyMonitor::reset()
+{
+    for (Slot &slot : m_stages) {
+        slot.histogram.reset();
+    }
+}
+
+bool LatencyMonitor::dumpToFile(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        return false;
+    }
+
+    static const double percentiles[] = { 0.0, 10.0, 25.0, 50.0, 75.0, 90.0, 95.0, 99.0, 99.9, 99.99, 100.0 };
+
+    QTextStream out(&file);
+    out << "# Latency from socket receive, microseconds, "
+        << QDateTime::currentDateTime().toString(Qt::ISODate) << '\n';
+    for (int stage = 0; stage < StageCount; ++stage) {
+        const LatencyHistogram &stageHistogram = histogram(Stage(stage));
+        out << '\n' << "## " << stageName(Stage(stage)) << " (" << stageHistogram.count() << " samples)\n";
+        out << qSetFieldWidth(12) << "Percentile" << "Value" << qSetFieldWidth(0) << '\n';
+        for (double percentile : percentiles) {
+            out << qSetFieldWidth(12) << QString::number(percentile, 'f', 2)
+                << stageHistogram.valueAtPercentile(percentile) << qSetFieldWidth(0) << '\n';
+        }
+    }
+    out.flush();
+    return file.error() == QFileDevice::NoError;
+}
+
+const char *LatencyMonitor::stageName(Stage stage)
+{
+    switch (stage) {
+    case Queued:
+        return "Queued";
+    case Delivered:
+        return "Delivered";
+    case Applied:
+        return "Applied";
+    case Painted:
+        return "Painted";
+    default:
+        return "?";
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef LATENCYMONITOR_H
+#define LATENCYMONITOR_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+// Log-linear latency histogram in the style of HdrHistogram.
+//
+// Values below SUB_BUCKET_COUNT are counted exactly; above that each power
+// of two is split into SUB_BUCKET_COUNT / 2 buckets, so any recorded value
+// is reported within about 3% of its true value. Recording is a relaxed
+// atomic increment and may happen on any thread while another reads.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(qint64 value);
+    void reset();
+
+    quint64 count() const;
+    qint64 max() const;
+
+    // Highest value equivalent to the one at the percentile (0-100)
+    qint64 valueAtPercentile(double percentile) const;
+
+    static const int SUB_BUCKET_BITS = 6;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int MAX_VALUE_BITS = 40; // Values are clamped to 2^40 - 1
+    static const int BUCKET_COUNT = SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT / 2;
+
+private:
+    static int bucketIndex(quint64 value);
+    static qint64 bucketUpperBound(int index);
+
+    std::atomic<quint64> m_counts[BUCKET_COUNT];
+    std::atomic<quint64> m_total;
+    std::atomic<qint64> m_max;
+};
+
+// Process-wide latency from a fix's socket receive to each pipeline stage.
+//
+// Fixes carry GpsFix::receiveNs, read from now() when their datagram left
+// the socket; each stage records now() - receiveNs in microseconds. Stage
+// histograms are written by the thread that owns the stage (the receiver
+// thread for Queued, the GUI thread for the rest) and read by the
+// diagnostics panel.
+class LatencyMonitor
+{
+public:
+    enum Stage {
+        Queued,    // Parsed, projected and pushed to the hand-off queue
+        Delivered, // Drained by the GUI thread
+        Applied,   // Applied to the map on a frame tick
+        Painted,   // Selected position marker painted
+        StageCount
+    };
+
+    static LatencyMonitor &instance();
+
+    // Monotonic clock shared by all stages, in nanoseconds
+    static qint64 now();
+
+    // No-op for fixes without a receive stamp
+    void record(Stage stage, qint64 receiveNs, qint64 nowNs);
+
+    const LatencyHistogram &histogram(Stage stage) const;
+    void reset();
+
+    // Percentile distribution of every stage as a text table
+    bool dumpToFile(const QString &path) const;
+
+    static const char *stageName(Stage stage);
+
+private:
+    LatencyMonitor();
+
+    struct alignas(64) Slot
+    {
+        LatencyHistogram histogram;
+    };
+    Slot m_stages[StageCount];
+};
+
+#endif // LATENCYMONITOR_H
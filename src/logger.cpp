@@ -0,0 +1,396 @@
+#include "logger.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+namespace {
+
+const int RING_CAPACITY = 8192; // Must be a power of two
+const int SINK_INTERVAL_MS = 20;
+
+qint64 monotonicMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+std::atomic<int> Logger::s_levels[Logger::CategoryCount] = {
+    { Logger::Info },   // App
+    { Logger::Info },   // Network
+    { Logger::Info },   // Parser
+    { Logger::Info },   // Map
+    { Logger::Info },   // Ui
+};
+
+// Drains the ring and writes formatted lines off the hot path
+class LogSinkThread : public QThread
+{
+public:
+    explicit LogSinkThread(Logger *logger)
+        : m_logger(logger)
+        , m_stopRequested(false)
+    {
+        setObjectName("LogSink");
+    }
+
+    void requestStop()
+    {
+        m_stopRequested.store(true, std::memory_order_release);
+    }
+
+protected:
+    void run() override
+    {
+        while (!m_stopRequested.load(std::memory_order_acquire)) {
+            m_logger->drain();
+            msleep(SINK_INTERVAL_MS);
+        }
+        m_logger->drain();
+    }
+
+private:
+    Logger *m_logger;
+    std::atomic<bool> m_stopRequested;
+};
+
+struct Logger::Private
+{
+    std::unique_ptr<Record[]> ring;
+    std::atomic<quint64> enqueuePosition;
+    quint64 dequeuePosition;
+    std::atomic<quint64> droppedRecords;
+
+    LogSinkThread *sinkThread;
+    QFile file;
+    QByteArray line;
+
+    Private()
+        : ring(new Record[RING_CAPACITY])
+        , enqueuePosition(0)
+        , dequeuePosition(0)
+        , droppedRecords(0)
+        , sinkThread(nullptr)
+    {
+        for (int i = 0; i < RING_CAPACITY; ++i) {
+            ring[i].sequence.store(quint64(i), std::memory_order_relaxed);
+        }
+        line.reserve(256);
+    }
+};
+
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : d(new Private)
+{
+}
+
+Logger::~Logger()
+{
+    stop();
+    delete d;
+}
+
+bool Logger::start(const QString &filePath)
+{
+    stop();
+
+    bool ok = true;
+    if (!filePath.isEmpty()) {
+        d->file.setFileName(filePath);
+        ok = d->file.open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+
+    d->sinkThread = new LogSinkThread(this);
+    d->sinkThread->start(QThread::LowPriority);
+    return ok;
+}
+
+void Logger::stop()
+{
+    if (d->sinkThread) {
+        d->sinkThread->requestStop();
+        d->sinkThread->wait();
+        delete d->sinkThread;
+        d->sinkThread = nullptr;
+    }
+    if (d->file.isOpen()) {
+        d->file.close();
+    }
+}
+
+QString Logger::filePath() const
+{
+    return d->file.fileName();
+}
+
+void Logger::setLevel(Category category, Level level)
+{
+    s_levels[category].store(int(level), std::memory_order_relaxed);
+}
+
+Logger::Level Logger::level(Category category)
+{
+    return Level(s_levels[category].load(std::memory_order_relaxed));
+}
+
+void Logger::configure(const QString &rules)
+{
+    static const char *const levelNames[] = { "trace", "debug", "info", "warning", "error", "off" };
+
+    const QStringList entries = rules.split(',', Qt::SkipEmptyParts);
+    for (const QString &entry : entries) {
+        const QStringList parts = entry.split('=');
+        if (parts.size() != 2) {
+            continue;
+        }
+
+        const QString name = parts[0].trimmed().toLower();
+        const QString levelText = parts[1].trimmed().toLower();
+
+        int newLevel = -1;
+        for (int i = 0; i <= Off; ++i) {
+            if (levelText == QLatin1String(levelNames[i])) {
+                newLevel = i;
+            }
+        }
+        if (newLevel < 0) {
+            continue;
+        }
+
+        for (int category = 0; category < CategoryCount; ++category) {
+            if (name == "*" || name == QLatin1String(categoryName(Category(category)))) {
+                setLevel(Category(category), Level(newLevel));
+            }
+        }
+    }
+}
+
+quint64 Logger::droppedRecords() const
+{
+    return d->droppedRecords.load(std::memory_order_relaxed);
+}
+
+const char *Logger::levelName(Level level)
+{
+    switch (level) {
+    case Trace: return "TRACE";
+    case Debug: return "DEBUG";
+    case Info: return "INFO";
+    case Warning: return "WARN";
+    case Error: return "ERROR";
+    case Off: break;
+    }
+    return "OFF";
+}
+
+const char *Logger::categoryName(Category category)
+{
+    switch (category) {
+    case App: return "app";
+    case Network: return "network";
+    case Parser: return "parser";
+    case Map: return "map";
+    case Ui: return "ui";
+    case CategoryCount: break;
+    }
+    return "unknown";
+}
+
+Logger::Record *Logger::beginRecord(Level level, Category category, const char *format, quint32 suppressed)
+{
+    // Bounded MPMC slot claim: a slot is free for position p when its
+    // sequence equals p, and readable by the sink once it equals p + 1
+    quint64 position = d->enqueuePosition.load(std::memory_order_relaxed);
+    Record *record = nullptr;
+    while (true) {
+        record = &d->ring[position & (RING_CAPACITY - 1)];
+        const quint64 sequence = record->sequence.load(std::memory_order_acquire);
+        const qint64 difference = qint64(sequence) - qint64(position);
+        if (difference == 0) {
+            if (d->enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                         std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // Ring full: never block the caller
+            d->droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            position = d->enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->timestampMs = QDateTime::currentMSecsSinceEpoch();
+    record->format = format;
+    record->level = quint8(level);
+    record->category = quint8(category);
+    record->argCount = 0;
+    record->textUsed = 0;
+    record->suppressed = suppressed;
+    return record;
+}
+
+void Logger::commitRecord(Record *record)
+{
+    record->sequence.store(record->sequence.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_release);
+}
+
+void Logger::addArg(Record *record, qint64 value)
+{
+    if (record->argCount < MAX_ARGS) {
+        Arg &arg = record->args[record->argCount++];
+        arg.type = Arg::IntArg;
+        arg.i = value;
+    }
+}
+
+void Logger::addArg(Record *record, quint64 value)
+{
+    if (record->argCount < MAX_ARGS) {
+        Arg &arg = record->args[record->argCount++];
+        arg.type = Arg::UIntArg;
+        arg.u = value;
+    }
+}
+
+void Logger::addArg(Record *record, double value)
+{
+    if (record->argCount < MAX_ARGS) {
+        Arg &arg = record->args[record->argCount++];
+        arg.type = Arg::DoubleArg;
+        arg.d = value;
+    }
+}
+
+void Logger::addArg(Record *record, const char *text, int length)
+{
+    if (record->argCount < MAX_ARGS) {
+        const int copied = qBound(0, length, TEXT_CAPACITY - record->textUsed);
+        Arg &arg = record->args[record->argCount++];
+        arg.type = Arg::TextArg;
+        arg.textOffset = record->textUsed;
+        arg.textLength = quint8(copied);
+        std::memcpy(record->text + record->textUsed, text, copied);
+        record->textUsed = quint8(record->textUsed + copied);
+    }
+}
+
+void Logger::appendString(Record *record, const QString &value)
+{
+    if (record->argCount >= MAX_ARGS) {
+        return;
+    }
+
+    // Latin-1 copy straight into the record, no temporary QByteArray
+    const int copied = qBound(0, value.size(), TEXT_CAPACITY - record->textUsed);
+    Arg &arg = record->args[record->argCount++];
+    arg.type = Arg::TextArg;
+    arg.textOffset = record->textUsed;
+    arg.textLength = quint8(copied);
+    const QChar *chars = value.constData();
+    for (int i = 0; i < copied; ++i) {
+        const ushort c = chars[i].unicode();
+        record->text[record->textUsed + i] = c < 0x80 ? char(c) : '?';
+    }
+    record->textUsed = quint8(record->textUsed + copied);
+}
+
+void Logger::drain()
+{
+    bool wrote = false;
+
+    while (true) {
+        Record &record = d->ring[d->dequeuePosition & (RING_CAPACITY - 1)];
+        if (record.sequence.load(std::memory_order_acquire) != d->dequeuePosition + 1) {
+            break;
+        }
+
+        QByteArray &line = d->line;
+        line.clear();
+        line += QDateTime::fromMSecsSinceEpoch(record.timestampMs)
+                    .toString("yyyy-MM-dd hh:mm:ss.zzz").toLatin1();
+        line += " [";
+        line += levelName(Level(record.level));
+        line += "] ";
+        line += categoryName(Category(record.category));
+        line += ": ";
+
+        int argIndex = 0;
+        for (const char *p = record.format; *p; ++p) {
+            if (p[0] == '{' && p[1] == '}' && argIndex < record.argCount) {
+                const Arg &arg = record.args[argIndex++];
+                switch (arg.type) {
+                case Arg::IntArg:
+                    line += QByteArray::number(arg.i);
+                    break;
+                case Arg::UIntArg:
+                    line += QByteArray::number(arg.u);
+                    break;
+                case Arg::DoubleArg:
+                    line += QByteArray::number(arg.d, 'g', 10);
+                    break;
+                case Arg::TextArg:
+                    line.append(record.text + arg.textOffset, arg.textLength);
+                    break;
+                }
+                ++p;
+            } else {
+                line += *p;
+            }
+        }
+
+        if (record.suppressed > 0) {
+            line += " (";
+            line += QByteArray::number(record.suppressed);
+            line += " similar messages suppressed)";
+        }
+        line += '\n';
+
+        // Release the slot before the (slow) write
+        record.sequence.store(d->dequeuePosition + RING_CAPACITY, std::memory_order_release);
+        ++d->dequeuePosition;
+
+        if (d->file.isOpen()) {
+            d->file.write(line);
+        } else {
+            std::fwrite(line.constData(), 1, size_t(line.size()), stderr);
+        }
+        wrote = true;
+    }
+
+    if (wrote && d->file.isOpen()) {
+        d->file.flush();
+    }
+}
+
+bool LogRateLimiter::allow(quint32 &suppressed)
+{
+    const qint64 now = monotonicMs();
+    qint64 windowStart = m_windowStartMs.load(std::memory_order_relaxed);
+    if (now - windowStart >= 1000
+        && m_windowStartMs.compare_exchange_strong(windowStart, now, std::memory_order_relaxed)) {
+        m_count.store(0, std::memory_order_relaxed);
+    }
+
+    if (m_count.fetch_add(1, std::memory_order_relaxed) < m_perSecond) {
+        suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
@@ -0,0 +1,232 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+// Leveled, per-category logger with a lock-free asynchronous sink.
+//
+// Call sites only copy the format pointer and raw argument values into a
+// preallocated ring slot; the "{}" placeholders are expanded and the line
+// written to the log file on a background thread. Statements below
+// GPS_LOG_MIN_LEVEL compile to nothing, and each category has a runtime
+// level that is checked with a single relaxed atomic load.
+//
+//   GPS_LOG_TRACE(Logger::Network, "datagram of {} bytes", size);
+//   GPS_LOG_RATE_LIMITED(Logger::Warning, Logger::Parser, 1, "bad payload: {}", text);
+
+#ifndef GPS_LOG_MIN_LEVEL
+#  ifdef QT_NO_DEBUG
+#    define GPS_LOG_MIN_LEVEL 2 // Info and above in release builds
+#  else
+#    define GPS_LOG_MIN_LEVEL 0 // Everything in debug builds
+#  endif
+#endif
+
+class LogRateLimiter;
+
+class Logger
+{
+public:
+    enum Level {
+        Trace = 0,
+        Debug = 1,
+        Info = 2,
+        Warning = 3,
+        Error = 4,
+        Off = 5
+    };
+
+    enum Category {
+        App = 0,
+        Network,
+        Parser,
+        Map,
+        Ui,
+        CategoryCount
+    };
+
+    static Logger &instance();
+
+    // Starts the sink thread; an empty path writes to stderr
+    bool start(const QString &filePath = QString());
+    void stop();
+    QString filePath() const;
+
+    static void setLevel(Category category, Level level);
+    static Level level(Category category);
+
+    // Rules such as "network=trace,map=off,*=info"
+    static void configure(const QString &rules);
+
+    static bool isEnabled(Category category, Level level)
+    {
+        return int(level) >= s_levels[category].load(std::memory_order_relaxed);
+    }
+
+    // Records that could not be queued because the ring was full
+    quint64 droppedRecords() const;
+
+    // Raw bytes copied into the record without building a QByteArray
+    struct Text
+    {
+        const char *data;
+        int size;
+    };
+
+    template <typename... Args>
+    void log(Level level, Category category, const char *format, const Args &...args)
+    {
+        logSuppressed(0, level, category, format, args...);
+    }
+
+    template <typename... Args>
+    void logSuppressed(quint32 suppressed, Level level, Category category,
+                       const char *format, const Args &...args);
+
+    static const char *levelName(Level level);
+    static const char *categoryName(Category category);
+
+private:
+    friend class LogRateLimiter;
+    friend class LogSinkThread;
+
+    Logger();
+    ~Logger();
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    // Argument storage; strings are copied into the record's text area
+    struct Arg
+    {
+        enum Type : quint8 { IntArg, UIntArg, DoubleArg, TextArg };
+        Type type;
+        quint8 textLength;
+        quint8 textOffset;
+        union {
+            qint64 i;
+            quint64 u;
+            double d;
+        };
+    };
+
+    static const int MAX_ARGS = 8;
+    static const int TEXT_CAPACITY = 96;
+
+    struct Record
+    {
+        std::atomic<quint64> sequence;
+        qint64 timestampMs;
+        const char *format;
+        quint8 level;
+        quint8 category;
+        quint8 argCount;
+        quint8 textUsed;
+        quint32 suppressed;
+        Arg args[MAX_ARGS];
+        char text[TEXT_CAPACITY];
+    };
+
+    Record *beginRecord(Level level, Category category, const char *format, quint32 suppressed);
+    void commitRecord(Record *record);
+    void drain();
+
+    static void addArg(Record *record, qint64 value);
+    static void addArg(Record *record, quint64 value);
+    static void addArg(Record *record, double value);
+    static void addArg(Record *record, const char *text, int length);
+
+    template <typename T>
+    static void appendArg(Record *record, const T &value)
+    {
+        if constexpr (std::is_same<T, bool>::value) {
+            addArg(record, value ? "true" : "false", value ? 4 : 5);
+        } else if constexpr (std::is_floating_point<T>::value) {
+            addArg(record, double(value));
+        } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+            addArg(record, qint64(value));
+        } else if constexpr (std::is_integral<T>::value || std::is_enum<T>::value) {
+            addArg(record, static_cast<quint64>(value));
+        } else if constexpr (std::is_same<T, Text>::value) {
+            addArg(record, value.data, value.size);
+        } else if constexpr (std::is_same<T, QByteArray>::value) {
+            addArg(record, value.constData(), value.size());
+        } else if constexpr (std::is_same<T, QString>::value) {
+            appendString(record, value);
+        } else {
+            addArg(record, static_cast<const char *>(value), int(std::strlen(value)));
+        }
+    }
+
+    static void appendString(Record *record, const QString &value);
+
+    static std::atomic<int> s_levels[CategoryCount];
+
+    struct Private;
+    Private *d;
+};
+
+// Per-call-site limiter: lets at most `perSecond` records through in any
+// one-second window and reports how many were suppressed in between.
+class LogRateLimiter
+{
+public:
+    explicit LogRateLimiter(int perSecond)
+        : m_perSecond(perSecond)
+        , m_windowStartMs(0)
+        , m_count(0)
+        , m_suppressed(0)
+    {
+    }
+
+    bool allow(quint32 &suppressed);
+
+private:
+    const int m_perSecond;
+    std::atomic<qint64> m_windowStartMs;
+    std::atomic<int> m_count;
+    std::atomic<quint32> m_suppressed;
+};
+
+template <typename... Args>
+void Logger::logSuppressed(quint32 suppressed, Level level, Category category,
+                           const char *format, const Args &...args)
+{
+    Record *record = beginRecord(level, category, format, suppressed);
+    if (!record) {
+        return;
+    }
+    (appendArg(record, args), ...);
+    commitRecord(record);
+}
+
+#define GPS_LOG(level, category, ...) \
+    do { \
+        if ((level) >= GPS_LOG_MIN_LEVEL && Logger::isEnabled((category), (level))) { \
+            Logger::instance().log((level), (category), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define GPS_LOG_TRACE(category, ...) GPS_LOG(Logger::Trace, category, __VA_ARGS__)
+#define GPS_LOG_DEBUG(category, ...) GPS_LOG(Logger::Debug, category, __VA_ARGS__)
+#define GPS_LOG_INFO(category, ...) GPS_LOG(Logger::Info, category, __VA_ARGS__)
+#define GPS_LOG_WARNING(category, ...) GPS_LOG(Logger::Warning, category, __VA_ARGS__)
+#define GPS_LOG_ERROR(category, ...) GPS_LOG(Logger::Error, category, __VA_ARGS__)
+
+#define GPS_LOG_RATE_LIMITED(level, category, perSecond, ...) \
+    do { \
+        if ((level) >= GPS_LOG_MIN_LEVEL && Logger::isEnabled((category), (level))) { \
+            static LogRateLimiter gpsLogLimiter_(perSecond); \
+            quint32 gpsLogSuppressed_ = 0; \
+            if (gpsLogLimiter_.allow(gpsLogSuppressed_)) { \
+                Logger::instance().logSuppressed(gpsLogSuppressed_, (level), (category), __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+
+#endif // LOGGER_H
@@ -0,0 +1,138 @@
+#include "logmodel.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QTextStream>
+
+LogModel::LogModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_capacity(qMax(1, capacity))
+    , m_first(0)
+    , m_count(0)
+{
+    m_entries.resize(m_capacity);
+}
+
+int LogModel::capacity() const
+{
+    return m_capacity;
+}
+
+void LogModel::setCapacity(int capacity)
+{
+    capacity = qMax(1, capacity);
+    if (capacity == m_capacity) {
+        return;
+    }
+
+    // Keep the newest entries that still fit
+    beginResetModel();
+    const int kept = qMin(m_count, capacity);
+    QVector<Entry> entries(capacity);
+    for (int i = 0; i < kept; ++i) {
+        entries[i] = entryAt(m_count - kept + i);
+    }
+    m_entries.swap(entries);
+    m_capacity = capacity;
+    m_first = 0;
+    m_count = kept;
+    endResetModel();
+}
+
+void LogModel::appendMessage(const QString &message)
+{
+    Entry entry;
+    entry.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    entry.message = message;
+    append(entry);
+}
+
+void LogModel::appendFix(const GpsFix &fix, int burstSize)
+{
+    Entry entry;
+    entry.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    entry.latitude = fix.latitude;
+    entry.longitude = fix.longitude;
+    entry.altitude = fix.altitude;
+    entry.burstSize = qMax(1, burstSize);
+    append(entry);
+}
+
+void LogModel::clear()
+{
+    beginResetModel();
+    for (Entry &entry : m_entries) {
+        entry = Entry();
+    }
+    m_first = 0;
+    m_count = 0;
+    endResetModel();
+}
+
+bool LogModel::exportToFile(const QString &filePath) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QTextStream out(&file);
+    for (int row = 0; row < m_count; ++row) {
+        out << formatEntry(entryAt(row)) << '\n';
+    }
+    out.flush();
+    return file.error() == QFileDevice::NoError;
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_count;
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if (role != Qt::DisplayRole || !index.isValid() || index.row() >= m_count) {
+        return QVariant();
+    }
+    return formatEntry(entryAt(index.row()));
+}
+
+void LogModel::append(const Entry &entry)
+{
+    if (m_count == m_capacity) {
+        // Full: the oldest row leaves before the new one arrives
+        beginRemoveRows(QModelIndex(), 0, 0);
+        m_entries[m_first] = Entry();
+        m_first = (m_first + 1) % m_capacity;
+        --m_count;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count);
+    m_entries[(m_first + m_count) % m_capacity] = entry;
+    ++m_count;
+    endInsertRows();
+}
+
+const LogModel::Entry &LogModel::entryAt(int row) const
+{
+    return m_entries[(m_first + row) % m_capacity];
+}
+
+QString LogModel::formatEntry(const Entry &entry) const
+{
+    const QString time = QDateTime::fromMSecsSinceEpoch(entry.timestampMs).toString("hh:mm:ss");
+
+    if (entry.burstSize == 0) {
+        return QString("[%1] %2").arg(time, entry.message);
+    }
+
+    QString message = QString("GPS: Lat=%1, Lon=%2, Alt=%3m")
+                     .arg(entry.latitude, 0, 'f', 6)
+                     .arg(entry.longitude, 0, 'f', 6)
+                     .arg(entry.altitude, 0, 'f', 2);
+    if (entry.burstSize > 1) {
+        message += QString(" (%1 fixes)").arg(entry.burstSize);
+    }
+    return QString("[%1] %2").arg(time, message);
+}
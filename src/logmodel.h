@@ -0,0 +1,55 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QVector>
+
+#include "gpsfix.h"
+
+// Fixed-capacity ring buffer of log entries for the GUI log view.
+//
+// Entries are stored as raw values and only formatted in data(), so rows
+// that are never scrolled into view cost no string work. Once full, the
+// oldest entry is dropped for every new one.
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit LogModel(int capacity, QObject *parent = nullptr);
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    void appendMessage(const QString &message);
+    void appendFix(const GpsFix &fix, int burstSize = 1);
+    void clear();
+
+    bool exportToFile(const QString &filePath) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    struct Entry
+    {
+        qint64 timestampMs = 0;
+        double latitude = 0.0;
+        double longitude = 0.0;
+        double altitude = 0.0;
+        int burstSize = 0;     // 0 for plain messages
+        QString message;
+    };
+
+    void append(const Entry &entry);
+    const Entry &entryAt(int row) const;
+    QString formatEntry(const Entry &entry) const;
+
+    QVector<Entry> m_entries;
+    int m_capacity;
+    int m_first;
+    int m_count;
+};
+
+#endif // LOGMODEL_H
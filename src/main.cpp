@@ -1,9 +1,11 @@
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QDir>
 #include <QDebug>
 #include <QMessageBox>
 #include <QStyleFactory>
 #include <QStandardPaths>
+#include <QTimer>
 
 // QGIS includes
 #include <qgsapplication.h>
@@ -11,6 +13,8 @@
 #include <qgsmessagelog.h>
 
 #include "mainwindow.h"
+#include "logger.h"
+#include "startupprofiler.h"
 
 void setupQGISEnvironment()
 {
@@ -55,8 +59,12 @@ void setupQGISEnvironment()
 
 int main(int argc, char *argv[])
 {
+    StartupProfiler &startup = StartupProfiler::instance();
+    startup.start();
+    
     // Create QgsApplication instead of QApplication for QGIS support
     QgsApplication app(argc, argv, true);
+    startup.mark(StartupProfiler::ApplicationCreated);
     
     // Set application properties
     app.setApplicationName("GPS Map Viewer");
@@ -64,11 +72,35 @@ int main(int argc, char *argv[])
     app.setOrganizationName("GPS Map Viewer");
     app.setOrganizationDomain("gps-map-viewer.local");
     
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Receives GPS fixes over UDP and shows them on a map.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption({ { "p", "port" }, "UDP port to listen on.", "port", "12345" });
+    parser.addOption({ "no-listen", "Do not start listening until \"Start Listening\" is clicked." });
+    parser.addOption({ "bus-in", "Also read fixes from this shared-memory fix bus.", "name" });
+    parser.addOption({ "bus-out", "Publish every parsed fix to this shared-memory fix bus.", "name" });
+    parser.process(app);
+    
+    // Start the asynchronous log sink; GPS_LOG_FILE and GPS_LOG_RULES
+    // (e.g. "network=trace,map=debug") override the defaults
+    QString logFile = qEnvironmentVariable("GPS_LOG_FILE");
+    if (logFile.isEmpty()) {
+        QString logDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        QDir().mkpath(logDir);
+        logFile = logDir + "/gps-map-viewer.log";
+    }
+    Logger::configure(qEnvironmentVariable("GPS_LOG_RULES"));
+    if (!Logger::instance().start(logFile)) {
+        qDebug() << "Could not open log file" << logFile;
+    }
+    
     // Setup QGIS environment
     setupQGISEnvironment();
     
-    // Initialize QGIS
+    // The only QGIS initialization; MapWidget relies on it
     QgsApplication::initQgis();
+    startup.mark(StartupProfiler::QgisInitialized);
     
     // Check if QGIS was initialized properly
     QgsProviderRegistry *providerRegistry = QgsProviderRegistry::instance();
@@ -79,7 +111,7 @@ int main(int argc, char *argv[])
         return -1;
     }
     
-    qDebug() << "Available data providers:" << providerRegistry->providerList();
+    GPS_LOG_DEBUG(Logger::App, "Available data providers: {}", providerRegistry->providerList().join(", "));
     
     // Set application style
     app.setStyle(QStyleFactory::create("Fusion"));
@@ -103,7 +135,17 @@ int main(int argc, char *argv[])
     
     // Create and show main window
     MainWindow window;
+    window.setFixBus(parser.value("bus-in"), parser.value("bus-out"));
     window.show();
+    startup.mark(StartupProfiler::WindowShown);
+    
+    // Listener first, then the tile cache and basemap, once the event loop
+    // has put the window on screen
+    const quint16 port = quint16(parser.value("port").toUInt());
+    const bool listen = !parser.isSet("no-listen");
+    QTimer::singleShot(0, &window, [&window, port, listen]() {
+        window.finishStartup(port, listen);
+    });
     
     qDebug() << "GPS Map Viewer started successfully";
     
@@ -113,5 +155,7 @@ int main(int argc, char *argv[])
     // Cleanup QGIS
     QgsApplication::exitQgis();
     
+    Logger::instance().stop();
+    
     return result;
 }
\ No newline at end of file
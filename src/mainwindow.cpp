@@ -1,10 +1,20 @@
 #include "mainwindow.h"
 #include "udpreceiver.h"
 #include "mapwidget.h"
+#include "logmodel.h"
+#include "uiupdatescheduler.h"
+#include "latencymonitor.h"
+#include "rendertierstats.h"
+#include "startupprofiler.h"
 
 #include <QApplication>
 #include <QMessageBox>
 #include <QDateTime>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QSignalBlocker>
+#include <QFontDatabase>
+#include <QScrollBar>
 #include <QSplitter>
 
 MainWindow::MainWindow(QWidget *parent)
@@ -15,8 +25,23 @@ MainWindow::MainWindow(QWidget *parent)
     , m_controlLayout(nullptr)
     , m_portLabel(nullptr)
     , m_portSpinBox(nullptr)
+    , m_listenersLabel(nullptr)
+    , m_listenersEdit(nullptr)
+    , m_receiveBufferLabel(nullptr)
+    , m_receiveBufferSpinBox(nullptr)
+    , m_threadsLabel(nullptr)
+    , m_threadsSpinBox(nullptr)
     , m_startButton(nullptr)
     , m_stopButton(nullptr)
+    , m_uiRateLabel(nullptr)
+    , m_uiRateSpinBox(nullptr)
+    , m_replayGroup(nullptr)
+    , m_recordButton(nullptr)
+    , m_replayButton(nullptr)
+    , m_stopReplayButton(nullptr)
+    , m_replaySpeedCombo(nullptr)
+    , m_replaySlider(nullptr)
+    , m_replayTimeLabel(nullptr)
     , m_gpsGroup(nullptr)
     , m_gpsLayout(nullptr)
     , m_latitudeLabel(nullptr)
@@ -25,26 +50,49 @@ MainWindow::MainWindow(QWidget *parent)
     , m_latitudeEdit(nullptr)
     , m_longitudeEdit(nullptr)
     , m_altitudeEdit(nullptr)
+    , m_latencyGroup(nullptr)
+    , m_latencyLabel(nullptr)
+    , m_dumpLatencyButton(nullptr)
+    , m_resetLatencyButton(nullptr)
     , m_mapWidget(nullptr)
     , m_logGroup(nullptr)
-    , m_logTextEdit(nullptr)
+    , m_logView(nullptr)
+    , m_logModel(nullptr)
+    , m_logCapacitySpinBox(nullptr)
+    , m_exportLogButton(nullptr)
     , m_statusLabel(nullptr)
+    , m_statsLabel(nullptr)
     , m_statusTimer(nullptr)
     , m_udpReceiver(nullptr)
+    , m_updateScheduler(nullptr)
     , m_currentLatitude(0.0)
     , m_currentLongitude(0.0)
     , m_currentAltitude(0.0)
     , m_isListening(false)
+    , m_startupReported(false)
 {
+    // Fixes are applied to the widgets at most once per frame
+    m_updateScheduler = new UiUpdateScheduler(UI_RATE_DEFAULT, this);
+    connect(m_updateScheduler, &UiUpdateScheduler::frameReady,
+            this, &MainWindow::onFrameReady);
+    
     setupUI();
     setupConnections();
     
-    // Initialize UDP receiver
-    m_udpReceiver = new UdpReceiver(this);
-    connect(m_udpReceiver, &UdpReceiver::gpsDataReceived,
-            this, &MainWindow::onGpsDataReceived);
+    // Initialize UDP receiver (socket and parsing run on a worker thread)
+    m_udpReceiver = new UdpReceiver(UdpReceiver::WorkerThread, this);
+    connect(m_udpReceiver, &UdpReceiver::gpsFixesReceived,
+            this, &MainWindow::onGpsFixesReceived);
     connect(m_udpReceiver, &UdpReceiver::connectionStatusChanged,
             this, &MainWindow::onConnectionStatusChanged);
+    connect(m_udpReceiver, &UdpReceiver::replayPosition,
+            this, &MainWindow::onReplayPosition);
+    connect(m_udpReceiver, &UdpReceiver::replayFinished,
+            this, &MainWindow::onReplayFinished);
+    connect(m_udpReceiver, &UdpReceiver::archiveSegmentSealed,
+            m_mapWidget, &MapWidget::addArchiveSegment);
+    connect(m_udpReceiver, &UdpReceiver::recordingStopped,
+            this, &MainWindow::onRecordingStopped);
     
     // Setup status timer
     m_statusTimer = new QTimer(this);
@@ -80,18 +128,87 @@ void MainWindow::setupUI()
     m_portSpinBox->setRange(1024, 65535);
     m_portSpinBox->setValue(12345);
     
+    m_listenersLabel = new QLabel("Also:", this);
+    m_listenersEdit = new QLineEdit(this);
+    m_listenersEdit->setPlaceholderText("10110/nmea, 5000@239.192.0.1/binary");
+    m_listenersEdit->setToolTip("More ports to listen on, comma-separated: "
+                                "port[@multicast group][/json|csv|nmea|binary]");
+    
+    m_receiveBufferLabel = new QLabel("Buffer (KiB):", this);
+    m_receiveBufferSpinBox = new QSpinBox(this);
+    m_receiveBufferSpinBox->setRange(0, 512 * 1024);
+    m_receiveBufferSpinBox->setSingleStep(1024);
+    m_receiveBufferSpinBox->setSpecialValueText("Default");
+    m_receiveBufferSpinBox->setToolTip("Kernel receive buffer per socket; "
+                                       "Linux caps it at net.core.rmem_max");
+    
+    m_threadsLabel = new QLabel("Threads:", this);
+    m_threadsSpinBox = new QSpinBox(this);
+    m_threadsSpinBox->setRange(1, UdpReceiver::MAX_THREADS);
+    m_threadsSpinBox->setToolTip("Receiver threads sharing each port through SO_REUSEPORT");
+    
     m_startButton = new QPushButton("Start Listening", this);
     m_stopButton = new QPushButton("Stop Listening", this);
     m_stopButton->setEnabled(false);
     
     m_controlLayout->addWidget(m_portLabel);
     m_controlLayout->addWidget(m_portSpinBox);
+    m_controlLayout->addWidget(m_listenersLabel);
+    m_controlLayout->addWidget(m_listenersEdit);
+    m_controlLayout->addWidget(m_receiveBufferLabel);
+    m_controlLayout->addWidget(m_receiveBufferSpinBox);
+    m_controlLayout->addWidget(m_threadsLabel);
+    m_controlLayout->addWidget(m_threadsSpinBox);
     m_controlLayout->addWidget(m_startButton);
     m_controlLayout->addWidget(m_stopButton);
+    
+    m_uiRateLabel = new QLabel("UI refresh (Hz):", this);
+    m_uiRateSpinBox = new QSpinBox(this);
+    m_uiRateSpinBox->setRange(1, 120);
+    m_uiRateSpinBox->setValue(UI_RATE_DEFAULT);
+    m_controlLayout->addWidget(m_uiRateLabel);
+    m_controlLayout->addWidget(m_uiRateSpinBox);
     m_controlLayout->addStretch();
     
     m_mainLayout->addWidget(m_controlGroup);
     
+    // Record / Replay
+    m_replayGroup = new QGroupBox("Record / Replay", this);
+    QHBoxLayout *replayLayout = new QHBoxLayout(m_replayGroup);
+    
+    m_recordButton = new QPushButton("Record...", this);
+    m_recordButton->setCheckable(true);
+    m_recordButton->setToolTip("Capture every received datagram to a file");
+    
+    m_replayButton = new QPushButton("Replay...", this);
+    m_replayButton->setToolTip("Feed a capture file through the receiver in place of the socket");
+    
+    m_replaySpeedCombo = new QComboBox(this);
+    m_replaySpeedCombo->addItem("1x", 1.0);
+    m_replaySpeedCombo->addItem("2x", 2.0);
+    m_replaySpeedCombo->addItem("10x", 10.0);
+    m_replaySpeedCombo->addItem("100x", 100.0);
+    m_replaySpeedCombo->addItem("Max", 0.0);
+    
+    m_replaySlider = new QSlider(Qt::Horizontal, this);
+    m_replaySlider->setRange(0, REPLAY_SLIDER_STEPS);
+    m_replaySlider->setEnabled(false);
+    
+    m_replayTimeLabel = new QLabel("--:--:--", this);
+    
+    m_stopReplayButton = new QPushButton("Stop Replay", this);
+    m_stopReplayButton->setEnabled(false);
+    
+    replayLayout->addWidget(m_recordButton);
+    replayLayout->addWidget(m_replayButton);
+    replayLayout->addWidget(new QLabel("Speed:", this));
+    replayLayout->addWidget(m_replaySpeedCombo);
+    replayLayout->addWidget(m_replaySlider, 1);
+    replayLayout->addWidget(m_replayTimeLabel);
+    replayLayout->addWidget(m_stopReplayButton);
+    
+    m_mainLayout->addWidget(m_replayGroup);
+    
     // Create splitter for GPS data and map
     QSplitter *topSplitter = new QSplitter(Qt::Horizontal, this);
     
@@ -120,10 +237,34 @@ void MainWindow::setupUI()
     m_gpsLayout->addWidget(m_longitudeEdit);
     m_gpsLayout->addWidget(m_altitudeLabel);
     m_gpsLayout->addWidget(m_altitudeEdit);
-    m_gpsLayout->addStretch();
     
-    m_gpsGroup->setMaximumWidth(250);
-    topSplitter->addWidget(m_gpsGroup);
+    // Latency diagnostics: time from socket receive to each stage
+    m_latencyGroup = new QGroupBox("Latency (ms)", this);
+    QVBoxLayout *latencyLayout = new QVBoxLayout(m_latencyGroup);
+    m_latencyLabel = new QLabel(this);
+    m_latencyLabel->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_latencyLabel->setToolTip("Receive to: Queued (parsed), Delivered (GUI thread), "
+                               "Applied (map update), Painted (marker drawn)\n"
+                               "Map tiers: paints served from cache and render time of "
+                               "the basemap, history and live overlays");
+    latencyLayout->addWidget(m_latencyLabel);
+    
+    QHBoxLayout *latencyButtonLayout = new QHBoxLayout();
+    m_dumpLatencyButton = new QPushButton("Dump...", this);
+    m_resetLatencyButton = new QPushButton("Reset", this);
+    latencyButtonLayout->addWidget(m_dumpLatencyButton);
+    latencyButtonLayout->addWidget(m_resetLatencyButton);
+    latencyLayout->addLayout(latencyButtonLayout);
+    
+    QWidget *leftPanel = new QWidget(this);
+    QVBoxLayout *leftLayout = new QVBoxLayout(leftPanel);
+    leftLayout->setContentsMargins(0, 0, 0, 0);
+    leftLayout->addWidget(m_gpsGroup);
+    leftLayout->addWidget(m_latencyGroup);
+    leftLayout->addStretch();
+    
+    leftPanel->setMaximumWidth(250);
+    topSplitter->addWidget(leftPanel);
     
     // Map Widget
     m_mapWidget = new MapWidget(this);
@@ -136,42 +277,270 @@ void MainWindow::setupUI()
     m_logGroup = new QGroupBox("Log", this);
     QVBoxLayout *logLayout = new QVBoxLayout(m_logGroup);
     
-    m_logTextEdit = new QTextEdit(this);
-    m_logTextEdit->setMaximumHeight(150);
-    m_logTextEdit->setReadOnly(true);
-    logLayout->addWidget(m_logTextEdit);
+    // Bounded ring buffer model; the list view only formats visible rows
+    m_logModel = new LogModel(LOG_CAPACITY_DEFAULT, this);
+    
+    m_logView = new QListView(this);
+    m_logView->setModel(m_logModel);
+    m_logView->setUniformItemSizes(true);
+    m_logView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_logView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_logView->setMaximumHeight(150);
+    logLayout->addWidget(m_logView);
+    
+    QHBoxLayout *logControlLayout = new QHBoxLayout();
+    logControlLayout->addWidget(new QLabel("Max lines:", this));
+    m_logCapacitySpinBox = new QSpinBox(this);
+    m_logCapacitySpinBox->setRange(100, 1000000);
+    m_logCapacitySpinBox->setSingleStep(1000);
+    m_logCapacitySpinBox->setValue(LOG_CAPACITY_DEFAULT);
+    logControlLayout->addWidget(m_logCapacitySpinBox);
+    m_exportLogButton = new QPushButton("Export Log...", this);
+    logControlLayout->addWidget(m_exportLogButton);
+    logControlLayout->addStretch();
+    logLayout->addLayout(logControlLayout);
     
     m_mainLayout->addWidget(m_logGroup);
     
     // Status Bar
     m_statusLabel = new QLabel("Ready", this);
     statusBar()->addWidget(m_statusLabel);
+    
+    m_statsLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(m_statsLabel);
 }
 
 void MainWindow::setupConnections()
 {
     connect(m_startButton, &QPushButton::clicked, this, &MainWindow::onStartListening);
     connect(m_stopButton, &QPushButton::clicked, this, &MainWindow::onStopListening);
+    connect(m_uiRateSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &MainWindow::onUiRateChanged);
+    connect(m_logCapacitySpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &MainWindow::onLogCapacityChanged);
+    connect(m_exportLogButton, &QPushButton::clicked, this, &MainWindow::onExportLog);
+    connect(m_mapWidget, &MapWidget::trackSelected, this, &MainWindow::onTrackSelected);
+    connect(m_recordButton, &QPushButton::toggled, this, &MainWindow::onRecordToggled);
+    connect(m_replayButton, &QPushButton::clicked, this, &MainWindow::onStartReplay);
+    connect(m_stopReplayButton, &QPushButton::clicked, this, &MainWindow::onStopReplay);
+    connect(m_replaySpeedCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onReplaySpeedChanged);
+    connect(m_replaySlider, &QSlider::sliderReleased, this, &MainWindow::onReplaySeek);
+    connect(m_dumpLatencyButton, &QPushButton::clicked, this, &MainWindow::onDumpLatency);
+    connect(m_resetLatencyButton, &QPushButton::clicked, this, &MainWindow::onResetLatency);
+}
+
+void MainWindow::logMessage(const QString &message)
+{
+    // Follow the tail only if the user has not scrolled up
+    QScrollBar *scrollBar = m_logView->verticalScrollBar();
+    const bool atBottom = scrollBar->value() == scrollBar->maximum();
+    
+    m_logModel->appendMessage(message);
+    
+    if (atBottom) {
+        m_logView->scrollToBottom();
+    }
+}
+
+void MainWindow::onLogCapacityChanged(int capacity)
+{
+    m_logModel->setCapacity(capacity);
+}
+
+void MainWindow::onExportLog()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, "Export Log",
+                                                    "gps-log.txt", "Text files (*.txt);;All files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    if (!m_logModel->exportToFile(filePath)) {
+        QMessageBox::warning(this, "Error", QString("Failed to write log to %1").arg(filePath));
+    }
+}
+
+void MainWindow::onTrackSelected(quint32 deviceId)
+{
+    logMessage(QString("Following device %1").arg(deviceId, 8, 16, QLatin1Char('0')));
+}
+
+void MainWindow::onRecordToggled(bool record)
+{
+    if (!record) {
+        m_udpReceiver->stopRecording();
+        m_recordButton->setText("Record...");
+        logMessage("Stopped recording");
+        return;
+    }
+    
+    const QString defaultName = QDateTime::currentDateTime().toString("'gps-'yyyyMMdd-HHmmss'.gpscap'");
+    QString filePath = QFileDialog::getSaveFileName(this, "Record Datagrams", defaultName,
+                                                    "GPS captures (*.gpscap);;All files (*)");
+    if (filePath.isEmpty() || !m_udpReceiver->startRecording(filePath)) {
+        if (!filePath.isEmpty()) {
+            QMessageBox::warning(this, "Error", QString("Failed to record to %1").arg(filePath));
+        }
+        QSignalBlocker blocker(m_recordButton);
+        m_recordButton->setChecked(false);
+        return;
+    }
+    
+    m_recordButton->setText("Stop Recording");
+    logMessage(QString("Recording datagrams to %1").arg(filePath));
+}
+
+void MainWindow::onRecordingStopped(const QString &error)
+{
+    QSignalBlocker blocker(m_recordButton);
+    m_recordButton->setChecked(false);
+    m_recordButton->setText("Record...");
+    logMessage(QString("Recording stopped: %1").arg(error));
+}
+
+void MainWindow::onStartReplay()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, "Replay Capture", QString(),
+                                                    "GPS captures (*.gpscap);;All files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    if (m_isListening) {
+        onStopListening();
+    }
+    if (m_udpReceiver->isReplaying()) {
+        m_udpReceiver->stopReplay();
+    }
+    
+    if (!m_udpReceiver->startReplay(filePath, replaySpeed())) {
+        QMessageBox::warning(this, "Error", QString("Failed to replay %1").arg(filePath));
+        return;
+    }
+    
+    m_replaySlider->setValue(0);
+    m_replaySlider->setEnabled(true);
+    m_stopReplayButton->setEnabled(true);
+    m_statusLabel->setText("Replaying " + QFileInfo(filePath).fileName());
+    updateReplayTimeLabel(m_udpReceiver->replayStartTimeUs());
+    logMessage(QString("Replaying %1").arg(filePath));
+}
+
+void MainWindow::onStopReplay()
+{
+    m_udpReceiver->stopReplay();
+    m_replaySlider->setEnabled(false);
+    m_stopReplayButton->setEnabled(false);
+    m_statusLabel->setText(m_isListening ? "Listening - No data" : "Disconnected");
+    logMessage("Stopped replay");
+}
+
+void MainWindow::onReplaySpeedChanged(int index)
+{
+    Q_UNUSED(index);
+    m_udpReceiver->setReplaySpeed(replaySpeed());
+}
+
+void MainWindow::onReplaySeek()
+{
+    const qint64 start = m_udpReceiver->replayStartTimeUs();
+    const qint64 end = m_udpReceiver->replayEndTimeUs();
+    const qint64 target = start + (end - start) * m_replaySlider->value() / REPLAY_SLIDER_STEPS;
+    m_udpReceiver->seekReplay(target);
+    updateReplayTimeLabel(target);
+}
+
+void MainWindow::onReplayPosition(qint64 timeUs)
+{
+    // Leave the handle alone while the user is dragging it
+    if (!m_replaySlider->isSliderDown()) {
+        const qint64 start = m_udpReceiver->replayStartTimeUs();
+        const qint64 span = qMax<qint64>(1, m_udpReceiver->replayEndTimeUs() - start);
+        m_replaySlider->setValue(int((timeUs - start) * REPLAY_SLIDER_STEPS / span));
+        updateReplayTimeLabel(timeUs);
+    }
+}
+
+void MainWindow::onReplayFinished()
+{
+    // The capture stays open so the slider can seek back into it
+    logMessage("Replay finished");
+}
+
+double MainWindow::replaySpeed() const
+{
+    return m_replaySpeedCombo->currentData().toDouble();
+}
+
+void MainWindow::updateReplayTimeLabel(qint64 timeUs)
+{
+    m_replayTimeLabel->setText(QDateTime::fromMSecsSinceEpoch(timeUs / 1000).toString("HH:mm:ss"));
+}
+
+void MainWindow::finishStartup(quint16 port, bool listen)
+{
+    m_portSpinBox->setValue(port);
+    if (listen) {
+        startListening(false);
+    }
+    
+    // Tile cache and basemap after the listener, so early fixes are not
+    // held up behind provider and network setup
+    QTimer::singleShot(0, m_mapWidget, &MapWidget::addBaseMap);
+}
+
+void MainWindow::setFixBus(const QString &input, const QString &output)
+{
+    m_busInput = input;
+    m_busOutput = output;
 }
 
 void MainWindow::onStartListening()
 {
-    int port = m_portSpinBox->value();
+    startListening(true);
+}
+
+bool MainWindow::startListening(bool interactive)
+{
+    ReceiverEndpoint primary;
+    primary.port = quint16(m_portSpinBox->value());
+    
+    ReceiverConfig config;
+    config.endpoints.append(primary);
+    QString error;
+    if (!ReceiverConfig::parseEndpoints(m_listenersEdit->text(), config.endpoints, error)) {
+        QMessageBox::warning(this, "Error", error);
+        return false;
+    }
+    config.receiveBufferBytes = m_receiveBufferSpinBox->value() * 1024;
+    config.threads = m_threadsSpinBox->value();
+    config.busInput = m_busInput;
+    config.busOutput = m_busOutput;
+    
+    // Live data and a replay would interleave into one meaningless track
+    if (m_udpReceiver->isReplaying()) {
+        onStopReplay();
+    }
     
-    if (m_udpReceiver->startListening(port)) {
+    if (m_udpReceiver->startListening(config)) {
         m_isListening = true;
-        m_startButton->setEnabled(false);
-        m_stopButton->setEnabled(true);
-        m_portSpinBox->setEnabled(false);
+        setListenerControlsEnabled(false);
+        StartupProfiler::instance().mark(StartupProfiler::Listening);
         
-        QString message = QString("Started listening on UDP port %1").arg(port);
-        m_logTextEdit->append(QString("[%1] %2")
-                             .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                             .arg(message));
+        const ReceiverConfig active = m_udpReceiver->config();
+        logMessage(QString("Started listening on UDP %1 (%2 thread(s))")
+                   .arg(active.endpointsString()).arg(active.threads));
+        return true;
+    }
+    
+    const QString message = QString("Failed to start UDP listener on %1").arg(config.endpointsString());
+    if (interactive) {
+        QMessageBox::warning(this, "Error", message);
     } else {
-        QMessageBox::warning(this, "Error", 
-                           QString("Failed to start UDP listener on port %1").arg(port));
+        logMessage(message);
     }
+    return false;
 }
 
 void MainWindow::onStopListening()
@@ -179,43 +548,60 @@ void MainWindow::onStopListening()
     if (m_udpReceiver) {
         m_udpReceiver->stopListening();
         m_isListening = false;
-        m_startButton->setEnabled(true);
-        m_stopButton->setEnabled(false);
-        m_portSpinBox->setEnabled(true);
+        setListenerControlsEnabled(true);
         
-        QString message = "Stopped UDP listener";
-        m_logTextEdit->append(QString("[%1] %2")
-                             .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                             .arg(message));
+        logMessage("Stopped UDP listener");
     }
 }
 
-void MainWindow::onGpsDataReceived(double latitude, double longitude, double altitude)
+void MainWindow::setListenerControlsEnabled(bool enabled)
+{
+    m_startButton->setEnabled(enabled);
+    m_stopButton->setEnabled(!enabled);
+    m_portSpinBox->setEnabled(enabled);
+    m_listenersEdit->setEnabled(enabled);
+    m_receiveBufferSpinBox->setEnabled(enabled);
+    m_threadsSpinBox->setEnabled(enabled);
+}
+
+void MainWindow::onGpsFixesReceived(const QVector<GpsFix> &fixes)
+{
+    StartupProfiler::instance().mark(StartupProfiler::FirstFixReceived);
+    
+    // Only buffered here; widgets and map are updated on the next frame tick
+    m_updateScheduler->submit(fixes);
+}
+
+void MainWindow::onFrameReady(const GpsFix &latest, const QVector<GpsFix> &fixes)
 {
-    m_currentLatitude = latitude;
-    m_currentLongitude = longitude;
-    m_currentAltitude = altitude;
+    // Update map: every fix goes to its device's track
+    m_mapWidget->updatePositions(fixes);
     
-    // Update GPS data display
-    m_latitudeEdit->setText(QString::number(latitude, 'f', 6));
-    m_longitudeEdit->setText(QString::number(longitude, 'f', 6));
-    m_altitudeEdit->setText(QString::number(altitude, 'f', 2));
+    // The GPS data display follows the track selected on the map
+    GpsFix selected = latest;
+    m_mapWidget->selectedFix(selected);
+    m_currentLatitude = selected.latitude;
+    m_currentLongitude = selected.longitude;
+    m_currentAltitude = selected.altitude;
     
-    // Update map
-    m_mapWidget->updatePosition(latitude, longitude, altitude);
+    m_latitudeEdit->setText(QString::number(selected.latitude, 'f', 6));
+    m_longitudeEdit->setText(QString::number(selected.longitude, 'f', 6));
+    m_altitudeEdit->setText(QString::number(selected.altitude, 'f', 2));
     
-    // Log the data
-    QString message = QString("GPS: Lat=%1, Lon=%2, Alt=%3m")
-                     .arg(latitude, 0, 'f', 6)
-                     .arg(longitude, 0, 'f', 6)
-                     .arg(altitude, 0, 'f', 2);
+    // Log the data; the row is formatted only when it becomes visible
+    QScrollBar *scrollBar = m_logView->verticalScrollBar();
+    const bool atBottom = scrollBar->value() == scrollBar->maximum();
     
-    m_logTextEdit->append(QString("[%1] %2")
-                         .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                         .arg(message));
+    m_logModel->appendFix(latest, fixes.size());
     
-    // Auto-scroll to bottom
-    m_logTextEdit->moveCursor(QTextCursor::End);
+    if (atBottom) {
+        m_logView->scrollToBottom();
+    }
+}
+
+void MainWindow::onUiRateChanged(int framesPerSecond)
+{
+    m_updateScheduler->setFrameRate(framesPerSecond);
 }
 
 void MainWindow::onConnectionStatusChanged(bool connected)
@@ -232,8 +618,8 @@ void MainWindow::onConnectionStatusChanged(bool connected)
 void MainWindow::updateStatusBar()
 {
     if (m_isListening) {
-        QString status = QString("Listening on port %1 | GPS: %2, %3 | Alt: %4m")
-                        .arg(m_portSpinBox->value())
+        QString status = QString("Listening on %1 | GPS: %2, %3 | Alt: %4m")
+                        .arg(m_udpReceiver->config().endpointsString())
                         .arg(m_currentLatitude, 0, 'f', 6)
                         .arg(m_currentLongitude, 0, 'f', 6)
                         .arg(m_currentAltitude, 0, 'f', 2);
@@ -241,4 +627,75 @@ void MainWindow::updateStatusBar()
     } else {
         setWindowTitle("GPS Map Viewer - Not listening");
     }
+    
+    QString stats = QString("Datagrams: %1 | Parse errors: %2 | Dropped: %3 | Kernel drops: %4 | Tracks: %5")
+                    .arg(m_udpReceiver->datagramsReceived())
+                    .arg(m_udpReceiver->parseErrors())
+                    .arg(m_udpReceiver->droppedFixes())
+                    .arg(m_udpReceiver->kernelDrops())
+                    .arg(m_mapWidget->trackCount());
+    if (!m_busInput.isEmpty()) {
+        stats += QString(" | Bus overruns: %1").arg(m_udpReceiver->busOverruns());
+    }
+    m_statsLabel->setText(stats);
+    
+    const StartupProfiler &startup = StartupProfiler::instance();
+    if (!m_startupReported && startup.isMarked(StartupProfiler::FirstFixPainted)) {
+        m_startupReported = true;
+        logMessage("Startup: " + startup.report());
+    }
+    
+    updateLatencyPanel();
+}
+
+void MainWindow::updateLatencyPanel()
+{
+    const LatencyMonitor &latency = LatencyMonitor::instance();
+    QStringList lines;
+    lines << QString("%1 %2 %3 %4").arg("", -9).arg("p50", 6).arg("p99", 6).arg("max", 6);
+    for (int stage = 0; stage < LatencyMonitor::StageCount; ++stage) {
+        const LatencyHistogram &histogram = latency.histogram(LatencyMonitor::Stage(stage));
+        lines << QString("%1 %2 %3 %4")
+                 .arg(LatencyMonitor::stageName(LatencyMonitor::Stage(stage)), -9)
+                 .arg(histogram.valueAtPercentile(50.0) / 1000.0, 6, 'f', 2)
+                 .arg(histogram.valueAtPercentile(99.0) / 1000.0, 6, 'f', 2)
+                 .arg(histogram.max() / 1000.0, 6, 'f', 2);
+    }
+    
+    // Map tiers: share of paints served from cache and render time
+    const RenderTierStats &render = RenderTierStats::instance();
+    lines << QString() << QString("%1 %2 %3 %4").arg("", -9).arg("hit%", 6).arg("p50", 6).arg("max", 6);
+    for (int tier = 0; tier < RenderTierStats::TierCount; ++tier) {
+        const double hitRate = render.hitRate(RenderTierStats::Tier(tier));
+        const LatencyHistogram &histogram = render.renderTime(RenderTierStats::Tier(tier));
+        lines << QString("%1 %2 %3 %4")
+                 .arg(RenderTierStats::tierName(RenderTierStats::Tier(tier)), -9)
+                 .arg(hitRate < 0.0 ? QString("-") : QString::number(hitRate, 'f', 0), 6)
+                 .arg(histogram.valueAtPercentile(50.0) / 1000.0, 6, 'f', 2)
+                 .arg(histogram.max() / 1000.0, 6, 'f', 2);
+    }
+    m_latencyLabel->setText(lines.join('\n'));
+}
+
+void MainWindow::onDumpLatency()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, "Dump Latency Histograms",
+                                                    "gps-latency.txt", "Text files (*.txt);;All files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    if (!LatencyMonitor::instance().dumpToFile(filePath)) {
+        QMessageBox::warning(this, "Error", QString("Failed to write latency to %1").arg(filePath));
+        return;
+    }
+    logMessage(QString("Latency histograms written to %1").arg(filePath));
+}
+
+void MainWindow::onResetLatency()
+{
+    logMessage("Render tiers: " + RenderTierStats::instance().summary());
+    LatencyMonitor::instance().reset();
+    RenderTierStats::instance().reset();
+    updateLatencyPanel();
 }
\ No newline at end of file
@@ -7,18 +7,24 @@
 #include <QLabel>
 #include <QLineEdit>
 #include <QPushButton>
-#include <QTextEdit>
+#include <QListView>
 #include <QGroupBox>
 #include <QSpinBox>
+#include <QComboBox>
+#include <QSlider>
 #include <QStatusBar>
 #include <QTimer>
 
+#include "gpsfix.h"
+
 QT_BEGIN_NAMESPACE
 class QUdpSocket;
 QT_END_NAMESPACE
 
 class UdpReceiver;
 class MapWidget;
+class LogModel;
+class UiUpdateScheduler;
 
 class MainWindow : public QMainWindow
 {
@@ -27,17 +33,46 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
+    
+    // Second half of startup, run once the window is on screen: starts
+    // listening on port unless listen is false, then loads the basemap
+    void finishStartup(quint16 port, bool listen);
+    
+    // Shared-memory fix buses used by every later start of the listener;
+    // empty names for none (see ReceiverConfig)
+    void setFixBus(const QString &input, const QString &output);
 
 private slots:
     void onStartListening();
     void onStopListening();
-    void onGpsDataReceived(double latitude, double longitude, double altitude);
+    void onGpsFixesReceived(const QVector<GpsFix> &fixes);
+    void onFrameReady(const GpsFix &latest, const QVector<GpsFix> &fixes);
+    void onUiRateChanged(int framesPerSecond);
     void onConnectionStatusChanged(bool connected);
     void updateStatusBar();
+    void onLogCapacityChanged(int capacity);
+    void onExportLog();
+    void onTrackSelected(quint32 deviceId);
+    void onRecordToggled(bool record);
+    void onRecordingStopped(const QString &error);
+    void onStartReplay();
+    void onStopReplay();
+    void onReplaySpeedChanged(int index);
+    void onReplaySeek();
+    void onReplayPosition(qint64 timeUs);
+    void onReplayFinished();
+    void onDumpLatency();
+    void onResetLatency();
 
 private:
     void setupUI();
     void setupConnections();
+    void logMessage(const QString &message);
+    void setListenerControlsEnabled(bool enabled);
+    bool startListening(bool interactive);
+    double replaySpeed() const;
+    void updateReplayTimeLabel(qint64 timeUs);
+    void updateLatencyPanel();
     
     // UI Components
     QWidget *m_centralWidget;
@@ -48,8 +83,25 @@ private:
     QHBoxLayout *m_controlLayout;
     QLabel *m_portLabel;
     QSpinBox *m_portSpinBox;
+    QLabel *m_listenersLabel;
+    QLineEdit *m_listenersEdit;
+    QLabel *m_receiveBufferLabel;
+    QSpinBox *m_receiveBufferSpinBox;
+    QLabel *m_threadsLabel;
+    QSpinBox *m_threadsSpinBox;
     QPushButton *m_startButton;
     QPushButton *m_stopButton;
+    QLabel *m_uiRateLabel;
+    QSpinBox *m_uiRateSpinBox;
+    
+    // Record / Replay
+    QGroupBox *m_replayGroup;
+    QPushButton *m_recordButton;
+    QPushButton *m_replayButton;
+    QPushButton *m_stopReplayButton;
+    QComboBox *m_replaySpeedCombo;
+    QSlider *m_replaySlider;
+    QLabel *m_replayTimeLabel;
     
     // GPS Data Display
     QGroupBox *m_gpsGroup;
@@ -61,25 +113,43 @@ private:
     QLineEdit *m_longitudeEdit;
     QLineEdit *m_altitudeEdit;
     
+    // Latency diagnostics
+    QGroupBox *m_latencyGroup;
+    QLabel *m_latencyLabel;
+    QPushButton *m_dumpLatencyButton;
+    QPushButton *m_resetLatencyButton;
+    
     // Map Widget
     MapWidget *m_mapWidget;
     
     // Log Display
     QGroupBox *m_logGroup;
-    QTextEdit *m_logTextEdit;
+    QListView *m_logView;
+    LogModel *m_logModel;
+    QSpinBox *m_logCapacitySpinBox;
+    QPushButton *m_exportLogButton;
     
     // Status
     QLabel *m_statusLabel;
+    QLabel *m_statsLabel;
     QTimer *m_statusTimer;
     
     // Network
     UdpReceiver *m_udpReceiver;
+    UiUpdateScheduler *m_updateScheduler;
+    QString m_busInput;
+    QString m_busOutput;
     
     // Current GPS data
     double m_currentLatitude;
     double m_currentLongitude;
     double m_currentAltitude;
     bool m_isListening;
+    bool m_startupReported;
+    
+    static const int LOG_CAPACITY_DEFAULT = 10000;
+    static const int UI_RATE_DEFAULT = 30; // frames per second
+    static const int REPLAY_SLIDER_STEPS = 1000;
 };
 
 #endif // MAINWINDOW_H
\ No newline at end of file
@@ -1,9 +1,20 @@
 #include "mapwidget.h"
+#include "latencymonitor.h"
+#include "logger.h"
+#include "positionmarkeritem.h"
+#include "rendertierstats.h"
+#include "startupprofiler.h"
+#include "tilecacheservice.h"
+#include "trailcanvasitem.h"
+#include "trackoverlayitem.h"
+#include "webmercator.h"
 
 #include <QDebug>
 #include <QMessageBox>
 #include <QDir>
 #include <QStandardPaths>
+#include <QMouseEvent>
+#include <QSignalBlocker>
 
 // Additional QGIS includes
 #include <qgspoint.h>
@@ -29,23 +40,63 @@ MapWidget::MapWidget(QWidget *parent)
     , m_baseMapCombo(nullptr)
     , m_showTrailCheckBox(nullptr)
     , m_clearTrailButton(nullptr)
+    , m_tileCacheLayout(nullptr)
+    , m_offlineCheckBox(nullptr)
+    , m_prefetchLabel(nullptr)
+    , m_prefetchMinZoomSpinBox(nullptr)
+    , m_prefetchMaxZoomSpinBox(nullptr)
+    , m_prefetchButton(nullptr)
+    , m_historyLayout(nullptr)
+    , m_historyDeviceEdit(nullptr)
+    , m_historyFromEdit(nullptr)
+    , m_historyToEdit(nullptr)
+    , m_showHistoryButton(nullptr)
+    , m_clearHistoryButton(nullptr)
+    , m_renderLayout(nullptr)
+    , m_renderThreadsSpinBox(nullptr)
+    , m_parallelRenderCheckBox(nullptr)
+    , m_progressiveRenderCheckBox(nullptr)
+    , m_adaptiveRenderCheckBox(nullptr)
+    , m_frameBudgetSpinBox(nullptr)
     , m_mapCanvas(nullptr)
-    , m_positionLayer(nullptr)
-    , m_trailLayer(nullptr)
+    , m_positionMarker(nullptr)
+    , m_trailItem(nullptr)
+    , m_trackOverlay(nullptr)
+    , m_historyItem(nullptr)
     , m_baseMapLayer(nullptr)
+    , m_osmLayer(nullptr)
+    , m_satelliteLayer(nullptr)
+    , m_baseMapRendered(nullptr)
+    , m_baseMapValid(false)
+    , m_baseMapPendingHit(false)
+    , m_renderStartNs(0)
+    , m_defaultMapUpdateInterval(0)
+    , m_draftQuality(false)
+    , m_restoringQuality(false)
+    , m_tileCache(nullptr)
     , m_currentLatitude(0.0)
     , m_currentLongitude(0.0)
     , m_currentAltitude(0.0)
     , m_hasPosition(false)
+    , m_tracedReceiveNs(0)
+    , m_selectedDevice(0)
     , m_showTrail(true)
+    , m_historyActive(false)
+    , m_historyDevice(0)
+    , m_historyFromMs(0)
+    , m_historyToMs(0)
     , m_mapCrs(QgsCoordinateReferenceSystem("EPSG:3857")) // Web Mercator
 {
-    initializeQGIS();
+    // QGIS is initialized once, in main(). The tile cache and basemap are
+    // left to addBaseMap() so the window can show without waiting for them.
     setupUI();
     setupMapCanvas();
-    createPositionLayer();
-    createTrailLayer();
-    addBaseMap();
+    createTrackOverlay();
+    createHistoryItem();
+    createTrailItem();
+    createPositionMarker();
+    setRenderProfile(m_renderProfile);
+    openArchive();
 }
 
 MapWidget::~MapWidget()
@@ -53,26 +104,6 @@ MapWidget::~MapWidget()
     // Cleanup is handled by Qt parent-child relationship
 }
 
-void MapWidget::initializeQGIS()
-{
-    // Initialize QGIS Application
-    // Note: This should ideally be done once in main(), but we'll do it here for simplicity
-    static bool qgisInitialized = false;
-    if (!qgisInitialized) {
-        // Set QGIS paths
-        QString qgisPrefix = QDir::homePath() + "/.local/share/QGIS/QGIS3";
-        if (!QDir(qgisPrefix).exists()) {
-            qgisPrefix = "/usr/share/qgis"; // Default Linux path
-        }
-        
-        QgsApplication::setPrefixPath(qgisPrefix, true);
-        QgsApplication::initQgis();
-        
-        qgisInitialized = true;
-        qDebug() << "QGIS initialized with prefix:" << qgisPrefix;
-    }
-}
-
 void MapWidget::setupUI()
 {
     m_mainLayout = new QVBoxLayout(this);
@@ -90,6 +121,7 @@ void MapWidget::setupUI()
     m_baseMapCombo->addItem("OpenStreetMap");
     m_baseMapCombo->addItem("Satellite");
     m_baseMapCombo->addItem("None");
+    m_baseMapCombo->setEnabled(false); // Until addBaseMap()
     
     m_showTrailCheckBox = new QCheckBox("Show Trail", this);
     m_showTrailCheckBox->setChecked(true);
@@ -108,6 +140,95 @@ void MapWidget::setupUI()
     
     m_mainLayout->addLayout(m_controlLayout);
     
+    // Tile cache controls
+    m_tileCacheLayout = new QHBoxLayout();
+    
+    m_offlineCheckBox = new QCheckBox("Offline", this);
+    m_offlineCheckBox->setToolTip("Serve basemap tiles from the local cache only");
+    m_offlineCheckBox->setEnabled(false); // Until the tile cache is started
+    
+    m_prefetchLabel = new QLabel("Prefetch zoom:", this);
+    m_prefetchMinZoomSpinBox = new QSpinBox(this);
+    m_prefetchMinZoomSpinBox->setRange(0, 19);
+    m_prefetchMinZoomSpinBox->setValue(PREFETCH_MIN_ZOOM_DEFAULT);
+    m_prefetchMaxZoomSpinBox = new QSpinBox(this);
+    m_prefetchMaxZoomSpinBox->setRange(0, 19);
+    m_prefetchMaxZoomSpinBox->setValue(PREFETCH_MAX_ZOOM_DEFAULT);
+    
+    m_prefetchButton = new QPushButton("Prefetch Track", this);
+    m_prefetchButton->setToolTip("Download the active basemap around the track for the selected zoom levels");
+    m_prefetchButton->setEnabled(false);
+    
+    m_tileCacheLayout->addWidget(m_offlineCheckBox);
+    m_tileCacheLayout->addWidget(m_prefetchLabel);
+    m_tileCacheLayout->addWidget(m_prefetchMinZoomSpinBox);
+    m_tileCacheLayout->addWidget(m_prefetchMaxZoomSpinBox);
+    m_tileCacheLayout->addWidget(m_prefetchButton);
+    m_tileCacheLayout->addStretch();
+    
+    m_mainLayout->addLayout(m_tileCacheLayout);
+    
+    // Archived history controls
+    m_historyLayout = new QHBoxLayout();
+    
+    m_historyDeviceEdit = new QLineEdit(this);
+    m_historyDeviceEdit->setPlaceholderText("Device ID (hex)");
+    m_historyDeviceEdit->setMaximumWidth(120);
+    
+    const QDateTime now = QDateTime::currentDateTime();
+    m_historyFromEdit = new QDateTimeEdit(now.addSecs(-HISTORY_HOURS_DEFAULT * 3600), this);
+    m_historyFromEdit->setCalendarPopup(true);
+    m_historyToEdit = new QDateTimeEdit(now, this);
+    m_historyToEdit->setCalendarPopup(true);
+    
+    m_showHistoryButton = new QPushButton("Show History", this);
+    m_showHistoryButton->setToolTip("Draw the device's archived track for the time range");
+    m_clearHistoryButton = new QPushButton("Clear History", this);
+    m_clearHistoryButton->setEnabled(false);
+    
+    m_historyLayout->addWidget(new QLabel("History:", this));
+    m_historyLayout->addWidget(m_historyDeviceEdit);
+    m_historyLayout->addWidget(m_historyFromEdit);
+    m_historyLayout->addWidget(new QLabel("to", this));
+    m_historyLayout->addWidget(m_historyToEdit);
+    m_historyLayout->addWidget(m_showHistoryButton);
+    m_historyLayout->addWidget(m_clearHistoryButton);
+    m_historyLayout->addStretch();
+    
+    m_mainLayout->addLayout(m_historyLayout);
+    
+    // Rendering performance controls
+    m_renderLayout = new QHBoxLayout();
+    
+    m_renderThreadsSpinBox = new QSpinBox(this);
+    m_renderThreadsSpinBox->setRange(0, MAX_RENDER_THREADS);
+    m_renderThreadsSpinBox->setSpecialValueText("All cores");
+    m_renderThreadsSpinBox->setToolTip("Threads the map layers are rendered on");
+    
+    m_parallelRenderCheckBox = new QCheckBox("Parallel", this);
+    m_parallelRenderCheckBox->setToolTip("Render each layer as its own job instead of all in turn on one thread");
+    m_progressiveRenderCheckBox = new QCheckBox("Progressive", this);
+    m_progressiveRenderCheckBox->setToolTip("Show partial renders, and render around the view ahead of panning");
+    m_adaptiveRenderCheckBox = new QCheckBox("Adaptive", this);
+    m_adaptiveRenderCheckBox->setToolTip("Drop antialiasing and detail while renders exceed the frame budget; "
+                                         "restore them once the view is idle");
+    
+    m_frameBudgetSpinBox = new QSpinBox(this);
+    m_frameBudgetSpinBox->setRange(10, 1000);
+    m_frameBudgetSpinBox->setSuffix(" ms");
+    m_frameBudgetSpinBox->setToolTip("Render time above which adaptive mode switches to draft quality");
+    
+    m_renderLayout->addWidget(new QLabel("Rendering threads:", this));
+    m_renderLayout->addWidget(m_renderThreadsSpinBox);
+    m_renderLayout->addWidget(m_parallelRenderCheckBox);
+    m_renderLayout->addWidget(m_progressiveRenderCheckBox);
+    m_renderLayout->addWidget(m_adaptiveRenderCheckBox);
+    m_renderLayout->addWidget(new QLabel("Frame budget:", this));
+    m_renderLayout->addWidget(m_frameBudgetSpinBox);
+    m_renderLayout->addStretch();
+    
+    m_mainLayout->addLayout(m_renderLayout);
+    
     // Connect signals
     connect(m_zoomInButton, &QPushButton::clicked, this, &MapWidget::onZoomIn);
     connect(m_zoomOutButton, &QPushButton::clicked, this, &MapWidget::onZoomOut);
@@ -117,6 +238,17 @@ void MapWidget::setupUI()
             this, &MapWidget::onBaseMapChanged);
     connect(m_showTrailCheckBox, &QCheckBox::toggled, this, &MapWidget::onShowTrailToggled);
     connect(m_clearTrailButton, &QPushButton::clicked, this, &MapWidget::onClearTrail);
+    connect(m_offlineCheckBox, &QCheckBox::toggled, this, &MapWidget::onOfflineToggled);
+    connect(m_prefetchButton, &QPushButton::clicked, this, &MapWidget::onPrefetchTrack);
+    connect(m_showHistoryButton, &QPushButton::clicked, this, &MapWidget::onShowHistory);
+    connect(m_clearHistoryButton, &QPushButton::clicked, this, &MapWidget::onClearHistory);
+    connect(m_renderThreadsSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &MapWidget::onRenderControlsChanged);
+    connect(m_parallelRenderCheckBox, &QCheckBox::toggled, this, &MapWidget::onRenderControlsChanged);
+    connect(m_progressiveRenderCheckBox, &QCheckBox::toggled, this, &MapWidget::onRenderControlsChanged);
+    connect(m_adaptiveRenderCheckBox, &QCheckBox::toggled, this, &MapWidget::onRenderControlsChanged);
+    connect(m_frameBudgetSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &MapWidget::onRenderControlsChanged);
 }
 
 void MapWidget::setupMapCanvas()
@@ -126,114 +258,158 @@ void MapWidget::setupMapCanvas()
     m_mapCanvas->enableAntiAliasing(true);
     m_mapCanvas->setDestinationCrs(m_mapCrs);
     
+    // Basemap tier: refreshes at an unchanged extent and scale reuse the
+    // rendered layer image instead of drawing the tiles again. Live data
+    // and history are canvas items and never go through the render job.
+    m_mapCanvas->setCachingEnabled(true);
+    connect(m_mapCanvas, &QgsMapCanvas::renderStarting, this, &MapWidget::onRenderStarting);
+    connect(m_mapCanvas, &QgsMapCanvas::mapCanvasRefreshed, this, &MapWidget::onMapCanvasRefreshed);
+    
+    // Adaptive quality returns to full once the view stops changing
+    m_defaultMapUpdateInterval = m_mapCanvas->mapUpdateInterval();
+    m_renderIdleTimer.setSingleShot(true);
+    m_renderIdleTimer.setInterval(RENDER_IDLE_MS);
+    connect(&m_renderIdleTimer, &QTimer::timeout, this, &MapWidget::onRenderIdle);
+    
     // Set initial extent (world view)
     QgsRectangle extent(-20037508.34, -20037508.34, 20037508.34, 20037508.34);
     m_mapCanvas->setExtent(extent);
     
     m_mainLayout->addWidget(m_mapCanvas);
     
+    // Archived history is loaded as the view moves over it
+    connect(m_mapCanvas, &QgsMapCanvas::extentsChanged, this, &MapWidget::onExtentsChanged);
+    
+    // Clicks on the canvas select the nearest track
+    m_mapCanvas->viewport()->installEventFilter(this);
+    
     qDebug() << "Map canvas created";
 }
 
-void MapWidget::createPositionLayer()
+void MapWidget::createPositionMarker()
 {
-    // Create memory layer for current position
-    QString layerDef = "Point?crs=EPSG:4326&field=id:integer&field=name:string(20)";
-    m_positionLayer = new QgsVectorLayer(layerDef, "Current Position", "memory");
+    // Overlay item instead of a memory layer: moving it repaints only its
+    // own few pixels rather than re-rendering the map
+    m_positionMarker = new PositionMarkerItem(m_mapCanvas);
+    m_positionMarker->setColor(QColor(255, 0, 0)); // Red
+    m_positionMarker->setVisible(false);
     
-    if (!m_positionLayer->isValid()) {
-        qDebug() << "Failed to create position layer";
-        return;
-    }
-    
-    // Create marker symbol
-    QgsMarkerSymbol *symbol = QgsMarkerSymbol::createSimple(QVariantMap());
-    symbol->setColor(QColor(255, 0, 0)); // Red
-    symbol->setSize(8);
+    qDebug() << "Position marker created";
+}
+
+void MapWidget::createTrailItem()
+{
+    // Columnar store drawn as a decimated polyline overlay; appending
+    // fixes repaints the overlay without re-rendering the map layers
+    // The item shows the selected track's trail; it has none until a fix arrives
+    m_trailItem = new TrailCanvasItem(m_mapCanvas, nullptr);
+    m_trailItem->setColor(QColor(0, 0, 255)); // Blue
+    m_trailItem->setVisible(m_showTrail);
+    
+    qDebug() << "Trail overlay created";
+}
+
+void MapWidget::createTrackOverlay()
+{
+    // Every other track shares one overlay below the selected trail
+    m_trackOverlay = new TrackOverlayItem(m_mapCanvas, &m_trackTable);
+    m_trackOverlay->setShowTrails(m_showTrail);
     
-    QgsSingleSymbolRenderer *renderer = new QgsSingleSymbolRenderer(symbol);
-    m_positionLayer->setRenderer(renderer);
+    GPS_LOG_DEBUG(Logger::Map, "Track overlay created");
+}
+
+void MapWidget::createHistoryItem()
+{
+    // Archived track, drawn under the live trail of the selected device
+    m_historyItem = new TrailCanvasItem(m_mapCanvas, nullptr);
+    m_historyItem->setColor(QColor(128, 0, 160)); // Purple
+    m_historyItem->setZValue(45);
     
-    // Add to project and canvas
-    QgsProject::instance()->addMapLayer(m_positionLayer);
+    // History tier: drawn into an image that live updates paint over
+    m_historyItem->setRenderTier(RenderTierStats::History);
     
-    qDebug() << "Position layer created";
+    GPS_LOG_DEBUG(Logger::Map, "History overlay created");
+}
+
+void MapWidget::openArchive()
+{
+    // Only lists the segment files; none is read until a query needs it
+    const QString directory = TrackArchive::defaultDirectory();
+    if (m_archive.open(directory)) {
+        GPS_LOG_INFO(Logger::Map, "Track archive {}: {} segments", directory, m_archive.segmentCount());
+    }
 }
 
-void MapWidget::createTrailLayer()
+void MapWidget::createTileCache()
 {
-    // Create memory layer for trail
-    QString layerDef = "Point?crs=EPSG:4326&field=id:integer&field=timestamp:string(20)";
-    m_trailLayer = new QgsVectorLayer(layerDef, "GPS Trail", "memory");
+    m_tileCache = new TileCacheService(this);
+    m_tileCache->addSource("osm", "https://tile.openstreetmap.org/{z}/{x}/{y}.png");
+    m_tileCache->addSource("satellite", "https://server.arcgisonline.com/ArcGIS/rest/services/World_Imagery/MapServer/tile/{z}/{y}/{x}");
     
-    if (!m_trailLayer->isValid()) {
-        qDebug() << "Failed to create trail layer";
-        return;
+    if (!m_tileCache->start()) {
+        GPS_LOG_WARNING(Logger::Map, "Tile cache unavailable; basemaps load tiles directly");
     }
     
-    // Create marker symbol for trail points
-    QgsMarkerSymbol *symbol = QgsMarkerSymbol::createSimple(QVariantMap());
-    symbol->setColor(QColor(0, 0, 255)); // Blue
-    symbol->setSize(4);
+    m_offlineCheckBox->setChecked(m_tileCache->isOffline());
+    m_offlineCheckBox->setEnabled(m_tileCache->isRunning());
+    m_prefetchButton->setEnabled(m_tileCache->isRunning());
     
-    QgsSingleSymbolRenderer *renderer = new QgsSingleSymbolRenderer(symbol);
-    m_trailLayer->setRenderer(renderer);
+    connect(m_tileCache, &TileCacheService::prefetchProgress, this, &MapWidget::onPrefetchProgress);
+    connect(m_tileCache, &TileCacheService::prefetchFinished, this, &MapWidget::onPrefetchFinished);
+}
+
+void MapWidget::addBaseMap()
+{
+    if (m_tileCache) {
+        return;
+    }
     
-    // Add to project and canvas
-    QgsProject::instance()->addMapLayer(m_trailLayer);
+    // Starts the tile server thread and creates the first raster layer,
+    // which loads the XYZ provider
+    createTileCache();
+    m_baseMapCombo->setEnabled(true);
+    onBaseMapChanged(m_baseMapCombo->currentText());
     
-    qDebug() << "Trail layer created";
+    StartupProfiler::instance().mark(StartupProfiler::BaseMapReady);
 }
 
-void MapWidget::addBaseMap()
+QgsRasterLayer *MapWidget::createTileLayer(const QString &source, const QString &name)
 {
-    // For now, we'll create a simple base map
-    // In a full implementation, you would add actual tile layers
-    addOpenStreetMapLayer();
+    // Tiles are requested through the local cache server when it is running
+    QString uri = "type=xyz&url=" + m_tileCache->tileUrl(source) + "&zmax=19&zmin=0";
+    QgsRasterLayer *layer = new QgsRasterLayer(uri, name, "wms");
+    
+    if (!layer->isValid()) {
+        qDebug() << "Failed to create" << name << "layer";
+        delete layer;
+        return nullptr;
+    }
+    
+    QgsProject::instance()->addMapLayer(layer);
+    connect(layer, &QgsMapLayer::repaintRequested, this, &MapWidget::onBaseMapRepaintRequested);
+    qDebug() << name << "layer added";
+    return layer;
 }
 
 void MapWidget::addOpenStreetMapLayer()
 {
-    // Create a raster layer for OpenStreetMap
-    // Note: This is a simplified implementation
-    // In reality, you'd need to configure tile server connections
-    
-    QString uri = "type=xyz&url=https://tile.openstreetmap.org/{z}/{x}/{y}.png&zmax=19&zmin=0";
-    m_baseMapLayer = new QgsRasterLayer(uri, "OpenStreetMap", "wms");
-    
-    if (m_baseMapLayer->isValid()) {
-        QgsProject::instance()->addMapLayer(m_baseMapLayer);
-        qDebug() << "OpenStreetMap layer added";
-    } else {
-        qDebug() << "Failed to create OpenStreetMap layer";
-        // Create a fallback empty layer
-        delete m_baseMapLayer;
-        m_baseMapLayer = nullptr;
+    // Basemap layers are created once and kept; switching only changes
+    // which one the canvas draws
+    if (!m_osmLayer) {
+        m_osmLayer = createTileLayer("osm", "OpenStreetMap");
     }
+    m_baseMapLayer = m_osmLayer;
     
     updateMapLayers();
 }
 
 void MapWidget::addSatelliteLayer()
 {
-    // Remove existing base map
-    if (m_baseMapLayer) {
-        QgsProject::instance()->removeMapLayer(m_baseMapLayer);
-        m_baseMapLayer = nullptr;
-    }
-    
-    // Add satellite imagery (example with Esri World Imagery)
-    QString uri = "type=xyz&url=https://server.arcgisonline.com/ArcGIS/rest/services/World_Imagery/MapServer/tile/{z}/{y}/{x}&zmax=19&zmin=0";
-    m_baseMapLayer = new QgsRasterLayer(uri, "Satellite", "wms");
-    
-    if (m_baseMapLayer->isValid()) {
-        QgsProject::instance()->addMapLayer(m_baseMapLayer);
-        qDebug() << "Satellite layer added";
-    } else {
-        qDebug() << "Failed to create satellite layer";
-        delete m_baseMapLayer;
-        m_baseMapLayer = nullptr;
+    // Esri World Imagery
+    if (!m_satelliteLayer) {
+        m_satelliteLayer = createTileLayer("satellite", "Satellite");
     }
+    m_baseMapLayer = m_satelliteLayer;
     
     updateMapLayers();
 }
@@ -246,12 +422,6 @@ void MapWidget::updateMapLayers()
     if (m_baseMapLayer) {
         layers.append(m_baseMapLayer);
     }
-    if (m_trailLayer && m_showTrail) {
-        layers.append(m_trailLayer);
-    }
-    if (m_positionLayer) {
-        layers.append(m_positionLayer);
-    }
     
     m_mapCanvas->setLayers(layers);
     m_mapCanvas->refresh();
@@ -259,77 +429,152 @@ void MapWidget::updateMapLayers()
 
 void MapWidget::updatePosition(double latitude, double longitude, double altitude)
 {
-    m_currentLatitude = latitude;
-    m_currentLongitude = longitude;
-    m_currentAltitude = altitude;
-    m_hasPosition = true;
+    GpsFix fix;
+    fix.latitude = latitude;
+    fix.longitude = longitude;
+    fix.altitude = altitude;
+    WebMercator::project(fix.longitude, fix.latitude, fix.mapX, fix.mapY);
+    updatePositions(QVector<GpsFix>{ fix });
+}
+
+void MapWidget::updatePositions(const QVector<GpsFix> &fixes)
+{
+    if (fixes.isEmpty()) {
+        return;
+    }
     
-    updatePositionMarker();
+    LatencyMonitor &latency = LatencyMonitor::instance();
+    const qint64 nowNs = LatencyMonitor::now();
+    for (const GpsFix &fix : fixes) {
+        latency.record(LatencyMonitor::Applied, fix.receiveNs, nowNs);
+    }
+    
+    // Every fix goes to its device's track; the marker follows the selected one
+    m_trackTable.update(fixes, m_showTrail);
+    
+    const bool firstPosition = !m_hasPosition;
+    if (m_trackTable.indexOf(m_selectedDevice) < 0) {
+        selectTrack(m_trackTable.indexOf(fixes.first().deviceId));
+    } else {
+        updateSelectedPosition();
+    }
     
-    if (m_showTrail) {
-        addTrailPoint();
+    // Time the marker's next paint if it moved to a new, on-screen fix
+    const int selected = m_trackTable.indexOf(m_selectedDevice);
+    if (selected >= 0) {
+        const GpsFix &latest = m_trackTable.track(selected).lastFix;
+        if (latest.receiveNs != m_tracedReceiveNs && m_mapCanvas->extent().contains(m_currentMapPoint)) {
+            m_positionMarker->traceNextPaint(latest.receiveNs);
+        }
+        m_tracedReceiveNs = latest.receiveNs;
     }
     
-    // Auto-center on first position
-    static bool firstPosition = true;
     if (firstPosition) {
         zoomToPosition();
-        firstPosition = false;
+    } else {
+        // One overlay repaint per burst; the map layers are not re-rendered
+        m_trackOverlay->update();
+        if (m_showTrail) {
+            m_trailItem->update();
+        }
     }
     
-    qDebug() << "Position updated:" << latitude << longitude << altitude;
+    GPS_LOG_TRACE(Logger::Map, "Position updated: {} {} {} ({} fixes, {} tracks)",
+                  m_currentLatitude, m_currentLongitude, m_currentAltitude, fixes.size(),
+                  m_trackTable.count());
 }
 
-void MapWidget::updatePositionMarker()
+int MapWidget::trackCount() const
 {
-    if (!m_positionLayer || !m_hasPosition) {
+    return m_trackTable.count();
+}
+
+void MapWidget::selectTrack(int index)
+{
+    if (index < 0 || index >= m_trackTable.count()) {
         return;
     }
     
-    // Clear existing features
-    m_positionLayer->dataProvider()->truncate();
-    
-    // Create new feature
-    QgsFeature feature;
-    feature.setGeometry(QgsGeometry::fromPointXY(QgsPointXY(m_currentLongitude, m_currentLatitude)));
-    
-    QgsFields fields = m_positionLayer->fields();
-    feature.setFields(fields);
-    feature.setAttribute("id", 1);
-    feature.setAttribute("name", "Current Position");
+    const Track &track = m_trackTable.track(index);
+    m_selectedDevice = track.deviceId;
+    m_trailItem->setStore(&track.trail);
+    m_historyDeviceEdit->setText(QString::number(track.deviceId, 16));
+    m_trackOverlay->setSelectedDevice(track.deviceId);
+    updateSelectedPosition();
     
-    // Add feature
-    m_positionLayer->dataProvider()->addFeatures(QgsFeatureList() << feature);
-    m_positionLayer->updateExtents();
-    m_positionLayer->triggerRepaint();
-    
-    m_mapCanvas->refresh();
+    emit trackSelected(track.deviceId);
+}
+
+bool MapWidget::selectedFix(GpsFix &fix) const
+{
+    const int index = m_trackTable.indexOf(m_selectedDevice);
+    if (index < 0) {
+        return false;
+    }
+    fix = m_trackTable.track(index).lastFix;
+    return true;
+}
+
+QgsMapCanvas *MapWidget::mapCanvas() const
+{
+    return m_mapCanvas;
 }
 
-void MapWidget::addTrailPoint()
+void MapWidget::updateSelectedPosition()
 {
-    if (!m_trailLayer || !m_hasPosition) {
+    const int index = m_trackTable.indexOf(m_selectedDevice);
+    if (index < 0) {
         return;
     }
     
-    QgsPointXY point(m_currentLongitude, m_currentLatitude);
-    m_trailPoints.append(point);
-    
-    // Create new feature
-    QgsFeature feature;
-    feature.setGeometry(QgsGeometry::fromPointXY(point));
+    const GpsFix &latest = m_trackTable.track(index).lastFix;
+    m_currentLatitude = latest.latitude;
+    m_currentLongitude = latest.longitude;
+    m_currentAltitude = latest.altitude;
+    m_currentMapPoint = QgsPointXY(latest.mapX, latest.mapY);
+    m_hasPosition = true;
     
-    QgsFields fields = m_trailLayer->fields();
-    feature.setFields(fields);
-    feature.setAttribute("id", m_trailPoints.size());
-    feature.setAttribute("timestamp", QDateTime::currentDateTime().toString());
+    updatePositionMarker();
+}
+
+bool MapWidget::selectedTrailExtent(double &minX, double &minY, double &maxX, double &maxY) const
+{
+    const int index = m_trackTable.indexOf(m_selectedDevice);
+    return index >= 0 && m_trackTable.track(index).trail.mapExtent(minX, minY, maxX, maxY);
+}
+
+bool MapWidget::eventFilter(QObject *watched, QEvent *event)
+{
+    if (m_mapCanvas && watched == m_mapCanvas->viewport()) {
+        if (event->type() == QEvent::MouseButtonPress) {
+            m_pressPosition = static_cast<QMouseEvent *>(event)->pos();
+        } else if (event->type() == QEvent::MouseButtonRelease) {
+            // A release near the press is a click; anything further was a pan
+            const QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
+            if (mouseEvent->button() == Qt::LeftButton
+                && (mouseEvent->pos() - m_pressPosition).manhattanLength() <= CLICK_SLOP_PIXELS) {
+                const QgsMapToPixel *mapToPixel = m_mapCanvas->getCoordinateTransform();
+                const QgsPointXY point = mapToPixel->toMapCoordinates(mouseEvent->pos());
+                const double radius = mapToPixel->mapUnitsPerPixel() * PICK_RADIUS_PIXELS;
+                const int index = m_trackTable.trackAt(point.x(), point.y(), radius);
+                if (index >= 0) {
+                    selectTrack(index);
+                }
+            }
+        }
+    }
     
-    // Add feature
-    m_trailLayer->dataProvider()->addFeatures(QgsFeatureList() << feature);
-    m_trailLayer->updateExtents();
-    m_trailLayer->triggerRepaint();
+    return QWidget::eventFilter(watched, event);
+}
+
+void MapWidget::updatePositionMarker()
+{
+    if (!m_positionMarker || !m_hasPosition) {
+        return;
+    }
     
-    m_mapCanvas->refresh();
+    m_positionMarker->setMapPosition(m_currentMapPoint);
+    m_positionMarker->setVisible(true);
 }
 
 void MapWidget::zoomToPosition()
@@ -338,9 +583,7 @@ void MapWidget::zoomToPosition()
         return;
     }
     
-    // Transform coordinates to map CRS
-    QgsCoordinateTransform transform(QgsCoordinateReferenceSystem("EPSG:4326"), m_mapCrs, QgsProject::instance());
-    QgsPointXY mapPoint = transform.transform(QgsPointXY(m_currentLongitude, m_currentLatitude));
+    const QgsPointXY &mapPoint = m_currentMapPoint;
     
     // Create extent around the point
     double buffer = 1000; // 1km buffer in map units
@@ -363,8 +606,12 @@ void MapWidget::onZoomOut()
 
 void MapWidget::onZoomToFit()
 {
-    if (m_positionLayer) {
-        m_mapCanvas->zoomToFeatureExtent(m_positionLayer->extent());
+    double minX, minY, maxX, maxY;
+    if (selectedTrailExtent(minX, minY, maxX, maxY)) {
+        QgsRectangle extent(minX, minY, maxX, maxY);
+        m_mapCanvas->zoomToFeatureExtent(extent);
+    } else {
+        zoomToPosition();
     }
 }
 
@@ -375,32 +622,342 @@ void MapWidget::onCenterOnPosition()
 
 void MapWidget::onBaseMapChanged(const QString &baseMapType)
 {
+    if (!m_tileCache) {
+        return;
+    }
+    
     if (baseMapType == "OpenStreetMap") {
         addOpenStreetMapLayer();
     } else if (baseMapType == "Satellite") {
         addSatelliteLayer();
     } else if (baseMapType == "None") {
-        if (m_baseMapLayer) {
-            QgsProject::instance()->removeMapLayer(m_baseMapLayer);
-            m_baseMapLayer = nullptr;
-            updateMapLayers();
-        }
+        m_baseMapLayer = nullptr;
+        updateMapLayers();
     }
 }
 
 void MapWidget::onShowTrailToggled(bool show)
 {
     m_showTrail = show;
-    updateMapLayers();
+    m_trailItem->setVisible(show);
+    m_trackOverlay->setShowTrails(show);
 }
 
 void MapWidget::onClearTrail()
 {
-    if (m_trailLayer) {
-        m_trailLayer->dataProvider()->truncate();
-        m_trailLayer->updateExtents();
-        m_trailLayer->triggerRepaint();
-        m_trailPoints.clear();
-        m_mapCanvas->refresh();
+    m_trackTable.clearTrails();
+    m_trailItem->update();
+    m_trackOverlay->update();
+}
+
+void MapWidget::onOfflineToggled(bool offline)
+{
+    m_tileCache->setOffline(offline);
+    
+    // Re-render so missing tiles show as gaps instead of stale requests;
+    // the cached basemap image is dropped, the other tiers are kept
+    if (m_baseMapLayer) {
+        m_baseMapLayer->triggerRepaint();
+    }
+}
+
+void MapWidget::onPrefetchTrack()
+{
+    double minX, minY, maxX, maxY;
+    if (!selectedTrailExtent(minX, minY, maxX, maxY)) {
+        if (!m_hasPosition) {
+            return;
+        }
+        minX = maxX = m_currentMapPoint.x();
+        minY = maxY = m_currentMapPoint.y();
+    }
+    
+    const QString source = (m_baseMapLayer && m_baseMapLayer == m_satelliteLayer) ? "satellite" : "osm";
+    const int minZoom = m_prefetchMinZoomSpinBox->value();
+    const int maxZoom = qMax(minZoom, m_prefetchMaxZoomSpinBox->value());
+    
+    m_prefetchButton->setEnabled(false);
+    m_prefetchButton->setText("Prefetching...");
+    m_tileCache->prefetch(source, minX - PREFETCH_MARGIN_M, minY - PREFETCH_MARGIN_M,
+                          maxX + PREFETCH_MARGIN_M, maxY + PREFETCH_MARGIN_M, minZoom, maxZoom);
+}
+
+void MapWidget::onPrefetchProgress(int done, int total)
+{
+    m_prefetchButton->setText(QString("Prefetching %1/%2").arg(done).arg(total));
+}
+
+void MapWidget::onPrefetchFinished(int fetched, int failed)
+{
+    m_prefetchButton->setText("Prefetch Track");
+    m_prefetchButton->setEnabled(true);
+    GPS_LOG_INFO(Logger::Map, "Prefetched {} tiles ({} failed)", fetched, failed);
+}
+
+void MapWidget::addArchiveSegment(const QString &path)
+{
+    if (m_archive.directory().isEmpty()) {
+        openArchive();
+    } else {
+        m_archive.addSegment(path);
+    }
+    
+    // A live device's newest history can land inside the range on display
+    if (m_historyActive) {
+        QVector<int> segments;
+        m_archive.segmentsInRange(m_historyFromMs, m_historyToMs, segments);
+        for (int segment : qAsConst(segments)) {
+            if (m_archive.segmentPath(segment) == path) {
+                double minX, minY, maxX, maxY;
+                m_historyExtents.insert(path, m_archive.deviceExtent(segment, m_historyDevice, minX, minY, maxX, maxY)
+                                                  ? QgsRectangle(minX, minY, maxX, maxY) : QgsRectangle());
+                loadVisibleHistory();
+                break;
+            }
+        }
+    }
+}
+
+void MapWidget::onShowHistory()
+{
+    bool ok = false;
+    const quint32 deviceId = m_historyDeviceEdit->text().trimmed().toUInt(&ok, 16);
+    if (!ok || deviceId == 0) {
+        GPS_LOG_WARNING(Logger::Map, "History needs a device ID in hex, e.g. from a selected track");
+        return;
+    }
+    
+    onClearHistory();
+    m_historyDevice = deviceId;
+    m_historyFromMs = m_historyFromEdit->dateTime().toMSecsSinceEpoch();
+    m_historyToMs = m_historyToEdit->dateTime().toMSecsSinceEpoch();
+    m_historyActive = true;
+    m_clearHistoryButton->setEnabled(true);
+    
+    // Per-segment extents come from the run directories alone; points are
+    // only read for segments the view reaches
+    QVector<int> segments;
+    m_archive.segmentsInRange(m_historyFromMs, m_historyToMs, segments);
+    QgsRectangle extent;
+    for (int segment : qAsConst(segments)) {
+        double minX, minY, maxX, maxY;
+        QgsRectangle segmentExtent;
+        if (m_archive.deviceExtent(segment, deviceId, minX, minY, maxX, maxY)) {
+            segmentExtent = QgsRectangle(minX, minY, maxX, maxY);
+            if (extent.isNull()) {
+                extent = segmentExtent;
+            } else {
+                extent.combineExtentWith(segmentExtent);
+            }
+        }
+        m_historyExtents.insert(m_archive.segmentPath(segment), segmentExtent);
+    }
+    
+    if (extent.isNull()) {
+        GPS_LOG_INFO(Logger::Map, "No archived fixes for device {} in {} segments",
+                     QString::number(deviceId, 16), segments.size());
+        return;
+    }
+    
+    GPS_LOG_INFO(Logger::Map, "History of device {}: {} segments", QString::number(deviceId, 16),
+                 segments.size());
+    m_mapCanvas->zoomToFeatureExtent(extent);
+    loadVisibleHistory();
+}
+
+void MapWidget::onClearHistory()
+{
+    m_historyActive = false;
+    m_historyExtents.clear();
+    m_historyLoaded.clear();
+    m_historyItem->setStores(QVector<const TrailStore *>());
+    m_historyTrails.clear();
+    m_clearHistoryButton->setEnabled(false);
+}
+
+void MapWidget::onExtentsChanged()
+{
+    loadVisibleHistory();
+    
+    // Still panning or zooming: stay in draft quality
+    if (m_draftQuality) {
+        m_renderIdleTimer.start();
+    }
+}
+
+void MapWidget::onRenderStarting()
+{
+    const QgsMapSettings &settings = m_mapCanvas->mapSettings();
+    m_baseMapPendingHit = m_baseMapValid && m_baseMapRendered == m_baseMapLayer
+                          && m_baseMapExtent == settings.visibleExtent() && m_baseMapSize == settings.outputSize();
+    m_renderStartNs = LatencyMonitor::now();
+}
+
+void MapWidget::onMapCanvasRefreshed()
+{
+    const qint64 renderNs = LatencyMonitor::now() - m_renderStartNs;
+    
+    // Account for this render before a quality switch below drops the image
+    if (m_baseMapLayer) {
+        RenderTierStats &stats = RenderTierStats::instance();
+        if (m_baseMapPendingHit) {
+            stats.recordHit(RenderTierStats::BaseMap);
+        } else {
+            stats.recordRender(RenderTierStats::BaseMap, renderNs);
+            GPS_LOG_DEBUG(Logger::Map, "Basemap rendered in {} ms", renderNs / 1e6);
+        }
+        
+        const QgsMapSettings &settings = m_mapCanvas->mapSettings();
+        m_baseMapRendered = m_baseMapLayer;
+        m_baseMapExtent = settings.visibleExtent();
+        m_baseMapSize = settings.outputSize();
+        m_baseMapValid = true;
+    } else {
+        m_baseMapValid = false;
+    }
+    
+    // The full-quality render after idle may take as long as it needs
+    if (m_restoringQuality) {
+        m_restoringQuality = false;
+    } else if (m_renderProfile.adaptive && renderNs > m_renderProfile.frameBudgetMs * Q_INT64_C(1000000)) {
+        if (!m_draftQuality) {
+            GPS_LOG_DEBUG(Logger::Map, "Render took {} ms, over the {} ms budget; drawing in draft quality",
+                          renderNs / 1e6, m_renderProfile.frameBudgetMs);
+            // Clears the canvas cache, so the basemap tier stays invalid
+            setDraftQuality(true);
+        }
+        m_renderIdleTimer.start();
     }
-}
\ No newline at end of file
+}
+
+void MapWidget::onBaseMapRepaintRequested()
+{
+    // QGIS drops the layer's cached image on the same signal
+    if (sender() == m_baseMapRendered) {
+        m_baseMapValid = false;
+    }
+}
+
+void MapWidget::setRenderProfile(const RenderProfile &profile)
+{
+    m_renderProfile = profile;
+    
+    // Layer jobs share the QGIS thread pool; -1 sizes it to the cores
+    QgsApplication::setMaxThreads(profile.threads > 0 ? profile.threads : -1);
+    m_mapCanvas->setParallelRenderingEnabled(profile.parallel);
+    m_mapCanvas->setPreviewJobsEnabled(profile.progressive);
+    m_mapCanvas->setMapUpdateInterval(profile.progressive ? PROGRESSIVE_UPDATE_MS : m_defaultMapUpdateInterval);
+    if (!profile.adaptive && m_draftQuality) {
+        m_renderIdleTimer.stop();
+        onRenderIdle();
+    }
+    
+    const QSignalBlocker threadsBlocker(m_renderThreadsSpinBox);
+    const QSignalBlocker parallelBlocker(m_parallelRenderCheckBox);
+    const QSignalBlocker progressiveBlocker(m_progressiveRenderCheckBox);
+    const QSignalBlocker adaptiveBlocker(m_adaptiveRenderCheckBox);
+    const QSignalBlocker budgetBlocker(m_frameBudgetSpinBox);
+    m_renderThreadsSpinBox->setValue(profile.threads);
+    m_parallelRenderCheckBox->setChecked(profile.parallel);
+    m_progressiveRenderCheckBox->setChecked(profile.progressive);
+    m_adaptiveRenderCheckBox->setChecked(profile.adaptive);
+    m_frameBudgetSpinBox->setValue(profile.frameBudgetMs);
+    m_frameBudgetSpinBox->setEnabled(profile.adaptive);
+    
+    GPS_LOG_INFO(Logger::Map, "Rendering: {} threads, {}, progressive {}, adaptive {} ({} ms budget)",
+                 QgsApplication::maxThreads(), profile.parallel ? "parallel" : "sequential",
+                 profile.progressive ? "on" : "off", profile.adaptive ? "on" : "off", profile.frameBudgetMs);
+}
+
+RenderProfile MapWidget::renderProfile() const
+{
+    return m_renderProfile;
+}
+
+void MapWidget::onRenderControlsChanged()
+{
+    RenderProfile profile;
+    profile.threads = m_renderThreadsSpinBox->value();
+    profile.parallel = m_parallelRenderCheckBox->isChecked();
+    profile.progressive = m_progressiveRenderCheckBox->isChecked();
+    profile.adaptive = m_adaptiveRenderCheckBox->isChecked();
+    profile.frameBudgetMs = m_frameBudgetSpinBox->value();
+    setRenderProfile(profile);
+}
+
+void MapWidget::onRenderIdle()
+{
+    if (!m_draftQuality) {
+        return;
+    }
+    
+    // One render at full quality for the view the user stopped on
+    GPS_LOG_DEBUG(Logger::Map, "View idle; restoring full render quality");
+    setDraftQuality(false);
+    m_restoringQuality = true;
+    m_mapCanvas->refresh();
+}
+
+void MapWidget::setDraftQuality(bool draft)
+{
+    m_draftQuality = draft;
+    
+    // Raster resampling is most of a basemap render's cost after the tiles
+    m_mapCanvas->enableAntiAliasing(!draft);
+    QgsMapSettings::Flags flags = m_mapCanvas->mapSettings().flags();
+    flags.setFlag(QgsMapSettings::HighQualityImageTransforms, !draft);
+    m_mapCanvas->setMapSettingsFlags(flags);
+    
+    // The cached basemap image was drawn at the other quality
+    m_mapCanvas->clearCache();
+    m_baseMapValid = false;
+    
+    m_trackOverlay->setDraft(draft);
+    m_historyItem->setDraft(draft);
+    m_trailItem->setDraft(draft);
+}
+
+void MapWidget::loadVisibleHistory()
+{
+    if (!m_historyActive) {
+        return;
+    }
+    
+    // Half a screen of margin so short pans find the track already loaded
+    QgsRectangle wanted = m_mapCanvas->extent();
+    wanted.grow(qMax(wanted.width(), wanted.height()) / 2);
+    
+    QVector<int> segments;
+    m_archive.segmentsInRange(m_historyFromMs, m_historyToMs, segments);
+    int loadedPoints = 0;
+    for (int segment : qAsConst(segments)) {
+        const QString path = m_archive.segmentPath(segment);
+        const QgsRectangle extent = m_historyExtents.value(path);
+        if (extent.isNull() || m_historyLoaded.contains(path) || !extent.intersects(wanted)) {
+            continue;
+        }
+        
+        std::unique_ptr<TrailStore> trail(new TrailStore);
+        loadedPoints += m_archive.loadTrack(segment, m_historyDevice, m_historyFromMs, m_historyToMs, *trail);
+        m_historyLoaded.insert(path);
+        if (!trail->isEmpty()) {
+            m_historyTrails.emplace(m_archive.segmentStartMs(segment), std::move(trail));
+        }
+    }
+    
+    if (loadedPoints > 0) {
+        GPS_LOG_DEBUG(Logger::Map, "Loaded {} archived fixes ({} of {} segments)", loadedPoints,
+                      m_historyLoaded.size(), m_historyExtents.size());
+        updateHistoryStores();
+    }
+}
+
+void MapWidget::updateHistoryStores()
+{
+    QVector<const TrailStore *> stores;
+    stores.reserve(int(m_historyTrails.size()));
+    for (const auto &entry : m_historyTrails) {
+        stores.append(entry.second.get());
+    }
+    m_historyItem->setStores(stores);
+}
@@ -9,6 +9,12 @@
 #include <QComboBox>
 #include <QSlider>
 #include <QCheckBox>
+#include <QSpinBox>
+#include <QLineEdit>
+#include <QDateTimeEdit>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
 
 // QGIS includes
 #include <qgsmapcanvas.h>
@@ -21,7 +27,7 @@
 #include <qgsfeature.h>
 #include <qgssymbol.h>
 #include <qgsrenderer.h>
-#include <qgssingleSymbolRenderer.h>
+#include <qgssinglesymbolrenderer.h>
 #include <qgsfillsymbol.h>
 #include <qgsmarkersymbol.h>
 #include <qgsrectangle.h>
@@ -30,9 +36,22 @@
 #include <qgsmaprendererparalleljob.h>
 #include <qgsmessagelog.h>
 
+#include "gpsfix.h"
+#include "renderprofile.h"
+#include "trackarchive.h"
+#include "tracktable.h"
+
+#include <map>
+#include <memory>
+
 class QgsMapCanvas;
 class QgsVectorLayer;
 class QgsMarkerSymbol;
+class QgsRasterLayer;
+class PositionMarkerItem;
+class TrailCanvasItem;
+class TrackOverlayItem;
+class TileCacheService;
 
 class MapWidget : public QWidget
 {
@@ -43,8 +62,36 @@ public:
     ~MapWidget();
 
     void updatePosition(double latitude, double longitude, double altitude);
+    void updatePositions(const QVector<GpsFix> &fixes);
     void zoomToPosition();
+    
+    // Starts the tile cache and shows the selected basemap; deferred from
+    // the constructor so startup does not wait on it. Later calls do nothing.
     void addBaseMap();
+    
+    // Tracks are keyed by GpsFix::deviceId; the selected one gets the
+    // position marker, the trail item and the coordinate display
+    int trackCount() const;
+    void selectTrack(int index);
+    bool selectedFix(GpsFix &fix) const;
+    
+    // The canvas the layers and overlays are drawn on
+    QgsMapCanvas *mapCanvas() const;
+    
+    // Render threads, job type, progressive preview and adaptive quality;
+    // the rendering controls follow
+    void setRenderProfile(const RenderProfile &profile);
+    RenderProfile renderProfile() const;
+
+public slots:
+    // Makes a segment sealed by the receiver available to history queries
+    void addArchiveSegment(const QString &path);
+
+signals:
+    void trackSelected(quint32 deviceId);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
     void onZoomIn();
@@ -54,17 +101,38 @@ private slots:
     void onBaseMapChanged(const QString &baseMapType);
     void onShowTrailToggled(bool show);
     void onClearTrail();
+    void onOfflineToggled(bool offline);
+    void onPrefetchTrack();
+    void onPrefetchProgress(int done, int total);
+    void onPrefetchFinished(int fetched, int failed);
+    void onShowHistory();
+    void onClearHistory();
+    void onExtentsChanged();
+    void onRenderStarting();
+    void onMapCanvasRefreshed();
+    void onBaseMapRepaintRequested();
+    void onRenderControlsChanged();
+    void onRenderIdle();
 
 private:
     void setupUI();
     void setupMapCanvas();
-    void initializeQGIS();
-    void createPositionLayer();
-    void createTrailLayer();
+    void createPositionMarker();
+    void createTrailItem();
+    void createTrackOverlay();
+    void createTileCache();
+    void createHistoryItem();
+    void openArchive();
+    void loadVisibleHistory();
+    void updateHistoryStores();
+    QgsRasterLayer *createTileLayer(const QString &source, const QString &name);
     void addOpenStreetMapLayer();
     void addSatelliteLayer();
+    void updateMapLayers();
     void updatePositionMarker();
-    void addTrailPoint();
+    void updateSelectedPosition();
+    bool selectedTrailExtent(double &minX, double &minY, double &maxX, double &maxY) const;
+    void setDraftQuality(bool draft);
     
     // UI Components
     QVBoxLayout *m_mainLayout;
@@ -77,26 +145,93 @@ private:
     QComboBox *m_baseMapCombo;
     QCheckBox *m_showTrailCheckBox;
     QPushButton *m_clearTrailButton;
+    QHBoxLayout *m_tileCacheLayout;
+    QCheckBox *m_offlineCheckBox;
+    QLabel *m_prefetchLabel;
+    QSpinBox *m_prefetchMinZoomSpinBox;
+    QSpinBox *m_prefetchMaxZoomSpinBox;
+    QPushButton *m_prefetchButton;
+    QHBoxLayout *m_historyLayout;
+    QLineEdit *m_historyDeviceEdit;
+    QDateTimeEdit *m_historyFromEdit;
+    QDateTimeEdit *m_historyToEdit;
+    QPushButton *m_showHistoryButton;
+    QPushButton *m_clearHistoryButton;
+    QHBoxLayout *m_renderLayout;
+    QSpinBox *m_renderThreadsSpinBox;
+    QCheckBox *m_parallelRenderCheckBox;
+    QCheckBox *m_progressiveRenderCheckBox;
+    QCheckBox *m_adaptiveRenderCheckBox;
+    QSpinBox *m_frameBudgetSpinBox;
     
     // QGIS Components
     QgsMapCanvas *m_mapCanvas;
-    QgsVectorLayer *m_positionLayer;
-    QgsVectorLayer *m_trailLayer;
-    QgsVectorLayer *m_baseMapLayer;
+    PositionMarkerItem *m_positionMarker;
+    TrailCanvasItem *m_trailItem;
+    TrackOverlayItem *m_trackOverlay;
+    TrailCanvasItem *m_historyItem;
+    QgsRasterLayer *m_baseMapLayer; // Active basemap, or nullptr for none
+    QgsRasterLayer *m_osmLayer;
+    QgsRasterLayer *m_satelliteLayer;
+    
+    // View the basemap tier image was last rendered for. QGIS keeps the
+    // layer image while extent, size and layer stay the same and the layer
+    // has not asked for a repaint; the render in flight is a hit if so.
+    QgsMapLayer *m_baseMapRendered;
+    QgsRectangle m_baseMapExtent;
+    QSize m_baseMapSize;
+    bool m_baseMapValid;
+    bool m_baseMapPendingHit;
+    qint64 m_renderStartNs;
+    
+    // Rendering profile; in adaptive mode a slow render switches to draft
+    // quality until the view has been idle for RENDER_IDLE_MS
+    RenderProfile m_renderProfile;
+    int m_defaultMapUpdateInterval;
+    bool m_draftQuality;
+    bool m_restoringQuality; // The render in flight is the full-quality one after idle
+    QTimer m_renderIdleTimer;
+    
+    // Read-through tile cache behind both basemaps
+    TileCacheService *m_tileCache;
     
     // Current position
     double m_currentLatitude;
     double m_currentLongitude;
     double m_currentAltitude;
+    QgsPointXY m_currentMapPoint; // Web Mercator
     bool m_hasPosition;
+    qint64 m_tracedReceiveNs; // Latest selected fix handed to the marker's latency trace
     
     // Trail tracking
-    QList<QgsPointXY> m_trailPoints;
+    TrackTable m_trackTable;
+    quint32 m_selectedDevice;
     bool m_showTrail;
+    QPoint m_pressPosition;
+    
+    // Archived history of one device; segments are loaded as the view
+    // reaches them and kept as one trail each, in time order
+    TrackArchive m_archive;
+    bool m_historyActive;
+    quint32 m_historyDevice;
+    qint64 m_historyFromMs;
+    qint64 m_historyToMs;
+    QHash<QString, QgsRectangle> m_historyExtents; // Per segment path; null when the device is absent
+    QSet<QString> m_historyLoaded;
+    std::multimap<qint64, std::unique_ptr<TrailStore>> m_historyTrails;
     
     // Map settings
     QgsCoordinateReferenceSystem m_mapCrs;
     static const int ZOOM_LEVEL_DEFAULT = 15;
+    static const int PREFETCH_MIN_ZOOM_DEFAULT = 10;
+    static const int PREFETCH_MAX_ZOOM_DEFAULT = 16;
+    static const int PREFETCH_MARGIN_M = 2000;
+    static const int CLICK_SLOP_PIXELS = 4;
+    static const int PICK_RADIUS_PIXELS = 8;
+    static const int HISTORY_HOURS_DEFAULT = 24;
+    static const int MAX_RENDER_THREADS = 64;
+    static const int PROGRESSIVE_UPDATE_MS = 100;
+    static const int RENDER_IDLE_MS = 400;
 };
 
 #endif // MAPWIDGET_H
\ No newline at end of file
@@ -0,0 +1,574 @@
+#include "nmeastream.h"
+#include "gpsparser.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const double kKnotsToMetresPerSecond = 1852.0 / 3600.0;
+const qint64 kMsPerDay = Q_INT64_C(86400000);
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+inline bool isEmpty(const char *begin, const char *end)
+{
+    return begin == end;
+}
+
+bool parseInteger(const char *begin, const char *end, int &out)
+{
+    if (begin == end) {
+        return false;
+    }
+    int value = 0;
+    for (const char *p = begin; p < end; ++p) {
+        if (!isDigit(*p) || value > 100000000) {
+            return false;
+        }
+        value = value * 10 + (*p - '0');
+    }
+    out = value;
+    return true;
+}
+
+// hhmmss[.sss] -> ms since UTC midnight
+bool parseTime(const char *begin, const char *end, int &timeOfDayMs)
+{
+    if (end - begin < 6) {
+        return false;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (!isDigit(begin[i])) {
+            return false;
+        }
+    }
+    const int hours = (begin[0] - '0') * 10 + (begin[1] - '0');
+    const int minutes = (begin[2] - '0') * 10 + (begin[3] - '0');
+    double seconds = 0.0;
+    if (hours > 23 || minutes > 59 || !GpsParser::parseNumber(begin + 4, end, seconds)
+        || seconds < 0.0 || seconds >= 61.0) {
+        return false;
+    }
+    timeOfDayMs = (hours * 60 + minutes) * 60000 + int(std::lround(seconds * 1000.0));
+    return true;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+qint64 daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const qint64 era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = int(year - era * 400);
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// ddmmyy -> ms since the epoch at UTC midnight
+bool parseDate(const char *begin, const char *end, qint64 &dateMs)
+{
+    if (end - begin != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; ++i) {
+        if (!isDigit(begin[i])) {
+            return false;
+        }
+    }
+    const int day = (begin[0] - '0') * 10 + (begin[1] - '0');
+    const int month = (begin[2] - '0') * 10 + (begin[3] - '0');
+    const int year = (begin[4] - '0') * 10 + (begin[5] - '0');
+    if (day < 1 || day > 31 || month < 1 || month > 12) {
+        return false;
+    }
+    dateMs = daysFromCivil(year < 80 ? 2000 + year : 1900 + year, month, day) * kMsPerDay;
+    return true;
+}
+
+// [d]ddmm.mmmm plus hemisphere -> signed decimal degrees
+bool parseCoordinate(const char *begin, const char *end, const char *hemisphere,
+                     const char *hemisphereEnd, char negative, char positive, double &out)
+{
+    if (hemisphereEnd - hemisphere != 1 || (*hemisphere != negative && *hemisphere != positive)) {
+        return false;
+    }
+
+    const char *dot = begin;
+    while (dot < end && *dot != '.') {
+        ++dot;
+    }
+    if (dot - begin < 3) {
+        return false;
+    }
+
+    int degrees = 0;
+    double minutes = 0.0;
+    if (!parseInteger(begin, dot - 2, degrees) || !GpsParser::parseNumber(dot - 2, end, minutes)
+        || minutes >= 60.0) {
+        return false;
+    }
+
+    out = degrees + minutes / 60.0;
+    if (*hemisphere == negative) {
+        out = -out;
+    }
+    return true;
+}
+
+} // namespace
+
+NmeaStream::NmeaStream()
+{
+    reset();
+}
+
+void NmeaStream::reset()
+{
+    m_lineLength = 0;
+    m_epoch = GpsFix();
+    m_epochTimeMs = -1;
+    m_epochHasPosition = false;
+    m_epochGsaSatellites = 0;
+    m_lastSentence = NoSentence;
+    m_cycleEnder = NoSentence;
+    m_dateMs = 0;
+    std::memset(m_satellitesInView, 0, sizeof(m_satellitesInView));
+    m_acceptedSentences = 0;
+    m_rejectedSentences = 0;
+}
+
+bool NmeaStream::hasPartialSentence() const
+{
+    return m_lineLength > 0;
+}
+
+quint64 NmeaStream::acceptedSentences() const
+{
+    return m_acceptedSentences;
+}
+
+quint64 NmeaStream::rejectedSentences() const
+{
+    return m_rejectedSentences;
+}
+
+int NmeaStream::feed(const char *data, int size, GpsFix *fixes, int maxFixes)
+{
+    int count = 0;
+
+    for (int i = 0; i < size; ++i) {
+        const char c = data[i];
+        if (c == '$' || c == '!') {
+            if (m_lineLength > 0) {
+                // Previous sentence never got its checksum
+                ++m_rejectedSentences;
+            }
+            m_line[0] = c;
+            m_lineLength = 1;
+        } else if (c == '\r' || c == '\n') {
+            if (m_lineLength > 0) {
+                endSentence(fixes, maxFixes, count);
+            }
+        } else if (m_lineLength > 0) {
+            if (m_lineLength == MAX_SENTENCE_LENGTH) {
+                // The rest of the sentence is dropped as noise until the
+                // next '$' or '!'
+                ++m_rejectedSentences;
+                m_lineLength = 0;
+            } else {
+                m_line[m_lineLength++] = c;
+            }
+        }
+        // Anything else is noise between sentences
+    }
+
+    // Datagram senders often leave out the final CR LF; a sentence that
+    // already ends in its checksum is complete
+    if (m_lineLength >= 4 && m_line[m_lineLength - 3] == '*'
+        && hexValue(m_line[m_lineLength - 2]) >= 0 && hexValue(m_line[m_lineLength - 1]) >= 0) {
+        endSentence(fixes, maxFixes, count);
+    }
+
+    return count;
+}
+
+int NmeaStream::flush(GpsFix *fixes, int maxFixes)
+{
+    int count = 0;
+    if (m_epochHasPosition) {
+        emitEpoch(fixes, maxFixes, count);
+    }
+    return count;
+}
+
+void NmeaStream::endSentence(GpsFix *fixes, int maxFixes, int &count)
+{
+    const SentenceType type = processSentence(m_line, m_line + m_lineLength, fixes, maxFixes, count);
+    m_lineLength = 0;
+
+    if (type == NoSentence) {
+        ++m_rejectedSentences;
+        return;
+    }
+    ++m_acceptedSentences;
+    if (type == OtherSentence) {
+        return;
+    }
+
+    m_lastSentence = type;
+    if (type == m_cycleEnder && m_epochHasPosition) {
+        emitEpoch(fixes, maxFixes, count);
+    }
+}
+
+NmeaStream::SentenceType NmeaStream::processSentence(const char *begin, const char *end,
+                                                     GpsFix *fixes, int maxFixes, int &count)
+{
+    // $<address>,<fields>*hh with hh the XOR of everything between $ and *
+    if (end - begin < 4 || end[-3] != '*') {
+        return NoSentence;
+    }
+    const char *star = end - 3;
+    const int expected = hexValue(star[1]) * 16 + hexValue(star[2]);
+    quint8 checksum = 0;
+    for (const char *p = begin + 1; p < star; ++p) {
+        checksum ^= quint8(*p);
+    }
+    if (hexValue(star[1]) < 0 || hexValue(star[2]) < 0 || checksum != expected) {
+        return NoSentence;
+    }
+
+    // AIS encapsulation and proprietary sentences are valid but not ours
+    if (*begin == '!' || begin[1] == 'P') {
+        return OtherSentence;
+    }
+
+    const char *fields[MAX_FIELDS];
+    const char *fieldEnds[MAX_FIELDS];
+    int fieldCount = 0;
+    const char *fieldStart = begin + 1;
+    for (const char *p = fieldStart; fieldCount < MAX_FIELDS; ++p) {
+        if (p == star || *p == ',') {
+            fields[fieldCount] = fieldStart;
+            fieldEnds[fieldCount] = p;
+            ++fieldCount;
+            if (p == star) {
+                break;
+            }
+            fieldStart = p + 1;
+        }
+    }
+
+    // Address is a two-letter talker and a three-letter formatter
+    if (fieldEnds[0] - fields[0] != 5) {
+        return OtherSentence;
+    }
+    const char *talker = fields[0];
+    const char *formatter = fields[0] + 2;
+
+    SentenceType type = OtherSentence;
+    if (std::memcmp(formatter, "GGA", 3) == 0) {
+        type = GgaSentence;
+    } else if (std::memcmp(formatter, "RMC", 3) == 0) {
+        type = RmcSentence;
+    } else if (std::memcmp(formatter, "VTG", 3) == 0) {
+        type = VtgSentence;
+    } else if (std::memcmp(formatter, "GSA", 3) == 0) {
+        type = GsaSentence;
+    } else if (std::memcmp(formatter, "GSV", 3) == 0) {
+        type = GsvSentence;
+    } else {
+        return OtherSentence;
+    }
+
+    // GGA and RMC carry the epoch time in field 1; a new time closes the
+    // previous epoch and tells us which sentence type ends a cycle
+    if ((type == GgaSentence || type == RmcSentence) && fieldCount > 1 && !isEmpty(fields[1], fieldEnds[1])) {
+        int timeOfDayMs = 0;
+        if (!parseTime(fields[1], fieldEnds[1], timeOfDayMs)) {
+            return NoSentence;
+        }
+        if (m_epochTimeMs < 0) {
+            m_epochTimeMs = timeOfDayMs;
+        } else if (timeOfDayMs != m_epochTimeMs) {
+            m_cycleEnder = m_lastSentence;
+            if (m_epochHasPosition) {
+                emitEpoch(fixes, maxFixes, count);
+            }
+            if (timeOfDayMs < m_epochTimeMs - kMsPerDay / 2 && m_dateMs > 0) {
+                // Past midnight without an RMC to say so
+                m_dateMs += kMsPerDay;
+            }
+            startEpoch(timeOfDayMs);
+        }
+    }
+
+    bool ok = false;
+    switch (type) {
+    case GgaSentence:
+        ok = applyGga(fields, fieldEnds, fieldCount);
+        break;
+    case RmcSentence:
+        ok = applyRmc(fields, fieldEnds, fieldCount);
+        break;
+    case VtgSentence:
+        ok = applyVtg(fields, fieldEnds, fieldCount);
+        break;
+    case GsaSentence:
+        ok = applyGsa(fields, fieldEnds, fieldCount);
+        break;
+    case GsvSentence:
+        ok = applyGsv(talker, fields, fieldEnds, fieldCount);
+        break;
+    case NoSentence:
+    case OtherSentence:
+        break;
+    }
+    return ok ? type : NoSentence;
+}
+
+bool NmeaStream::applyGga(const char *const *fields, const char *const *fieldEnds, int fieldCount)
+{
+    // GGA,time,lat,N/S,lon,E/W,quality,satellites,hdop,altitude,M,...
+    if (fieldCount < 11) {
+        return false;
+    }
+
+    // Quality 0 (or empty) is a valid "no fix" report
+    if (isEmpty(fields[6], fieldEnds[6]) || *fields[6] == '0') {
+        return true;
+    }
+
+    double latitude = 0.0;
+    double longitude = 0.0;
+    if (!parseCoordinate(fields[2], fieldEnds[2], fields[3], fieldEnds[3], 'S', 'N', latitude)
+        || !parseCoordinate(fields[4], fieldEnds[4], fields[5], fieldEnds[5], 'W', 'E', longitude)
+        || latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0) {
+        return false;
+    }
+
+    int satellites = 0;
+    double hdop = 0.0;
+    double altitude = 0.0;
+    if ((!isEmpty(fields[7], fieldEnds[7]) && !parseInteger(fields[7], fieldEnds[7], satellites))
+        || (!isEmpty(fields[8], fieldEnds[8]) && !GpsParser::parseNumber(fields[8], fieldEnds[8], hdop))
+        || (!isEmpty(fields[9], fieldEnds[9]) && !GpsParser::parseNumber(fields[9], fieldEnds[9], altitude))) {
+        return false;
+    }
+
+    m_epoch.latitude = latitude;
+    m_epoch.longitude = longitude;
+    m_epoch.altitude = altitude;
+    m_epoch.satellitesUsed = quint8(qMin(satellites, 255));
+    if (hdop > 0.0) {
+        m_epoch.hdop = float(hdop);
+    }
+    m_epochHasPosition = true;
+    return true;
+}
+
+bool NmeaStream::applyRmc(const char *const *fields, const char *const *fieldEnds, int fieldCount)
+{
+    // RMC,time,status,lat,N/S,lon,E/W,speed(kn),course,date,magvar,E/W[,mode]
+    if (fieldCount < 10) {
+        return false;
+    }
+
+    qint64 dateMs = 0;
+    if (!isEmpty(fields[9], fieldEnds[9])) {
+        if (!parseDate(fields[9], fieldEnds[9], dateMs)) {
+            return false;
+        }
+        m_dateMs = dateMs;
+    }
+
+    const bool noFixMode = fieldCount > 12 && fieldEnds[12] - fields[12] == 1 && *fields[12] == 'N';
+    if (fieldEnds[2] - fields[2] != 1 || *fields[2] != 'A' || noFixMode) {
+        return true;
+    }
+
+    double latitude = 0.0;
+    double longitude = 0.0;
+    if (!parseCoordinate(fields[3], fieldEnds[3], fields[4], fieldEnds[4], 'S', 'N', latitude)
+        || !parseCoordinate(fields[5], fieldEnds[5], fields[6], fieldEnds[6], 'W', 'E', longitude)
+        || latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0) {
+        return false;
+    }
+
+    double knots = 0.0;
+    double course = 0.0;
+    if (!isEmpty(fields[7], fieldEnds[7])) {
+        if (!GpsParser::parseNumber(fields[7], fieldEnds[7], knots)) {
+            return false;
+        }
+        m_epoch.speed = float(knots * kKnotsToMetresPerSecond);
+        m_epoch.optionalFields |= GpsFix::HasSpeed;
+    }
+    if (!isEmpty(fields[8], fieldEnds[8])) {
+        if (!GpsParser::parseNumber(fields[8], fieldEnds[8], course)) {
+            return false;
+        }
+        m_epoch.heading = float(course);
+        m_epoch.optionalFields |= GpsFix::HasHeading;
+    }
+
+    // GGA has altitude and is preferred when both report a position
+    if (!m_epochHasPosition) {
+        m_epoch.latitude = latitude;
+        m_epoch.longitude = longitude;
+        m_epochHasPosition = true;
+    }
+    return true;
+}
+
+bool NmeaStream::applyVtg(const char *const *fields, const char *const *fieldEnds, int fieldCount)
+{
+    // VTG,course,T,course,M,speed,N,speed,K[,mode]; pre-2.3 receivers send
+    // VTG,course,course,speed(kn),speed(km/h) without the unit letters
+    const bool unitLetters = fieldCount >= 9 && fieldEnds[2] - fields[2] == 1 && *fields[2] == 'T';
+    if (!unitLetters && fieldCount < 5) {
+        return false;
+    }
+    if (unitLetters && fieldCount > 9 && fieldEnds[9] - fields[9] == 1 && *fields[9] == 'N') {
+        return true;
+    }
+
+    const int knotsField = unitLetters ? 5 : 3;
+    const int kmhField = unitLetters ? 7 : 4;
+
+    double value = 0.0;
+    if (!isEmpty(fields[1], fieldEnds[1])) {
+        if (!GpsParser::parseNumber(fields[1], fieldEnds[1], value)) {
+            return false;
+        }
+        m_epoch.heading = float(value);
+        m_epoch.optionalFields |= GpsFix::HasHeading;
+    }
+    if (!isEmpty(fields[knotsField], fieldEnds[knotsField])) {
+        if (!GpsParser::parseNumber(fields[knotsField], fieldEnds[knotsField], value)) {
+            return false;
+        }
+        m_epoch.speed = float(value * kKnotsToMetresPerSecond);
+        m_epoch.optionalFields |= GpsFix::HasSpeed;
+    } else if (!isEmpty(fields[kmhField], fieldEnds[kmhField])) {
+        if (!GpsParser::parseNumber(fields[kmhField], fieldEnds[kmhField], value)) {
+            return false;
+        }
+        m_epoch.speed = float(value / 3.6);
+        m_epoch.optionalFields |= GpsFix::HasSpeed;
+    }
+    return true;
+}
+
+bool NmeaStream::applyGsa(const char *const *fields, const char *const *fieldEnds, int fieldCount)
+{
+    // GSA,mode,fixType,sv1..sv12,PDOP,HDOP,VDOP[,systemId]; multi-GNSS
+    // receivers send one per constellation under the GN talker
+    if (fieldCount < 18) {
+        return false;
+    }
+    if (fieldEnds[2] - fields[2] != 1 || *fields[2] < '2') {
+        return true;
+    }
+
+    int used = 0;
+    for (int i = 3; i <= 14; ++i) {
+        if (!isEmpty(fields[i], fieldEnds[i])) {
+            ++used;
+        }
+    }
+    m_epochGsaSatellites += used;
+
+    double hdop = 0.0;
+    if (!isEmpty(fields[16], fieldEnds[16])) {
+        if (!GpsParser::parseNumber(fields[16], fieldEnds[16], hdop)) {
+            return false;
+        }
+        if (m_epoch.hdop <= 0.0f && hdop > 0.0) {
+            m_epoch.hdop = float(hdop);
+        }
+    }
+    return true;
+}
+
+bool NmeaStream::applyGsv(const char *talker, const char *const *fields, const char *const *fieldEnds,
+                          int fieldCount)
+{
+    // GSV,messages,message,satellitesInView,{prn,elevation,azimuth,snr}...
+    if (fieldCount < 4) {
+        return false;
+    }
+
+    int inView = 0;
+    if (!parseInteger(fields[3], fieldEnds[3], inView)) {
+        return false;
+    }
+
+    Constellation constellation = ConstellationCount;
+    if (talker[0] == 'G' && talker[1] == 'P') {
+        constellation = Gps;
+    } else if (talker[0] == 'G' && talker[1] == 'L') {
+        constellation = Glonass;
+    } else if (talker[0] == 'G' && talker[1] == 'A') {
+        constellation = Galileo;
+    } else if ((talker[0] == 'G' && talker[1] == 'B') || (talker[0] == 'B' && talker[1] == 'D')) {
+        constellation = BeiDou;
+    } else if ((talker[0] == 'G' && talker[1] == 'Q') || (talker[0] == 'Q' && talker[1] == 'Z')) {
+        constellation = Qzss;
+    } else if (talker[0] == 'G' && talker[1] == 'I') {
+        constellation = NavIc;
+    }
+
+    if (constellation != ConstellationCount) {
+        m_satellitesInView[constellation] = quint8(qMin(inView, 255));
+    }
+    return true;
+}
+
+void NmeaStream::startEpoch(int timeOfDayMs)
+{
+    m_epoch = GpsFix();
+    m_epochTimeMs = timeOfDayMs;
+    m_epochHasPosition = false;
+    m_epochGsaSatellites = 0;
+}
+
+void NmeaStream::emitEpoch(GpsFix *fixes, int maxFixes, int &count)
+{
+    if (count < maxFixes) {
+        GpsFix &fix = fixes[count++];
+        fix = m_epoch;
+        if (fix.satellitesUsed == 0) {
+            fix.satellitesUsed = quint8(qMin(m_epochGsaSatellites, 255));
+        }
+        int inView = 0;
+        for (int i = 0; i < ConstellationCount; ++i) {
+            inView += m_satellitesInView[i];
+        }
+        fix.satellitesInView = quint8(qMin(inView, 255));
+        if (m_dateMs > 0 && m_epochTimeMs >= 0) {
+            fix.sourceTimestampMs = m_dateMs + m_epochTimeMs;
+        }
+    }
+
+    // Later sentences of the same epoch start from a clean slate
+    startEpoch(m_epochTimeMs);
+}
@@ -0,0 +1,94 @@
+#ifndef NMEASTREAM_H
+#define NMEASTREAM_H
+
+#include <QtGlobal>
+
+#include "gpsfix.h"
+
+// Streaming NMEA 0183 decoder for one source.
+//
+// Bytes are fed as they arrive; sentences may be split across feeds and
+// several may share one. Each sentence must carry a valid "*hh" checksum.
+// GGA, RMC, VTG, GSA and GSV from any talker (GP, GL, GA, GB/BD, GQ, GN...)
+// are merged into one GpsFix per epoch, keyed by the UTC time in GGA/RMC.
+//
+// An epoch is emitted when the sentence type that closed the previous
+// epoch arrives again (learned from the stream, as receivers repeat a
+// fixed sentence order), or when a sentence with a new time starts the
+// next epoch. Everything works on the caller's bytes and a fixed line
+// buffer; nothing is allocated per sentence or field.
+class NmeaStream
+{
+public:
+    NmeaStream();
+
+    // Decodes as much of data as possible and writes completed epochs to
+    // fixes; returns how many were written. Epochs beyond maxFixes are lost.
+    int feed(const char *data, int size, GpsFix *fixes, int maxFixes);
+
+    // Emits the epoch in progress, if it has a position
+    int flush(GpsFix *fixes, int maxFixes);
+
+    void reset();
+
+    // True while a sentence is buffered waiting for the rest of its bytes
+    bool hasPartialSentence() const;
+
+    quint64 acceptedSentences() const;
+    quint64 rejectedSentences() const;
+
+    static const int MAX_SENTENCE_LENGTH = 128; // NMEA allows 82; leave room for vendors
+    static const int MAX_FIELDS = 24;
+
+private:
+    enum SentenceType {
+        NoSentence,
+        GgaSentence,
+        RmcSentence,
+        VtgSentence,
+        GsaSentence,
+        GsvSentence,
+        OtherSentence
+    };
+
+    enum Constellation {
+        Gps,
+        Glonass,
+        Galileo,
+        BeiDou,
+        Qzss,
+        NavIc,
+        ConstellationCount
+    };
+
+    void endSentence(GpsFix *fixes, int maxFixes, int &count);
+    SentenceType processSentence(const char *begin, const char *end, GpsFix *fixes, int maxFixes, int &count);
+    bool applyGga(const char *const *fields, const char *const *fieldEnds, int fieldCount);
+    bool applyRmc(const char *const *fields, const char *const *fieldEnds, int fieldCount);
+    bool applyVtg(const char *const *fields, const char *const *fieldEnds, int fieldCount);
+    bool applyGsa(const char *const *fields, const char *const *fieldEnds, int fieldCount);
+    bool applyGsv(const char *talker, const char *const *fields, const char *const *fieldEnds, int fieldCount);
+    void startEpoch(int timeOfDayMs);
+    void emitEpoch(GpsFix *fixes, int maxFixes, int &count);
+
+    // Line assembly
+    char m_line[MAX_SENTENCE_LENGTH];
+    int m_lineLength;
+
+    // Epoch being merged
+    GpsFix m_epoch;
+    int m_epochTimeMs;     // UTC ms of day, -1 before the first timed sentence
+    bool m_epochHasPosition;
+    int m_epochGsaSatellites;
+    SentenceType m_lastSentence;
+    SentenceType m_cycleEnder; // Last sentence type of an epoch, once learned
+
+    // Carried across epochs
+    qint64 m_dateMs; // UTC midnight from the latest RMC, 0 before one
+    quint8 m_satellitesInView[ConstellationCount];
+
+    quint64 m_acceptedSentences;
+    quint64 m_rejectedSentences;
+};
+
+#endif // NMEASTREAM_H
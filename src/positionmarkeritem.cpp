@@ -0,0 +1,80 @@
+#include "positionmarkeritem.h"
+#include "latencymonitor.h"
+#include "rendertierstats.h"
+#include "startupprofiler.h"
+
+#include <QPainter>
+
+#include <qgsmapcanvas.h>
+
+PositionMarkerItem::PositionMarkerItem(QgsMapCanvas *mapCanvas)
+    : QgsMapCanvasItem(mapCanvas)
+    , m_color(255, 0, 0) // Red
+    , m_diameter(12)
+    , m_traceReceiveNs(0)
+{
+    // Draw above trail overlays
+    setZValue(100);
+}
+
+void PositionMarkerItem::setMapPosition(const QgsPointXY &mapPoint)
+{
+    m_mapPosition = mapPoint;
+
+    // setPos() invalidates just the old and new bounding rectangles
+    setPos(toCanvasCoordinates(m_mapPosition));
+}
+
+QgsPointXY PositionMarkerItem::mapPosition() const
+{
+    return m_mapPosition;
+}
+
+void PositionMarkerItem::setColor(const QColor &color)
+{
+    m_color = color;
+    update();
+}
+
+void PositionMarkerItem::setDiameter(int pixels)
+{
+    prepareGeometryChange();
+    m_diameter = pixels;
+}
+
+void PositionMarkerItem::traceNextPaint(qint64 receiveNs)
+{
+    m_traceReceiveNs = receiveNs;
+}
+
+void PositionMarkerItem::paint(QPainter *painter)
+{
+    if (!painter) {
+        return;
+    }
+
+    if (m_traceReceiveNs != 0) {
+        LatencyMonitor::instance().record(LatencyMonitor::Painted, m_traceReceiveNs, LatencyMonitor::now());
+        StartupProfiler::instance().mark(StartupProfiler::FirstFixPainted);
+        m_traceReceiveNs = 0;
+    }
+
+    RenderTierStats::ScopedRender render(RenderTierStats::Live);
+    const qreal radius = m_diameter / 2.0;
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    painter->setPen(QPen(Qt::white, OUTLINE_WIDTH));
+    painter->setBrush(m_color);
+    painter->drawEllipse(QPointF(0, 0), radius, radius);
+}
+
+QRectF PositionMarkerItem::boundingRect() const
+{
+    const qreal extent = m_diameter / 2.0 + OUTLINE_WIDTH;
+    return QRectF(-extent, -extent, 2 * extent, 2 * extent);
+}
+
+void PositionMarkerItem::updatePosition()
+{
+    // Called by the canvas after pan/zoom
+    setMapPosition(m_mapPosition);
+}
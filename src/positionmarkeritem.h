@@ -0,0 +1,42 @@
+#ifndef POSITIONMARKERITEM_H
+#define POSITIONMARKERITEM_H
+
+#include <QColor>
+
+#include <qgsmapcanvasitem.h>
+#include <qgspointxy.h>
+
+// Live position marker drawn as a canvas overlay.
+//
+// Moving the marker only repositions this graphics item, so the scene
+// repaints the marker's old and new few-pixel rectangles; no map layer is
+// touched and no map render job is started.
+class PositionMarkerItem : public QgsMapCanvasItem
+{
+public:
+    explicit PositionMarkerItem(QgsMapCanvas *mapCanvas);
+
+    // Position in map (canvas destination) CRS coordinates
+    void setMapPosition(const QgsPointXY &mapPoint);
+    QgsPointXY mapPosition() const;
+
+    void setColor(const QColor &color);
+    void setDiameter(int pixels);
+
+    // The next paint records LatencyMonitor::Painted for a fix received
+    // at receiveNs
+    void traceNextPaint(qint64 receiveNs);
+
+    void paint(QPainter *painter) override;
+    QRectF boundingRect() const override;
+    void updatePosition() override;
+
+private:
+    QgsPointXY m_mapPosition;
+    QColor m_color;
+    int m_diameter;
+    qint64 m_traceReceiveNs;
+    static const int OUTLINE_WIDTH = 2;
+};
+
+#endif // POSITIONMARKERITEM_H
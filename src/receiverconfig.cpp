@@ -0,0 +1,115 @@
+#include "receiverconfig.h"
+
+#include <QStringList>
+
+namespace {
+
+struct FormatName
+{
+    GpsParser::Format format;
+    const char *name;
+};
+
+const FormatName FORMAT_NAMES[] = {
+    { GpsParser::JsonFormat, "json" },
+    { GpsParser::CsvFormat, "csv" },
+    { GpsParser::NmeaFormat, "nmea" },
+    { GpsParser::BinaryFormat, "binary" },
+};
+
+} // namespace
+
+bool ReceiverEndpoint::parse(const QString &text, ReceiverEndpoint &endpoint)
+{
+    ReceiverEndpoint result;
+    QString rest = text.trimmed();
+
+    const int slash = rest.indexOf('/');
+    if (slash >= 0) {
+        const QString name = rest.mid(slash + 1).trimmed().toLower();
+        rest = rest.left(slash);
+        result.formatHint = GpsParser::UnknownFormat;
+        for (const FormatName &candidate : FORMAT_NAMES) {
+            if (name == QLatin1String(candidate.name)) {
+                result.formatHint = candidate.format;
+            }
+        }
+        if (result.formatHint == GpsParser::UnknownFormat) {
+            return false;
+        }
+    }
+
+    const int at = rest.indexOf('@');
+    if (at >= 0) {
+        if (!result.group.setAddress(rest.mid(at + 1).trimmed()) || !result.group.isMulticast()) {
+            return false;
+        }
+        rest = rest.left(at);
+    }
+
+    bool ok = false;
+    const uint port = rest.trimmed().toUInt(&ok);
+    if (!ok || port == 0 || port > 65535) {
+        return false;
+    }
+    result.port = quint16(port);
+
+    endpoint = result;
+    return true;
+}
+
+QString ReceiverEndpoint::toString() const
+{
+    QString text = QString::number(port);
+    if (!group.isNull()) {
+        text += '@' + group.toString();
+    }
+    for (const FormatName &candidate : FORMAT_NAMES) {
+        if (candidate.format == formatHint) {
+            text += '/';
+            text += QLatin1String(candidate.name);
+        }
+    }
+    return text;
+}
+
+bool ReceiverConfig::parseEndpoints(const QString &text, QVector<ReceiverEndpoint> &endpoints, QString &error)
+{
+    QVector<ReceiverEndpoint> result = endpoints;
+    const QStringList entries = text.split(',', Qt::SkipEmptyParts);
+    for (const QString &entry : entries) {
+        if (entry.trimmed().isEmpty()) {
+            continue;
+        }
+        ReceiverEndpoint endpoint;
+        if (!ReceiverEndpoint::parse(entry, endpoint)) {
+            error = QString("Invalid listener \"%1\"; expected port[@multicast group][/json|csv|nmea|binary]")
+                        .arg(entry.trimmed());
+            return false;
+        }
+        for (const ReceiverEndpoint &other : qAsConst(result)) {
+            if (other.port == endpoint.port && other.group == endpoint.group) {
+                error = QString("Listener \"%1\" is already listened on as %2; a port takes one unicast "
+                                "listener and one per multicast group")
+                            .arg(entry.trimmed(), other.toString());
+                return false;
+            }
+        }
+        result.append(endpoint);
+    }
+
+    endpoints = result;
+    return true;
+}
+
+QString ReceiverConfig::endpointsString() const
+{
+    QStringList parts;
+    for (const ReceiverEndpoint &endpoint : endpoints) {
+        parts.append(endpoint.toString());
+    }
+    if (!busInput.isEmpty()) {
+        parts.append(QString("fix bus %1").arg(busInput));
+    }
+    return parts.join(", ");
+}
@@ -0,0 +1,74 @@
+#ifndef RECEIVERCONFIG_H
+#define RECEIVERCONFIG_H
+
+#include <QHostAddress>
+#include <QString>
+#include <QVector>
+
+#include "gpsparser.h"
+
+// One UDP socket the receiver listens on
+struct ReceiverEndpoint
+{
+    quint16 port = 0;
+
+    // Multicast group joined on the default interface; null for unicast
+    QHostAddress group;
+
+    // Format every datagram on this socket is expected in. UnknownFormat
+    // detects it per datagram; NmeaFormat sends everything through the
+    // sender's NMEA stream, so sentences split at any byte still join up;
+    // any other hint rejects datagrams in a different format.
+    GpsParser::Format formatHint = GpsParser::UnknownFormat;
+
+    // "port[@group][/format]" with format json, csv, nmea or binary, e.g.
+    // "10110/nmea" or "5000@239.192.0.1/binary"
+    static bool parse(const QString &text, ReceiverEndpoint &endpoint);
+    QString toString() const;
+};
+
+// What UdpReceiver listens on and how
+struct ReceiverConfig
+{
+    QVector<ReceiverEndpoint> endpoints;
+
+    // SO_RCVBUF requested for every socket, in bytes; 0 keeps the system
+    // default. Linux caps requests at net.core.rmem_max unless the process
+    // has CAP_NET_ADMIN.
+    int receiveBufferBytes = 0;
+
+    // Receiver threads. Above 1, every thread opens each unicast endpoint
+    // with SO_REUSEPORT and the kernel spreads senders across them by
+    // address; multicast endpoints stay on the first thread, since every
+    // socket in the group would get its own copy of each datagram.
+    int threads = 1;
+
+    // Shared-memory fix bus (FixBusWriter) read by the first receiver
+    // thread alongside its sockets; empty for none. The bus may appear,
+    // vanish and reappear while the receiver runs.
+    QString busInput;
+
+    // Bus every parsed fix is published to, for local consumers; empty for
+    // none. busCapacity is its size in records, 0 for the default.
+    QString busOutput;
+    int busCapacity = 0;
+
+    // Directory received fixes are archived to; empty for
+    // TrackArchive::defaultDirectory()
+    QString archiveDirectory;
+
+    // Size the archive is kept under by deleting its oldest segments; 0
+    // for no limit, negative for TrackArchive::defaultMaxBytes()
+    qint64 archiveMaxBytes = -1;
+
+    // Appends a comma-separated ReceiverEndpoint::parse() list to endpoints,
+    // which may already hold the primary port. A port takes one unicast
+    // endpoint plus one per multicast group; a second one would split or
+    // duplicate its datagrams, so it is rejected like an entry that did not
+    // parse, and error names the first such entry.
+    static bool parseEndpoints(const QString &text, QVector<ReceiverEndpoint> &endpoints, QString &error);
+    // Endpoints and the input bus, for log messages
+    QString endpointsString() const;
+};
+
+#endif // RECEIVERCONFIG_H
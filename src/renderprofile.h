@@ -0,0 +1,27 @@
+#ifndef RENDERPROFILE_H
+#define RENDERPROFILE_H
+
+// How MapWidget renders the map canvas
+struct RenderProfile
+{
+    // Threads QGIS renders layers on; 0 uses every core
+    int threads = 0;
+
+    // Every layer renders as its own job on the thread pool; otherwise the
+    // layers render in turn on one thread
+    bool parallel = true;
+
+    // Partial images are shown while a render runs, and the area around
+    // the view is rendered ahead so a pan shows the map before the new
+    // render finishes
+    bool progressive = true;
+
+    // A canvas render slower than frameBudgetMs switches the map to draft
+    // quality: no antialiasing, fast raster resampling, coarser trail
+    // simplification and plain point markers. Full quality comes back in
+    // one more render once the view has been still for a moment.
+    bool adaptive = false;
+    int frameBudgetMs = 50;
+};
+
+#endif // RENDERPROFILE_H
@@ -0,0 +1,94 @@
+#include "rendertierstats.h"
+
+#include <QStringList>
+
+RenderTierStats::ScopedRender::ScopedRender(Tier tier)
+    : m_tier(tier)
+    , m_startNs(LatencyMonitor::now())
+{
+}
+
+RenderTierStats::ScopedRender::~ScopedRender()
+{
+    RenderTierStats::instance().recordRender(m_tier, LatencyMonitor::now() - m_startNs);
+}
+
+RenderTierStats::RenderTierStats()
+{
+    reset();
+}
+
+RenderTierStats &RenderTierStats::instance()
+{
+    static RenderTierStats stats;
+    return stats;
+}
+
+void RenderTierStats::recordHit(Tier tier)
+{
+    m_tiers[tier].hits.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RenderTierStats::recordRender(Tier tier, qint64 renderNs)
+{
+    m_tiers[tier].renderTime.record(renderNs / 1000);
+}
+
+quint64 RenderTierStats::hits(Tier tier) const
+{
+    return m_tiers[tier].hits.load(std::memory_order_relaxed);
+}
+
+quint64 RenderTierStats::renders(Tier tier) const
+{
+    return m_tiers[tier].renderTime.count();
+}
+
+double RenderTierStats::hitRate(Tier tier) const
+{
+    const quint64 hitCount = hits(tier);
+    const quint64 total = hitCount + renders(tier);
+    return total == 0 ? -1.0 : 100.0 * hitCount / total;
+}
+
+const LatencyHistogram &RenderTierStats::renderTime(Tier tier) const
+{
+    return m_tiers[tier].renderTime;
+}
+
+void RenderTierStats::reset()
+{
+    for (Slot &slot : m_tiers) {
+        slot.hits.store(0, std::memory_order_relaxed);
+        slot.renderTime.reset();
+    }
+}
+
+QString RenderTierStats::summary() const
+{
+    QStringList parts;
+    for (int tier = 0; tier < TierCount; ++tier) {
+        const LatencyHistogram &histogram = renderTime(Tier(tier));
+        parts << QString("%1 %2 hits/%3 renders p50 %4 ms max %5 ms")
+                 .arg(tierName(Tier(tier)))
+                 .arg(hits(Tier(tier)))
+                 .arg(histogram.count())
+                 .arg(histogram.valueAtPercentile(50.0) / 1000.0, 0, 'f', 2)
+                 .arg(histogram.max() / 1000.0, 0, 'f', 2);
+    }
+    return parts.join(", ");
+}
+
+const char *RenderTierStats::tierName(Tier tier)
+{
+    switch (tier) {
+    case BaseMap:
+        return "basemap";
+    case History:
+        return "history";
+    case Live:
+        return "live";
+    default:
+        return "?";
+    }
+}
@@ -0,0 +1,99 @@
+#include "spatialgrid.h"
+
+#include <cmath>
+
+SpatialGrid::SpatialGrid(double cellSize)
+    : m_cellSize(cellSize)
+{
+}
+
+void SpatialGrid::insert(int id, double x, double y)
+{
+    m_cells[cellKey(cellIndex(x), cellIndex(y))].append(id);
+}
+
+void SpatialGrid::remove(int id, double x, double y)
+{
+    auto cell = m_cells.find(cellKey(cellIndex(x), cellIndex(y)));
+    if (cell == m_cells.end()) {
+        return;
+    }
+
+    // Order within a cell does not matter: swap with the last entry
+    QVector<int> &ids = *cell;
+    const int position = ids.indexOf(id);
+    if (position >= 0) {
+        ids[position] = ids.last();
+        ids.removeLast();
+    }
+    if (ids.isEmpty()) {
+        m_cells.erase(cell);
+    }
+}
+
+void SpatialGrid::move(int id, double oldX, double oldY, double x, double y)
+{
+    const qint32 oldColumn = cellIndex(oldX);
+    const qint32 oldRow = cellIndex(oldY);
+    const qint32 column = cellIndex(x);
+    const qint32 row = cellIndex(y);
+    if (oldColumn == column && oldRow == row) {
+        return;
+    }
+    remove(id, oldX, oldY);
+    m_cells[cellKey(column, row)].append(id);
+}
+
+void SpatialGrid::clear()
+{
+    m_cells.clear();
+}
+
+int SpatialGrid::occupiedCells() const
+{
+    return m_cells.size();
+}
+
+void SpatialGrid::query(double minX, double minY, double maxX, double maxY, QVector<int> &ids) const
+{
+    if (m_cells.isEmpty()) {
+        return;
+    }
+
+    const qint32 firstColumn = cellIndex(minX);
+    const qint32 lastColumn = cellIndex(maxX);
+    const qint32 firstRow = cellIndex(minY);
+    const qint32 lastRow = cellIndex(maxY);
+
+    const double coveredCells = (double(lastColumn) - firstColumn + 1) * (double(lastRow) - firstRow + 1);
+    if (coveredCells <= m_cells.size()) {
+        for (qint32 column = firstColumn; column <= lastColumn; ++column) {
+            for (qint32 row = firstRow; row <= lastRow; ++row) {
+                auto cell = m_cells.constFind(cellKey(column, row));
+                if (cell != m_cells.constEnd()) {
+                    ids += *cell;
+                }
+            }
+        }
+        return;
+    }
+
+    // Zoomed out: fewer occupied cells than covered ones
+    for (auto cell = m_cells.constBegin(); cell != m_cells.constEnd(); ++cell) {
+        const qint32 column = qint32(quint32(cell.key() >> 32));
+        const qint32 row = qint32(quint32(cell.key()));
+        if (column >= firstColumn && column <= lastColumn && row >= firstRow && row <= lastRow) {
+            ids += cell.value();
+        }
+    }
+}
+
+qint32 SpatialGrid::cellIndex(double value) const
+{
+    return qint32(std::floor(value / m_cellSize));
+}
+
+quint64 SpatialGrid::cellKey(qint32 column, qint32 row)
+{
+    return (quint64(quint32(column)) << 32) | quint32(row);
+}
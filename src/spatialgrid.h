@@ -0,0 +1,39 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QHash>
+#include <QVector>
+
+// Uniform hash grid over map coordinates, indexing integer IDs by point.
+//
+// Only occupied cells are stored, so the grid costs memory per entry, not
+// per unit of area. A query walks whichever is smaller: the cells covered
+// by the rectangle or the occupied cells, which keeps world-scale views as
+// cheap as street-scale ones.
+class SpatialGrid
+{
+public:
+    explicit SpatialGrid(double cellSize);
+
+    void insert(int id, double x, double y);
+    void remove(int id, double x, double y);
+
+    // Cheap when the point stays in its cell, which is the common case
+    void move(int id, double oldX, double oldY, double x, double y);
+
+    void clear();
+    int occupiedCells() const;
+
+    // Appends the IDs in every cell touching the rectangle; callers still
+    // test exact positions
+    void query(double minX, double minY, double maxX, double maxY, QVector<int> &ids) const;
+
+private:
+    qint32 cellIndex(double value) const;
+    static quint64 cellKey(qint32 column, qint32 row);
+
+    double m_cellSize;
+    QHash<quint64, QVector<int>> m_cells;
+};
+
+#endif // SPATIALGRID_H
@@ -0,0 +1,73 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <vector>
+
+// Bounded lock-free single-producer/single-consumer queue.
+//
+// One thread may call tryPush() and one (other) thread may call tryPop().
+// The capacity is rounded up to a power of two; pushing into a full queue
+// fails instead of blocking so the producer can account for the drop.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(int capacity)
+    {
+        quint32 size = 2;
+        while (size < quint32(qMax(capacity, 2))) {
+            size <<= 1;
+        }
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    int capacity() const
+    {
+        return int(m_mask + 1);
+    }
+
+    bool tryPush(const T &value)
+    {
+        const quint32 head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) > m_mask) {
+            return false;
+        }
+        m_buffer[head & m_mask] = value;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &value)
+    {
+        const quint32 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = m_buffer[tail & m_mask];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently with push/pop
+    int size() const
+    {
+        return int(m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire));
+    }
+
+private:
+    std::vector<T> m_buffer;
+    quint32 m_mask = 0;
+
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<quint32> m_head{0};
+    alignas(64) std::atomic<quint32> m_tail{0};
+};
+
+#endif // SPSCQUEUE_H
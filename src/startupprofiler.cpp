@@ -0,0 +1,93 @@
+#include "startupprofiler.h"
+#include "latencymonitor.h"
+#include "logger.h"
+
+#include <QStringList>
+
+StartupProfiler::StartupProfiler()
+    : m_startNs(LatencyMonitor::now())
+{
+    for (std::atomic<qint64> &phase : m_phaseNs) {
+        phase.store(0, std::memory_order_relaxed);
+    }
+}
+
+StartupProfiler &StartupProfiler::instance()
+{
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+void StartupProfiler::start()
+{
+    m_startNs.store(LatencyMonitor::now(), std::memory_order_relaxed);
+    for (std::atomic<qint64> &phase : m_phaseNs) {
+        phase.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool StartupProfiler::mark(Phase phase)
+{
+    if (m_phaseNs[phase].load(std::memory_order_relaxed) != 0) {
+        return false;
+    }
+
+    qint64 expected = 0;
+    if (!m_phaseNs[phase].compare_exchange_strong(expected, LatencyMonitor::now(), std::memory_order_relaxed)) {
+        return false;
+    }
+
+    if (phase == FirstFixPainted) {
+        GPS_LOG_INFO(Logger::App, "Startup: {}", report());
+    } else {
+        GPS_LOG_DEBUG(Logger::App, "Startup phase {} at {} ms", phaseName(phase), elapsedMs(phase));
+    }
+    return true;
+}
+
+bool StartupProfiler::isMarked(Phase phase) const
+{
+    return m_phaseNs[phase].load(std::memory_order_relaxed) != 0;
+}
+
+double StartupProfiler::elapsedMs(Phase phase) const
+{
+    const qint64 phaseNs = m_phaseNs[phase].load(std::memory_order_relaxed);
+    if (phaseNs == 0) {
+        return -1.0;
+    }
+    return (phaseNs - m_startNs.load(std::memory_order_relaxed)) / 1e6;
+}
+
+QString StartupProfiler::report() const
+{
+    QStringList parts;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        const double ms = elapsedMs(Phase(phase));
+        parts << QString("%1 %2").arg(phaseName(Phase(phase)))
+                                 .arg(ms < 0.0 ? QString("-") : QString("%1 ms").arg(ms, 0, 'f', 0));
+    }
+    return parts.join(", ");
+}
+
+const char *StartupProfiler::phaseName(Phase phase)
+{
+    switch (phase) {
+    case ApplicationCreated:
+        return "application";
+    case QgisInitialized:
+        return "QGIS";
+    case WindowShown:
+        return "window";
+    case Listening:
+        return "listening";
+    case BaseMapReady:
+        return "basemap";
+    case FirstFixReceived:
+        return "first fix received";
+    case FirstFixPainted:
+        return "first fix painted";
+    default:
+        return "?";
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+// Milestones of one application start, from main() to the first fix
+// painted on the map.
+//
+// Each phase is stamped once, the first time it is reached, in
+// milliseconds since start(); later marks are a single atomic load, so
+// hot paths may mark unconditionally. Phases may be marked from any
+// thread. The report is logged when FirstFixPainted is reached.
+class StartupProfiler
+{
+public:
+    enum Phase {
+        ApplicationCreated, // QgsApplication constructed
+        QgisInitialized,    // initQgis() returned
+        WindowShown,        // Main window shown, before any basemap work
+        Listening,          // UDP receiver bound
+        BaseMapReady,       // Tile cache started and basemap layer created
+        FirstFixReceived,   // First fix delivered to the GUI thread
+        FirstFixPainted,    // First fix drawn by the position marker
+        PhaseCount
+    };
+
+    static StartupProfiler &instance();
+
+    // Call first thing in main(); phases are measured from here
+    void start();
+
+    // Stamps phase unless it already is; true when this call stamped it
+    bool mark(Phase phase);
+
+    bool isMarked(Phase phase) const;
+
+    // Milliseconds from start() to phase, or -1 when not reached yet
+    double elapsedMs(Phase phase) const;
+
+    // "QGIS 312 ms, window 420 ms, ..." with "-" for phases not reached
+    QString report() const;
+
+    static const char *phaseName(Phase phase);
+
+private:
+    StartupProfiler();
+
+    std::atomic<qint64> m_startNs;
+    std::atomic<qint64> m_phaseNs[PhaseCount]; // 0 until reached
+};
+
+#endif // STARTUPPROFILER_H
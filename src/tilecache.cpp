@@ -0,0 +1,186 @@
+#include "tilecache.h"
+#include "logger.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QVector>
+
+#include <algorithm>
+
+TileCache::TileCache(const QString &rootPath, qint64 maxBytes)
+    : m_rootPath(QDir::cleanPath(rootPath))
+    , m_maxBytes(maxBytes)
+    , m_totalBytes(0)
+    , m_evictions(0)
+{
+}
+
+bool TileCache::open()
+{
+    m_lru.clear();
+    m_entries.clear();
+    m_totalBytes = 0;
+
+    if (!QDir().mkpath(m_rootPath)) {
+        GPS_LOG_ERROR(Logger::Network, "Cannot create tile cache directory {}", m_rootPath);
+        return false;
+    }
+
+    struct ScannedTile
+    {
+        QString key;
+        qint64 size;
+        qint64 lastUsedMs;
+    };
+
+    QVector<ScannedTile> tiles;
+    const QDir root(m_rootPath);
+    QDirIterator it(m_rootPath, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        tiles.append({ root.relativeFilePath(info.filePath()), info.size(),
+                       info.lastModified().toMSecsSinceEpoch() });
+    }
+
+    // Oldest first, so pushing to the front leaves the newest at the head
+    std::sort(tiles.begin(), tiles.end(), [](const ScannedTile &a, const ScannedTile &b) {
+        return a.lastUsedMs < b.lastUsedMs;
+    });
+    for (const ScannedTile &tile : qAsConst(tiles)) {
+        m_lru.push_front(tile.key);
+        m_entries.insert(tile.key, Entry{ m_lru.begin(), tile.size });
+        m_totalBytes += tile.size;
+    }
+
+    evict();
+
+    GPS_LOG_INFO(Logger::Network, "Tile cache {}: {} tiles, {} of {} MB", m_rootPath, m_entries.size(),
+                 m_totalBytes / (1024 * 1024), m_maxBytes / (1024 * 1024));
+    return true;
+}
+
+QString TileCache::rootPath() const
+{
+    return m_rootPath;
+}
+
+qint64 TileCache::maxBytes() const
+{
+    return m_maxBytes;
+}
+
+void TileCache::setMaxBytes(qint64 maxBytes)
+{
+    m_maxBytes = maxBytes;
+    evict();
+}
+
+qint64 TileCache::totalBytes() const
+{
+    return m_totalBytes;
+}
+
+int TileCache::tileCount() const
+{
+    return m_entries.size();
+}
+
+quint64 TileCache::evictions() const
+{
+    return m_evictions;
+}
+
+bool TileCache::contains(const QString &source, int z, int x, int y) const
+{
+    return m_entries.contains(tileKey(source, z, x, y));
+}
+
+bool TileCache::read(const QString &source, int z, int x, int y, QByteArray &data)
+{
+    const QString key = tileKey(source, z, x, y);
+    auto entry = m_entries.find(key);
+    if (entry == m_entries.end()) {
+        return false;
+    }
+
+    QFile file(filePath(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        // Removed behind our back; forget it
+        m_totalBytes -= entry->size;
+        m_lru.erase(entry->position);
+        m_entries.erase(entry);
+        return false;
+    }
+    data = file.readAll();
+    file.close();
+
+    touch(key, *entry);
+    return true;
+}
+
+bool TileCache::write(const QString &source, int z, int x, int y, const QByteArray &data)
+{
+    const QString key = tileKey(source, z, x, y);
+    const QString path = filePath(key);
+    QDir().mkpath(QFileInfo(path).path());
+
+    // Write to a temporary file and rename, so readers never see half a tile
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        GPS_LOG_RATE_LIMITED(Logger::Warning, Logger::Network, 1, "Cannot write tile {}: {}",
+                             path, file.errorString());
+        return false;
+    }
+
+    auto entry = m_entries.find(key);
+    if (entry != m_entries.end()) {
+        m_totalBytes -= entry->size;
+        m_lru.erase(entry->position);
+        m_entries.erase(entry);
+    }
+    m_lru.push_front(key);
+    m_entries.insert(key, Entry{ m_lru.begin(), data.size() });
+    m_totalBytes += data.size();
+
+    evict();
+    return true;
+}
+
+QString TileCache::tileKey(const QString &source, int z, int x, int y)
+{
+    return QString("%1/%2/%3/%4").arg(source).arg(z).arg(x).arg(y);
+}
+
+QString TileCache::filePath(const QString &key) const
+{
+    return m_rootPath + QLatin1Char('/') + key;
+}
+
+void TileCache::touch(const QString &key, Entry &entry)
+{
+    if (entry.position != m_lru.begin()) {
+        m_lru.splice(m_lru.begin(), m_lru, entry.position);
+    }
+
+    // The modification time carries the recency order across restarts
+    QFile file(filePath(key));
+    if (file.open(QIODevice::ReadWrite)) {
+        file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    }
+}
+
+void TileCache::evict()
+{
+    while (m_totalBytes > m_maxBytes && !m_lru.empty()) {
+        const QString key = m_lru.back();
+        m_lru.pop_back();
+        m_totalBytes -= m_entries.take(key).size;
+        QFile::remove(filePath(key));
+        ++m_evictions;
+    }
+}
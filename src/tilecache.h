@@ -0,0 +1,61 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <list>
+
+// Size-bounded on-disk store of map tiles.
+//
+// Tiles live in a plain directory tree, <root>/<source>/<z>/<x>/<y>, so a
+// cache can be copied onto a field unit or inspected by hand. Least
+// recently used tiles are evicted once the total size exceeds the limit;
+// the recency order survives restarts through the files' modification
+// times. Not thread-safe: TileProxyServer owns it on its own thread.
+class TileCache
+{
+public:
+    TileCache(const QString &rootPath, qint64 maxBytes);
+
+    // Scans the directory tree and rebuilds the LRU index
+    bool open();
+
+    QString rootPath() const;
+    qint64 maxBytes() const;
+    void setMaxBytes(qint64 maxBytes);
+
+    qint64 totalBytes() const;
+    int tileCount() const;
+    quint64 evictions() const;
+
+    bool contains(const QString &source, int z, int x, int y) const;
+
+    // Reads a tile and marks it as most recently used
+    bool read(const QString &source, int z, int x, int y, QByteArray &data);
+    bool write(const QString &source, int z, int x, int y, const QByteArray &data);
+
+private:
+    struct Entry
+    {
+        std::list<QString>::iterator position;
+        qint64 size;
+    };
+
+    static QString tileKey(const QString &source, int z, int x, int y);
+    QString filePath(const QString &key) const;
+    void touch(const QString &key, Entry &entry);
+    void evict();
+
+    QString m_rootPath;
+    qint64 m_maxBytes;
+    qint64 m_totalBytes;
+    quint64 m_evictions;
+
+    // Most recently used first
+    std::list<QString> m_lru;
+    QHash<QString, Entry> m_entries;
+};
+
+#endif // TILECACHE_H
@@ -0,0 +1,129 @@
+#include "tilecacheservice.h"
+#include "tileproxyserver.h"
+
+#include <QStandardPaths>
+#include <QThread>
+
+TileCacheService::TileCacheService(QObject *parent)
+    : QObject(parent)
+    , m_server(nullptr)
+    , m_serverThread(nullptr)
+    , m_port(0)
+    , m_offline(qEnvironmentVariableIntValue("GPS_TILE_OFFLINE") == 1)
+{
+    QString cacheDir = qEnvironmentVariable("GPS_TILE_CACHE_DIR");
+    if (cacheDir.isEmpty()) {
+        cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/tiles";
+    }
+
+    bool ok = false;
+    int cacheMb = qEnvironmentVariableIntValue("GPS_TILE_CACHE_MB", &ok);
+    if (!ok || cacheMb <= 0) {
+        cacheMb = CACHE_SIZE_DEFAULT_MB;
+    }
+
+    m_server = new TileProxyServer(cacheDir, qint64(cacheMb) * 1024 * 1024);
+    m_server->setOffline(m_offline);
+    m_serverThread = new QThread(this);
+    m_serverThread->setObjectName("TileCache");
+    m_server->moveToThread(m_serverThread);
+    connect(m_serverThread, &QThread::finished, m_server, &QObject::deleteLater);
+
+    connect(m_server, &TileProxyServer::prefetchProgress,
+            this, &TileCacheService::prefetchProgress);
+    connect(m_server, &TileProxyServer::prefetchFinished,
+            this, &TileCacheService::prefetchFinished);
+
+    m_serverThread->start();
+}
+
+TileCacheService::~TileCacheService()
+{
+    m_serverThread->quit();
+    m_serverThread->wait();
+}
+
+void TileCacheService::addSource(const QString &name, const QString &upstreamTemplate)
+{
+    // Lets the stand-in test server replace a real tile provider
+    const QString overrideUrl = qEnvironmentVariable(qPrintable(QString("GPS_TILE_%1_URL").arg(name.toUpper())));
+    const QString upstream = overrideUrl.isEmpty() ? upstreamTemplate : overrideUrl;
+    m_upstreams.insert(name, upstream);
+
+    QMetaObject::invokeMethod(m_server, [this, name, upstream]() {
+        m_server->addSource(name, upstream);
+    }, Qt::BlockingQueuedConnection);
+}
+
+bool TileCacheService::start()
+{
+    if (m_port != 0) {
+        return true;
+    }
+
+    quint16 port = 0;
+    QMetaObject::invokeMethod(m_server, [this, &port]() {
+        if (m_server->start(0)) {
+            port = m_server->port();
+        }
+    }, Qt::BlockingQueuedConnection);
+
+    m_port = port;
+    return m_port != 0;
+}
+
+bool TileCacheService::isRunning() const
+{
+    return m_port != 0;
+}
+
+QString TileCacheService::tileUrl(const QString &name) const
+{
+    if (m_port == 0) {
+        return m_upstreams.value(name);
+    }
+    return QString("http://127.0.0.1:%1/%2/{z}/{x}/{y}").arg(m_port).arg(name);
+}
+
+void TileCacheService::setOffline(bool offline)
+{
+    m_offline = offline;
+    QMetaObject::invokeMethod(m_server, [this, offline]() {
+        m_server->setOffline(offline);
+    }, Qt::BlockingQueuedConnection);
+}
+
+bool TileCacheService::isOffline() const
+{
+    return m_offline;
+}
+
+void TileCacheService::prefetch(const QString &source, double minX, double minY, double maxX, double maxY,
+                                int minZoom, int maxZoom)
+{
+    QMetaObject::invokeMethod(m_server, [=]() {
+        m_server->prefetch(source, minX, minY, maxX, maxY, minZoom, maxZoom);
+    }, Qt::QueuedConnection);
+}
+
+void TileCacheService::cancelPrefetch()
+{
+    QMetaObject::invokeMethod(m_server, [this]() {
+        m_server->cancelPrefetch();
+    }, Qt::QueuedConnection);
+}
+
+quint64 TileCacheService::cacheHits() const
+{
+    return m_server->cacheHits();
+}
+
+quint64 TileCacheService::cacheMisses() const
+{
+    return m_server->cacheMisses();
+}
+
+quint64 TileCacheService::upstreamFailures() const
+{
+    return m_server->upstreamFailures();
+}
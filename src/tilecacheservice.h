@@ -0,0 +1,66 @@
+#ifndef TILECACHESERVICE_H
+#define TILECACHESERVICE_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+class TileProxyServer;
+
+// GUI-side handle to the tile cache server running on its own thread.
+//
+// Configured from the environment so a field unit or a test rig can point
+// it elsewhere without rebuilding:
+//   GPS_TILE_CACHE_DIR      cache directory (default: app data dir/tiles)
+//   GPS_TILE_CACHE_MB       size limit in MB (default 512)
+//   GPS_TILE_OFFLINE        start in offline mode when set to 1
+//   GPS_TILE_<SOURCE>_URL   upstream template override, e.g. GPS_TILE_OSM_URL
+class TileCacheService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TileCacheService(QObject *parent = nullptr);
+    ~TileCacheService();
+
+    // Sources must be added before start()
+    void addSource(const QString &name, const QString &upstreamTemplate);
+
+    bool start();
+    bool isRunning() const;
+
+    // XYZ template QGIS should load for a source; the upstream URL itself
+    // when the server is not running
+    QString tileUrl(const QString &name) const;
+
+    void setOffline(bool offline);
+    bool isOffline() const;
+
+    // Rectangle in Web Mercator metres
+    void prefetch(const QString &source, double minX, double minY, double maxX, double maxY,
+                  int minZoom, int maxZoom);
+    void cancelPrefetch();
+
+    quint64 cacheHits() const;
+    quint64 cacheMisses() const;
+    quint64 upstreamFailures() const;
+
+signals:
+    void prefetchProgress(int done, int total);
+    void prefetchFinished(int fetched, int failed);
+
+private:
+    TileProxyServer *m_server;
+    QThread *m_serverThread;
+    QHash<QString, QString> m_upstreams;
+    quint16 m_port;
+    bool m_offline;
+
+    static const int CACHE_SIZE_DEFAULT_MB = 512;
+};
+
+#endif // TILECACHESERVICE_H
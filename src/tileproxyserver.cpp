@@ -0,0 +1,385 @@
+#include "tileproxyserver.h"
+#include "logger.h"
+#include "webmercator.h"
+
+#include <QHostAddress>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+
+#include <cmath>
+
+namespace {
+
+const double WORLD_HALF_SIZE = WebMercator::EARTH_RADIUS * 3.14159265358979323846;
+
+// Tile column/row containing a Web Mercator coordinate at a zoom level
+int tileIndex(double offset, int tilesPerSide)
+{
+    const int index = int(std::floor(offset / (2.0 * WORLD_HALF_SIZE) * tilesPerSide));
+    return qBound(0, index, tilesPerSide - 1);
+}
+
+QByteArray statusText(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    default: return "Bad Gateway";
+    }
+}
+
+} // namespace
+
+TileProxyServer::TileProxyServer(const QString &cacheRoot, qint64 maxBytes, QObject *parent)
+    : QObject(parent)
+    , m_cache(cacheRoot, maxBytes)
+    , m_server(nullptr)
+    , m_network(nullptr)
+    , m_offline(false)
+    , m_prefetchTotal(0)
+    , m_prefetchDone(0)
+    , m_prefetchFailed(0)
+    , m_cacheHits(0)
+    , m_cacheMisses(0)
+    , m_upstreamFailures(0)
+{
+}
+
+TileProxyServer::~TileProxyServer()
+{
+    stop();
+}
+
+void TileProxyServer::addSource(const QString &name, const QString &upstreamTemplate)
+{
+    m_upstreams.insert(name, upstreamTemplate);
+}
+
+bool TileProxyServer::start(quint16 port)
+{
+    // Network objects are created lazily so they belong to the server thread
+    if (!m_server) {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &TileProxyServer::onNewConnection);
+        m_network = new QNetworkAccessManager(this);
+    }
+
+    if (m_server->isListening()) {
+        return true;
+    }
+
+    m_cache.open();
+
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        GPS_LOG_ERROR(Logger::Network, "Tile cache server cannot listen: {}", m_server->errorString());
+        return false;
+    }
+
+    GPS_LOG_INFO(Logger::Network, "Tile cache server on 127.0.0.1:{}{}", m_server->serverPort(),
+                 m_offline ? " (offline)" : "");
+    return true;
+}
+
+void TileProxyServer::stop()
+{
+    if (m_server && m_server->isListening()) {
+        m_server->close();
+    }
+}
+
+quint16 TileProxyServer::port() const
+{
+    return m_server ? m_server->serverPort() : 0;
+}
+
+void TileProxyServer::setOffline(bool offline)
+{
+    if (m_offline != offline) {
+        m_offline = offline;
+        GPS_LOG_INFO(Logger::Network, "Tile cache {}", offline ? "offline" : "online");
+    }
+}
+
+bool TileProxyServer::isOffline() const
+{
+    return m_offline;
+}
+
+void TileProxyServer::prefetch(const QString &source, double minX, double minY, double maxX, double maxY,
+                               int minZoom, int maxZoom)
+{
+    cancelPrefetch();
+
+    if (!m_upstreams.contains(source) || m_offline) {
+        GPS_LOG_WARNING(Logger::Network, "Cannot prefetch {} tiles{}", source,
+                        m_offline ? " while offline" : ": unknown source");
+        emit prefetchFinished(0, 0);
+        return;
+    }
+
+    // Coarse levels first, so a capped job still covers the whole region
+    bool capped = false;
+    for (int z = qMax(0, minZoom); z <= qMin(maxZoom, 22) && !capped; ++z) {
+        const int tilesPerSide = 1 << z;
+        const int firstX = tileIndex(minX + WORLD_HALF_SIZE, tilesPerSide);
+        const int lastX = tileIndex(maxX + WORLD_HALF_SIZE, tilesPerSide);
+        const int firstY = tileIndex(WORLD_HALF_SIZE - maxY, tilesPerSide);
+        const int lastY = tileIndex(WORLD_HALF_SIZE - minY, tilesPerSide);
+
+        for (int x = firstX; x <= lastX && !capped; ++x) {
+            for (int y = firstY; y <= lastY; ++y) {
+                if (m_prefetchQueue.size() >= MAX_PREFETCH_TILES) {
+                    GPS_LOG_WARNING(Logger::Network, "Prefetch capped at {} tiles (zoom {})",
+                                    int(MAX_PREFETCH_TILES), z);
+                    capped = true;
+                    break;
+                }
+                if (!m_cache.contains(source, z, x, y)) {
+                    m_prefetchQueue.enqueue(TileRequest{ source, z, x, y });
+                }
+            }
+        }
+    }
+
+    m_prefetchTotal = m_prefetchQueue.size();
+    GPS_LOG_INFO(Logger::Network, "Prefetching {} {} tiles for zoom {}..{}", m_prefetchTotal, source,
+                 minZoom, maxZoom);
+    startNextPrefetch();
+    checkPrefetchDone();
+}
+
+void TileProxyServer::cancelPrefetch()
+{
+    // Fetches already in flight complete and are cached normally
+    m_prefetchQueue.clear();
+    m_prefetchInFlight.clear();
+    m_prefetchTotal = 0;
+    m_prefetchDone = 0;
+    m_prefetchFailed = 0;
+}
+
+quint64 TileProxyServer::cacheHits() const
+{
+    return m_cacheHits.load(std::memory_order_relaxed);
+}
+
+quint64 TileProxyServer::cacheMisses() const
+{
+    return m_cacheMisses.load(std::memory_order_relaxed);
+}
+
+quint64 TileProxyServer::upstreamFailures() const
+{
+    return m_upstreamFailures.load(std::memory_order_relaxed);
+}
+
+void TileProxyServer::onNewConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QTcpSocket *client = m_server->nextPendingConnection();
+        connect(client, &QTcpSocket::readyRead, this, &TileProxyServer::onClientReadyRead);
+        connect(client, &QTcpSocket::disconnected, this, [this, client]() {
+            m_pendingRequests.remove(client);
+            client->deleteLater();
+        });
+    }
+}
+
+void TileProxyServer::onClientReadyRead()
+{
+    QTcpSocket *client = qobject_cast<QTcpSocket *>(sender());
+    if (!client) {
+        return;
+    }
+
+    QByteArray &request = m_pendingRequests[client];
+    request += client->readAll();
+
+    const int headerEnd = request.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (request.size() > MAX_REQUEST_SIZE) {
+            m_pendingRequests.remove(client);
+            respond(client, 400, QByteArray());
+        }
+        return;
+    }
+
+    // "GET /<source>/<z>/<x>/<y> HTTP/1.1"
+    const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    m_pendingRequests.remove(client);
+
+    if (requestLine.size() < 2 || requestLine[0] != "GET") {
+        respond(client, 405, QByteArray());
+        return;
+    }
+    handleRequest(client, requestLine[1]);
+}
+
+void TileProxyServer::handleRequest(QTcpSocket *client, const QByteArray &path)
+{
+    QByteArray route = path;
+    const int query = route.indexOf('?');
+    if (query >= 0) {
+        route.truncate(query);
+    }
+
+    const QList<QByteArray> parts = route.split('/');
+    bool okZ = false, okX = false, okY = false;
+    TileRequest tile;
+    if (parts.size() == 5) {
+        tile.source = QString::fromUtf8(parts[1]);
+        tile.z = parts[2].toInt(&okZ);
+        tile.x = parts[3].toInt(&okX);
+        tile.y = parts[4].toInt(&okY);
+    }
+    if (!okZ || !okX || !okY || !m_upstreams.contains(tile.source)
+        || tile.z < 0 || tile.z > 30 || tile.x < 0 || tile.y < 0
+        || tile.x >= (1 << tile.z) || tile.y >= (1 << tile.z)) {
+        respond(client, 404, QByteArray());
+        return;
+    }
+
+    QByteArray data;
+    if (m_cache.read(tile.source, tile.z, tile.x, tile.y, data)) {
+        m_cacheHits.fetch_add(1, std::memory_order_relaxed);
+        respond(client, 200, data);
+        return;
+    }
+
+    m_cacheMisses.fetch_add(1, std::memory_order_relaxed);
+    if (m_offline) {
+        respond(client, 404, QByteArray());
+        return;
+    }
+
+    // Join a fetch already in flight for this tile instead of starting another
+    const QString key = tileKey(tile);
+    const bool inFlight = m_waiting.contains(key) || m_prefetchInFlight.contains(key);
+    m_waiting[key].append(QPointer<QTcpSocket>(client));
+    if (!inFlight) {
+        fetchUpstream(tile);
+    }
+}
+
+void TileProxyServer::fetchUpstream(const TileRequest &tile)
+{
+    QString url = m_upstreams.value(tile.source);
+    url.replace("{z}", QString::number(tile.z));
+    url.replace("{x}", QString::number(tile.x));
+    url.replace("{y}", QString::number(tile.y));
+
+    QNetworkRequest request{ QUrl(url) };
+    request.setHeader(QNetworkRequest::UserAgentHeader, "GPSMapViewer/1.0");
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                         QNetworkRequest::NoLessSafeRedirectPolicy);
+
+    QNetworkReply *reply = m_network->get(request);
+    m_replies.insert(reply, tile);
+    connect(reply, &QNetworkReply::finished, this, &TileProxyServer::onUpstreamFinished);
+}
+
+void TileProxyServer::onUpstreamFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply) {
+        return;
+    }
+    reply->deleteLater();
+
+    const TileRequest tile = m_replies.take(reply);
+    const QString key = tileKey(tile);
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QByteArray data = reply->readAll();
+    const bool ok = reply->error() == QNetworkReply::NoError && status == 200 && !data.isEmpty();
+
+    if (ok) {
+        m_cache.write(tile.source, tile.z, tile.x, tile.y, data);
+    } else {
+        m_upstreamFailures.fetch_add(1, std::memory_order_relaxed);
+        GPS_LOG_RATE_LIMITED(Logger::Warning, Logger::Network, 1, "Tile {} failed: HTTP {} {}",
+                             key, status, reply->errorString());
+    }
+
+    const QList<QPointer<QTcpSocket>> waiting = m_waiting.take(key);
+    for (const QPointer<QTcpSocket> &client : waiting) {
+        if (client) {
+            respond(client, ok ? 200 : 502, ok ? data : QByteArray());
+        }
+    }
+
+    if (m_prefetchInFlight.remove(key)) {
+        finishPrefetchTile(ok);
+    }
+}
+
+void TileProxyServer::startNextPrefetch()
+{
+    while (m_prefetchInFlight.size() < PREFETCH_CONCURRENCY && !m_prefetchQueue.isEmpty()) {
+        const TileRequest tile = m_prefetchQueue.dequeue();
+        if (m_cache.contains(tile.source, tile.z, tile.x, tile.y)) {
+            // Fetched on demand since the job was queued
+            ++m_prefetchDone;
+            continue;
+        }
+
+        const QString key = tileKey(tile);
+        m_prefetchInFlight.insert(key);
+        if (!m_waiting.contains(key)) {
+            fetchUpstream(tile);
+        }
+    }
+}
+
+void TileProxyServer::finishPrefetchTile(bool ok)
+{
+    ++m_prefetchDone;
+    if (!ok) {
+        ++m_prefetchFailed;
+    }
+    emit prefetchProgress(m_prefetchDone, m_prefetchTotal);
+
+    startNextPrefetch();
+    checkPrefetchDone();
+}
+
+void TileProxyServer::checkPrefetchDone()
+{
+    if (!m_prefetchQueue.isEmpty() || !m_prefetchInFlight.isEmpty()) {
+        return;
+    }
+
+    const int fetched = m_prefetchDone - m_prefetchFailed;
+    const int failed = m_prefetchFailed;
+    GPS_LOG_INFO(Logger::Network, "Prefetch finished: {} fetched, {} failed, cache {} MB", fetched,
+                 failed, m_cache.totalBytes() / (1024 * 1024));
+    cancelPrefetch();
+    emit prefetchFinished(fetched, failed);
+}
+
+QString TileProxyServer::tileKey(const TileRequest &tile)
+{
+    return QString("%1/%2/%3/%4").arg(tile.source).arg(tile.z).arg(tile.x).arg(tile.y);
+}
+
+void TileProxyServer::respond(QTcpSocket *client, int status, const QByteArray &body)
+{
+    // PNG and JPEG are the only tile formats the basemaps serve
+    const QByteArray contentType = body.startsWith("\x89PNG") ? "image/png" : "image/jpeg";
+
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + ' ' + statusText(status) + "\r\n";
+    if (status == 200) {
+        response += "Content-Type: " + contentType + "\r\n";
+    }
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                "Connection: close\r\n\r\n";
+    response += body;
+
+    client->write(response);
+    client->disconnectFromHost();
+}
@@ -0,0 +1,119 @@
+#ifndef TILEPROXYSERVER_H
+#define TILEPROXYSERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QQueue>
+#include <QSet>
+#include <QString>
+
+#include <atomic>
+
+#include "tilecache.h"
+
+QT_BEGIN_NAMESPACE
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTcpServer;
+class QTcpSocket;
+QT_END_NAMESPACE
+
+// Read-through tile cache exposed as a loopback HTTP server.
+//
+// QGIS XYZ layers point at http://127.0.0.1:<port>/<source>/{z}/{x}/{y}.
+// Cached tiles are answered from disk; misses are fetched from the
+// source's upstream URL template, stored and then answered. Concurrent
+// requests for the same tile share one upstream fetch. In offline mode
+// misses are answered with 404 and nothing leaves the machine.
+//
+// TileCacheService runs the server on its own thread so slow uplinks and
+// disk I/O never stall the GUI.
+class TileProxyServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    TileProxyServer(const QString &cacheRoot, qint64 maxBytes, QObject *parent = nullptr);
+    ~TileProxyServer();
+
+    // Upstream templates use {z}, {x} and {y} placeholders
+    void addSource(const QString &name, const QString &upstreamTemplate);
+
+    bool start(quint16 port);
+    void stop();
+    quint16 port() const;
+
+    void setOffline(bool offline);
+    bool isOffline() const;
+
+    // Downloads every missing tile of the Web Mercator rectangle for the
+    // zoom levels minZoom..maxZoom
+    void prefetch(const QString &source, double minX, double minY, double maxX, double maxY,
+                  int minZoom, int maxZoom);
+    void cancelPrefetch();
+
+    // Statistics, readable from any thread
+    quint64 cacheHits() const;
+    quint64 cacheMisses() const;
+    quint64 upstreamFailures() const;
+
+    static const int MAX_PREFETCH_TILES = 50000;
+
+signals:
+    void prefetchProgress(int done, int total);
+    void prefetchFinished(int fetched, int failed);
+
+private slots:
+    void onNewConnection();
+    void onClientReadyRead();
+    void onUpstreamFinished();
+
+private:
+    struct TileRequest
+    {
+        QString source;
+        int z;
+        int x;
+        int y;
+    };
+
+    void handleRequest(QTcpSocket *client, const QByteArray &path);
+    void fetchUpstream(const TileRequest &tile);
+    void startNextPrefetch();
+    void finishPrefetchTile(bool ok);
+    void checkPrefetchDone();
+    static QString tileKey(const TileRequest &tile);
+    static void respond(QTcpSocket *client, int status, const QByteArray &body);
+
+    TileCache m_cache;
+    QTcpServer *m_server;
+    QNetworkAccessManager *m_network;
+    QHash<QString, QString> m_upstreams;
+    bool m_offline;
+
+    // Partial request headers per client connection
+    QHash<QTcpSocket *, QByteArray> m_pendingRequests;
+
+    // Clients waiting on an in-flight upstream fetch, by tile key
+    QHash<QString, QList<QPointer<QTcpSocket>>> m_waiting;
+    QHash<QNetworkReply *, TileRequest> m_replies;
+
+    // Prefetch job
+    QQueue<TileRequest> m_prefetchQueue;
+    QSet<QString> m_prefetchInFlight;
+    int m_prefetchTotal;
+    int m_prefetchDone;
+    int m_prefetchFailed;
+    static const int PREFETCH_CONCURRENCY = 4;
+
+    std::atomic<quint64> m_cacheHits;
+    std::atomic<quint64> m_cacheMisses;
+    std::atomic<quint64> m_upstreamFailures;
+
+    static const int MAX_REQUEST_SIZE = 8192;
+};
+
+#endif // TILEPROXYSERVER_H
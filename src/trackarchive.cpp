@@ -0,0 +1,591 @@
+#include "trackarchive.h"
+#include "trailstore.h"
+#include "webmercator.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const char TrackArchive::MAGIC[6] = { 'G', 'P', 'S', 'S', 'E', 'G' };
+
+namespace {
+
+qint32 toFixedPoint(double degrees)
+{
+    return qint32(std::lround(degrees * TrackArchive::COORDINATE_SCALE));
+}
+
+// Parses "<start>-<end>.seg", "<start>-<end>-<writer>.seg" and
+// "<start>-<end>-<writer>-<copy>.seg"; false for anything else in the
+// directory
+bool parseSegmentName(const QString &fileName, qint64 &startMs, qint64 &endMs)
+{
+    if (!fileName.endsWith(".seg")) {
+        return false;
+    }
+    const QStringList times = fileName.chopped(4).split('-');
+    bool startOk = false;
+    bool endOk = false;
+    bool writerOk = true;
+    for (int i = 2; i < times.size() && writerOk; ++i) {
+        times[i].toUInt(&writerOk);
+    }
+    if (times.size() >= 2 && times.size() <= 4) {
+        startMs = times[0].toLongLong(&startOk);
+        endMs = times[1].toLongLong(&endOk);
+    }
+    return startOk && endOk && writerOk && startMs <= endMs;
+}
+
+} // namespace
+
+TrackArchiveWriter::TrackArchiveWriter()
+    : m_writerId(0)
+    , m_maxBytes(0)
+    , m_partitionEndMs(0)
+{
+}
+
+TrackArchiveWriter::~TrackArchiveWriter()
+{
+    seal();
+}
+
+bool TrackArchiveWriter::open(const QString &directory, int writerId)
+{
+    if (!QDir().mkpath(directory)) {
+        m_error = QString("Cannot create %1").arg(directory);
+        return false;
+    }
+    m_directory = directory;
+    m_writerId = writerId;
+    return true;
+}
+
+bool TrackArchiveWriter::isOpen() const
+{
+    return !m_directory.isEmpty();
+}
+
+void TrackArchiveWriter::setMaxBytes(qint64 maxBytes)
+{
+    m_maxBytes = qMax(Q_INT64_C(0), maxBytes);
+}
+
+bool TrackArchiveWriter::accepts(qint64 timestampMs) const
+{
+    // Late fixes from an earlier partition stay in the open segment; its
+    // file name records the times it actually spans
+    return isEmpty()
+           || (m_timestamps.size() < TrackArchive::MAX_SEGMENT_FIXES && timestampMs < m_partitionEndMs);
+}
+
+void TrackArchiveWriter::append(const GpsFix &fix)
+{
+    if (isEmpty()) {
+        const qint64 duration = TrackArchive::SEGMENT_DURATION_MS;
+        m_partitionEndMs = (fix.timestampMs / duration + 1) * duration;
+    }
+    m_deviceIds.append(fix.deviceId);
+    m_timestamps.append(fix.timestampMs);
+    m_longitudes.append(toFixedPoint(fix.longitude));
+    m_latitudes.append(toFixedPoint(fix.latitude));
+    m_altitudes.append(qint32(std::lround(fix.altitude * 1000.0)));
+}
+
+bool TrackArchiveWriter::isEmpty() const
+{
+    return m_timestamps.isEmpty();
+}
+
+QString TrackArchiveWriter::seal()
+{
+    if (!isOpen() || isEmpty()) {
+        return QString();
+    }
+
+    const int rows = m_timestamps.size();
+
+    // Device-major, time-minor: each device's track becomes one run
+    QVector<int> order(rows);
+    for (int i = 0; i < rows; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return m_deviceIds[a] != m_deviceIds[b] ? m_deviceIds[a] < m_deviceIds[b]
+                                                : m_timestamps[a] < m_timestamps[b];
+    });
+
+    int runs = 0;
+    int indexEntries = 0;
+    for (int begin = 0; begin < rows;) {
+        int end = begin + 1;
+        while (end < rows && m_deviceIds[order[end]] == m_deviceIds[order[begin]]) {
+            ++end;
+        }
+        ++runs;
+        indexEntries += (end - begin + TrackArchive::INDEX_STRIDE - 1) / TrackArchive::INDEX_STRIDE;
+        begin = end;
+    }
+
+    const qint64 runsOffset = TrackArchive::HEADER_SIZE;
+    const qint64 indexOffset = runsOffset + qint64(runs) * TrackArchive::RUN_SIZE;
+    const qint64 timeOffset = indexOffset + qint64(indexEntries) * 8;
+    const qint64 longitudeOffset = timeOffset + qint64(rows) * 8;
+    const qint64 latitudeOffset = longitudeOffset + qint64(rows) * 4;
+    const qint64 altitudeOffset = latitudeOffset + qint64(rows) * 4;
+    QByteArray bytes(int(altitudeOffset + qint64(rows) * 4), Qt::Uninitialized);
+    uchar *out = reinterpret_cast<uchar *>(bytes.data());
+
+    qint64 minTime = m_timestamps[order[0]];
+    qint64 maxTime = minTime;
+    qint32 box[4] = { m_longitudes[0], m_latitudes[0], m_longitudes[0], m_latitudes[0] };
+
+    uchar *run = out + runsOffset;
+    uchar *index = out + indexOffset;
+    int indexEntry = 0;
+    for (int begin = 0; begin < rows;) {
+        const quint32 deviceId = m_deviceIds[order[begin]];
+        qint32 runBox[4] = { m_longitudes[order[begin]], m_latitudes[order[begin]],
+                             m_longitudes[order[begin]], m_latitudes[order[begin]] };
+        const int firstIndexEntry = indexEntry;
+
+        int row = begin;
+        for (; row < rows && m_deviceIds[order[row]] == deviceId; ++row) {
+            const int i = order[row];
+            qToLittleEndian<qint64>(m_timestamps[i], out + timeOffset + qint64(row) * 8);
+            qToLittleEndian<qint32>(m_longitudes[i], out + longitudeOffset + qint64(row) * 4);
+            qToLittleEndian<qint32>(m_latitudes[i], out + latitudeOffset + qint64(row) * 4);
+            qToLittleEndian<qint32>(m_altitudes[i], out + altitudeOffset + qint64(row) * 4);
+            if ((row - begin) % TrackArchive::INDEX_STRIDE == 0) {
+                qToLittleEndian<qint64>(m_timestamps[i], index + qint64(indexEntry++) * 8);
+            }
+            runBox[0] = qMin(runBox[0], m_longitudes[i]);
+            runBox[1] = qMin(runBox[1], m_latitudes[i]);
+            runBox[2] = qMax(runBox[2], m_longitudes[i]);
+            runBox[3] = qMax(runBox[3], m_latitudes[i]);
+        }
+
+        const qint64 runMinTime = m_timestamps[order[begin]];
+        const qint64 runMaxTime = m_timestamps[order[row - 1]];
+        qToLittleEndian<quint32>(deviceId, run);
+        qToLittleEndian<quint32>(quint32(begin), run + 4);
+        qToLittleEndian<quint32>(quint32(row - begin), run + 8);
+        qToLittleEndian<quint32>(quint32(firstIndexEntry), run + 12);
+        qToLittleEndian<qint64>(runMinTime, run + 16);
+        qToLittleEndian<qint64>(runMaxTime, run + 24);
+        for (int k = 0; k < 4; ++k) {
+            qToLittleEndian<qint32>(runBox[k], run + 32 + k * 4);
+        }
+        run += TrackArchive::RUN_SIZE;
+
+        minTime = qMin(minTime, runMinTime);
+        maxTime = qMax(maxTime, runMaxTime);
+        box[0] = qMin(box[0], runBox[0]);
+        box[1] = qMin(box[1], runBox[1]);
+        box[2] = qMax(box[2], runBox[2]);
+        box[3] = qMax(box[3], runBox[3]);
+        begin = row;
+    }
+
+    std::memcpy(out, TrackArchive::MAGIC, sizeof(TrackArchive::MAGIC));
+    qToLittleEndian<quint16>(TrackArchive::VERSION, out + 6);
+    qToLittleEndian<quint32>(quint32(rows), out + 8);
+    qToLittleEndian<quint32>(quint32(runs), out + 12);
+    qToLittleEndian<quint32>(quint32(indexEntries), out + 16);
+    qToLittleEndian<quint32>(0, out + 20);
+    qToLittleEndian<qint64>(minTime, out + 24);
+    qToLittleEndian<qint64>(maxTime, out + 32);
+    for (int k = 0; k < 4; ++k) {
+        qToLittleEndian<qint32>(box[k], out + 40 + k * 4);
+    }
+
+    m_deviceIds.clear();
+    m_timestamps.clear();
+    m_longitudes.clear();
+    m_latitudes.clear();
+    m_altitudes.clear();
+
+    // Written aside and renamed so readers never see a partial segment
+    const QString name = QString("%1-%2").arg(minTime).arg(maxTime);
+    const QDir directory(m_directory);
+    const QString temporaryPath = directory.filePath(QString("%1-%2.%3.tmp").arg(name).arg(m_writerId)
+                                                         .arg(QCoreApplication::applicationPid()));
+    QFile file(temporaryPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || file.write(bytes) != bytes.size() || !file.flush()) {
+        m_error = file.errorString();
+        file.remove();
+        return QString();
+    }
+    file.close();
+
+    // A restarted process, or another one sharing the directory, may have
+    // sealed the same span already. rename() never replaces a file, so
+    // that segment is kept and this one takes the next free name.
+    for (int copy = 0; copy < MAX_NAME_ATTEMPTS; ++copy) {
+        QString fileName = name;
+        if (m_writerId > 0 || copy > 0) {
+            fileName += QString("-%1").arg(m_writerId);
+        }
+        if (copy > 0) {
+            fileName += QString("-%1").arg(copy);
+        }
+        const QString path = directory.filePath(fileName + ".seg");
+        if (QFile::rename(temporaryPath, path)) {
+            prune(path);
+            return path;
+        }
+        if (!QFile::exists(path)) {
+            break;
+        }
+    }
+    m_error = QString("Cannot rename %1").arg(temporaryPath);
+    QFile::remove(temporaryPath);
+    return QString();
+}
+
+void TrackArchiveWriter::prune(const QString &keepPath)
+{
+    if (m_maxBytes <= 0) {
+        return;
+    }
+
+    struct SegmentFile
+    {
+        qint64 endMs;
+        qint64 size;
+        QString path;
+    };
+    QVector<SegmentFile> files;
+    qint64 total = 0;
+    const QFileInfoList entries = QDir(m_directory).entryInfoList(QStringList() << "*.seg", QDir::Files);
+    for (const QFileInfo &entry : entries) {
+        qint64 startMs, endMs;
+        if (parseSegmentName(entry.fileName(), startMs, endMs)) {
+            files.append({ endMs, entry.size(), entry.filePath() });
+            total += entry.size();
+        }
+    }
+    if (total <= m_maxBytes) {
+        return;
+    }
+
+    // Oldest history goes first; the segment just sealed always stays
+    std::sort(files.begin(), files.end(), [](const SegmentFile &a, const SegmentFile &b) {
+        return a.endMs < b.endMs;
+    });
+    for (const SegmentFile &file : qAsConst(files)) {
+        if (total <= m_maxBytes) {
+            break;
+        }
+        if (file.path != keepPath && QFile::remove(file.path)) {
+            total -= file.size;
+        }
+    }
+}
+
+QString TrackArchiveWriter::errorString() const
+{
+    return m_error;
+}
+
+TrackArchive::TrackArchive()
+    : m_mappedCount(0)
+    , m_useCounter(0)
+{
+}
+
+TrackArchive::~TrackArchive()
+{
+    close();
+}
+
+bool TrackArchive::open(const QString &directory)
+{
+    close();
+
+    QDir dir(directory);
+    if (!dir.exists()) {
+        return false;
+    }
+    m_directory = directory;
+
+    const QStringList names = dir.entryList(QStringList() << "*.seg", QDir::Files);
+    for (const QString &name : names) {
+        Segment segment;
+        if (parseSegmentName(name, segment.startMs, segment.endMs)) {
+            segment.path = dir.filePath(name);
+            m_segments.push_back(std::move(segment));
+        }
+    }
+    std::sort(m_segments.begin(), m_segments.end(), [](const Segment &a, const Segment &b) {
+        return a.startMs < b.startMs;
+    });
+    return true;
+}
+
+void TrackArchive::close()
+{
+    // Mappings are released with their QFile
+    m_segments.clear();
+    m_mappedCount = 0;
+    m_directory.clear();
+}
+
+QString TrackArchive::directory() const
+{
+    return m_directory;
+}
+
+void TrackArchive::addSegment(const QString &path)
+{
+    Segment segment;
+    if (!parseSegmentName(QFileInfo(path).fileName(), segment.startMs, segment.endMs)) {
+        return;
+    }
+    segment.path = path;
+
+    // Newly sealed segments are almost always the latest
+    auto position = std::upper_bound(m_segments.begin(), m_segments.end(), segment.startMs,
+                                     [](qint64 start, const Segment &s) { return start < s.startMs; });
+    m_segments.insert(position, std::move(segment));
+}
+
+int TrackArchive::segmentCount() const
+{
+    return int(m_segments.size());
+}
+
+QString TrackArchive::segmentPath(int segment) const
+{
+    return m_segments[segment].path;
+}
+
+qint64 TrackArchive::segmentStartMs(int segment) const
+{
+    return m_segments[segment].startMs;
+}
+
+qint64 TrackArchive::segmentEndMs(int segment) const
+{
+    return m_segments[segment].endMs;
+}
+
+void TrackArchive::segmentsInRange(qint64 fromMs, qint64 toMs, QVector<int> &segments) const
+{
+    segments.clear();
+    for (int i = 0; i < int(m_segments.size()) && m_segments[i].startMs <= toMs; ++i) {
+        if (m_segments[i].endMs >= fromMs) {
+            segments.append(i);
+        }
+    }
+}
+
+bool TrackArchive::segmentExtent(int segment, double &minX, double &minY, double &maxX, double &maxY) const
+{
+    const Mapping *mapping = map(segment);
+    if (!mapping || mapping->rows == 0) {
+        return false;
+    }
+    extentOf(mapping->data + 40, minX, minY, maxX, maxY);
+    return true;
+}
+
+bool TrackArchive::deviceExtent(int segment, quint32 deviceId,
+                                double &minX, double &minY, double &maxX, double &maxY) const
+{
+    const Mapping *mapping = map(segment);
+    const uchar *run = mapping ? findRun(*mapping, deviceId) : nullptr;
+    if (!run) {
+        return false;
+    }
+    extentOf(run + 32, minX, minY, maxX, maxY);
+    return true;
+}
+
+int TrackArchive::loadTrack(int segment, quint32 deviceId, qint64 fromMs, qint64 toMs, TrailStore &trail) const
+{
+    const Mapping *mapping = map(segment);
+    const uchar *run = mapping ? findRun(*mapping, deviceId) : nullptr;
+    if (!run || qFromLittleEndian<qint64>(run + 16) > toMs || qFromLittleEndian<qint64>(run + 24) < fromMs) {
+        return 0;
+    }
+
+    const quint32 firstRow = qFromLittleEndian<quint32>(run + 4);
+    const quint32 rowCount = qFromLittleEndian<quint32>(run + 8);
+    const quint32 firstIndexEntry = qFromLittleEndian<quint32>(run + 12);
+    const quint32 indexCount = (rowCount + INDEX_STRIDE - 1) / INDEX_STRIDE;
+    const uchar *index = mapping->index();
+    const uchar *times = mapping->timeColumn();
+
+    // Last index entry before fromMs, then forward to the first row at
+    // fromMs. Rows sharing a timestamp (a whole receive batch) may straddle
+    // an index entry, so an entry equal to fromMs is not a safe start.
+    quint32 low = 0;
+    quint32 high = indexCount;
+    while (low < high) {
+        const quint32 middle = (low + high) / 2;
+        if (qFromLittleEndian<qint64>(index + qint64(firstIndexEntry + middle) * 8) < fromMs) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    quint32 row = firstRow + (low > 0 ? (low - 1) * INDEX_STRIDE : 0);
+    const quint32 endRow = firstRow + rowCount;
+    while (row < endRow && qFromLittleEndian<qint64>(times + qint64(row) * 8) < fromMs) {
+        ++row;
+    }
+    quint32 last = row;
+    while (last < endRow && qFromLittleEndian<qint64>(times + qint64(last) * 8) <= toMs) {
+        ++last;
+    }
+
+    const int count = int(last - row);
+    if (count == 0) {
+        return 0;
+    }
+
+    m_longitudes.resize(count);
+    m_latitudes.resize(count);
+    m_x.resize(count);
+    m_y.resize(count);
+    const uchar *longitudes = mapping->longitudeColumn() + qint64(row) * 4;
+    const uchar *latitudes = mapping->latitudeColumn() + qint64(row) * 4;
+    for (int i = 0; i < count; ++i) {
+        m_longitudes[i] = qFromLittleEndian<qint32>(longitudes + i * 4) / COORDINATE_SCALE;
+        m_latitudes[i] = qFromLittleEndian<qint32>(latitudes + i * 4) / COORDINATE_SCALE;
+    }
+    WebMercator::project(m_longitudes.constData(), m_latitudes.constData(), m_x.data(), m_y.data(), count);
+
+    const uchar *altitudes = mapping->altitudeColumn() + qint64(row) * 4;
+    for (int i = 0; i < count; ++i) {
+        trail.append(m_longitudes[i], m_latitudes[i], qFromLittleEndian<qint32>(altitudes + i * 4) / 1000.0,
+                     qFromLittleEndian<qint64>(times + qint64(row + i) * 8), m_x[i], m_y[i]);
+    }
+    return count;
+}
+
+qint64 TrackArchive::defaultMaxBytes()
+{
+    bool ok = false;
+    const qint64 megabytes = qEnvironmentVariable("GPS_ARCHIVE_MAX_MB").toLongLong(&ok);
+    return (ok && megabytes >= 0 ? megabytes : qint64(DEFAULT_MAX_MB)) * 1024 * 1024;
+}
+
+QString TrackArchive::defaultDirectory()
+{
+    const QString directory = qEnvironmentVariable("GPS_ARCHIVE_DIR");
+    if (!directory.isEmpty()) {
+        return directory;
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/archive";
+}
+
+const TrackArchive::Mapping *TrackArchive::map(int segment) const
+{
+    if (segment < 0 || segment >= int(m_segments.size())) {
+        return nullptr;
+    }
+
+    Segment &entry = m_segments[segment];
+    if (entry.mapping) {
+        entry.mapping->lastUse = ++m_useCounter;
+        return entry.mapping->data ? entry.mapping.get() : nullptr;
+    }
+
+    if (m_mappedCount >= MAX_MAPPED_SEGMENTS) {
+        unmapLeastRecentlyUsed();
+    }
+
+    // A segment that fails validation keeps an empty mapping so it is not
+    // retried on every pan
+    std::unique_ptr<Mapping> mapping(new Mapping);
+    mapping->lastUse = ++m_useCounter;
+    mapping->file.setFileName(entry.path);
+    if (mapping->file.open(QIODevice::ReadOnly) && mapping->file.size() >= HEADER_SIZE) {
+        const qint64 size = mapping->file.size();
+        const uchar *data = mapping->file.map(0, size);
+        if (data && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0
+            && qFromLittleEndian<quint16>(data + 6) == VERSION) {
+            const quint32 rows = qFromLittleEndian<quint32>(data + 8);
+            const quint32 runs = qFromLittleEndian<quint32>(data + 12);
+            const quint32 indexEntries = qFromLittleEndian<quint32>(data + 16);
+            const qint64 expected = HEADER_SIZE + qint64(runs) * RUN_SIZE + qint64(indexEntries) * 8
+                                    + qint64(rows) * 20;
+            if (expected == size && runsInBounds(data, rows, runs, indexEntries)) {
+                mapping->data = data;
+                mapping->rows = rows;
+                mapping->runs = runs;
+                mapping->indexEntries = indexEntries;
+            }
+        }
+    }
+
+    entry.mapping = std::move(mapping);
+    ++m_mappedCount;
+    return entry.mapping->data ? entry.mapping.get() : nullptr;
+}
+
+void TrackArchive::unmapLeastRecentlyUsed() const
+{
+    Segment *oldest = nullptr;
+    for (Segment &segment : m_segments) {
+        if (segment.mapping && (!oldest || segment.mapping->lastUse < oldest->mapping->lastUse)) {
+            oldest = &segment;
+        }
+    }
+    if (oldest) {
+        oldest->mapping.reset();
+        --m_mappedCount;
+    }
+}
+
+bool TrackArchive::runsInBounds(const uchar *data, quint32 rows, quint32 runs, quint32 indexEntries)
+{
+    // A corrupt run table must not send loadTrack() past the mapping
+    for (quint32 i = 0; i < runs; ++i) {
+        const uchar *run = data + HEADER_SIZE + qint64(i) * RUN_SIZE;
+        const quint32 firstRow = qFromLittleEndian<quint32>(run + 4);
+        const quint32 rowCount = qFromLittleEndian<quint32>(run + 8);
+        const quint32 firstIndexEntry = qFromLittleEndian<quint32>(run + 12);
+        const quint32 indexCount = (rowCount + INDEX_STRIDE - 1) / INDEX_STRIDE;
+        if (quint64(firstRow) + rowCount > rows || quint64(firstIndexEntry) + indexCount > indexEntries) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const uchar *TrackArchive::findRun(const Mapping &mapping, quint32 deviceId)
+{
+    quint32 low = 0;
+    quint32 high = mapping.runs;
+    while (low < high) {
+        const quint32 middle = (low + high) / 2;
+        if (qFromLittleEndian<quint32>(mapping.run(middle)) < deviceId) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < mapping.runs && qFromLittleEndian<quint32>(mapping.run(low)) == deviceId) {
+        return mapping.run(low);
+    }
+    return nullptr;
+}
+
+void TrackArchive::extentOf(const uchar *box, double &minX, double &minY, double &maxX, double &maxY)
+{
+    WebMercator::project(qFromLittleEndian<qint32>(box) / COORDINATE_SCALE,
+                         qFromLittleEndian<qint32>(box + 4) / COORDINATE_SCALE, minX, minY);
+    WebMercator::project(qFromLittleEndian<qint32>(box + 8) / COORDINATE_SCALE,
+                         qFromLittleEndian<qint32>(box + 12) / COORDINATE_SCALE, maxX, maxY);
+}
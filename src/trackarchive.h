@@ -0,0 +1,178 @@
+#ifndef TRACKARCHIVE_H
+#define TRACKARCHIVE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+#include "gpsfix.h"
+
+class TrailStore;
+
+// Persistent fix history: a directory of time-partitioned segment files.
+//
+// Each segment holds the fixes received in one SEGMENT_DURATION_MS window
+// (or MAX_SEGMENT_FIXES of them), sorted by device and then time, stored
+// column by column so one device's track is a contiguous slice of each
+// column. A segment is laid out as (all integers little-endian):
+//
+//   header     "GPSSEG", u16 version, u32 rows, u32 runs, u32 index
+//              entries, u32 reserved, i64 min/max time (ms since the
+//              epoch), i32 min lon/lat, max lon/lat (1e-7 degrees)
+//   runs       one per device, sorted by ID: u32 device ID, u32 first row,
+//              u32 row count, u32 first index entry, i64 min/max time,
+//              i32 min lon/lat, max lon/lat
+//   index      i64 time of every INDEX_STRIDE-th row of each run
+//   columns    i64 time[rows], i32 lon[rows], i32 lat[rows] (1e-7
+//              degrees), i32 altitude[rows] (mm)
+//
+// Segments are written once, under a temporary name, and renamed into
+// place as "<min time>-<max time>.seg" (with "-<writer>" appended when
+// several receiver threads archive at once, and "-<writer>-<copy>" when a
+// segment of that name exists already), so opening the archive only
+// lists the directory. Writers delete the oldest segments once the
+// directory outgrows its size limit. Files are memory-mapped on first use and a time-range
+// query for one device touches the run directory, a few index entries and
+// the rows it returns.
+class TrackArchiveWriter
+{
+public:
+    TrackArchiveWriter();
+    ~TrackArchiveWriter();
+
+    // Writers in one process sharing a directory need distinct writerIds
+    // so their temporary files do not collide
+    bool open(const QString &directory, int writerId = 0);
+    bool isOpen() const;
+
+    // Once the segments in the directory add up to more than maxBytes,
+    // seal() deletes the oldest ones; 0 keeps everything
+    void setMaxBytes(qint64 maxBytes);
+
+    // False once the open segment is full or timestampMs is past its
+    // partition; seal() first in that case
+    bool accepts(qint64 timestampMs) const;
+    void append(const GpsFix &fix);
+    bool isEmpty() const;
+
+    // Writes the buffered fixes as a segment and starts a new one; returns
+    // the segment's path, or an empty string when there was nothing to
+    // write or the write failed
+    QString seal();
+
+    QString errorString() const;
+
+private:
+    void prune(const QString &keepPath);
+
+    static const int MAX_NAME_ATTEMPTS = 100;
+
+    QString m_directory;
+    int m_writerId;
+    qint64 m_maxBytes;
+    qint64 m_partitionEndMs;
+    QVector<quint32> m_deviceIds;
+    QVector<qint64> m_timestamps;
+    QVector<qint32> m_longitudes;
+    QVector<qint32> m_latitudes;
+    QVector<qint32> m_altitudes;
+    QString m_error;
+};
+
+class TrackArchive
+{
+public:
+    TrackArchive();
+    ~TrackArchive();
+
+    // Lists the segments in directory; no segment is read until queried
+    bool open(const QString &directory);
+    void close();
+    QString directory() const;
+
+    // Registers a segment sealed after open()
+    void addSegment(const QString &path);
+
+    int segmentCount() const;
+    QString segmentPath(int segment) const;
+    qint64 segmentStartMs(int segment) const;
+    qint64 segmentEndMs(int segment) const;
+
+    // Segments overlapping [fromMs, toMs], oldest first
+    void segmentsInRange(qint64 fromMs, qint64 toMs, QVector<int> &segments) const;
+
+    // Bounding box in map coordinates of the segment, or of one device's
+    // fixes in it; false when the segment has none
+    bool segmentExtent(int segment, double &minX, double &minY, double &maxX, double &maxY) const;
+    bool deviceExtent(int segment, quint32 deviceId,
+                      double &minX, double &minY, double &maxX, double &maxY) const;
+
+    // Appends the device's fixes in [fromMs, toMs] from one segment to
+    // trail, in time order; returns how many were appended
+    int loadTrack(int segment, quint32 deviceId, qint64 fromMs, qint64 toMs, TrailStore &trail) const;
+
+    // GPS_ARCHIVE_DIR, or the application data directory + "/archive"
+    static QString defaultDirectory();
+
+    // GPS_ARCHIVE_MAX_MB (0 for no limit), or DEFAULT_MAX_MB, in bytes
+    static qint64 defaultMaxBytes();
+
+    static const char MAGIC[6];
+    static const quint16 VERSION = 1;
+    static const int HEADER_SIZE = 56;
+    static const int RUN_SIZE = 48;
+    static const int INDEX_STRIDE = 256;
+    static const qint64 SEGMENT_DURATION_MS = 10 * 60 * 1000;
+    static const int MAX_SEGMENT_FIXES = 1 << 18; // Bounds the stall of one seal
+    static const int MAX_MAPPED_SEGMENTS = 64;
+    static const qint64 DEFAULT_MAX_MB = 2048;
+    static constexpr double COORDINATE_SCALE = 1e7;
+
+private:
+    struct Mapping
+    {
+        QFile file;
+        const uchar *data = nullptr;
+        quint32 rows = 0;
+        quint32 runs = 0;
+        quint32 indexEntries = 0;
+        quint64 lastUse = 0;
+
+        const uchar *run(quint32 i) const { return data + HEADER_SIZE + qint64(i) * RUN_SIZE; }
+        const uchar *index() const { return run(runs); }
+        const uchar *timeColumn() const { return index() + qint64(indexEntries) * 8; }
+        const uchar *longitudeColumn() const { return timeColumn() + qint64(rows) * 8; }
+        const uchar *latitudeColumn() const { return longitudeColumn() + qint64(rows) * 4; }
+        const uchar *altitudeColumn() const { return latitudeColumn() + qint64(rows) * 4; }
+    };
+
+    struct Segment
+    {
+        QString path;
+        qint64 startMs;
+        qint64 endMs;
+        std::unique_ptr<Mapping> mapping; // Null until first queried
+    };
+
+    const Mapping *map(int segment) const;
+    void unmapLeastRecentlyUsed() const;
+    static const uchar *findRun(const Mapping &mapping, quint32 deviceId);
+    static bool runsInBounds(const uchar *data, quint32 rows, quint32 runs, quint32 indexEntries);
+    static void extentOf(const uchar *box, double &minX, double &minY, double &maxX, double &maxY);
+
+    QString m_directory;
+    mutable std::vector<Segment> m_segments;
+    mutable int m_mappedCount;
+    mutable quint64 m_useCounter;
+
+    // Scratch columns for projecting a slice before it enters a trail
+    mutable QVector<double> m_longitudes;
+    mutable QVector<double> m_latitudes;
+    mutable QVector<double> m_x;
+    mutable QVector<double> m_y;
+};
+
+#endif // TRACKARCHIVE_H
@@ -0,0 +1,136 @@
+#include "trackoverlayitem.h"
+#include "rendertierstats.h"
+#include "trailcanvasitem.h"
+#include "tracktable.h"
+
+#include <QPainter>
+
+#include <qgsmapcanvas.h>
+#include <qgsmaptopixel.h>
+
+TrackOverlayItem::TrackOverlayItem(QgsMapCanvas *mapCanvas, const TrackTable *tracks)
+    : QgsMapCanvasItem(mapCanvas)
+    , m_tracks(tracks)
+    , m_selectedDevice(0)
+    , m_showTrails(true)
+    , m_draft(false)
+    , m_lastVisibleTracks(0)
+{
+    // Below the selected track's trail and marker
+    setZValue(40);
+    updatePosition();
+}
+
+void TrackOverlayItem::setSelectedDevice(quint32 deviceId)
+{
+    m_selectedDevice = deviceId;
+    update();
+}
+
+void TrackOverlayItem::setShowTrails(bool show)
+{
+    m_showTrails = show;
+    update();
+}
+
+void TrackOverlayItem::setDraft(bool draft)
+{
+    m_draft = draft;
+    update();
+}
+
+int TrackOverlayItem::lastVisibleTracks() const
+{
+    return m_lastVisibleTracks;
+}
+
+void TrackOverlayItem::paint(QPainter *painter)
+{
+    m_lastVisibleTracks = 0;
+    if (!painter || !m_tracks || m_tracks->count() == 0) {
+        return;
+    }
+    RenderTierStats::ScopedRender render(RenderTierStats::Live);
+
+    const QgsMapToPixel &mapToPixel = mMapCanvas->mapSettings().mapToPixel();
+    const double unitsPerPixel = mapToPixel.mapUnitsPerPixel();
+    const QPointF origin = pos();
+
+    // Pad by a marker so ones straddling the edge still draw
+    QgsRectangle visible = mMapCanvas->mapSettings().visibleExtent();
+    visible.grow(unitsPerPixel * MARKER_DIAMETER);
+
+    painter->setRenderHint(QPainter::Antialiasing, !m_draft);
+
+    if (m_showTrails) {
+        const int level = TrailCanvasItem::levelOfDetail(mapToPixel, m_draft);
+        QPen pen(Qt::gray, 1);
+        painter->setBrush(Qt::NoBrush);
+        for (int i = 0; i < m_tracks->count(); ++i) {
+            const Track &track = m_tracks->track(i);
+            double minX, minY, maxX, maxY;
+            if (track.deviceId == m_selectedDevice || !track.trail.mapExtent(minX, minY, maxX, maxY)) {
+                continue;
+            }
+            if (maxX < visible.xMinimum() || minX > visible.xMaximum()
+                || maxY < visible.yMinimum() || minY > visible.yMaximum()) {
+                continue;
+            }
+            pen.setColor(deviceColor(track.deviceId));
+            painter->setPen(pen);
+            TrailCanvasItem::drawTrail(painter, track.trail, mapToPixel, visible, level, origin);
+        }
+    }
+
+    m_visible.clear();
+    m_tracks->tracksInExtent(visible.xMinimum(), visible.yMinimum(),
+                             visible.xMaximum(), visible.yMaximum(), m_visible);
+    m_lastVisibleTracks = m_visible.size();
+
+    if (m_draft || m_visible.size() > DENSE_MARKER_THRESHOLD) {
+        QVector<QPointF> points;
+        points.reserve(m_visible.size());
+        for (int index : qAsConst(m_visible)) {
+            const Track &track = m_tracks->track(index);
+            if (track.deviceId == m_selectedDevice) {
+                continue; // PositionMarkerItem draws it
+            }
+            double x = track.lastFix.mapX;
+            double y = track.lastFix.mapY;
+            mapToPixel.transformInPlace(x, y);
+            points.append(QPointF(x, y) - origin);
+        }
+        QPen pen(QColor(255, 140, 0), MARKER_DIAMETER / 2); // Orange
+        pen.setCapStyle(Qt::RoundCap);
+        painter->setPen(pen);
+        painter->drawPoints(points.constData(), points.size());
+        return;
+    }
+
+    const qreal radius = MARKER_DIAMETER / 2.0;
+    painter->setPen(QPen(Qt::white, 1));
+    for (int index : qAsConst(m_visible)) {
+        const Track &track = m_tracks->track(index);
+        if (track.deviceId == m_selectedDevice) {
+            continue;
+        }
+        double x = track.lastFix.mapX;
+        double y = track.lastFix.mapY;
+        mapToPixel.transformInPlace(x, y);
+        painter->setBrush(deviceColor(track.deviceId));
+        painter->drawEllipse(QPointF(x, y) - origin, radius, radius);
+    }
+}
+
+void TrackOverlayItem::updatePosition()
+{
+    // Cover the visible map; called by the canvas after pan/zoom/resize
+    setRect(mMapCanvas->extent());
+}
+
+QColor TrackOverlayItem::deviceColor(quint32 deviceId)
+{
+    // Spread hues with a multiplicative hash so neighbouring IDs differ
+    const int hue = int((deviceId * 2654435761u) >> 16) % 360;
+    return QColor::fromHsv(hue, 200, 230);
+}
@@ -0,0 +1,49 @@
+#ifndef TRACKOVERLAYITEM_H
+#define TRACKOVERLAYITEM_H
+
+#include <QVector>
+
+#include <qgsmapcanvasitem.h>
+
+class TrackTable;
+
+// Draws every live track except the selected one as a single canvas item.
+//
+// Markers come from a spatial query of the visible extent and trails are
+// skipped unless their bounding box is on screen, so painting cost follows
+// what is visible rather than how many targets are tracked. Above
+// DENSE_MARKER_THRESHOLD visible markers the per-device colours give way
+// to one batched drawPoints() call.
+class TrackOverlayItem : public QgsMapCanvasItem
+{
+public:
+    TrackOverlayItem(QgsMapCanvas *mapCanvas, const TrackTable *tracks);
+
+    // The selected track is drawn by the position marker and trail items
+    void setSelectedDevice(quint32 deviceId);
+    void setShowTrails(bool show);
+
+    // Draft quality: no antialiasing, coarser trails and plain point markers
+    void setDraft(bool draft);
+
+    // Markers drawn by the last paint, for diagnostics
+    int lastVisibleTracks() const;
+
+    void paint(QPainter *painter) override;
+    void updatePosition() override;
+
+    static QColor deviceColor(quint32 deviceId);
+
+private:
+    const TrackTable *m_tracks;
+    quint32 m_selectedDevice;
+    bool m_showTrails;
+    bool m_draft;
+    int m_lastVisibleTracks;
+    QVector<int> m_visible;
+
+    static const int MARKER_DIAMETER = 8;
+    static const int DENSE_MARKER_THRESHOLD = 2000;
+};
+
+#endif // TRACKOVERLAYITEM_H
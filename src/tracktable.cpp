@@ -0,0 +1,94 @@
+#include "tracktable.h"
+
+TrackTable::TrackTable()
+    : m_grid(GRID_CELL_SIZE_M)
+{
+}
+
+void TrackTable::update(const QVector<GpsFix> &fixes, bool recordTrails)
+{
+    for (const GpsFix &fix : fixes) {
+        auto existing = m_indexByDevice.constFind(fix.deviceId);
+        Track *track;
+        if (existing == m_indexByDevice.constEnd()) {
+            const int index = int(m_tracks.size());
+            m_tracks.emplace_back(new Track);
+            track = m_tracks.back().get();
+            track->deviceId = fix.deviceId;
+            m_indexByDevice.insert(fix.deviceId, index);
+            m_grid.insert(index, fix.mapX, fix.mapY);
+        } else {
+            track = m_tracks[size_t(*existing)].get();
+            m_grid.move(*existing, track->lastFix.mapX, track->lastFix.mapY, fix.mapX, fix.mapY);
+        }
+
+        track->lastFix = fix;
+        ++track->fixCount;
+        if (recordTrails) {
+            track->trail.append(fix.longitude, fix.latitude, fix.altitude, fix.timestampMs,
+                                fix.mapX, fix.mapY);
+        }
+    }
+}
+
+int TrackTable::count() const
+{
+    return int(m_tracks.size());
+}
+
+const Track &TrackTable::track(int index) const
+{
+    return *m_tracks[size_t(index)];
+}
+
+int TrackTable::indexOf(quint32 deviceId) const
+{
+    return m_indexByDevice.value(deviceId, -1);
+}
+
+void TrackTable::tracksInExtent(double minX, double minY, double maxX, double maxY,
+                                QVector<int> &indexes) const
+{
+    m_candidates.clear();
+    m_grid.query(minX, minY, maxX, maxY, m_candidates);
+    for (int index : qAsConst(m_candidates)) {
+        const GpsFix &fix = m_tracks[size_t(index)]->lastFix;
+        if (fix.mapX >= minX && fix.mapX <= maxX && fix.mapY >= minY && fix.mapY <= maxY) {
+            indexes.append(index);
+        }
+    }
+}
+
+int TrackTable::trackAt(double x, double y, double radius) const
+{
+    m_candidates.clear();
+    m_grid.query(x - radius, y - radius, x + radius, y + radius, m_candidates);
+
+    int nearest = -1;
+    double nearestDistanceSquared = radius * radius;
+    for (int index : qAsConst(m_candidates)) {
+        const GpsFix &fix = m_tracks[size_t(index)]->lastFix;
+        const double dx = fix.mapX - x;
+        const double dy = fix.mapY - y;
+        const double distanceSquared = dx * dx + dy * dy;
+        if (distanceSquared <= nearestDistanceSquared) {
+            nearestDistanceSquared = distanceSquared;
+            nearest = index;
+        }
+    }
+    return nearest;
+}
+
+void TrackTable::clearTrails()
+{
+    for (const std::unique_ptr<Track> &track : m_tracks) {
+        track->trail.clear();
+    }
+}
+
+void TrackTable::clear()
+{
+    m_tracks.clear();
+    m_indexByDevice.clear();
+    m_grid.clear();
+}
@@ -0,0 +1,61 @@
+#ifndef TRACKTABLE_H
+#define TRACKTABLE_H
+
+#include <QHash>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+#include "gpsfix.h"
+#include "spatialgrid.h"
+#include "trailstore.h"
+
+// Live state of one tracked device
+struct Track
+{
+    quint32 deviceId = 0;
+    GpsFix lastFix;
+    quint64 fixCount = 0;
+    TrailStore trail;
+};
+
+// All tracks seen so far, keyed by GpsFix::deviceId.
+//
+// Track indexes are stable for the table's lifetime (tracks are never
+// removed individually), and each track's current position is kept in a
+// SpatialGrid so rendering and hit-testing only touch the tracks inside
+// the area of interest.
+class TrackTable
+{
+public:
+    TrackTable();
+
+    // Routes each fix to its track, creating tracks on first sight; trail
+    // points are only recorded when recordTrails is set
+    void update(const QVector<GpsFix> &fixes, bool recordTrails);
+
+    int count() const;
+    const Track &track(int index) const;
+    int indexOf(quint32 deviceId) const;
+
+    // Tracks whose current position lies in the rectangle (map coordinates)
+    void tracksInExtent(double minX, double minY, double maxX, double maxY, QVector<int> &indexes) const;
+
+    // Nearest track within radius of the point, or -1
+    int trackAt(double x, double y, double radius) const;
+
+    void clearTrails();
+    void clear();
+
+    // Sized for vehicles: most fixes stay in their cell between frames
+    static const int GRID_CELL_SIZE_M = 2000;
+
+private:
+    std::vector<std::unique_ptr<Track>> m_tracks;
+    QHash<quint32, int> m_indexByDevice;
+    SpatialGrid m_grid;
+    mutable QVector<int> m_candidates;
+};
+
+#endif // TRACKTABLE_H
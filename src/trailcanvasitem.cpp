@@ -0,0 +1,207 @@
+#include "trailcanvasitem.h"
+#include "trailstore.h"
+
+#include <QPainter>
+#include <QPolygonF>
+
+#include <qgsmapcanvas.h>
+#include <qgsmaptopixel.h>
+
+TrailCanvasItem::TrailCanvasItem(QgsMapCanvas *mapCanvas, const TrailStore *store)
+    : QgsMapCanvasItem(mapCanvas)
+    , m_pen(QColor(0, 0, 255), 2) // Blue
+    , m_lastVertexCount(0)
+    , m_draft(false)
+    , m_tier(RenderTierStats::Live)
+    , m_cacheValid(false)
+{
+    m_pen.setCapStyle(Qt::RoundCap);
+    m_pen.setJoinStyle(Qt::RoundJoin);
+    if (store) {
+        m_stores.append(store);
+    }
+
+    // Below the position marker
+    setZValue(50);
+    updatePosition();
+}
+
+void TrailCanvasItem::setColor(const QColor &color)
+{
+    m_pen.setColor(color);
+    invalidate();
+}
+
+void TrailCanvasItem::setWidth(int pixels)
+{
+    m_pen.setWidth(pixels);
+    invalidate();
+}
+
+void TrailCanvasItem::setStore(const TrailStore *store)
+{
+    m_stores.clear();
+    if (store) {
+        m_stores.append(store);
+    }
+    invalidate();
+}
+
+void TrailCanvasItem::setStores(const QVector<const TrailStore *> &stores)
+{
+    m_stores = stores;
+    invalidate();
+}
+
+void TrailCanvasItem::setRenderTier(RenderTierStats::Tier tier)
+{
+    m_tier = tier;
+    invalidate();
+}
+
+void TrailCanvasItem::setDraft(bool draft)
+{
+    if (draft != m_draft) {
+        m_draft = draft;
+        invalidate();
+    }
+}
+
+void TrailCanvasItem::invalidate()
+{
+    m_cacheValid = false;
+    m_cache = QImage();
+    update();
+}
+
+int TrailCanvasItem::lastVertexCount() const
+{
+    return m_lastVertexCount;
+}
+
+void TrailCanvasItem::paint(QPainter *painter)
+{
+    if (!painter || m_stores.isEmpty()) {
+        m_lastVertexCount = 0;
+        return;
+    }
+
+    if (m_tier == RenderTierStats::Live) {
+        RenderTierStats::ScopedRender render(m_tier);
+        m_lastVertexCount = drawStores(painter);
+        return;
+    }
+
+    // Overlays repainting above this item reuse the image; only a new view
+    // or new stores draw the trail again
+    const QgsRectangle extent = mMapCanvas->mapSettings().visibleExtent();
+    const qreal ratio = painter->device() ? painter->device()->devicePixelRatioF() : 1.0;
+    const QSize size = (boundingRect().size() * ratio).toSize();
+    if (m_cacheValid && m_cacheExtent == extent && m_cache.size() == size) {
+        RenderTierStats::instance().recordHit(m_tier);
+    } else {
+        RenderTierStats::ScopedRender render(m_tier);
+        m_cache = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        m_cache.setDevicePixelRatio(ratio);
+        m_cache.fill(Qt::transparent);
+        QPainter imagePainter(&m_cache);
+        m_lastVertexCount = drawStores(&imagePainter);
+        imagePainter.end();
+        m_cacheExtent = extent;
+        m_cacheValid = true;
+    }
+    painter->drawImage(QPointF(0, 0), m_cache);
+}
+
+int TrailCanvasItem::drawStores(QPainter *painter)
+{
+    const QgsMapToPixel &mapToPixel = mMapCanvas->mapSettings().mapToPixel();
+
+    // Pad the view by the pen width so strokes crossing the edge still draw
+    QgsRectangle visible = mMapCanvas->mapSettings().visibleExtent();
+    visible.grow(mapToPixel.mapUnitsPerPixel() * m_pen.widthF());
+
+    painter->setRenderHint(QPainter::Antialiasing, !m_draft);
+    painter->setPen(m_pen);
+    painter->setBrush(Qt::NoBrush);
+
+    // Item coordinates are relative to the top-left corner set by setRect()
+    const int level = levelOfDetail(mapToPixel, m_draft);
+    int vertexCount = 0;
+    for (const TrailStore *store : qAsConst(m_stores)) {
+        vertexCount += drawTrail(painter, *store, mapToPixel, visible, level, pos());
+    }
+    return vertexCount;
+}
+
+int TrailCanvasItem::levelOfDetail(const QgsMapToPixel &mapToPixel, bool draft)
+{
+    return TrailStore::levelForTolerance(mapToPixel.mapUnitsPerPixel()
+                                         * (draft ? DRAFT_TOLERANCE_PIXELS : TOLERANCE_PIXELS));
+}
+
+int TrailCanvasItem::drawTrail(QPainter *painter, const TrailStore &store, const QgsMapToPixel &mapToPixel,
+                               const QgsRectangle &visible, int level, const QPointF &origin)
+{
+    int vertexCount = 0;
+    QPolygonF polyline;
+    bool hasPrevious = false;
+    double previousX = 0.0;
+    double previousY = 0.0;
+
+    for (int i = 0; i < store.chunkCount(); ++i) {
+        const TrailStore::Chunk &chunk = store.chunk(i);
+
+        // The segment joining the previous chunk belongs to this one
+        double minX = chunk.minX;
+        double minY = chunk.minY;
+        double maxX = chunk.maxX;
+        double maxY = chunk.maxY;
+        if (hasPrevious) {
+            minX = qMin(minX, previousX);
+            minY = qMin(minY, previousY);
+            maxX = qMax(maxX, previousX);
+            maxY = qMax(maxY, previousY);
+        }
+
+        const bool intersects = maxX >= visible.xMinimum() && minX <= visible.xMaximum()
+                                && maxY >= visible.yMinimum() && minY <= visible.yMaximum();
+        if (intersects) {
+            const QVector<int> &indices = store.simplified(i, level);
+
+            polyline.clear();
+            polyline.reserve(indices.size() + 1);
+            if (hasPrevious) {
+                double x = previousX;
+                double y = previousY;
+                mapToPixel.transformInPlace(x, y);
+                polyline.append(QPointF(x, y) - origin);
+            }
+            for (int index : indices) {
+                double x = chunk.x[index];
+                double y = chunk.y[index];
+                mapToPixel.transformInPlace(x, y);
+                polyline.append(QPointF(x, y) - origin);
+            }
+
+            if (polyline.size() == 1) {
+                painter->drawPoint(polyline.first());
+            } else {
+                painter->drawPolyline(polyline);
+            }
+            vertexCount += polyline.size();
+        }
+
+        previousX = chunk.x.last();
+        previousY = chunk.y.last();
+        hasPrevious = true;
+    }
+
+    return vertexCount;
+}
+
+void TrailCanvasItem::updatePosition()
+{
+    // Cover the visible map; called by the canvas after pan/zoom/resize
+    setRect(mMapCanvas->extent());
+}
@@ -0,0 +1,83 @@
+#ifndef TRAILCANVASITEM_H
+#define TRAILCANVASITEM_H
+
+#include <QImage>
+#include <QPen>
+#include <QVector>
+
+#include <qgsmapcanvasitem.h>
+#include <qgsrectangle.h>
+
+#include "rendertierstats.h"
+
+class QgsMapToPixel;
+class TrailStore;
+
+// Draws a TrailStore as a polyline overlay on the map canvas.
+//
+// Chunks outside the visible extent are skipped by their bounding box and
+// visible ones are drawn from their cached Douglas-Peucker simplification
+// at the current scale, so the number of vertices painted tracks the
+// on-screen length of the trail rather than the number of stored fixes.
+//
+// On the live tier every paint draws the trail. On a cached tier the trail
+// is drawn once into an image, which later paints reuse until the extent,
+// scale or stores change; stores must then not change behind the item.
+class TrailCanvasItem : public QgsMapCanvasItem
+{
+public:
+    TrailCanvasItem(QgsMapCanvas *mapCanvas, const TrailStore *store);
+
+    void setStore(const TrailStore *store);
+
+    // Draws several trails as separate polylines, e.g. archive pieces that
+    // are loaded independently
+    void setStores(const QVector<const TrailStore *> &stores);
+    void setColor(const QColor &color);
+    void setWidth(int pixels);
+
+    // Live by default; RenderTierStats::History caches the drawn trail
+    void setRenderTier(RenderTierStats::Tier tier);
+
+    // Drops the cached image, e.g. after a store changed
+    void invalidate();
+
+    // Draft quality draws without antialiasing from a coarser simplification
+    void setDraft(bool draft);
+
+    // Vertices drawn by the last render, for diagnostics
+    int lastVertexCount() const;
+
+    void paint(QPainter *painter) override;
+    void updatePosition() override;
+
+    // Simplification level that keeps the line within TOLERANCE_PIXELS,
+    // or DRAFT_TOLERANCE_PIXELS for draft quality
+    static int levelOfDetail(const QgsMapToPixel &mapToPixel, bool draft = false);
+
+    // Draws the visible part of a trail with the painter's current pen;
+    // origin is the painter position of map pixel (0, 0). Returns the
+    // number of vertices drawn.
+    static int drawTrail(QPainter *painter, const TrailStore &store, const QgsMapToPixel &mapToPixel,
+                         const QgsRectangle &visible, int level, const QPointF &origin);
+
+private:
+    int drawStores(QPainter *painter);
+
+    QVector<const TrailStore *> m_stores;
+    QPen m_pen;
+    int m_lastVertexCount;
+    bool m_draft;
+
+    // Image of a cached tier and the view it was drawn for
+    RenderTierStats::Tier m_tier;
+    QImage m_cache;
+    QgsRectangle m_cacheExtent;
+    bool m_cacheValid;
+
+    // Simplification may move the line by at most this many pixels
+    static constexpr double TOLERANCE_PIXELS = 0.5;
+    static constexpr double DRAFT_TOLERANCE_PIXELS = 2.0;
+};
+
+#endif // TRAILCANVASITEM_H
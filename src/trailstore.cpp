@@ -0,0 +1,199 @@
+#include "trailstore.h"
+
+#include <QPair>
+
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Level 0 keeps everything that deviates by more than 0.25 map units
+// (metres in Web Mercator); each level doubles the tolerance
+const double BASE_TOLERANCE = 0.25;
+
+} // namespace
+
+TrailStore::TrailStore()
+    : m_size(0)
+    , m_minX(0.0)
+    , m_minY(0.0)
+    , m_maxX(0.0)
+    , m_maxY(0.0)
+{
+}
+
+void TrailStore::append(double longitude, double latitude, double altitude, qint64 timestampMs,
+                        double mapX, double mapY)
+{
+    if (m_chunks.empty() || m_chunks.back()->chunk.isFull()) {
+        std::unique_ptr<ChunkData> data(new ChunkData);
+        Chunk &chunk = data->chunk;
+        chunk.minX = chunk.minY = std::numeric_limits<double>::max();
+        chunk.maxX = chunk.maxY = std::numeric_limits<double>::lowest();
+        m_chunks.push_back(std::move(data));
+    }
+
+    Chunk &chunk = m_chunks.back()->chunk;
+    chunk.longitude.append(longitude);
+    chunk.latitude.append(latitude);
+    chunk.altitude.append(altitude);
+    chunk.timestampMs.append(timestampMs);
+    chunk.x.append(mapX);
+    chunk.y.append(mapY);
+
+    chunk.minX = qMin(chunk.minX, mapX);
+    chunk.minY = qMin(chunk.minY, mapY);
+    chunk.maxX = qMax(chunk.maxX, mapX);
+    chunk.maxY = qMax(chunk.maxY, mapY);
+
+    if (m_size == 0) {
+        m_minX = m_maxX = mapX;
+        m_minY = m_maxY = mapY;
+    } else {
+        m_minX = qMin(m_minX, mapX);
+        m_minY = qMin(m_minY, mapY);
+        m_maxX = qMax(m_maxX, mapX);
+        m_maxY = qMax(m_maxY, mapY);
+    }
+
+    ++m_size;
+}
+
+void TrailStore::clear()
+{
+    m_chunks.clear();
+    m_size = 0;
+}
+
+qint64 TrailStore::size() const
+{
+    return m_size;
+}
+
+bool TrailStore::isEmpty() const
+{
+    return m_size == 0;
+}
+
+int TrailStore::chunkCount() const
+{
+    return int(m_chunks.size());
+}
+
+const TrailStore::Chunk &TrailStore::chunk(int index) const
+{
+    return m_chunks[size_t(index)]->chunk;
+}
+
+bool TrailStore::mapExtent(double &minX, double &minY, double &maxX, double &maxY) const
+{
+    if (m_size == 0) {
+        return false;
+    }
+
+    minX = m_minX;
+    minY = m_minY;
+    maxX = m_maxX;
+    maxY = m_maxY;
+    return true;
+}
+
+int TrailStore::levelForTolerance(double mapUnits)
+{
+    if (!(mapUnits > BASE_TOLERANCE)) {
+        return 0;
+    }
+    const int level = int(std::floor(std::log2(mapUnits / BASE_TOLERANCE)));
+    return qBound(0, level, LOD_LEVELS - 1);
+}
+
+double TrailStore::toleranceForLevel(int level)
+{
+    return std::ldexp(BASE_TOLERANCE, level);
+}
+
+const QVector<int> &TrailStore::simplified(int chunkIndex, int level) const
+{
+    const ChunkData &data = *m_chunks[size_t(chunkIndex)];
+    level = qBound(0, level, LOD_LEVELS - 1);
+
+    if (!data.chunk.isFull()) {
+        // The open chunk still grows, so its simplification is not cached
+        simplify(data.chunk, toleranceForLevel(level), m_openChunkLod);
+        return m_openChunkLod;
+    }
+
+    if (!data.lodValid[level]) {
+        simplify(data.chunk, toleranceForLevel(level), data.lod[level]);
+        data.lod[level].squeeze();
+        data.lodValid[level] = true;
+    }
+    return data.lod[level];
+}
+
+void TrailStore::simplify(const Chunk &chunk, double tolerance, QVector<int> &result)
+{
+    // Iterative Douglas-Peucker over the projected columns
+    result.clear();
+    const int count = chunk.size();
+    if (count <= 2) {
+        for (int i = 0; i < count; ++i) {
+            result.append(i);
+        }
+        return;
+    }
+
+    const double *x = chunk.x.constData();
+    const double *y = chunk.y.constData();
+    const double toleranceSquared = tolerance * tolerance;
+
+    QVector<char> keep(count, 0);
+    keep[0] = 1;
+    keep[count - 1] = 1;
+
+    QVector<QPair<int, int>> stack;
+    stack.append(qMakePair(0, count - 1));
+    while (!stack.isEmpty()) {
+        const QPair<int, int> range = stack.takeLast();
+        const int first = range.first;
+        const int last = range.second;
+        if (last - first < 2) {
+            continue;
+        }
+
+        const double dx = x[last] - x[first];
+        const double dy = y[last] - y[first];
+        const double lengthSquared = dx * dx + dy * dy;
+
+        double maxDistanceSquared = -1.0;
+        int farthest = -1;
+        for (int i = first + 1; i < last; ++i) {
+            double px = x[i] - x[first];
+            double py = y[i] - y[first];
+            if (lengthSquared > 0.0) {
+                // Distance to the segment, not the infinite line, so loops
+                // and back-tracking are preserved
+                const double t = qBound(0.0, (px * dx + py * dy) / lengthSquared, 1.0);
+                px -= t * dx;
+                py -= t * dy;
+            }
+            const double distanceSquared = px * px + py * py;
+            if (distanceSquared > maxDistanceSquared) {
+                maxDistanceSquared = distanceSquared;
+                farthest = i;
+            }
+        }
+
+        if (maxDistanceSquared > toleranceSquared) {
+            keep[farthest] = 1;
+            stack.append(qMakePair(first, farthest));
+            stack.append(qMakePair(farthest, last));
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (keep[i]) {
+            result.append(i);
+        }
+    }
+}
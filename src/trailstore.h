@@ -0,0 +1,86 @@
+#ifndef TRAILSTORE_H
+#define TRAILSTORE_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <memory>
+#include <vector>
+
+// Append-only GPS trail stored as struct-of-arrays chunks.
+//
+// Each chunk holds up to CHUNK_SIZE fixes in separate lon/lat/alt/time
+// columns plus their projected map coordinates and a bounding box, so a
+// renderer can skip chunks outside the view without touching their points.
+// Full chunks never change again; their Douglas-Peucker simplifications
+// are computed once per level of detail and cached. Columns grow on demand,
+// so a short trail (one of thousands of tracks) stays small.
+class TrailStore
+{
+public:
+    static const int CHUNK_SIZE = 4096;
+    static const int LOD_LEVELS = 28;
+
+    struct Chunk
+    {
+        QVector<double> longitude;
+        QVector<double> latitude;
+        QVector<double> altitude;
+        QVector<qint64> timestampMs;
+
+        // Map CRS coordinates of the same points
+        QVector<double> x;
+        QVector<double> y;
+
+        double minX;
+        double minY;
+        double maxX;
+        double maxY;
+
+        int size() const { return x.size(); }
+        bool isFull() const { return x.size() >= CHUNK_SIZE; }
+    };
+
+    TrailStore();
+
+    void append(double longitude, double latitude, double altitude, qint64 timestampMs,
+                double mapX, double mapY);
+    void clear();
+
+    qint64 size() const;
+    bool isEmpty() const;
+    int chunkCount() const;
+    const Chunk &chunk(int index) const;
+
+    // Bounding box of all points in map coordinates; false when empty
+    bool mapExtent(double &minX, double &minY, double &maxX, double &maxY) const;
+
+    // Coarsest level whose tolerance does not exceed the given distance
+    // (typically one pixel in map units)
+    static int levelForTolerance(double mapUnits);
+    static double toleranceForLevel(int level);
+
+    // Indices of the points kept by Douglas-Peucker at the given level.
+    // Cached for full chunks; computed on each call for the open chunk.
+    const QVector<int> &simplified(int chunkIndex, int level) const;
+
+private:
+    struct ChunkData
+    {
+        Chunk chunk;
+        mutable QVector<int> lod[LOD_LEVELS];
+        mutable bool lodValid[LOD_LEVELS] = {};
+    };
+
+    static void simplify(const Chunk &chunk, double tolerance, QVector<int> &result);
+
+    std::vector<std::unique_ptr<ChunkData>> m_chunks;
+    qint64 m_size;
+    double m_minX;
+    double m_minY;
+    double m_maxX;
+    double m_maxY;
+    mutable QVector<int> m_openChunkLod;
+};
+
+#endif // TRAILSTORE_H
@@ -1,65 +1,195 @@
 #include "udpreceiver.h"
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QDateTime>
-#include <QDebug>
-#include <QRegularExpression>
+#include "udpreceiverworker.h"
+#include "batchdatagramreader.h"
+#include "capturefile.h"
+#include "fixbus.h"
+#include "latencymonitor.h"
+
+#include "logger.h"
+
+#include <QThread>
 
 UdpReceiver::UdpReceiver(QObject *parent)
+    : UdpReceiver(WorkerThread, parent)
+{
+}
+
+UdpReceiver::UdpReceiver(ThreadingMode mode, QObject *parent)
     : QObject(parent)
-    , m_udpSocket(nullptr)
-    , m_port(0)
+    , m_threadingMode(mode)
+    , m_activeWorkers(0)
     , m_isListening(false)
-    , m_connectionTimer(nullptr)
-    , m_lastDataTime(0)
     , m_isConnected(false)
+    , m_isReplaying(false)
+    , m_replayStartTimeUs(0)
+    , m_replayEndTimeUs(0)
 {
-    m_udpSocket = new QUdpSocket(this);
-    connect(m_udpSocket, &QUdpSocket::readyRead,
-            this, &UdpReceiver::processPendingDatagrams);
-    
-    // Setup connection monitoring timer
-    m_connectionTimer = new QTimer(this);
-    connect(m_connectionTimer, &QTimer::timeout,
-            this, &UdpReceiver::checkConnectionTimeout);
-    m_connectionTimer->start(1000); // Check every second
+    qRegisterMetaType<GpsFix>();
+    qRegisterMetaType<QVector<GpsFix>>();
+    m_batch.reserve(FIX_QUEUE_CAPACITY);
+
+    UdpReceiverWorker *worker = createWorker();
+
+    // Only the first worker replays
+    connect(worker, &UdpReceiverWorker::replayPosition,
+            this, &UdpReceiver::replayPosition);
+    connect(worker, &UdpReceiverWorker::replayFinished,
+            this, &UdpReceiver::replayFinished);
 }
 
 UdpReceiver::~UdpReceiver()
 {
     stopListening();
+    stopReplay();
+    stopRecording();
+
+    for (QThread *thread : qAsConst(m_workerThreads)) {
+        thread->quit();
+        thread->wait();
+    }
+}
+
+UdpReceiverWorker *UdpReceiver::createWorker()
+{
+    UdpReceiverWorker *worker;
+    if (m_threadingMode == WorkerThread) {
+        worker = new UdpReceiverWorker(FIX_QUEUE_CAPACITY);
+        QThread *thread = new QThread(this);
+        thread->setObjectName(m_workers.isEmpty() ? QString("UdpReceiver")
+                                                  : QString("UdpReceiver-%1").arg(m_workers.size()));
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        thread->start(QThread::HighPriority);
+        m_workerThreads.append(thread);
+    } else {
+        worker = new UdpReceiverWorker(FIX_QUEUE_CAPACITY, this);
+    }
+
+    // Cross-thread connections are queued automatically
+    connect(worker, &UdpReceiverWorker::fixesAvailable,
+            this, &UdpReceiver::drainFixes);
+    connect(worker, &UdpReceiverWorker::connectionStatusChanged,
+            this, &UdpReceiver::onWorkerConnectionStatusChanged);
+    connect(worker, &UdpReceiverWorker::errorOccurred,
+            this, &UdpReceiver::errorOccurred);
+    connect(worker, &UdpReceiverWorker::archiveSegmentSealed,
+            this, &UdpReceiver::archiveSegmentSealed);
+    connect(worker, &UdpReceiverWorker::recordingFailed,
+            this, &UdpReceiver::onWorkerRecordingFailed);
+
+    // Workers joining later pick up a recording in progress
+    if (m_recorder) {
+        QMetaObject::invokeMethod(worker, [worker, recorder = m_recorder]() {
+            worker->setRecorder(recorder);
+        }, workerConnectionType());
+    }
+    if (m_busWriter) {
+        QMetaObject::invokeMethod(worker, [worker, bus = m_busWriter]() {
+            worker->setBusWriter(bus);
+        }, workerConnectionType());
+    }
+
+    m_workers.append(worker);
+    m_workerConnected.append(false);
+    return worker;
 }
 
 bool UdpReceiver::startListening(quint16 port)
+{
+    ReceiverEndpoint endpoint;
+    endpoint.port = port;
+    ReceiverConfig config;
+    config.endpoints.append(endpoint);
+    return startListening(config);
+}
+
+bool UdpReceiver::startListening(const ReceiverConfig &config)
 {
     if (m_isListening) {
         stopListening();
     }
-    
-    if (m_udpSocket->bind(QHostAddress::Any, port)) {
-        m_port = port;
-        m_isListening = true;
-        m_lastDataTime = 0;
-        m_isConnected = false;
-        
-        qDebug() << "UDP receiver started on port" << port;
-        return true;
-    } else {
-        qDebug() << "Failed to bind UDP socket to port" << port;
-        emit errorOccurred(QString("Failed to bind to port %1").arg(port));
-        return false;
+
+    ReceiverConfig effective = config;
+    effective.threads = qBound(1, config.threads, int(MAX_THREADS));
+    if (effective.threads > 1 && (m_threadingMode != WorkerThread || !BatchDatagramReader::isReusePortSupported())) {
+        GPS_LOG_WARNING(Logger::Network, "SO_REUSEPORT fan-out is not available; using one receiver thread");
+        effective.threads = 1;
+    }
+
+    if (!effective.busOutput.isEmpty()) {
+        if (effective.busOutput == effective.busInput) {
+            GPS_LOG_ERROR(Logger::Network, "Fix bus {} cannot be both input and output", effective.busOutput);
+            emit errorOccurred(QString("Fix bus %1 cannot be both input and output").arg(effective.busOutput));
+            return false;
+        }
+
+        // One ring shared by every receiver thread, created before any of
+        // them starts so no fix misses it
+        std::shared_ptr<FixBusWriter> bus = std::make_shared<FixBusWriter>();
+        if (!bus->create(effective.busOutput,
+                         effective.busCapacity > 0 ? effective.busCapacity : int(FixBusWriter::DEFAULT_CAPACITY))) {
+            const QString message = QString("Cannot publish to fix bus %1: %2")
+                                        .arg(effective.busOutput, bus->errorString());
+            GPS_LOG_ERROR(Logger::Network, "{}", message);
+            emit errorOccurred(message);
+            return false;
+        }
+        for (UdpReceiverWorker *worker : qAsConst(m_workers)) {
+            QMetaObject::invokeMethod(worker, [worker, bus]() {
+                worker->setBusWriter(bus);
+            }, workerConnectionType());
+        }
+        m_busWriter = bus;
+        GPS_LOG_INFO(Logger::Network, "Publishing fixes to fix bus {}", effective.busOutput);
     }
+
+    while (m_workers.size() < effective.threads) {
+        createWorker();
+    }
+
+    for (int i = 0; i < effective.threads; ++i) {
+        UdpReceiverWorker *worker = m_workers[i];
+        bool ok = false;
+        QMetaObject::invokeMethod(worker, [worker, &effective, i, &ok]() {
+            ok = worker->startListening(effective, i);
+        }, workerConnectionType());
+
+        if (!ok) {
+            // Release the ports the other threads already hold
+            for (int started = 0; started < i; ++started) {
+                UdpReceiverWorker *startedWorker = m_workers[started];
+                QMetaObject::invokeMethod(startedWorker, [startedWorker]() {
+                    startedWorker->stopListening();
+                }, workerConnectionType());
+            }
+            closeBusWriter();
+            return false;
+        }
+    }
+
+    m_config = effective;
+    m_activeWorkers = effective.threads;
+    m_isListening = true;
+    return true;
 }
 
 void UdpReceiver::stopListening()
 {
     if (m_isListening) {
-        m_udpSocket->close();
+        for (int i = 0; i < m_activeWorkers; ++i) {
+            UdpReceiverWorker *worker = m_workers[i];
+            QMetaObject::invokeMethod(worker, [worker]() {
+                worker->stopListening();
+            }, workerConnectionType());
+        }
+
+        closeBusWriter();
         m_isListening = false;
-        m_port = 0;
+        m_activeWorkers = 0;
+        m_config = ReceiverConfig();
+        m_workerConnected.fill(false);
         m_isConnected = false;
         emit connectionStatusChanged(false);
-        qDebug() << "UDP receiver stopped";
     }
 }
 
@@ -70,182 +200,233 @@ bool UdpReceiver::isListening() const
 
 quint16 UdpReceiver::currentPort() const
 {
-    return m_port;
-}
-
-void UdpReceiver::processPendingDatagrams()
-{
-    while (m_udpSocket->hasPendingDatagrams()) {
-        QByteArray datagram;
-        datagram.resize(m_udpSocket->pendingDatagramSize());
-        QHostAddress sender;
-        quint16 senderPort;
-        
-        m_udpSocket->readDatagram(datagram.data(), datagram.size(),
-                                 &sender, &senderPort);
-        
-        qDebug() << "Received datagram from" << sender.toString() << ":" << senderPort;
-        qDebug() << "Data:" << datagram;
-        
-        double latitude, longitude, altitude;
-        if (parseGpsData(datagram, latitude, longitude, altitude)) {
-            m_lastDataTime = QDateTime::currentMSecsSinceEpoch();
-            
-            if (!m_isConnected) {
-                m_isConnected = true;
-                emit connectionStatusChanged(true);
-            }
-            
-            emit gpsDataReceived(latitude, longitude, altitude);
-        } else {
-            qDebug() << "Failed to parse GPS data:" << datagram;
-            emit errorOccurred("Failed to parse GPS data");
-        }
-    }
+    return m_config.endpoints.isEmpty() ? 0 : m_config.endpoints.first().port;
 }
 
-void UdpReceiver::checkConnectionTimeout()
+ReceiverConfig UdpReceiver::config() const
 {
-    if (!m_isListening) {
-        return;
-    }
-    
-    qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-    
-    if (m_isConnected && m_lastDataTime > 0) {
-        if (currentTime - m_lastDataTime > CONNECTION_TIMEOUT_MS) {
-            m_isConnected = false;
-            emit connectionStatusChanged(false);
-            qDebug() << "Connection timeout - no data received for" << CONNECTION_TIMEOUT_MS << "ms";
-        }
+    return m_config;
+}
+
+UdpReceiver::ThreadingMode UdpReceiver::threadingMode() const
+{
+    return m_threadingMode;
+}
+
+quint64 UdpReceiver::datagramsReceived() const
+{
+    quint64 total = 0;
+    for (const UdpReceiverWorker *worker : m_workers) {
+        total += worker->datagramsReceived();
     }
+    return total;
 }
 
-bool UdpReceiver::parseGpsData(const QByteArray &data, double &latitude, double &longitude, double &altitude)
+quint64 UdpReceiver::parseErrors() const
 {
-    // Try different formats
-    
-    // 1. Try JSON format first
-    if (parseJsonFormat(data, latitude, longitude, altitude)) {
-        return true;
+    quint64 total = 0;
+    for (const UdpReceiverWorker *worker : m_workers) {
+        total += worker->parseErrors();
     }
-    
-    // 2. Try CSV format
-    if (parseCSVFormat(data, latitude, longitude, altitude)) {
-        return true;
+    return total;
+}
+
+quint64 UdpReceiver::droppedFixes() const
+{
+    quint64 total = 0;
+    for (const UdpReceiverWorker *worker : m_workers) {
+        total += worker->queueDrops();
     }
-    
-    // 3. Try NMEA format
-    if (parseNMEAFormat(data, latitude, longitude, altitude)) {
-        return true;
+    return total;
+}
+
+quint64 UdpReceiver::kernelDrops() const
+{
+    quint64 total = 0;
+    for (const UdpReceiverWorker *worker : m_workers) {
+        total += worker->kernelDrops();
     }
-    
-    return false;
+    return total;
 }
 
-bool UdpReceiver::parseJsonFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude)
+quint64 UdpReceiver::busOverruns() const
 {
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
-    
-    if (error.error != QJsonParseError::NoError) {
-        return false;
+    quint64 total = 0;
+    for (const UdpReceiverWorker *worker : m_workers) {
+        total += worker->busOverruns();
     }
-    
-    QJsonObject obj = doc.object();
-    
-    // Check for required fields
-    if (!obj.contains("latitude") || !obj.contains("longitude")) {
+    return total;
+}
+
+bool UdpReceiver::startRecording(const QString &path)
+{
+    stopRecording();
+
+    // One capture shared by every receiver thread
+    std::shared_ptr<CaptureWriter> recorder = std::make_shared<CaptureWriter>();
+    if (!recorder->open(path)) {
+        GPS_LOG_ERROR(Logger::Network, "Cannot record to {}: {}", path, recorder->errorString());
         return false;
     }
-    
-    latitude = obj["latitude"].toDouble();
-    longitude = obj["longitude"].toDouble();
-    altitude = obj.value("altitude").toDouble(0.0); // Default to 0 if not present
-    
-    // Basic validation
-    if (latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0) {
-        return false;
+
+    for (UdpReceiverWorker *worker : qAsConst(m_workers)) {
+        QMetaObject::invokeMethod(worker, [worker, recorder]() {
+            worker->setRecorder(recorder);
+        }, workerConnectionType());
     }
-    
+    m_recorder = recorder;
+
+    GPS_LOG_INFO(Logger::Network, "Recording datagrams to {}", path);
     return true;
 }
 
-bool UdpReceiver::parseCSVFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude)
+void UdpReceiver::stopRecording()
 {
-    QString str = QString::fromUtf8(data).trimmed();
-    QStringList parts = str.split(',');
-    
-    if (parts.size() < 2) {
-        return false;
-    }
-    
-    bool latOk, lonOk, altOk = true;
-    latitude = parts[0].toDouble(&latOk);
-    longitude = parts[1].toDouble(&lonOk);
-    
-    if (parts.size() >= 3) {
-        altitude = parts[2].toDouble(&altOk);
-    } else {
-        altitude = 0.0;
+    if (m_recorder) {
+        // Blocking, so no worker appends once the file is closed
+        for (UdpReceiverWorker *worker : qAsConst(m_workers)) {
+            QMetaObject::invokeMethod(worker, [worker]() {
+                worker->setRecorder(nullptr);
+            }, workerConnectionType());
+        }
+
+        GPS_LOG_INFO(Logger::Network, "Recorded {} datagrams", m_recorder->datagramsWritten());
+        m_recorder->close();
+        m_recorder.reset();
     }
-    
-    if (!latOk || !lonOk || !altOk) {
-        return false;
+}
+
+void UdpReceiver::closeBusWriter()
+{
+    if (m_busWriter) {
+        // Blocking, so no worker publishes once the ring is unmapped
+        for (UdpReceiverWorker *worker : qAsConst(m_workers)) {
+            QMetaObject::invokeMethod(worker, [worker]() {
+                worker->setBusWriter(nullptr);
+            }, workerConnectionType());
+        }
+
+        GPS_LOG_INFO(Logger::Network, "Published {} fixes to fix bus {}", m_busWriter->published(),
+                     m_busWriter->name());
+        m_busWriter->close();
+        m_busWriter.reset();
     }
-    
-    // Basic validation
-    if (latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0) {
-        return false;
+}
+
+bool UdpReceiver::isRecording() const
+{
+    return m_recorder != nullptr;
+}
+
+bool UdpReceiver::startReplay(const QString &path, double speed)
+{
+    UdpReceiverWorker *worker = m_workers.first();
+    bool ok = false;
+    QMetaObject::invokeMethod(worker, [this, worker, path, speed, &ok]() {
+        ok = worker->startReplay(path, speed);
+        m_replayStartTimeUs = worker->replayStartTimeUs();
+        m_replayEndTimeUs = worker->replayEndTimeUs();
+    }, workerConnectionType());
+
+    m_isReplaying = ok;
+    return ok;
+}
+
+void UdpReceiver::stopReplay()
+{
+    if (m_isReplaying) {
+        UdpReceiverWorker *worker = m_workers.first();
+        QMetaObject::invokeMethod(worker, [worker]() {
+            worker->stopReplay();
+        }, workerConnectionType());
+        m_isReplaying = false;
     }
-    
-    return true;
 }
 
-bool UdpReceiver::parseNMEAFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude)
+bool UdpReceiver::isReplaying() const
 {
-    QString str = QString::fromUtf8(data).trimmed();
-    
-    // Simple GPGGA parser
-    if (!str.startsWith("$GPGGA")) {
-        return false;
+    return m_isReplaying;
+}
+
+void UdpReceiver::setReplaySpeed(double speed)
+{
+    // Fire and forget: nothing to report back, so the GUI does not wait
+    UdpReceiverWorker *worker = m_workers.first();
+    QMetaObject::invokeMethod(worker, [worker, speed]() {
+        worker->setReplaySpeed(speed);
+    }, m_threadingMode == WorkerThread ? Qt::QueuedConnection : Qt::DirectConnection);
+}
+
+void UdpReceiver::seekReplay(qint64 timeUs)
+{
+    UdpReceiverWorker *worker = m_workers.first();
+    QMetaObject::invokeMethod(worker, [worker, timeUs]() {
+        worker->seekReplay(timeUs);
+    }, m_threadingMode == WorkerThread ? Qt::QueuedConnection : Qt::DirectConnection);
+}
+
+qint64 UdpReceiver::replayStartTimeUs() const
+{
+    return m_replayStartTimeUs;
+}
+
+qint64 UdpReceiver::replayEndTimeUs() const
+{
+    return m_replayEndTimeUs;
+}
+
+void UdpReceiver::drainFixes()
+{
+    // m_batch keeps its capacity across clear(), so steady state does not allocate
+    m_batch.clear();
+    GpsFix fix;
+    for (UdpReceiverWorker *worker : qAsConst(m_workers)) {
+        worker->beginDrain();
+        while (worker->takeFix(fix)) {
+            m_batch.append(fix);
+        }
     }
-    
-    QStringList parts = str.split(',');
-    if (parts.size() < 15) {
-        return false;
+
+    if (!m_batch.isEmpty()) {
+        LatencyMonitor &latency = LatencyMonitor::instance();
+        const qint64 nowNs = LatencyMonitor::now();
+        for (const GpsFix &drained : qAsConst(m_batch)) {
+            latency.record(LatencyMonitor::Delivered, drained.receiveNs, nowNs);
+        }
+        emit gpsFixesReceived(m_batch);
     }
-    
-    // Parse latitude (field 2 and 3)
-    if (parts[2].isEmpty() || parts[3].isEmpty()) {
-        return false;
+}
+
+void UdpReceiver::onWorkerConnectionStatusChanged(bool connected)
+{
+    // Connected while any receiver thread has live input
+    const int index = m_workers.indexOf(qobject_cast<UdpReceiverWorker *>(sender()));
+    if (index < 0) {
+        return;
     }
-    
-    double lat = parts[2].left(2).toDouble() + parts[2].mid(2).toDouble() / 60.0;
-    if (parts[3] == "S") lat = -lat;
-    
-    // Parse longitude (field 4 and 5)
-    if (parts[4].isEmpty() || parts[5].isEmpty()) {
-        return false;
+    m_workerConnected[index] = connected;
+
+    const bool anyConnected = m_workerConnected.contains(true);
+    if (anyConnected != m_isConnected) {
+        m_isConnected = anyConnected;
+        emit connectionStatusChanged(anyConnected);
     }
-    
-    double lon = parts[4].left(3).toDouble() + parts[4].mid(3).toDouble() / 60.0;
-    if (parts[5] == "W") lon = -lon;
-    
-    // Parse altitude (field 9)
-    double alt = 0.0;
-    if (!parts[9].isEmpty()) {
-        alt = parts[9].toDouble();
-    }
-    
-    latitude = lat;
-    longitude = lon;
-    altitude = alt;
-    
-    // Basic validation
-    if (latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0) {
-        return false;
+}
+
+void UdpReceiver::onWorkerRecordingFailed(const QString &error)
+{
+    // The first failing worker stops the capture for all of them; later
+    // reports of the same failure find it already stopped
+    if (!m_recorder) {
+        return;
     }
-    
-    return true;
-}
\ No newline at end of file
+    stopRecording();
+    emit errorOccurred(QString("Recording stopped: %1").arg(error));
+    emit recordingStopped(error);
+}
+
+Qt::ConnectionType UdpReceiver::workerConnectionType() const
+{
+    // startListening() reports the bind result, so wait for the worker
+    return m_threadingMode == WorkerThread ? Qt::BlockingQueuedConnection : Qt::DirectConnection;
+}
@@ -2,47 +2,122 @@
 #define UDPRECEIVER_H
 
 #include <QObject>
-#include <QUdpSocket>
-#include <QTimer>
-#include <QHostAddress>
+#include <QVector>
+
+#include <memory>
+
+#include "gpsfix.h"
+#include "receiverconfig.h"
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+class CaptureWriter;
+class FixBusWriter;
+class UdpReceiverWorker;
 
 class UdpReceiver : public QObject
 {
     Q_OBJECT
 
 public:
+    // WorkerThread runs the socket, parsing and timeout monitoring on a
+    // dedicated QThread; GuiThread keeps everything on the caller's thread.
+    enum ThreadingMode {
+        GuiThread,
+        WorkerThread
+    };
+
     explicit UdpReceiver(QObject *parent = nullptr);
+    explicit UdpReceiver(ThreadingMode mode, QObject *parent = nullptr);
     ~UdpReceiver();
 
+    // Listens on one port with default socket options
     bool startListening(quint16 port);
+
+    // Listens on every endpoint of config. Several threads need
+    // WorkerThread mode and SO_REUSEPORT; otherwise one thread is used.
+    // Fails if config.busOutput cannot be created.
+    bool startListening(const ReceiverConfig &config);
     void stopListening();
     bool isListening() const;
     quint16 currentPort() const;
+    ReceiverConfig config() const;
+    ThreadingMode threadingMode() const;
+
+    // Statistics since construction, summed over all receiver threads
+    quint64 datagramsReceived() const;
+    quint64 parseErrors() const;
+    quint64 droppedFixes() const;
+
+    // Datagrams the kernel discarded because a socket buffer was full;
+    // only counted on Linux
+    quint64 kernelDrops() const;
+
+    // Records the input fix bus overwrote before they were read
+    quint64 busOverruns() const;
+
+    // Raw datagram capture of everything the receiver processes
+    bool startRecording(const QString &path);
+    void stopRecording();
+    bool isRecording() const;
+
+    // Feeds a capture through the parse pipeline; speed is a multiple of
+    // real time, 0 for as fast as the GUI keeps up
+    bool startReplay(const QString &path, double speed);
+    void stopReplay();
+    bool isReplaying() const;
+    void setReplaySpeed(double speed);
+    void seekReplay(qint64 timeUs);
+    qint64 replayStartTimeUs() const;
+    qint64 replayEndTimeUs() const;
+
+    static const int MAX_THREADS = 16;
 
 signals:
-    void gpsDataReceived(double latitude, double longitude, double altitude);
+    // Every fix drained from the receiver thread since the last emission,
+    // oldest first; emitted once per burst rather than once per datagram
+    void gpsFixesReceived(const QVector<GpsFix> &fixes);
     void connectionStatusChanged(bool connected);
     void errorOccurred(const QString &error);
+    void replayPosition(qint64 timeUs);
+    void replayFinished();
+
+    // A segment of live fixes was added to the track archive
+    void archiveSegmentSealed(const QString &path);
+
+    // Recording stopped by itself because the capture could not be written
+    void recordingStopped(const QString &error);
 
 private slots:
-    void processPendingDatagrams();
-    void checkConnectionTimeout();
+    void drainFixes();
+    void onWorkerConnectionStatusChanged(bool connected);
+    void onWorkerRecordingFailed(const QString &error);
 
 private:
-    bool parseGpsData(const QByteArray &data, double &latitude, double &longitude, double &altitude);
-    bool parseJsonFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude);
-    bool parseCSVFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude);
-    bool parseNMEAFormat(const QByteArray &data, double &latitude, double &longitude, double &altitude);
-    
-    QUdpSocket *m_udpSocket;
-    quint16 m_port;
+    UdpReceiverWorker *createWorker();
+    void closeBusWriter();
+    Qt::ConnectionType workerConnectionType() const;
+
+    // m_workers[0] also replays; the others exist only for SO_REUSEPORT
+    // fan-out and are created the first time they are needed
+    QVector<UdpReceiverWorker *> m_workers;
+    QVector<QThread *> m_workerThreads;
+    QVector<bool> m_workerConnected;
+    ThreadingMode m_threadingMode;
+    ReceiverConfig m_config;
+    int m_activeWorkers;
     bool m_isListening;
-    
-    // Connection monitoring
-    QTimer *m_connectionTimer;
-    qint64 m_lastDataTime;
-    static const int CONNECTION_TIMEOUT_MS = 5000; // 5 seconds
     bool m_isConnected;
+    std::shared_ptr<CaptureWriter> m_recorder;
+    std::shared_ptr<FixBusWriter> m_busWriter;
+    bool m_isReplaying;
+    qint64 m_replayStartTimeUs;
+    qint64 m_replayEndTimeUs;
+    QVector<GpsFix> m_batch;
+
+    static const int FIX_QUEUE_CAPACITY = 4096;
 };
 
-#endif // UDPRECEIVER_H
\ No newline at end of file
+#endif // UDPRECEIVER_H
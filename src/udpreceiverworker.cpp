@@ -0,0 +1,854 @@
+#include "udpreceiverworker.h"
+#include "batchdatagramreader.h"
+#include "capturefile.h"
+#include "fixbus.h"
+#include "gpsparser.h"
+#include "latencymonitor.h"
+#include "nmeastream.h"
+#include "trackarchive.h"
+#include "webmercator.h"
+
+#include "logger.h"
+
+#include <QDateTime>
+#include <QSocketNotifier>
+
+#include <chrono>
+
+namespace {
+
+qint64 currentTimeUs()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+UdpReceiverWorker::UdpReceiverWorker(int queueCapacity, QObject *parent)
+    : QObject(parent)
+    , m_isListening(false)
+    , m_fixQueue(queueCapacity)
+    , m_notifyPending(false)
+    , m_datagramsReceived(0)
+    , m_parseErrors(0)
+    , m_queueDrops(0)
+    , m_kernelDrops(0)
+    , m_busOverruns(0)
+    , m_reportedParseErrors(0)
+    , m_connectionTimer(nullptr)
+    , m_lastDataTime(0)
+    , m_isConnected(false)
+    , m_replayReader(nullptr)
+    , m_replayTimer(nullptr)
+    , m_replayOriginUs(0)
+    , m_replaySpeed(1.0)
+    , m_lastReplayProgressMs(0)
+    , m_receiveNs(0)
+    , m_busReader(nullptr)
+    , m_busTimer(nullptr)
+    , m_busDeviceId(0)
+    , m_busReaderOverruns(0)
+    , m_archiveWriter(nullptr)
+    , m_archiveWriterId(0)
+{
+    // Room for a full batch plus one maximal binary datagram, so appending
+    // never reallocates (callers publish once BATCH_SIZE is reached)
+    m_pendingFixes.reserve(BatchDatagramReader::BATCH_SIZE + GpsParser::MAX_FIXES_PER_DATAGRAM);
+}
+
+UdpReceiverWorker::~UdpReceiverWorker()
+{
+    stopListening();
+    stopReplay();
+    delete m_replayReader;
+    delete m_busReader;
+    delete m_archiveWriter;
+    qDeleteAll(m_nmeaStreams);
+}
+
+bool UdpReceiverWorker::startListening(const ReceiverConfig &config, int workerIndex)
+{
+    if (!m_connectionTimer) {
+        m_connectionTimer = new QTimer(this);
+        connect(m_connectionTimer, &QTimer::timeout,
+                this, &UdpReceiverWorker::checkConnectionTimeout);
+    }
+
+    if (m_isListening) {
+        stopListening();
+    }
+
+    const bool reusePort = config.threads > 1;
+    for (const ReceiverEndpoint &endpoint : config.endpoints) {
+        if (workerIndex > 0 && !endpoint.group.isNull()) {
+            continue;
+        }
+
+        Listener listener;
+        listener.endpoint = endpoint;
+        if (!openListener(listener, config.receiveBufferBytes, reusePort)) {
+            closeListeners();
+            emit errorOccurred(QString("Failed to listen on %1").arg(endpoint.toString()));
+            return false;
+        }
+        m_listeners.append(listener);
+    }
+
+    const bool readsBus = workerIndex == 0 && !config.busInput.isEmpty();
+    if (m_listeners.isEmpty() && workerIndex == 0 && !readsBus) {
+        GPS_LOG_ERROR(Logger::Network, "No UDP endpoints to listen on");
+        emit errorOccurred("No UDP endpoints to listen on");
+        return false;
+    }
+
+    if (readsBus) {
+        if (!m_busReader) {
+            m_busReader = new FixBusReader;
+            m_busTimer = new QTimer(this);
+            m_busTimer->setTimerType(Qt::PreciseTimer);
+            connect(m_busTimer, &QTimer::timeout, this, &UdpReceiverWorker::processBus);
+        }
+        m_busName = config.busInput;
+        const QByteArray name = m_busName.toUtf8();
+        m_busDeviceId = GpsFix::deviceIdFromName(name.constData(), name.size());
+
+        // The producer may start later; checkConnectionTimeout() retries
+        if (!attachBus()) {
+            GPS_LOG_INFO(Logger::Network, "Waiting for fix bus {}: {}", m_busName, m_busReader->errorString());
+        }
+        m_busTimer->start(BUS_POLL_INTERVAL_MS);
+    }
+
+    const QString archiveDirectory = config.archiveDirectory.isEmpty() ? TrackArchive::defaultDirectory()
+                                                                       : config.archiveDirectory;
+    if (m_archiveWriter && (m_archiveWriterId != workerIndex || m_archiveDirectory != archiveDirectory)) {
+        sealArchiveSegment();
+        delete m_archiveWriter;
+        m_archiveWriter = nullptr;
+    }
+    m_archiveWriterId = workerIndex;
+    m_archiveDirectory = archiveDirectory;
+    openArchive();
+    if (m_archiveWriter) {
+        m_archiveWriter->setMaxBytes(config.archiveMaxBytes >= 0 ? config.archiveMaxBytes
+                                                                 : TrackArchive::defaultMaxBytes());
+    }
+    m_isListening = true;
+    m_lastDataTime = 0;
+    m_isConnected = false;
+    m_connectionTimer->start(1000); // Check every second
+
+    GPS_LOG_INFO(Logger::Network, "UDP receiver {} listening on {} ({})", workerIndex, config.endpointsString(),
+                 BatchDatagramReader::isSupported() ? "recvmmsg batch mode" : "QUdpSocket");
+    return true;
+}
+
+bool UdpReceiverWorker::openListener(Listener &listener, int receiveBufferBytes, bool reusePort)
+{
+    const ReceiverEndpoint &endpoint = listener.endpoint;
+
+    // Socket objects are created here so they belong to the thread the
+    // worker runs on
+    if (BatchDatagramReader::isSupported()) {
+        listener.batchReader = new BatchDatagramReader;
+        listener.batchReader->setReceiveBufferSize(receiveBufferBytes);
+        listener.batchReader->setReusePort(reusePort);
+        if (!listener.batchReader->bind(endpoint.port, endpoint.group)) {
+            GPS_LOG_ERROR(Logger::Network, "Failed to bind UDP socket to {}: {}", endpoint.toString(),
+                          listener.batchReader->errorString());
+            delete listener.batchReader;
+            listener.batchReader = nullptr;
+            return false;
+        }
+
+        // The kernel reports twice the usable size
+        const int granted = listener.batchReader->receiveBufferSize() / 2;
+        if (receiveBufferBytes > 0 && granted < receiveBufferBytes) {
+            GPS_LOG_WARNING(Logger::Network,
+                            "Receive buffer on {} is {} bytes instead of {}; raise net.core.rmem_max",
+                            endpoint.toString(), granted, receiveBufferBytes);
+        }
+
+        listener.notifier = new QSocketNotifier(listener.batchReader->socketDescriptor(),
+                                                QSocketNotifier::Read, this);
+        // activated() is overloaded in Qt 5.15, hence the string-based connection
+        connect(listener.notifier, SIGNAL(activated(int)),
+                this, SLOT(processPendingDatagrams()));
+        return true;
+    }
+
+    listener.socket = new QUdpSocket(this);
+    bool bound;
+    if (endpoint.group.isNull()) {
+        // Shared, so multicast endpoints on the same port can bind too
+        bound = listener.socket->bind(QHostAddress::Any, endpoint.port,
+                                      QAbstractSocket::ShareAddress | QAbstractSocket::ReuseAddressHint);
+    } else {
+#ifdef Q_OS_WIN
+        // Windows cannot bind to a group address
+        const QHostAddress local(endpoint.group.protocol() == QAbstractSocket::IPv4Protocol
+                                     ? QHostAddress::AnyIPv4 : QHostAddress::AnyIPv6);
+#else
+        // Bound to the group, so other endpoints on the same port do not
+        // also receive its datagrams
+        const QHostAddress local = endpoint.group;
+#endif
+        bound = listener.socket->bind(local, endpoint.port,
+                                      QAbstractSocket::ShareAddress | QAbstractSocket::ReuseAddressHint)
+                && listener.socket->joinMulticastGroup(endpoint.group);
+    }
+    if (!bound) {
+        GPS_LOG_ERROR(Logger::Network, "Failed to bind UDP socket to {}: {}", endpoint.toString(),
+                      listener.socket->errorString());
+        delete listener.socket;
+        listener.socket = nullptr;
+        return false;
+    }
+
+    if (receiveBufferBytes > 0) {
+        listener.socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, receiveBufferBytes);
+    }
+    connect(listener.socket, &QUdpSocket::readyRead,
+            this, &UdpReceiverWorker::processPendingDatagrams);
+    return true;
+}
+
+void UdpReceiverWorker::closeListeners()
+{
+    for (Listener &listener : m_listeners) {
+        delete listener.notifier;
+        delete listener.batchReader;
+        delete listener.socket;
+    }
+    m_listeners.clear();
+}
+
+void UdpReceiverWorker::stopListening()
+{
+    if (m_isListening) {
+        closeListeners();
+        if (m_busTimer) {
+            m_busTimer->stop();
+            detachBus();
+            m_busName.clear();
+        }
+        m_connectionTimer->stop();
+        sealArchiveSegment();
+        qDeleteAll(m_nmeaStreams);
+        m_nmeaStreams.clear();
+        m_isListening = false;
+        m_isConnected = false;
+        emit connectionStatusChanged(false);
+        GPS_LOG_INFO(Logger::Network, "UDP receiver stopped");
+    }
+}
+
+void UdpReceiverWorker::beginDrain()
+{
+    // Cleared before popping so a push racing with the drain re-notifies
+    m_notifyPending.store(false, std::memory_order_release);
+}
+
+bool UdpReceiverWorker::takeFix(GpsFix &fix)
+{
+    return m_fixQueue.tryPop(fix);
+}
+
+quint64 UdpReceiverWorker::datagramsReceived() const
+{
+    return m_datagramsReceived.load(std::memory_order_relaxed);
+}
+
+quint64 UdpReceiverWorker::parseErrors() const
+{
+    return m_parseErrors.load(std::memory_order_relaxed);
+}
+
+quint64 UdpReceiverWorker::queueDrops() const
+{
+    return m_queueDrops.load(std::memory_order_relaxed);
+}
+
+quint64 UdpReceiverWorker::kernelDrops() const
+{
+    return m_kernelDrops.load(std::memory_order_relaxed);
+}
+
+quint64 UdpReceiverWorker::busOverruns() const
+{
+    return m_busOverruns.load(std::memory_order_relaxed);
+}
+
+void UdpReceiverWorker::processPendingDatagrams()
+{
+    // Only the socket that fired needs reading
+    const QObject *source = sender();
+    for (int i = 0; i < m_listeners.size(); ++i) {
+        Listener &listener = m_listeners[i];
+        if (source && source != listener.notifier && source != listener.socket) {
+            continue;
+        }
+        if (listener.batchReader) {
+            processBatchedDatagrams(listener);
+        } else {
+            processQueuedDatagrams(listener);
+        }
+    }
+}
+
+void UdpReceiverWorker::processBatchedDatagrams(Listener &listener)
+{
+    BatchDatagramReader *reader = listener.batchReader;
+    const GpsParser::Format formatHint = listener.endpoint.formatHint;
+    bool published = false;
+
+    while (true) {
+        const int count = reader->receiveBatch();
+        if (count < 0) {
+            emit errorOccurred(reader->errorString());
+            break;
+        }
+
+        // One clock read per batch: the whole batch arrived in one syscall
+        const qint64 receiveTimeUs = currentTimeUs();
+        m_receiveNs = LatencyMonitor::now();
+
+        for (int i = 0; i < count; ++i) {
+            if (reader->isTruncated(i)) {
+                m_datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+                m_parseErrors.fetch_add(1, std::memory_order_relaxed);
+                GPS_LOG_RATE_LIMITED(Logger::Warning, Logger::Network, 1,
+                                     "Dropped datagram larger than {} bytes",
+                                     int(BatchDatagramReader::MAX_DATAGRAM_SIZE));
+                continue;
+            }
+            processDatagram(reader->data(i), reader->size(i), reader->senderId(i), receiveTimeUs, true,
+                            formatHint);
+            if (m_pendingFixes.size() >= BatchDatagramReader::BATCH_SIZE) {
+                published |= publishPendingFixes();
+            }
+        }
+        published |= publishPendingFixes();
+
+        // A short batch means the socket is drained; skip the EAGAIN round trip
+        if (count < BatchDatagramReader::BATCH_SIZE) {
+            break;
+        }
+    }
+
+    const quint64 kernelDrops = reader->kernelDrops();
+    if (kernelDrops != listener.kernelDrops) {
+        m_kernelDrops.fetch_add(kernelDrops - listener.kernelDrops, std::memory_order_relaxed);
+        GPS_LOG_RATE_LIMITED(Logger::Warning, Logger::Network, 1,
+                             "Kernel dropped {} datagrams on {}: socket receive buffer full",
+                             kernelDrops - listener.kernelDrops, listener.endpoint.toString());
+        listener.kernelDrops = kernelDrops;
+    }
+
+    if (published) {
+        notifyConsumer();
+    }
+}
+
+void UdpReceiverWorker::processQueuedDatagrams(Listener &listener)
+{
+    QUdpSocket *socket = listener.socket;
+    bool published = false;
+
+    while (socket->hasPendingDatagrams()) {
+        QByteArray datagram;
+        datagram.resize(socket->pendingDatagramSize());
+        QHostAddress sender;
+        quint16 senderPort = 0;
+        socket->readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
+
+        const Q_IPV6ADDR address = sender.toIPv6Address();
+        m_receiveNs = LatencyMonitor::now();
+        processDatagram(datagram.constData(), datagram.size(),
+                        GpsFix::deviceIdFromAddress(address.c, senderPort), currentTimeUs(), true,
+                        listener.endpoint.formatHint);
+        if (m_pendingFixes.size() >= BatchDatagramReader::BATCH_SIZE) {
+            published |= publishPendingFixes();
+        }
+    }
+    published |= publishPendingFixes();
+
+    if (published) {
+        notifyConsumer();
+    }
+}
+
+void UdpReceiverWorker::processDatagram(const char *data, int size, quint32 senderId, qint64 receiveTimeUs,
+                                        bool archive, GpsParser::Format formatHint)
+{
+    m_datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+    GPS_LOG_TRACE(Logger::Network, "Datagram of {} bytes: {}", size, Logger::Text{ data, size });
+
+    // Captured before parsing so unparseable input is reproducible too
+    if (m_recorder && !m_recorder->append(receiveTimeUs, senderId, data, size)) {
+        // UdpReceiver stops the other workers' recording too
+        const QString error = m_recorder->errorString();
+        GPS_LOG_ERROR(Logger::Network, "Recording stopped: {}", error);
+        m_recorder.reset();
+        emit recordingFailed(error);
+    }
+
+    int count = 0;
+    quint64 errors = 0;
+    NmeaStream *nmeaStream = m_nmeaStreams.value(senderId, nullptr);
+    GpsParser::Format format = formatHint;
+    bool parsed = false;
+    if (format == GpsParser::UnknownFormat) {
+        format = GpsParser::detectFormat(data, size);
+
+        // The rest of a sentence split across datagrams starts with no
+        // recognizable format, or with a digit like CSV; datagrams in any
+        // other format from the same sender are parsed as such
+        if (nmeaStream && nmeaStream->hasPartialSentence()) {
+            if (format == GpsParser::CsvFormat) {
+                count = GpsParser::parse(data, size, m_decodedFixes, GpsParser::MAX_FIXES_PER_DATAGRAM);
+                parsed = count > 0;
+            }
+            if (format == GpsParser::UnknownFormat || (format == GpsParser::CsvFormat && !parsed)) {
+                format = GpsParser::NmeaFormat;
+            }
+        }
+    }
+
+    if (format == GpsParser::NmeaFormat) {
+        // NMEA keeps per-sender state: sentences may span datagrams and
+        // several sentences make up one fix
+        if (!nmeaStream) {
+            nmeaStream = createNmeaStream(senderId);
+        }
+        const quint64 rejectedBefore = nmeaStream->rejectedSentences();
+        count = nmeaStream->feed(data, size, m_decodedFixes, GpsParser::MAX_FIXES_PER_DATAGRAM);
+        errors = nmeaStream->rejectedSentences() - rejectedBefore;
+    } else if (formatHint != GpsParser::UnknownFormat && GpsParser::detectFormat(data, size) != formatHint) {
+        // Not what this endpoint carries
+        errors = 1;
+    } else {
+        if (!parsed) {
+            count = GpsParser::parse(data, size, m_decodedFixes, GpsParser::MAX_FIXES_PER_DATAGRAM);
+        }
+        errors = count == 0 ? 1 : 0;
+    }
+
+    if (errors > 0) {
+        m_parseErrors.fetch_add(errors, std::memory_order_relaxed);
+        GPS_LOG_RATE_LIMITED(Logger::Warning, Logger::Parser, 1,
+                             "Failed to parse GPS data: {}", Logger::Text{ data, size });
+        if (count == 0) {
+            return;
+        }
+    }
+
+    m_lastDataTime = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < count; ++i) {
+        GpsFix &fix = m_decodedFixes[i];
+        fix.timestampMs = receiveTimeUs / 1000;
+        fix.receiveNs = m_receiveNs;
+        if (fix.deviceId == 0) {
+            // No device ID in the payload: one track per sender address and port
+            fix.deviceId = senderId;
+        }
+        if (archive && m_archiveWriter) {
+            if (!m_archiveWriter->accepts(fix.timestampMs)) {
+                sealArchiveSegment();
+            }
+            m_archiveWriter->append(fix);
+        }
+        m_pendingFixes.append(fix);
+    }
+
+    if (!m_isConnected) {
+        m_isConnected = true;
+        emit connectionStatusChanged(true);
+    }
+}
+
+NmeaStream *UdpReceiverWorker::createNmeaStream(quint32 senderId)
+{
+    if (m_nmeaStreams.size() >= MAX_NMEA_STREAMS) {
+        // Departed senders are never noticed; start over rather than
+        // grow without bound
+        GPS_LOG_WARNING(Logger::Parser, "More than {} NMEA senders; resetting NMEA state",
+                        int(MAX_NMEA_STREAMS));
+        qDeleteAll(m_nmeaStreams);
+        m_nmeaStreams.clear();
+    }
+
+    NmeaStream *stream = new NmeaStream;
+    m_nmeaStreams.insert(senderId, stream);
+    return stream;
+}
+
+bool UdpReceiverWorker::publishPendingFixes()
+{
+    if (m_pendingFixes.isEmpty()) {
+        return false;
+    }
+
+    // Project the whole batch once here so the GUI thread never reprojects
+    WebMercator::project(m_pendingFixes.data(), m_pendingFixes.size());
+
+    // Local consumers see every fix, even those the queue sheds below
+    if (m_busWriter) {
+        m_busWriter->publish(m_pendingFixes.constData(), m_pendingFixes.size());
+    }
+
+    bool published = false;
+    LatencyMonitor &latency = LatencyMonitor::instance();
+    const qint64 nowNs = LatencyMonitor::now();
+    for (const GpsFix &fix : qAsConst(m_pendingFixes)) {
+        if (m_fixQueue.tryPush(fix)) {
+            latency.record(LatencyMonitor::Queued, fix.receiveNs, nowNs);
+            published = true;
+        } else {
+            // Consumer is behind; shed the newest fix rather than block the socket
+            m_queueDrops.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    m_pendingFixes.clear();
+    return published;
+}
+
+void UdpReceiverWorker::notifyConsumer()
+{
+    if (!m_notifyPending.exchange(true, std::memory_order_acq_rel)) {
+        emit fixesAvailable();
+    }
+}
+
+void UdpReceiverWorker::checkConnectionTimeout()
+{
+    // Bounds what a crash can lose from a recording to about a second
+    if (m_recorder) {
+        m_recorder->flush();
+    }
+
+    // Close the segment once its partition is over, even if input stopped
+    if (m_archiveWriter && !m_archiveWriter->accepts(QDateTime::currentMSecsSinceEpoch())) {
+        sealArchiveSegment();
+    }
+
+    // Parse failures are only counted per datagram; a malformed flood
+    // would otherwise queue one signal per datagram to the GUI
+    const quint64 parseErrors = m_parseErrors.load(std::memory_order_relaxed);
+    if (parseErrors != m_reportedParseErrors) {
+        emit errorOccurred(QString("Failed to parse GPS data (%1 errors)").arg(parseErrors - m_reportedParseErrors));
+        m_reportedParseErrors = parseErrors;
+    }
+
+    if (!m_isListening) {
+        return;
+    }
+
+    // A restarted producer creates a new ring under the same name
+    if (!m_busName.isEmpty()) {
+        if (m_busReader->isAttached() && m_busReader->isWriterGone()) {
+            GPS_LOG_INFO(Logger::Network, "Fix bus {} closed by its writer", m_busName);
+            detachBus();
+        }
+        if (!m_busReader->isAttached()) {
+            attachBus();
+        }
+    }
+
+    qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
+
+    if (m_isConnected && m_lastDataTime > 0) {
+        if (currentTime - m_lastDataTime > CONNECTION_TIMEOUT_MS) {
+            m_isConnected = false;
+            emit connectionStatusChanged(false);
+            GPS_LOG_INFO(Logger::Network, "Connection timeout - no data received for {} ms",
+                         int(CONNECTION_TIMEOUT_MS));
+        }
+    }
+}
+
+void UdpReceiverWorker::setRecorder(const std::shared_ptr<CaptureWriter> &recorder)
+{
+    m_recorder = recorder;
+}
+
+void UdpReceiverWorker::setBusWriter(const std::shared_ptr<FixBusWriter> &bus)
+{
+    m_busWriter = bus;
+}
+
+bool UdpReceiverWorker::attachBus()
+{
+    // Only records published from now on: the ring may hold minutes of
+    // fixes from before this receiver started
+    if (!m_busReader->attach(m_busName, FixBusReader::Latest)) {
+        GPS_LOG_DEBUG(Logger::Network, "Cannot attach to fix bus {}: {}", m_busName, m_busReader->errorString());
+        return false;
+    }
+    m_busReaderOverruns = 0;
+    GPS_LOG_INFO(Logger::Network, "Reading fix bus {}", m_busName);
+    return true;
+}
+
+void UdpReceiverWorker::detachBus()
+{
+    if (m_busReader) {
+        m_busReader->detach();
+    }
+}
+
+void UdpReceiverWorker::processBus()
+{
+    if (!m_busReader->isAttached()) {
+        return;
+    }
+
+    // A producer that keeps the ring full would otherwise hold the worker
+    // here and starve its sockets and queued calls
+    bool published = false;
+    bool received = false;
+    int read = 0;
+    int count;
+    do {
+        count = m_busReader->read(m_decodedFixes, GpsParser::MAX_FIXES_PER_DATAGRAM);
+        if (count == 0) {
+            break;
+        }
+
+        // Producers that stamped their fixes keep their times, so latency
+        // is traced from their own receive
+        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+        m_receiveNs = LatencyMonitor::now();
+        for (int i = 0; i < count; ++i) {
+            GpsFix &fix = m_decodedFixes[i];
+            if (fix.timestampMs == 0) {
+                fix.timestampMs = nowMs;
+            }
+            if (fix.receiveNs == 0) {
+                fix.receiveNs = m_receiveNs;
+            }
+            if (fix.deviceId == 0) {
+                fix.deviceId = m_busDeviceId;
+            }
+            if (m_archiveWriter) {
+                if (!m_archiveWriter->accepts(fix.timestampMs)) {
+                    sealArchiveSegment();
+                }
+                m_archiveWriter->append(fix);
+            }
+            m_pendingFixes.append(fix);
+        }
+        m_lastDataTime = nowMs;
+        received = true;
+        read += count;
+
+        if (m_pendingFixes.size() >= BatchDatagramReader::BATCH_SIZE) {
+            published |= publishPendingFixes();
+        }
+    } while (count == GpsParser::MAX_FIXES_PER_DATAGRAM && read < BUS_CHUNK);
+    published |= publishPendingFixes();
+
+    const quint64 overruns = m_busReader->overruns();
+    if (overruns != m_busReaderOverruns) {
+        m_busOverruns.fetch_add(overruns - m_busReaderOverruns, std::memory_order_relaxed);
+        GPS_LOG_RATE_LIMITED(Logger::Warning, Logger::Network, 1,
+                             "Fell {} records behind fix bus {}: ring overwritten before it was read",
+                             overruns - m_busReaderOverruns, m_busName);
+        m_busReaderOverruns = overruns;
+    }
+
+    if (published) {
+        notifyConsumer();
+    }
+    if (received && !m_isConnected) {
+        m_isConnected = true;
+        emit connectionStatusChanged(true);
+    }
+}
+
+bool UdpReceiverWorker::startReplay(const QString &path, double speed)
+{
+    stopReplay();
+
+    if (!m_replayReader) {
+        m_replayReader = new CaptureReader;
+    }
+    if (!m_replayReader->open(path)) {
+        GPS_LOG_ERROR(Logger::Network, "Cannot replay {}: {}", path, m_replayReader->errorString());
+        emit errorOccurred(m_replayReader->errorString());
+        return false;
+    }
+
+    if (!m_replayTimer) {
+        m_replayTimer = new QTimer(this);
+        m_replayTimer->setSingleShot(true);
+        m_replayTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_replayTimer, &QTimer::timeout, this, &UdpReceiverWorker::processReplay);
+    }
+
+    // Replayed NMEA must not be stitched onto sentences from before
+    qDeleteAll(m_nmeaStreams);
+    m_nmeaStreams.clear();
+
+    m_replaySpeed = speed;
+    restartReplayClock();
+    m_replayTimer->start(0);
+
+    GPS_LOG_INFO(Logger::Network, "Replaying {} at {}x", path, speed);
+    return true;
+}
+
+void UdpReceiverWorker::stopReplay()
+{
+    if (m_replayReader && m_replayReader->isOpen()) {
+        m_replayTimer->stop();
+        m_replayReader->close();
+        if (!m_isListening && m_isConnected) {
+            m_isConnected = false;
+            emit connectionStatusChanged(false);
+        }
+    }
+}
+
+bool UdpReceiverWorker::isReplaying() const
+{
+    return m_replayReader && m_replayReader->isOpen();
+}
+
+void UdpReceiverWorker::setReplaySpeed(double speed)
+{
+    m_replaySpeed = speed;
+    if (isReplaying()) {
+        restartReplayClock();
+        m_replayTimer->start(0);
+    }
+}
+
+void UdpReceiverWorker::seekReplay(qint64 timeUs)
+{
+    if (!isReplaying()) {
+        return;
+    }
+
+    m_replayReader->seek(timeUs);
+    qDeleteAll(m_nmeaStreams);
+    m_nmeaStreams.clear();
+    restartReplayClock();
+    m_replayTimer->start(0);
+}
+
+qint64 UdpReceiverWorker::replayStartTimeUs() const
+{
+    return m_replayReader ? m_replayReader->startTimeUs() : 0;
+}
+
+qint64 UdpReceiverWorker::replayEndTimeUs() const
+{
+    return m_replayReader ? m_replayReader->endTimeUs() : 0;
+}
+
+void UdpReceiverWorker::restartReplayClock()
+{
+    // Pacing is relative to the record the replay resumes from
+    CapturedDatagram datagram;
+    m_replayOriginUs = m_replayReader->peek(datagram) ? datagram.receiveTimeUs : 0;
+    m_replayClock.start();
+    m_lastReplayProgressMs = 0;
+}
+
+void UdpReceiverWorker::processReplay()
+{
+    if (!isReplaying()) {
+        return;
+    }
+
+    // Back-pressure instead of drops: replay waits for the consumer, so
+    // as-fast-as-possible runs measure the whole pipeline deterministically
+    if (m_fixQueue.size() > m_fixQueue.capacity() / 2) {
+        m_replayTimer->start(1);
+        return;
+    }
+
+    const bool paced = m_replaySpeed > 0.0;
+    const qint64 elapsedUs = m_replayClock.nsecsElapsed() / 1000;
+    bool published = false;
+    int processed = 0;
+    qint64 nextDueUs = -1;
+
+    CapturedDatagram datagram;
+    while (processed < REPLAY_CHUNK && m_replayReader->peek(datagram)) {
+        if (paced) {
+            const qint64 dueUs = qint64((datagram.receiveTimeUs - m_replayOriginUs) / m_replaySpeed);
+            if (dueUs > elapsedUs) {
+                nextDueUs = dueUs;
+                break;
+            }
+        }
+
+        // Fixes keep their captured receive time so replays are repeatable;
+        // latency is measured from the moment the replay reads them
+        m_receiveNs = LatencyMonitor::now();
+        processDatagram(datagram.data, datagram.size, datagram.senderId, datagram.receiveTimeUs, false,
+                        GpsParser::UnknownFormat);
+        m_replayReader->next();
+        ++processed;
+
+        if (m_pendingFixes.size() >= BatchDatagramReader::BATCH_SIZE) {
+            published |= publishPendingFixes();
+        }
+    }
+    published |= publishPendingFixes();
+
+    if (published) {
+        notifyConsumer();
+    }
+
+    const qint64 nowMs = m_replayClock.elapsed();
+    const bool finished = !m_replayReader->peek(datagram);
+    if (finished || nowMs - m_lastReplayProgressMs >= REPLAY_PROGRESS_INTERVAL_MS) {
+        m_lastReplayProgressMs = nowMs;
+        emit replayPosition(finished ? m_replayReader->endTimeUs() : datagram.receiveTimeUs);
+    }
+
+    if (finished) {
+        GPS_LOG_INFO(Logger::Network, "Replay finished");
+        emit replayFinished();
+        return;
+    }
+
+    // Sleep until the next record is due; otherwise yield to the event
+    // loop between chunks so stop/seek requests get through
+    m_replayTimer->start(nextDueUs >= 0 ? int((nextDueUs - elapsedUs) / 1000) : 0);
+}
+
+void UdpReceiverWorker::openArchive()
+{
+    if (m_archiveWriter) {
+        return;
+    }
+
+    m_archiveWriter = new TrackArchiveWriter;
+    if (!m_archiveWriter->open(m_archiveDirectory, m_archiveWriterId)) {
+        GPS_LOG_WARNING(Logger::Network, "Track archive disabled: {}", m_archiveWriter->errorString());
+        delete m_archiveWriter;
+        m_archiveWriter = nullptr;
+        return;
+    }
+    GPS_LOG_INFO(Logger::Network, "Archiving fixes to {}", m_archiveDirectory);
+}
+
+void UdpReceiverWorker::sealArchiveSegment()
+{
+    if (!m_archiveWriter || m_archiveWriter->isEmpty()) {
+        return;
+    }
+
+    const QString path = m_archiveWriter->seal();
+    if (path.isEmpty()) {
+        GPS_LOG_ERROR(Logger::Network, "Failed to write archive segment: {}", m_archiveWriter->errorString());
+        return;
+    }
+    GPS_LOG_DEBUG(Logger::Network, "Archive segment written: {}", path);
+    emit archiveSegmentSealed(path);
+}
@@ -0,0 +1,203 @@
+#ifndef UDPRECEIVERWORKER_H
+#define UDPRECEIVERWORKER_H
+
+#include <QObject>
+#include <QUdpSocket>
+#include <QTimer>
+#include <QHostAddress>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <memory>
+
+#include "gpsfix.h"
+#include "gpsparser.h"
+#include "receiverconfig.h"
+#include "spscqueue.h"
+
+QT_BEGIN_NAMESPACE
+class QSocketNotifier;
+QT_END_NAMESPACE
+
+class BatchDatagramReader;
+class CaptureReader;
+class CaptureWriter;
+class FixBusReader;
+class FixBusWriter;
+class NmeaStream;
+class TrackArchiveWriter;
+
+// Owns the UDP sockets, the parser and the connection-timeout timer.
+//
+// UdpReceiver moves the worker onto its own QThread so socket reads never
+// wait for the GUI event loop. Parsed fixes are handed to the consumer
+// through a bounded queue; fixesAvailable() is emitted once per batch of
+// pushes, not once per fix.
+//
+// The worker listens on every endpoint of a ReceiverConfig at once. On
+// Linux each socket is drained with recvmmsg() through BatchDatagramReader,
+// which also reports datagrams the kernel dropped; other platforms fall
+// back to QUdpSocket.
+//
+// Every datagram can be recorded to a capture file, and a capture can be
+// replayed through the same parse path in place of (or alongside) the
+// socket, paced at its original rate times a speed factor or, with speed
+// 0, as fast as the consumer keeps up.
+//
+// Live fixes are also appended to the track archive (TrackArchive); each
+// sealed segment is announced with archiveSegmentSealed(). Replayed fixes
+// are already in the archive or belong to someone else's, so they are not
+// archived again.
+//
+// The first worker can also read fixes from a shared-memory fix bus
+// (FixBusReader), polled every millisecond, as if they came from a socket:
+// they are projected, archived and queued like parsed fixes. Every worker
+// can publish the fixes it hands to the consumer to an output bus.
+class UdpReceiverWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UdpReceiverWorker(int queueCapacity, QObject *parent = nullptr);
+    ~UdpReceiverWorker();
+
+    // workerIndex is this worker's position among the receiver threads
+    // sharing config; workers after the first open only the unicast
+    // endpoints and tag their archive segments with their index
+    bool startListening(const ReceiverConfig &config, int workerIndex = 0);
+    void stopListening();
+
+    // Consumer side: call beginDrain() before popping queued fixes
+    void beginDrain();
+    bool takeFix(GpsFix &fix);
+
+    quint64 datagramsReceived() const;
+    quint64 parseErrors() const;
+    quint64 queueDrops() const;
+    quint64 kernelDrops() const;
+
+    // Bus records overwritten before the input bus reader got to them
+    quint64 busOverruns() const;
+
+    // Every datagram is appended to recorder until it is replaced or
+    // cleared; several workers may share one CaptureWriter
+    void setRecorder(const std::shared_ptr<CaptureWriter> &recorder);
+
+    // Every projected fix is published to bus until it is replaced or
+    // cleared; several workers may share one FixBusWriter
+    void setBusWriter(const std::shared_ptr<FixBusWriter> &bus);
+
+    // speed is a multiple of real time; 0 replays as fast as possible
+    bool startReplay(const QString &path, double speed);
+    void stopReplay();
+    bool isReplaying() const;
+    void setReplaySpeed(double speed);
+    void seekReplay(qint64 timeUs);
+    qint64 replayStartTimeUs() const;
+    qint64 replayEndTimeUs() const;
+
+signals:
+    void fixesAvailable();
+    void connectionStatusChanged(bool connected);
+    void errorOccurred(const QString &error);
+    void replayPosition(qint64 timeUs);
+    void replayFinished();
+    void archiveSegmentSealed(const QString &path);
+
+    // Appending to the shared recorder failed; this worker has let go of it
+    void recordingFailed(const QString &error);
+
+private slots:
+    void processPendingDatagrams();
+    void checkConnectionTimeout();
+    void processReplay();
+    void processBus();
+
+private:
+    struct Listener
+    {
+        ReceiverEndpoint endpoint;
+        BatchDatagramReader *batchReader = nullptr;
+        QSocketNotifier *notifier = nullptr;
+        QUdpSocket *socket = nullptr;
+        quint64 kernelDrops = 0; // Already added to m_kernelDrops
+    };
+
+    bool openListener(Listener &listener, int receiveBufferBytes, bool reusePort);
+    void closeListeners();
+    void processBatchedDatagrams(Listener &listener);
+    void processQueuedDatagrams(Listener &listener);
+    void processDatagram(const char *data, int size, quint32 senderId, qint64 receiveTimeUs, bool archive,
+                         GpsParser::Format formatHint);
+    void openArchive();
+    void sealArchiveSegment();
+    NmeaStream *createNmeaStream(quint32 senderId);
+    void restartReplayClock();
+    bool attachBus();
+    void detachBus();
+    bool publishPendingFixes();
+    void notifyConsumer();
+
+    QVector<Listener> m_listeners;
+    bool m_isListening;
+
+    // Fixes parsed from the current batch, projected together before hand-off
+    QVector<GpsFix> m_pendingFixes;
+
+    // Decode target for one datagram; binary datagrams carry several fixes
+    GpsFix m_decodedFixes[GpsParser::MAX_FIXES_PER_DATAGRAM];
+
+    // NMEA sentence and epoch state per sender
+    QHash<quint32, NmeaStream *> m_nmeaStreams;
+    static const int MAX_NMEA_STREAMS = 1024;
+
+    // Hand-off to the consumer thread
+    SpscQueue<GpsFix> m_fixQueue;
+    std::atomic<bool> m_notifyPending;
+
+    // Statistics, readable from any thread
+    std::atomic<quint64> m_datagramsReceived;
+    std::atomic<quint64> m_parseErrors;
+    std::atomic<quint64> m_queueDrops;
+    std::atomic<quint64> m_kernelDrops;
+    std::atomic<quint64> m_busOverruns;
+    quint64 m_reportedParseErrors; // Already announced with errorOccurred()
+
+    // Connection monitoring
+    QTimer *m_connectionTimer;
+    qint64 m_lastDataTime;
+    static const int CONNECTION_TIMEOUT_MS = 5000; // 5 seconds
+    bool m_isConnected;
+
+    // Record and replay
+    std::shared_ptr<CaptureWriter> m_recorder;
+    CaptureReader *m_replayReader;
+    QTimer *m_replayTimer;
+    QElapsedTimer m_replayClock;
+    qint64 m_replayOriginUs;
+    double m_replaySpeed;
+    qint64 m_lastReplayProgressMs;
+
+    // LatencyMonitor::now() when the datagrams being processed were read
+    qint64 m_receiveNs;
+    static const int REPLAY_CHUNK = 4096; // Datagrams per event loop pass
+    static const int REPLAY_PROGRESS_INTERVAL_MS = 100;
+
+    // Fix bus input (first worker only) and output
+    FixBusReader *m_busReader;
+    QTimer *m_busTimer;
+    QString m_busName;
+    quint32 m_busDeviceId; // For records that carry no device ID
+    quint64 m_busReaderOverruns; // Already added to m_busOverruns
+    std::shared_ptr<FixBusWriter> m_busWriter;
+    static const int BUS_POLL_INTERVAL_MS = 1;
+    static const int BUS_CHUNK = 4096; // Records per poll; the timer resumes
+
+    // Persistent history of live fixes
+    TrackArchiveWriter *m_archiveWriter;
+    int m_archiveWriterId;
+    QString m_archiveDirectory;
+};
+
+#endif // UDPRECEIVERWORKER_H
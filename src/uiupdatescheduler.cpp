@@ -0,0 +1,70 @@
+#include "uiupdatescheduler.h"
+
+UiUpdateScheduler::UiUpdateScheduler(int framesPerSecond, QObject *parent)
+    : QObject(parent)
+    , m_timer(nullptr)
+    , m_frameRate(0)
+    , m_framesDelivered(0)
+    , m_fixesDelivered(0)
+{
+    m_timer = new QTimer(this);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &UiUpdateScheduler::onTick);
+
+    setFrameRate(framesPerSecond);
+}
+
+int UiUpdateScheduler::frameRate() const
+{
+    return m_frameRate;
+}
+
+void UiUpdateScheduler::setFrameRate(int framesPerSecond)
+{
+    m_frameRate = qBound(1, framesPerSecond, 240);
+    m_timer->setInterval(1000 / m_frameRate);
+}
+
+void UiUpdateScheduler::submit(const QVector<GpsFix> &fixes)
+{
+    if (fixes.isEmpty()) {
+        return;
+    }
+
+    m_latest = fixes.last();
+    m_pending += fixes;
+
+    if (!m_timer->isActive()) {
+        m_timer->start();
+    }
+}
+
+quint64 UiUpdateScheduler::framesDelivered() const
+{
+    return m_framesDelivered;
+}
+
+quint64 UiUpdateScheduler::fixesDelivered() const
+{
+    return m_fixesDelivered;
+}
+
+void UiUpdateScheduler::onTick()
+{
+    if (m_pending.isEmpty()) {
+        // Nothing arrived during the last frame; sleep until the next submit()
+        m_timer->stop();
+        return;
+    }
+
+    // Swap buffers so receivers may submit() while handling the frame;
+    // both vectors keep their capacity between frames
+    m_delivering.swap(m_pending);
+    m_pending.clear();
+
+    ++m_framesDelivered;
+    m_fixesDelivered += quint64(m_delivering.size());
+
+    emit frameReady(m_latest, m_delivering);
+    m_delivering.clear();
+}
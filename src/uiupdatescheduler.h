@@ -0,0 +1,51 @@
+#ifndef UIUPDATESCHEDULER_H
+#define UIUPDATESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include "gpsfix.h"
+
+// Paces GUI updates to a fixed frame rate.
+//
+// Incoming fixes overwrite a latest-value slot and are appended to a
+// pending batch. On each timer tick the newest fix and the whole batch are
+// delivered once through frameReady(), so widgets and the map canvas are
+// touched at most once per frame regardless of the feed rate, while the
+// trail still receives every fix. The timer idles when nothing arrives.
+class UiUpdateScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UiUpdateScheduler(int framesPerSecond, QObject *parent = nullptr);
+
+    int frameRate() const;
+    void setFrameRate(int framesPerSecond);
+
+    void submit(const QVector<GpsFix> &fixes);
+
+    // Frames delivered and fixes coalesced into them, for diagnostics
+    quint64 framesDelivered() const;
+    quint64 fixesDelivered() const;
+
+signals:
+    void frameReady(const GpsFix &latest, const QVector<GpsFix> &fixes);
+
+private slots:
+    void onTick();
+
+private:
+    QTimer *m_timer;
+    int m_frameRate;
+
+    GpsFix m_latest;
+    QVector<GpsFix> m_pending;
+    QVector<GpsFix> m_delivering;
+
+    quint64 m_framesDelivered;
+    quint64 m_fixesDelivered;
+};
+
+#endif // UIUPDATESCHEDULER_H
@@ -0,0 +1,152 @@
+#include "webmercator.h"
+
+#include <QtGlobal>
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  define GPS_MERCATOR_SSE2
+#  include <emmintrin.h>
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const double DEGREES_TO_RADIANS = PI / 180.0;
+
+#ifdef GPS_MERCATOR_SSE2
+
+// Odd Taylor series of sin() up to x^19; the latitude clamp keeps
+// |x| <= 1.485 rad, where the truncation error is below 1e-16
+inline __m128d sinSse2(__m128d x)
+{
+    const __m128d x2 = _mm_mul_pd(x, x);
+    __m128d p = _mm_set1_pd(-1.0 / 121645100408832000.0);
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(1.0 / 355687428096000.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(-1.0 / 1307674368000.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(1.0 / 6227020800.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(-1.0 / 39916800.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(1.0 / 362880.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(-1.0 / 5040.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(1.0 / 120.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(-1.0 / 6.0));
+    return _mm_add_pd(x, _mm_mul_pd(_mm_mul_pd(p, x2), x));
+}
+
+// Natural log of positive, normal doubles: split off the binary exponent,
+// fold the mantissa into [sqrt(1/2), sqrt(2)) and evaluate 2*atanh(t)
+inline __m128d logSse2(__m128d v)
+{
+    const __m128i bits = _mm_castpd_si128(v);
+
+    __m128d mantissa = _mm_castsi128_pd(_mm_or_si128(
+        _mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+        _mm_set1_epi64x(0x3FF0000000000000LL)));
+
+    // Biased exponent to double via the 2^52 magic-number trick
+    const __m128i exponentBits = _mm_srli_epi64(bits, 52);
+    const __m128d magic = _mm_set1_pd(4503599627370496.0); // 2^52
+    __m128d exponent = _mm_sub_pd(
+        _mm_castsi128_pd(_mm_or_si128(exponentBits, _mm_castpd_si128(magic))), magic);
+    exponent = _mm_sub_pd(exponent, _mm_set1_pd(1023.0));
+
+    const __m128d large = _mm_cmpgt_pd(mantissa, _mm_set1_pd(1.4142135623730951));
+    mantissa = _mm_add_pd(_mm_andnot_pd(large, mantissa),
+                          _mm_and_pd(large, _mm_mul_pd(mantissa, _mm_set1_pd(0.5))));
+    exponent = _mm_add_pd(exponent, _mm_and_pd(large, _mm_set1_pd(1.0)));
+
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d t = _mm_div_pd(_mm_sub_pd(mantissa, one), _mm_add_pd(mantissa, one));
+    const __m128d t2 = _mm_mul_pd(t, t);
+
+    // |t| <= 0.1716, so terms up to t^21 reach full double precision
+    __m128d p = _mm_set1_pd(1.0 / 21.0);
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 19.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 17.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 15.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 13.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 11.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 9.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 7.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 5.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(1.0 / 3.0));
+    p = _mm_add_pd(_mm_mul_pd(p, t2), one);
+    const __m128d logMantissa = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(2.0), t), p);
+
+    return _mm_add_pd(_mm_mul_pd(exponent, _mm_set1_pd(0.6931471805599453)), logMantissa);
+}
+
+// y = R * atanh(sin(lat)) = R/2 * log((1 + sin) / (1 - sin)), which needs
+// no tan() and stays accurate up to the latitude clamp
+inline void projectSse2(__m128d longitude, __m128d latitude, __m128d &x, __m128d &y)
+{
+    const __m128d limit = _mm_set1_pd(WebMercator::MAX_LATITUDE);
+    latitude = _mm_max_pd(_mm_min_pd(latitude, limit), _mm_sub_pd(_mm_setzero_pd(), limit));
+
+    const __m128d scale = _mm_set1_pd(WebMercator::EARTH_RADIUS * DEGREES_TO_RADIANS);
+    x = _mm_mul_pd(longitude, scale);
+
+    const __m128d s = sinSse2(_mm_mul_pd(latitude, _mm_set1_pd(DEGREES_TO_RADIANS)));
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d ratio = _mm_div_pd(_mm_add_pd(one, s), _mm_sub_pd(one, s));
+    y = _mm_mul_pd(logSse2(ratio), _mm_set1_pd(0.5 * WebMercator::EARTH_RADIUS));
+}
+
+#endif // GPS_MERCATOR_SSE2
+
+} // namespace
+
+void WebMercator::project(double longitude, double latitude, double &x, double &y)
+{
+    latitude = qBound(-MAX_LATITUDE, latitude, MAX_LATITUDE);
+    x = EARTH_RADIUS * longitude * DEGREES_TO_RADIANS;
+    y = EARTH_RADIUS * std::log(std::tan(PI / 4.0 + latitude * DEGREES_TO_RADIANS / 2.0));
+}
+
+void WebMercator::project(const double *longitude, const double *latitude,
+                          double *x, double *y, int count)
+{
+    int i = 0;
+#ifdef GPS_MERCATOR_SSE2
+    for (; i + 2 <= count; i += 2) {
+        __m128d px;
+        __m128d py;
+        projectSse2(_mm_loadu_pd(longitude + i), _mm_loadu_pd(latitude + i), px, py);
+        _mm_storeu_pd(x + i, px);
+        _mm_storeu_pd(y + i, py);
+    }
+#endif
+    for (; i < count; ++i) {
+        project(longitude[i], latitude[i], x[i], y[i]);
+    }
+}
+
+void WebMercator::project(GpsFix *fixes, int count)
+{
+    int i = 0;
+#ifdef GPS_MERCATOR_SSE2
+    for (; i + 2 <= count; i += 2) {
+        GpsFix &a = fixes[i];
+        GpsFix &b = fixes[i + 1];
+        __m128d px;
+        __m128d py;
+        projectSse2(_mm_set_pd(b.longitude, a.longitude), _mm_set_pd(b.latitude, a.latitude), px, py);
+        _mm_storel_pd(&a.mapX, px);
+        _mm_storeh_pd(&b.mapX, px);
+        _mm_storel_pd(&a.mapY, py);
+        _mm_storeh_pd(&b.mapY, py);
+    }
+#endif
+    for (; i < count; ++i) {
+        project(fixes[i].longitude, fixes[i].latitude, fixes[i].mapX, fixes[i].mapY);
+    }
+}
+
+bool WebMercator::hasSimdKernel()
+{
+#ifdef GPS_MERCATOR_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
@@ -3,7 +3,7 @@
 GPS UDP Test Sender
 
 This script sends simulated GPS data via UDP to test the GPS Map Viewer application.
-It supports multiple data formats: JSON, CSV, and NMEA.
+It supports multiple data formats: JSON, CSV, NMEA, and the compact binary format.
 
 Usage:
     python3 test_sender.py [options]
@@ -11,31 +11,48 @@ Usage:
 Options:
     --host HOST     Target host (default: localhost)
     --port PORT     Target port (default: 12345)
-    --format FORMAT Data format: json, csv, nmea (default: json)
+    --format FORMAT Data format: json, csv, nmea, binary (default: json)
     --interval SEC  Send interval in seconds (default: 1.0)
     --simulate      Simulate moving GPS coordinates (default: False)
+    --devices N     Number of simulated devices, each with its own socket (default: 1)
+    --pack N        Fixes per binary datagram (default: 32)
     --help          Show this help message
 """
 
 import socket
+import struct
 import time
 import json
 import math
 import argparse
 import sys
-from datetime import datetime
+from datetime import datetime, timezone
+
+# Binary wire format (see src/gpsparser.h): little-endian header and records
+BINARY_HEADER = struct.Struct('<BBBB')         # magic 0xA5, 'G', version, count
+BINARY_RECORD = struct.Struct('<IqiiiHHHBB')   # 32 bytes per fix
+BINARY_MAX_FIXES = 255
+HAS_SPEED, HAS_HEADING, HAS_ACCURACY = 0x01, 0x02, 0x04
+
+def device_id(name):
+    """FNV-1a of a device name, matching GpsFix::deviceIdFromName()"""
+    h = 2166136261
+    for byte in name.encode('utf-8'):
+        h = ((h ^ byte) * 16777619) & 0xFFFFFFFF
+    return h or 1
 
 class GPSSimulator:
-    def __init__(self):
-        # Starting position (example: New York City)
-        self.base_lat = 40.7128
-        self.base_lon = -74.0060
+    def __init__(self, index=0):
+        # Starting position (example: New York City); further devices are
+        # spread out on a grid around it
+        self.base_lat = 40.7128 + (index // 32) * 0.02
+        self.base_lon = -74.0060 + (index % 32) * 0.02
         self.base_alt = 10.0
         
         # Movement parameters
         self.radius = 0.01  # Movement radius in degrees
         self.speed = 0.1    # Movement speed
-        self.time_offset = 0
+        self.time_offset = index
         
     def get_position(self, simulate_movement=False):
         """Get current GPS position"""
@@ -55,13 +72,15 @@ class GPSSimulator:
         return lat, lon, alt
 
 class UDPSender:
-    def __init__(self, host='localhost', port=12345):
+    def __init__(self, host='localhost', port=12345, devices=1, pack=32):
         self.host = host
         self.port = port
-        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-        self.gps_sim = GPSSimulator()
+        self.pack = max(1, min(pack, BINARY_MAX_FIXES))
+        # One socket per device so CSV/NMEA sources are told apart by port
+        self.sockets = [socket.socket(socket.AF_INET, socket.SOCK_DGRAM) for _ in range(devices)]
+        self.gps_sims = [GPSSimulator(i) for i in range(devices)]
         
-    def format_json(self, lat, lon, alt):
+    def format_json(self, lat, lon, alt, device=None):
         """Format GPS data as JSON"""
         data = {
             "latitude": lat,
@@ -72,14 +91,24 @@ class UDPSender:
             "speed": 0.0,
             "heading": 0.0
         }
+        if device is not None:
+            data["device_id"] = f"sim-{device}"
         return json.dumps(data).encode('utf-8')
     
     def format_csv(self, lat, lon, alt):
         """Format GPS data as CSV"""
         return f"{lat:.6f},{lon:.6f},{alt:.2f}".encode('utf-8')
     
+    @staticmethod
+    def nmea_sentence(body):
+        """Wrap an NMEA sentence body with '$' and its XOR checksum"""
+        checksum = 0
+        for char in body.encode('ascii'):
+            checksum ^= char
+        return f"${body}*{checksum:02X}\r\n"
+    
     def format_nmea(self, lat, lon, alt):
-        """Format GPS data as NMEA GPGGA sentence"""
+        """Format GPS data as one NMEA epoch: GPRMC followed by GPGGA"""
         # Convert decimal degrees to NMEA format
         lat_deg = int(abs(lat))
         lat_min = (abs(lat) - lat_deg) * 60
@@ -89,13 +118,28 @@ class UDPSender:
         lon_min = (abs(lon) - lon_deg) * 60
         lon_dir = 'E' if lon >= 0 else 'W'
         
-        # Create GPGGA sentence (simplified)
-        time_str = datetime.now().strftime("%H%M%S")
+        now = datetime.now(timezone.utc)
+        time_str = now.strftime("%H%M%S.") + f"{now.microsecond // 10000:02d}"
+        date_str = now.strftime("%d%m%y")
         lat_str = f"{lat_deg:02d}{lat_min:07.4f}"
         lon_str = f"{lon_deg:03d}{lon_min:07.4f}"
         
-        sentence = f"$GPGGA,{time_str},{lat_str},{lat_dir},{lon_str},{lon_dir},1,08,1.0,{alt:.1f},M,46.9,M,,*47"
-        return sentence.encode('utf-8')
+        rmc = self.nmea_sentence(f"GPRMC,{time_str},A,{lat_str},{lat_dir},{lon_str},{lon_dir},0.0,0.0,{date_str},,,A")
+        gga = self.nmea_sentence(f"GPGGA,{time_str},{lat_str},{lat_dir},{lon_str},{lon_dir},1,08,1.0,{alt:.1f},M,46.9,M,,")
+        return (rmc + gga).encode('ascii')
+    
+    def format_binary_record(self, lat, lon, alt, device=None):
+        """Format one GPS fix as a 32-byte binary record"""
+        return BINARY_RECORD.pack(
+            device_id(f"sim-{device}") if device is not None else 0,
+            int(time.time() * 1000),
+            round(lat * 1e7), round(lon * 1e7), round(alt * 1000),
+            0, 0, 350,  # speed cm/s, heading 0.01 deg, accuracy cm
+            HAS_SPEED | HAS_HEADING | HAS_ACCURACY, 0)
+    
+    def format_binary(self, records):
+        """Pack up to 255 binary records into one datagram"""
+        return BINARY_HEADER.pack(0xA5, ord('G'), 1, len(records)) + b''.join(records)
     
     def send_data(self, data_format='json', simulate_movement=False, interval=1.0):
         """Send GPS data continuously"""
@@ -104,28 +148,46 @@ class UDPSender:
         print(f"Format: {data_format}")
         print(f"Interval: {interval}s")
         print(f"Movement: {'Simulated' if simulate_movement else 'Static with noise'}")
+        print(f"Devices: {len(self.sockets)}")
+        if data_format == 'binary':
+            print(f"Fixes per datagram: {self.pack}")
         print("Press Ctrl+C to stop\n")
         
         try:
             while True:
-                lat, lon, alt = self.gps_sim.get_position(simulate_movement)
-                
-                # Format data according to specified format
-                if data_format == 'json':
-                    data = self.format_json(lat, lon, alt)
-                elif data_format == 'csv':
-                    data = self.format_csv(lat, lon, alt)
-                elif data_format == 'nmea':
-                    data = self.format_nmea(lat, lon, alt)
-                else:
-                    raise ValueError(f"Unknown format: {data_format}")
+                records = []
+                for device, (sock, gps_sim) in enumerate(zip(self.sockets, self.gps_sims)):
+                    lat, lon, alt = gps_sim.get_position(simulate_movement)
+                    tag = device if len(self.sockets) > 1 else None
+                    
+                    # Binary fixes are packed several to a datagram below
+                    if data_format == 'binary':
+                        records.append(self.format_binary_record(lat, lon, alt, tag))
+                        continue
+                    
+                    # Format data according to specified format
+                    if data_format == 'json':
+                        data = self.format_json(lat, lon, alt, tag)
+                    elif data_format == 'csv':
+                        data = self.format_csv(lat, lon, alt)
+                    elif data_format == 'nmea':
+                        data = self.format_nmea(lat, lon, alt)
+                    else:
+                        raise ValueError(f"Unknown format: {data_format}")
+                    
+                    # Send data
+                    sock.sendto(data, (self.host, self.port))
                 
-                # Send data
-                self.socket.sendto(data, (self.host, self.port))
+                for start in range(0, len(records), self.pack):
+                    data = self.format_binary(records[start:start + self.pack])
+                    self.sockets[0].sendto(data, (self.host, self.port))
                 
                 # Print status
                 timestamp = datetime.now().strftime("%H:%M:%S")
-                print(f"[{timestamp}] Sent: Lat={lat:.6f}, Lon={lon:.6f}, Alt={alt:.2f}m")
+                if len(self.sockets) == 1:
+                    print(f"[{timestamp}] Sent: Lat={lat:.6f}, Lon={lon:.6f}, Alt={alt:.2f}m")
+                else:
+                    print(f"[{timestamp}] Sent {len(self.sockets)} fixes")
                 
                 time.sleep(interval)
                 
@@ -134,23 +196,28 @@ class UDPSender:
         except Exception as e:
             print(f"Error: {e}")
         finally:
-            self.socket.close()
+            for sock in self.sockets:
+                sock.close()
 
 def main():
     parser = argparse.ArgumentParser(description='GPS UDP Test Sender')
     parser.add_argument('--host', default='localhost', help='Target host (default: localhost)')
     parser.add_argument('--port', type=int, default=12345, help='Target port (default: 12345)')
-    parser.add_argument('--format', choices=['json', 'csv', 'nmea'], default='json',
+    parser.add_argument('--format', choices=['json', 'csv', 'nmea', 'binary'], default='json',
                        help='Data format (default: json)')
     parser.add_argument('--interval', type=float, default=1.0,
                        help='Send interval in seconds (default: 1.0)')
     parser.add_argument('--simulate', action='store_true',
                        help='Simulate moving GPS coordinates')
+    parser.add_argument('--devices', type=int, default=1,
+                       help='Number of simulated devices (default: 1)')
+    parser.add_argument('--pack', type=int, default=32,
+                       help='Fixes per binary datagram (default: 32)')
     
     args = parser.parse_args()
     
     # Create and start sender
-    sender = UDPSender(args.host, args.port)
+    sender = UDPSender(args.host, args.port, max(1, args.devices), args.pack)
     sender.send_data(args.format, args.simulate, args.interval)
 
 if __name__ == '__main__':
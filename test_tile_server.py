@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""
+Stand-in XYZ Tile Server
+
+Serves generated 256x256 PNG tiles so the tile cache, prefetch and offline
+mode of the GPS Map Viewer can be exercised without internet access. Each
+tile is a solid colour derived from its z/x/y, so cached and fresh tiles
+are easy to tell apart on screen.
+
+Usage:
+    python3 test_tile_server.py [options]
+    GPS_TILE_OSM_URL='http://127.0.0.1:8088/{z}/{x}/{y}.png' ./GPSMapViewer
+
+Options:
+    --port PORT       Listen port (default: 8088)
+    --delay SEC       Delay before each response, to mimic a slow uplink (default: 0)
+    --fail-rate RATE  Fraction of requests answered with HTTP 503 (default: 0)
+    --help            Show this help message
+"""
+
+import argparse
+import random
+import re
+import struct
+import threading
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+TILE_SIZE = 256
+TILE_PATH = re.compile(r'^/(\d+)/(\d+)/(\d+)(\.png)?$')
+
+
+def make_png(red, green, blue):
+    """Encode a solid-colour RGB tile"""
+    def chunk(kind, data):
+        body = kind + data
+        return struct.pack('>I', len(data)) + body + struct.pack('>I', zlib.crc32(body) & 0xffffffff)
+
+    row = b'\x00' + bytes((red, green, blue)) * TILE_SIZE
+    header = struct.pack('>IIBBBBB', TILE_SIZE, TILE_SIZE, 8, 2, 0, 0, 0)
+    return (b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', header)
+            + chunk(b'IDAT', zlib.compress(row * TILE_SIZE, 9)) + chunk(b'IEND', b''))
+
+
+class TileStats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.served = 0
+        self.failed = 0
+
+    def record(self, ok):
+        with self.lock:
+            if ok:
+                self.served += 1
+            else:
+                self.failed += 1
+            return self.served, self.failed
+
+
+class TileHandler(BaseHTTPRequestHandler):
+    delay = 0.0
+    fail_rate = 0.0
+    stats = TileStats()
+
+    def do_GET(self):
+        match = TILE_PATH.match(self.path.split('?')[0])
+        if not match:
+            self.send_error(404)
+            return
+
+        z, x, y = (int(v) for v in match.groups()[:3])
+        if x >= 2 ** z or y >= 2 ** z:
+            self.send_error(404)
+            return
+
+        if self.delay > 0:
+            time.sleep(self.delay)
+
+        if random.random() < self.fail_rate:
+            self.stats.record(False)
+            self.send_error(503)
+            return
+
+        body = make_png((z * 40) % 256, (x * 7) % 256, (y * 13) % 256)
+        self.send_response(200)
+        self.send_header('Content-Type', 'image/png')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+        served, failed = self.stats.record(True)
+        print(f"tile {z}/{x}/{y}  served={served} failed={failed}")
+
+    def log_message(self, format, *args):
+        # Per-tile lines are printed by do_GET
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stand-in XYZ Tile Server')
+    parser.add_argument('--port', type=int, default=8088, help='Listen port (default: 8088)')
+    parser.add_argument('--delay', type=float, default=0.0,
+                        help='Delay before each response in seconds (default: 0)')
+    parser.add_argument('--fail-rate', type=float, default=0.0,
+                        help='Fraction of requests answered with HTTP 503 (default: 0)')
+
+    args = parser.parse_args()
+
+    TileHandler.delay = args.delay
+    TileHandler.fail_rate = args.fail_rate
+
+    server = ThreadingHTTPServer(('127.0.0.1', args.port), TileHandler)
+    print(f"Serving tiles on http://127.0.0.1:{args.port}/{{z}}/{{x}}/{{y}}.png")
+    print("Press Ctrl+C to stop")
+
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        print("\nStopped")
+        print(f"Tiles served: {TileHandler.stats.served}, failed: {TileHandler.stats.failed}")
+
+
+if __name__ == '__main__':
+    main()